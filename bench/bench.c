@@ -0,0 +1,624 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: bench/bench.c
+ * Purpose: uaengine_bench - repeatable microbenchmarks over a synthetic book
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Generates a book (corpus.h), then times the hot paths of build, export
+ *     and serve against it: slugify, qsort_nat_ci_cmp, list_tree_files,
+ *     concat_md_dir, pack_book_draft, light_export_html, request-line
+ *     parsing, serve_run round trips and ueng_parallel_for scaling.
+ *   - Each benchmark runs once to warm caches, then --reps times; the median
+ *     is the figure compared. Results print as a table and, with --json, as
+ *     a JSON file that a later run reads back with --baseline: a median more
+ *     than --tolerance percent slower than the baseline is a regression and
+ *     the exit status is 1.
+ *   - Not part of `ctest`: timings depend on the machine. Keep baselines
+ *     per machine (see docs/DEVELOPMENT.md).
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "corpus.h"
+#include "ueng/common.h"
+#include "ueng/fs.h"
+#include "ueng/hash.h"
+#include "ueng/pool.h"
+#include "ueng/serve.h"
+#include "ueng/version.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <direct.h> /* _chdir, _rmdir */
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET bench_socket_t;
+#define closesock closesocket
+#define chdir _chdir
+#define rmdir _rmdir
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int bench_socket_t;
+#define closesock close
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------ harness -------------------------------------*/
+
+#define MAX_REPS 64
+#define MAX_RESULTS 64
+
+typedef struct
+{
+  char name[48];
+  const char *unit; /* "MB/s" or "ops/s" */
+  double work;      /* MB or operations per repetition */
+  double median, min, mean;
+  int has_base;
+  double base; /* baseline median, ms */
+} BenchResult;
+
+static struct
+{
+  int reps;
+  const char *filter;
+  BenchResult res[MAX_RESULTS];
+  size_t n;
+} g_bench;
+
+static int cmp_double(const void *A, const void *B)
+{
+  double a = *(const double *)A, b = *(const double *)B;
+  return (a > b) - (a < b);
+}
+
+static void bench_run(const char *name, const char *unit, double work, void (*fn)(void *),
+                      void *ctx)
+{
+  if ((g_bench.filter && !strstr(name, g_bench.filter)) || g_bench.n == MAX_RESULTS)
+    return;
+  double ms[MAX_REPS];
+  fn(ctx); /* warm-up: page cache, allocator, lazily created pool */
+  for (int r = 0; r < g_bench.reps; ++r)
+  {
+    double t0 = ueng_now_ms();
+    fn(ctx);
+    ms[r] = ueng_now_ms() - t0;
+  }
+  qsort(ms, (size_t)g_bench.reps, sizeof(double), cmp_double);
+  BenchResult *b = &g_bench.res[g_bench.n++];
+  memset(b, 0, sizeof(*b));
+  snprintf(b->name, sizeof(b->name), "%s", name);
+  b->unit = unit;
+  b->work = work;
+  b->min = ms[0];
+  b->median = (g_bench.reps % 2) ? ms[g_bench.reps / 2]
+                                 : (ms[g_bench.reps / 2 - 1] + ms[g_bench.reps / 2]) / 2.0;
+  for (int r = 0; r < g_bench.reps; ++r)
+    b->mean += ms[r] / g_bench.reps;
+  printf("%-24s %10.3f ms  (min %10.3f)  %12.1f %s\n", b->name, b->median, b->min,
+         b->median > 0 ? b->work / (b->median / 1000.0) : 0.0, b->unit);
+  fflush(stdout);
+}
+
+/*------------------------------ fixtures ------------------------------------*/
+
+typedef struct
+{
+  StrList chapters; /* workspace/chapters, in book order */
+  UengArena mem; /* titles and names */
+  char **titles;
+  size_t n_titles;
+  char **names; /* file names to sort (copied into 'scratch' per run) */
+  const char **scratch;
+  size_t n_names;
+  double draft_mb;
+  double corpus_mb;
+  size_t tree_files;
+  char *blob; /* draft in memory, for the pool benchmark */
+  size_t blob_len;
+  uint64_t *hashes; /* one per 64 KiB block of blob */
+  int jobs;
+  int port;
+} Fixture;
+
+static Fixture F;
+
+/*------------------------------ benchmarks ----------------------------------*/
+
+static void b_slugify(void *ud)
+{
+  (void)ud;
+  char out[256];
+  for (size_t i = 0; i < F.n_titles; ++i)
+    slugify(F.titles[i], out, sizeof(out));
+}
+
+static void b_sort(void *ud)
+{
+  (void)ud;
+  memcpy(F.scratch, F.names, F.n_names * sizeof(char *));
+  qsort(F.scratch, F.n_names, sizeof(char *), qsort_nat_ci_cmp);
+}
+
+static void b_tree(void *ud)
+{
+  (void)ud;
+  StrList l;
+  sl_init(&l);
+  (void)list_tree_files("dropzone", &l);
+  F.tree_files = l.count;
+  sl_free(&l);
+}
+
+static void b_concat(void *ud)
+{
+  (void)ud;
+  FILE *f = ueng_fopen("workspace/bench-concat.md", "wb");
+  if (!f)
+    return;
+  (void)concat_md_dir("workspace/chapters", &F.chapters, f);
+  fclose(f);
+}
+
+static void b_pack(void *ud)
+{
+  (void)ud;
+  (void)pack_book_draft("Bench Book", ".", &F.chapters, NULL);
+}
+
+static void b_light(void *ud)
+{
+  (void)ud;
+  char out[PATH_MAX];
+  (void)light_export_html("Bench Book", "Benchmark", "workspace/bench-html",
+                          "workspace/book-draft.md", out, sizeof(out));
+}
+
+static const char *const k_requests[] = {
+    "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n",
+    "GET /index.html HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n",
+    "HEAD /style.css HTTP/1.0\r\n\r\n",
+    "GET /__search?q=river+light HTTP/1.1\r\nHost: localhost\r\n\r\n",
+    "GET /md/book-draft.md?x=1 HTTP/1.1\r\nHost: localhost\r\n\r\n",
+    "POST /upload HTTP/1.1\r\nContent-Length: 0\r\n\r\n",
+    "garbage\r\n\r\n",
+    "GET /a/very/long/path/that/goes/on/and/on/chapter-0042.html HTTP/1.1\r\n\r\n"};
+#define N_REQUESTS (sizeof(k_requests) / sizeof(k_requests[0]))
+#define PARSE_LOOPS 20000
+
+static void b_parse(void *ud)
+{
+  volatile int sink = 0;
+  (void)ud;
+  ServeRequest r;
+  for (int k = 0; k < PARSE_LOOPS; ++k)
+    for (size_t i = 0; i < N_REQUESTS; ++i)
+      sink += serve_parse_request(k_requests[i], &r);
+  (void)sink;
+}
+
+/* Parallel scaling: hash the draft in 64 KiB blocks. */
+#define POOL_BLOCK ((size_t)64 << 10)
+
+static void hash_block(void *ud, size_t i)
+{
+  uint64_t *out = (uint64_t *)ud;
+  size_t off = i * POOL_BLOCK;
+  size_t n = F.blob_len - off < POOL_BLOCK ? F.blob_len - off : POOL_BLOCK;
+  uint64_t h = 0;
+  for (int round = 0; round < 8; ++round)
+    h ^= ueng_hash64(F.blob + off, n, (uint64_t)round);
+  out[i] = h;
+}
+
+static void b_pool(void *ud)
+{
+  (void)ud;
+  ueng_parallel_for((F.blob_len + POOL_BLOCK - 1) / POOL_BLOCK, F.jobs, hash_block, F.hashes);
+}
+
+/*------------------------------ serve round trips ---------------------------*/
+
+#define SERVE_REQUESTS 200
+
+static void serve_thread(void *ud)
+{
+  (void)serve_run((const char *)ud, "127.0.0.1", F.port);
+}
+
+/* One GET over a fresh connection (serve closes after each response).
+   Returns the bytes received, or -1. */
+static long http_get(const char *path)
+{
+  bench_socket_t s = (bench_socket_t)socket(AF_INET, SOCK_STREAM, 0);
+  if (s == (bench_socket_t)-1)
+    return -1;
+  struct sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons((unsigned short)F.port);
+  a.sin_addr.s_addr = htonl(0x7F000001); /* 127.0.0.1 */
+  if (connect(s, (struct sockaddr *)&a, sizeof(a)) != 0)
+  {
+    closesock(s);
+    return -1;
+  }
+  char req[512];
+  int n = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\nHost: localhost\r\n\r\n", path);
+  if (send(s, req, n, 0) != n)
+  {
+    closesock(s);
+    return -1;
+  }
+  long total = 0;
+  char buf[16384];
+  for (;;)
+  {
+    int r = (int)recv(s, buf, sizeof(buf), 0);
+    if (r <= 0)
+      break;
+    total += r;
+  }
+  closesock(s);
+  return total;
+}
+
+static void b_serve(void *ud)
+{
+  (void)ud;
+  for (int i = 0; i < SERVE_REQUESTS; ++i)
+    (void)http_get((i & 1) ? "/page.html" : "/");
+}
+
+/* Ask the OS for a free loopback port (a race with other programs is
+   possible but harmless: the benchmark is then skipped). */
+static int free_port(void)
+{
+  bench_socket_t s = (bench_socket_t)socket(AF_INET, SOCK_STREAM, 0);
+  if (s == (bench_socket_t)-1)
+    return 0;
+  struct sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(0x7F000001);
+  socklen_t len = (socklen_t)sizeof(a);
+  int port = 0;
+  if (bind(s, (struct sockaddr *)&a, sizeof(a)) == 0 &&
+      getsockname(s, (struct sockaddr *)&a, &len) == 0)
+    port = ntohs(a.sin_port);
+  closesock(s);
+  return port;
+}
+
+static int start_server(const char *site)
+{
+  F.port = free_port();
+  if (F.port == 0)
+    return -1;
+  ueng_thread_t th; /* never joined: serve_run does not return */
+  if (ueng_thread_start(&th, serve_thread, (void *)site) != 0)
+    return -1;
+  for (int tries = 0; tries < 200; ++tries)
+  {
+    if (http_get("/") > 0)
+      return 0;
+    double t0 = ueng_now_ms();
+    while (ueng_now_ms() - t0 < 10.0)
+      ; /* short spin between connect attempts; startup takes a few ms */
+  }
+  return -1;
+}
+
+/*------------------------------ JSON + baseline -----------------------------*/
+
+static int write_json(const char *path, const CorpusOptions *co, const CorpusStats *cs)
+{
+  FILE *f = ueng_fopen(path, "wb");
+  if (!f)
+    return -1;
+  fprintf(f, "{\n  \"tool\": \"uaengine_bench\",\n  \"version\": \"%s\",\n", UENG_VERSION_STR);
+  fprintf(f,
+          "  \"corpus\": {\"chapters\": %zu, \"bytes\": %zu, \"unicode_pct\": %d, \"seed\": "
+          "%llu},\n",
+          co->chapters, cs->bytes, co->unicode_pct, co->seed);
+  fprintf(f, "  \"reps\": %d,\n  \"jobs\": %d,\n  \"results\": [\n", g_bench.reps, ueng_jobs());
+  for (size_t i = 0; i < g_bench.n; ++i)
+  {
+    const BenchResult *b = &g_bench.res[i];
+    fprintf(f,
+            "    {\"name\":\"%s\", \"median_ms\":%.4f, \"min_ms\":%.4f, \"mean_ms\":%.4f, "
+            "\"rate\":%.2f, \"unit\":\"%s\"}%s\n",
+            b->name, b->median, b->min, b->mean,
+            b->median > 0 ? b->work / (b->median / 1000.0) : 0.0, b->unit,
+            i + 1 < g_bench.n ? "," : "");
+  }
+  fputs("  ]\n}\n", f);
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+/* Read the medians of a file written by write_json (only that layout is
+   understood). Returns the number of regressions, or -1 when unreadable. */
+static int compare_baseline(const char *path, double tolerance_pct)
+{
+  char *txt = read_file_alloc(path, NULL);
+  if (!txt)
+    return -1;
+  int regressions = 0;
+  printf("\n%-24s %12s %12s %9s\n", "benchmark", "baseline ms", "now ms", "change");
+  for (size_t i = 0; i < g_bench.n; ++i)
+  {
+    BenchResult *b = &g_bench.res[i];
+    char key[80];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", b->name);
+    const char *p = strstr(txt, key);
+    const char *m = p ? strstr(p, "\"median_ms\":") : NULL;
+    if (!m)
+    {
+      printf("%-24s %12s %12.3f %9s\n", b->name, "-", b->median, "new");
+      continue;
+    }
+    b->has_base = 1;
+    b->base = strtod(m + 12, NULL);
+    double change = b->base > 0 ? (b->median / b->base - 1.0) * 100.0 : 0.0;
+    int bad = change > tolerance_pct;
+    regressions += bad;
+    printf("%-24s %12.3f %12.3f %+8.1f%%%s\n", b->name, b->base, b->median, change,
+           bad ? "  REGRESSION" : "");
+  }
+  free(txt);
+  return regressions;
+}
+
+/*------------------------------ main ----------------------------------------*/
+
+static void usage(void)
+{
+  puts("Usage: uaengine_bench [options]\n"
+       "  --chapters N      chapters in the synthetic book (default 400)\n"
+       "  --mb N            approximate book size in MB (default 16)\n"
+       "  --unicode PCT     share of non-ASCII words (default 15)\n"
+       "  --seed N          corpus seed (default 1)\n"
+       "  --reps N          timed repetitions per benchmark (default 5)\n"
+       "  --filter TEXT     only benchmarks whose name contains TEXT\n"
+       "  --dir DIR         where to generate the book (default bench-corpus)\n"
+       "  --keep            leave the generated book in place\n"
+       "  --json FILE       write results as JSON\n"
+       "  --baseline FILE   compare with an earlier --json file; exit 1 on regression\n"
+       "  --tolerance PCT   allowed slowdown against the baseline (default 10)");
+}
+
+int main(int argc, char **argv)
+{
+  CorpusOptions co;
+  memset(&co, 0, sizeof(co));
+  co.dir = "bench-corpus";
+  co.chapters = 400;
+  co.bytes = (size_t)16 << 20;
+  co.depth = 2;
+  co.unicode_pct = 15;
+  co.seed = 1;
+  const char *json = NULL, *baseline = NULL;
+  double tolerance = 10.0;
+  g_bench.reps = 5;
+  int keep = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *a = argv[i];
+    if (strcmp(a, "--keep") == 0)
+    {
+      keep = 1;
+      continue;
+    }
+    if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0)
+    {
+      usage();
+      return 0;
+    }
+    if (i + 1 >= argc)
+    {
+      usage();
+      return 2;
+    }
+    const char *v = argv[++i];
+    if (strcmp(a, "--chapters") == 0)
+      co.chapters = (size_t)strtoull(v, NULL, 10);
+    else if (strcmp(a, "--mb") == 0)
+      co.bytes = (size_t)(atof(v) * 1024.0 * 1024.0);
+    else if (strcmp(a, "--unicode") == 0)
+      co.unicode_pct = atoi(v);
+    else if (strcmp(a, "--seed") == 0)
+      co.seed = strtoull(v, NULL, 10);
+    else if (strcmp(a, "--reps") == 0)
+      g_bench.reps = atoi(v);
+    else if (strcmp(a, "--filter") == 0)
+      g_bench.filter = v;
+    else if (strcmp(a, "--dir") == 0)
+      co.dir = v;
+    else if (strcmp(a, "--json") == 0)
+      json = v;
+    else if (strcmp(a, "--baseline") == 0)
+      baseline = v;
+    else if (strcmp(a, "--tolerance") == 0)
+      tolerance = atof(v);
+    else
+    {
+      usage();
+      return 2;
+    }
+  }
+  if (co.chapters == 0 || g_bench.reps < 1 || g_bench.reps > MAX_REPS)
+  {
+    fprintf(stderr, "[bench] ERROR: --chapters must be >= 1 and --reps 1..%d\n", MAX_REPS);
+    return 2;
+  }
+
+#ifdef _WIN32
+  WSADATA wsa;
+  WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+  /* Absolute paths first: everything below runs inside the book. */
+  char dir[PATH_MAX], json_abs[PATH_MAX], base_abs[PATH_MAX];
+  if (mkpath(co.dir) != 0 || path_abs(co.dir, dir, sizeof(dir)) != 0)
+  {
+    fprintf(stderr, "[bench] ERROR: cannot create %s\n", co.dir);
+    return 2;
+  }
+  if (json && path_abs(json, json_abs, sizeof(json_abs)) == 0)
+    json = json_abs;
+  if (baseline && path_abs(baseline, base_abs, sizeof(base_abs)) == 0)
+    baseline = base_abs;
+  co.dir = dir;
+
+  /* Only ever wipe a directory this program generated (or an empty one). */
+  char marker[PATH_MAX + 32];
+  snprintf(marker, sizeof(marker), "%s%c%s", dir, PATH_SEP, CORPUS_MARKER);
+  StrList existing;
+  sl_init(&existing);
+  (void)list_tree_files(dir, &existing);
+  size_t n_existing = existing.count;
+  sl_free(&existing);
+  if (n_existing && !file_exists(marker))
+  {
+    fprintf(stderr, "[bench] ERROR: %s is not empty and was not made by uaengine_bench\n", dir);
+    return 2;
+  }
+
+  double t0 = ueng_now_ms();
+  CorpusStats cs;
+  (void)clean_dir(dir);
+  if (corpus_generate(&co, &cs) != 0 || chdir(dir) != 0)
+  {
+    fprintf(stderr, "[bench] ERROR: could not generate the book in %s\n", dir);
+    return 2;
+  }
+  F.corpus_mb = (double)cs.bytes / (1024.0 * 1024.0);
+  printf("[bench] %s, %d jobs; book: %zu chapters, %.1f MB in %s (%.0f ms)\n\n",
+         UENG_VERSION_STR, ueng_jobs(), co.chapters, F.corpus_mb, dir, ueng_now_ms() - t0);
+
+  /* Fixtures. */
+  sl_init(&F.chapters);
+  (void)list_md_dir("workspace/chapters", &F.chapters);
+  unsigned long long st = co.seed;
+  F.n_titles = 20000;
+  F.titles = (char **)calloc(F.n_titles, sizeof(char *));
+  F.n_names = 20000;
+  F.names = (char **)calloc(F.n_names, sizeof(char *));
+  F.scratch = (const char **)calloc(F.n_names, sizeof(char *));
+  if (!F.titles || !F.names || !F.scratch)
+    return 2;
+  for (size_t i = 0; i < F.n_titles; ++i)
+  {
+    char t[256];
+    corpus_title(&st, co.unicode_pct, t, sizeof(t));
+    F.titles[i] = ueng_arena_strdup(&F.mem, t);
+  }
+  for (size_t i = 0; i < F.n_names; ++i)
+  {
+    char t[64];
+    /* Shuffled chapter-like names: mixed case, unpadded numbers. */
+    snprintf(t, sizeof(t), "%s%llu-part%llu.md", (i % 3) ? "ch" : "Ch",
+             (unsigned long long)((i * 7919) % F.n_names), (unsigned long long)(i % 7));
+    F.names[i] = ueng_arena_strdup(&F.mem, t);
+  }
+
+  /* Strings and listing. */
+  bench_run("slugify", "ops/s", (double)F.n_titles, b_slugify, NULL);
+  bench_run("qsort_nat_ci_cmp", "ops/s", (double)F.n_names, b_sort, NULL);
+  b_tree(NULL);
+  bench_run("list_tree_files", "ops/s", (double)F.tree_files, b_tree, NULL);
+  bench_run("serve_parse_request", "ops/s", (double)PARSE_LOOPS * N_REQUESTS, b_parse, NULL);
+
+  /* Build and export paths. */
+  bench_run("concat_md_dir", "MB/s", F.corpus_mb, b_concat, NULL);
+  bench_run("pack_book_draft", "MB/s", F.corpus_mb, b_pack, NULL);
+  b_pack(NULL);
+  F.blob = read_file_alloc("workspace/book-draft.md", &F.blob_len);
+  F.draft_mb = (double)F.blob_len / (1024.0 * 1024.0);
+  bench_run("light_export_html", "MB/s", F.draft_mb, b_light, NULL);
+
+  /* Pool scaling: 1, 2, 4, ... threads up to ueng_jobs() (at least 2). */
+  F.hashes = (uint64_t *)calloc(F.blob_len / POOL_BLOCK + 1, sizeof(uint64_t));
+  if (F.blob && F.blob_len && F.hashes)
+  {
+    int maxj = ueng_jobs() > 2 ? ueng_jobs() : 2;
+    for (int j = 1;; j = j * 2 < maxj ? j * 2 : maxj)
+    {
+      char name[48];
+      snprintf(name, sizeof(name), "parallel_for/j%d", j);
+      F.jobs = j;
+      bench_run(name, "MB/s", F.draft_mb * 8.0, b_pool, NULL);
+      if (j == maxj)
+        break;
+    }
+  }
+
+  /* serve: a small landing page and a 64 KiB page, over loopback. */
+  if (!g_bench.filter || strstr("serve_run", g_bench.filter))
+  {
+    char site[PATH_MAX + 32];
+    snprintf(site, sizeof(site), "%s%cworkspace%cbench-site", dir, PATH_SEP, PATH_SEP);
+    (void)write_site_index(site, "Bench Book", "Benchmark", "bench-book", "-", 0, 1, 0);
+    char page[PATH_MAX + 64];
+    snprintf(page, sizeof(page), "%s%cpage.html", site, PATH_SEP);
+    size_t plen = F.blob_len < ((size_t)64 << 10) ? F.blob_len : ((size_t)64 << 10);
+    FILE *pf = ueng_fopen(page, "wb");
+    if (pf)
+    {
+      if (F.blob)
+        fwrite(F.blob, 1, plen, pf);
+      fclose(pf);
+    }
+    if (start_server(site) == 0)
+      bench_run("serve_run", "ops/s", (double)SERVE_REQUESTS, b_serve, NULL);
+    else
+      fprintf(stderr, "[bench] WARN: could not start the server; serve_run skipped\n");
+  }
+
+  int rc = 0;
+  if (json && write_json(json, &co, &cs) != 0)
+  {
+    fprintf(stderr, "[bench] ERROR: cannot write %s\n", json);
+    rc = 2;
+  }
+  else if (json)
+    printf("\n[bench] results: %s\n", json);
+  if (baseline)
+  {
+    int reg = compare_baseline(baseline, tolerance);
+    if (reg < 0)
+    {
+      fprintf(stderr, "[bench] ERROR: cannot read baseline %s\n", baseline);
+      rc = 2;
+    }
+    else if (reg > 0)
+    {
+      printf("[bench] %d regression(s) beyond %.0f%%\n", reg, tolerance);
+      if (rc == 0)
+        rc = 1;
+    }
+  }
+
+  if (!keep && chdir("..") == 0)
+  {
+    (void)clean_dir(dir);
+    (void)rmdir(dir);
+  }
+  fflush(stdout);
+  /* The server thread is still blocked in accept; leave without joining. */
+  exit(rc);
+}
@@ -0,0 +1,222 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: bench/corpus.c
+ * Purpose: Synthetic book generator for the benchmark suite
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "corpus.h"
+#include "ueng/common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------ words ---------------------------------------*/
+
+static const char *const k_ascii[] = {
+    "the",     "book",   "chapter", "author",  "river",   "light",   "morning", "quiet",
+    "letter",  "garden", "window",  "stone",   "voice",   "memory",  "harbour", "winter",
+    "and",     "of",     "to",      "in",      "a",       "was",     "she",     "he",
+    "they",    "said",   "through", "between", "under",   "before",  "after",   "again",
+    "city",    "road",   "house",   "silence", "answer",  "question", "story",  "night",
+    "2025",    "v0.1",   "e-mail",  "well-known", "it's", "(aside)", "self-made", "42"};
+static const char *const k_uni[] = {
+    "café",   "naïve",  "façade", "Zürich", "señor",  "Ærø",    "smörgås", "déjà vu",
+    "λόγος",  "ψυχή",   "книга",  "голос",  "書籍",   "物語",   "東京",    "한국어",
+    "“quoted”", "‘single’", "—",   "…",      "📚",     "✍️",     "naïve’s", "résumé"};
+#define N_ASCII (sizeof(k_ascii) / sizeof(k_ascii[0]))
+#define N_UNI (sizeof(k_uni) / sizeof(k_uni[0]))
+
+/* xorshift64*: small, fast and identical everywhere. */
+static unsigned long long rnd(unsigned long long *s)
+{
+  unsigned long long x = *s ? *s : 0x9E3779B97F4A7C15ull;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *s = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+static size_t rnd_below(unsigned long long *s, size_t n) { return (size_t)(rnd(s) % n); }
+
+static const char *word(unsigned long long *s, int unicode_pct)
+{
+  if ((int)rnd_below(s, 100) < unicode_pct)
+    return k_uni[rnd_below(s, N_UNI)];
+  return k_ascii[rnd_below(s, N_ASCII)];
+}
+
+void corpus_title(unsigned long long *state, int unicode_pct, char *out, size_t outsz)
+{
+  if (!out || outsz == 0)
+    return;
+  size_t used = 0, n = 2 + rnd_below(state, 6);
+  out[0] = '\0';
+  for (size_t i = 0; i < n && used + 1 < outsz; ++i)
+  {
+    int w = snprintf(out + used, outsz - used, "%s%s", i ? " " : "", word(state, unicode_pct));
+    if (w < 0)
+      break;
+    used += (size_t)w;
+  }
+  if (used < outsz && out[0] >= 'a' && out[0] <= 'z')
+    out[0] = (char)(out[0] - 'a' + 'A');
+}
+
+/*------------------------------ text buffer ---------------------------------*/
+
+typedef struct
+{
+  char *p;
+  size_t len, cap;
+} Buf;
+
+static int buf_put(Buf *b, const char *s, size_t n)
+{
+  if (b->len + n + 1 > b->cap)
+  {
+    size_t cap = b->cap ? b->cap : 4096;
+    while (b->len + n + 1 > cap)
+      cap *= 2;
+    char *p = (char *)realloc(b->p, cap);
+    if (!p)
+      return -1;
+    b->p = p;
+    b->cap = cap;
+  }
+  memcpy(b->p + b->len, s, n);
+  b->len += n;
+  b->p[b->len] = '\0';
+  return 0;
+}
+
+static int buf_str(Buf *b, const char *s) { return buf_put(b, s, strlen(s)); }
+
+/* One chapter of roughly 'target' bytes. */
+static int chapter_text(Buf *b, size_t idx, size_t target, unsigned long long *s, int upct)
+{
+  char line[512], title[256];
+  b->len = 0;
+  corpus_title(s, upct, title, sizeof(title));
+  snprintf(line, sizeof(line), "# Chapter %zu: %s\n\n", idx + 1, title);
+  if (buf_str(b, line) != 0)
+    return -1;
+  size_t para = 0;
+  while (b->len < target)
+  {
+    if (para % 8 == 7)
+    {
+      corpus_title(s, upct, title, sizeof(title));
+      snprintf(line, sizeof(line), "## %s\n\n", title);
+      if (buf_str(b, line) != 0)
+        return -1;
+    }
+    if (para % 13 == 12)
+    {
+      for (size_t k = 0, n = 2 + rnd_below(s, 4); k < n; ++k)
+      {
+        corpus_title(s, upct, title, sizeof(title));
+        snprintf(line, sizeof(line), "- %s\n", title);
+        if (buf_str(b, line) != 0)
+          return -1;
+      }
+      if (buf_str(b, "\n") != 0)
+        return -1;
+    }
+    size_t words = 40 + rnd_below(s, 80);
+    for (size_t w = 0; w < words; ++w)
+    {
+      if (w && buf_str(b, " ") != 0)
+        return -1;
+      if (buf_str(b, word(s, upct)) != 0)
+        return -1;
+      if (w + 1 < words && rnd_below(s, 12) == 0 &&
+          buf_str(b, rnd_below(s, 2) ? "," : ".") != 0)
+        return -1;
+    }
+    if (buf_str(b, ".\n\n") != 0)
+      return -1;
+    para++;
+  }
+  return 0;
+}
+
+static int write_all(const char *path, const Buf *b)
+{
+  if (mkpath_parent(path) != 0)
+    return -1;
+  FILE *f = ueng_fopen(path, "wb");
+  if (!f)
+    return -1;
+  size_t n = fwrite(b->p, 1, b->len, f);
+  int rc = fclose(f);
+  return (n == b->len && rc == 0) ? 0 : -1;
+}
+
+/*------------------------------ generator -----------------------------------*/
+
+int corpus_generate(const CorpusOptions *o, CorpusStats *st)
+{
+  if (!o || !o->dir || o->chapters == 0)
+    return -1;
+  CorpusStats local;
+  if (!st)
+    st = &local;
+  memset(st, 0, sizeof(*st));
+  unsigned long long s = o->seed ? o->seed : 1;
+  int upct = o->unicode_pct < 0 ? 0 : (o->unicode_pct > 100 ? 100 : o->unicode_pct);
+  size_t per = o->bytes / o->chapters;
+  if (per < 256)
+    per = 256;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s%cbook.yaml", o->dir, PATH_SEP);
+  if (mkpath(o->dir) != 0 ||
+      write_text_file(path, "title: Bench Book\nauthor: Benchmark\ningest_on_build: false\n") != 0)
+    return -1;
+  snprintf(path, sizeof(path), "%s%c%s", o->dir, PATH_SEP, CORPUS_MARKER);
+  if (write_text_file(path, "synthetic book; safe to delete\n") != 0)
+    return -1;
+
+  Buf b;
+  memset(&b, 0, sizeof(b));
+  int rc = 0;
+  for (size_t i = 0; i < o->chapters && rc == 0; ++i)
+  {
+    /* Sizes vary +-50% around the mean; names mix case and unpadded
+       numbers so the natural sort has work to do. */
+    size_t target = per / 2 + rnd_below(&s, per + 1);
+    if (chapter_text(&b, i, target, &s, upct) != 0)
+    {
+      rc = -1;
+      break;
+    }
+    const char *stem = k_ascii[rnd_below(&s, 16)];
+    char name[128];
+    snprintf(name, sizeof(name), "%s%zu-%s.md", (i % 3) ? "ch" : "Ch", i + 1, stem);
+    snprintf(path, sizeof(path), "%s%cworkspace%cchapters%c%s", o->dir, PATH_SEP, PATH_SEP,
+             PATH_SEP, name);
+    rc = write_all(path, &b);
+    if (rc == 0)
+    {
+      char sub[64] = "";
+      if (o->depth >= 2)
+        snprintf(sub, sizeof(sub), "part%02zu%csection%02zu%c", i / 100, PATH_SEP, (i / 10) % 10,
+                 PATH_SEP);
+      else if (o->depth == 1)
+        snprintf(sub, sizeof(sub), "part%02zu%c", i / 100, PATH_SEP);
+      snprintf(path, sizeof(path), "%s%cdropzone%c%s%s", o->dir, PATH_SEP, PATH_SEP, sub, name);
+      rc = write_all(path, &b);
+    }
+    st->files += 2;
+    st->bytes += b.len;
+  }
+  free(b.p);
+  return rc;
+}
+
+/*------------------------------ End of file --------------------------------*/
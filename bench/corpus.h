@@ -0,0 +1,55 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: bench/corpus.h
+ * Purpose: Synthetic book generator for the benchmark suite
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Writes a book that uaengine can build: book.yaml, N chapters in
+ *     workspace/chapters (names that exercise natural sorting: ch2 < Ch10),
+ *     and the same chapters again under dropzone/ in nested part/section
+ *     folders for the tree walks.
+ *   - Text is Markdown prose (headings, paragraphs, the odd list) with a
+ *     configurable share of non-ASCII words: accented Latin, Greek,
+ *     Cyrillic, CJK, typographic quotes and emoji.
+ *   - Output depends only on the options: the same seed gives byte-identical
+ *     files on every platform, so runs are comparable.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_BENCH_CORPUS_H
+#define UENG_BENCH_CORPUS_H
+
+#include <stddef.h> /* size_t */
+
+/* Written into every generated book; uaengine_bench only deletes
+   directories that carry it. */
+#define CORPUS_MARKER ".uaengine-bench"
+
+typedef struct
+{
+  const char *dir;      /* created if missing; existing files are overwritten */
+  size_t chapters;      /* number of chapters (>= 1) */
+  size_t bytes;         /* approximate total chapter bytes */
+  int depth;            /* dropzone nesting: 0 = flat, 2 = part/section/ */
+  int unicode_pct;      /* share of non-ASCII words, 0..100 */
+  unsigned long long seed;
+} CorpusOptions;
+
+typedef struct
+{
+  size_t files; /* chapter files written (dropzone copies included) */
+  size_t bytes; /* bytes of one copy of the chapters */
+} CorpusStats;
+
+/* Generate the book. Returns 0 on success, -1 on an I/O error. */
+int corpus_generate(const CorpusOptions *o, CorpusStats *st);
+
+/* Deterministic words and titles for string benchmarks (same mix as the
+   chapters). corpus_title writes a NUL-terminated title into 'out'. */
+void corpus_title(unsigned long long *state, int unicode_pct, char *out, size_t outsz);
+
+#endif /* UENG_BENCH_CORPUS_H */
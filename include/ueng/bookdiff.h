@@ -0,0 +1,90 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/bookdiff.h
+ * Purpose: Chapter-level change report between two packed drafts
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Inputs are two book-draft.md files (outputs/<slug>/<day>/md/), split
+ *     into chapters at the "<!-- name -->" markers pack_book_draft writes;
+ *     text before the first marker is the "(front matter)" chapter.
+ *   - Chapters whose bytes are identical are settled with a memcmp. The
+ *     others are cut into paragraphs (runs of non-blank lines), each hashed
+ *     over its words, so re-wrapping or re-spacing a paragraph is not a
+ *     change; a chapter whose paragraph hashes all match is unchanged.
+ *   - Changed chapters are diffed in parallel with Myers' O(ND) algorithm
+ *     (linear-space bisection, as in diff-match-patch) over the paragraph
+ *     hashes; the writers diff the words of replaced paragraphs the same
+ *     way to highlight the edit inside them.
+ *   - Both drafts stay mmap'd until bookdiff_free; the report points into
+ *     them instead of copying text.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_BOOKDIFF_H
+#define UENG_BOOKDIFF_H
+
+#include "ueng/common.h" /* UengMap */
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h>  /* FILE */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef enum
+  {
+    BOOKDIFF_SAME = 0,
+    BOOKDIFF_CHANGED,
+    BOOKDIFF_ADDED,
+    BOOKDIFF_REMOVED
+  } BookDiffStatus;
+
+  typedef struct
+  {
+    uint32_t off, len; /* byte range in the draft */
+    uint32_t words;
+    uint64_t hash;
+  } BookDiffPara;
+
+  typedef struct
+  {
+    char name[256];
+    BookDiffStatus status;
+    BookDiffPara *a, *b; /* paragraphs of the old / new chapter */
+    size_t na, nb;
+    unsigned char *del, *ins; /* per paragraph: removed from a / inserted in b */
+    size_t para_del, para_ins;
+    size_t words_del, words_ins;
+  } BookDiffChapter;
+
+  typedef struct
+  {
+    UengMap ma, mb;
+    BookDiffChapter *ch;
+    size_t n;
+    size_t changed, added, removed, same;
+    size_t words_del, words_ins;
+    double ms;
+  } BookDiff;
+
+  /* Compare two drafts. Returns 0 on success; free with bookdiff_free. */
+  int bookdiff_run(const char *draft_a, const char *draft_b, int jobs, BookDiff *d);
+  void bookdiff_free(BookDiff *d);
+
+  /* Change report: compact JSON, or a standalone HTML page with the edits
+     highlighted. Unchanged chapters are only counted. */
+  int bookdiff_write_json(const BookDiff *d, const char *label_a, const char *label_b, FILE *out);
+  int bookdiff_write_html(const BookDiff *d, const char *title, const char *label_a,
+                          const char *label_b, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_BOOKDIFF_H */
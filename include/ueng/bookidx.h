@@ -0,0 +1,125 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/bookidx.h
+ * Purpose: Binary book index (config, chapters, outline, per-chapter stats)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - workspace/.cache/book.idx holds everything commands used to rediscover
+ *     on their own: the book.yaml "key: value" pairs, the chapter list in
+ *     build order with a content hash, the heading outline and the
+ *     textstats counts (words, sentences, paragraphs, ...). Readers mmap it (bookidx_open) and never parse or list again.
+ *   - bookidx_update is incremental: a chapter whose size and mtime match its
+ *     record is reused as is; only new or changed files are read, in
+ *     parallel, and one whose content hash still matches keeps its stats
+ *     without being scanned. When nothing changed the file is not rewritten.
+ *     Files modified in the same second the index was written are always
+ *     re-read, so a quick edit right after a build is never missed.
+ *   - Config freshness is checked by hashing book.yaml (it is tiny), so the
+ *     index can be trusted for config without a rebuild.
+ *   - Headings are ATX ("#".."######") outside fenced code; offsets are into
+ *     the normalized chapter text (UTF-8, LF), which is what build packs.
+ *   - On-disk layout (all integers little-endian, offsets from file start):
+ *       header      64 bytes: magic, version, counts, section offsets,
+ *                   file_len, book.yaml hash, write time
+ *       config      n_cfg      x { u32 key_str, u32 value_str }
+ *       chapters    n_chapters x 64-byte records (see BookIdxChapter)
+ *       headings    n_headings x { u32 offset, u32 level, u32 title_str }
+ *       strings     NUL-terminated UTF-8 strings; offset 0 is ""
+ *     The file is replaced atomically, so a mapped copy stays valid.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_BOOKIDX_H
+#define UENG_BOOKIDX_H
+
+#include "ueng/common.h" /* UengMap, StrList */
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t, uint64_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define BOOKIDX_MAGIC "UENGBIX1"
+#define BOOKIDX_VERSION 3u
+
+  typedef struct
+  {
+    const char *name;  /* file name in the chapters dir */
+    const char *title; /* first heading, "" when there is none */
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash; /* ueng_hash64 of the file bytes */
+    uint32_t words, lines;
+    uint32_t head_first, head_count; /* range in the heading table */
+    uint32_t sentences, paragraphs, code_lines; /* see textstats.h */
+  } BookIdxChapter;
+
+  typedef struct
+  {
+    uint32_t offset; /* byte offset of the heading line in the normalized text */
+    uint32_t level;  /* 1..6 */
+    const char *title;
+  } BookIdxHeading;
+
+  typedef struct
+  {
+    UengMap map;
+    uint32_t n_cfg, n_chapters, n_headings;
+    uint32_t cfg_off, chapters_off, headings_off, strings_off;
+    uint64_t yaml_hash;
+    int64_t built; /* time the index was written (seconds since epoch) */
+  } BookIndex;
+
+  typedef struct
+  {
+    const char *index_path;   /* e.g. "workspace/.cache/book.idx" */
+    const char *book_yaml;    /* e.g. "book.yaml"; a missing file means no config */
+    const char *chapters_dir; /* e.g. "workspace/chapters" */
+    int jobs;                 /* 0 = ueng_jobs() */
+  } BookIdxOptions;
+
+  typedef struct
+  {
+    size_t chapters, headings;
+    size_t scanned; /* chapters read this run */
+    size_t reused;  /* chapters taken from the previous index */
+    int written;    /* 1 when the file was rewritten */
+    double ms;
+  } BookIdxStats;
+
+  /* Bring the index at o->index_path up to date. Returns 0 on success. */
+  int bookidx_update(const BookIdxOptions *o, BookIdxStats *st);
+
+  /* Map an existing index read-only. Returns 0 on success (close it with
+     bookidx_close); on failure 'ix' is left empty. */
+  int bookidx_open(const char *index_path, BookIndex *ix);
+  void bookidx_close(BookIndex *ix);
+
+  /* 1 when the config in 'ix' matches the current contents of 'yaml_path'. */
+  int bookidx_config_current(const BookIndex *ix, const char *yaml_path);
+
+  /* Config entries in book.yaml order (a key may repeat; the last one wins). */
+  int bookidx_cfg_at(const BookIndex *ix, size_t i, const char **key, const char **value);
+
+  int bookidx_chapter(const BookIndex *ix, size_t i, BookIdxChapter *out);
+  int bookidx_heading(const BookIndex *ix, size_t i, BookIdxHeading *out);
+
+  /* Append the chapter names in build order to 'out'. */
+  int bookidx_chapter_names(const BookIndex *ix, StrList *out);
+
+  /* Call fn(ud, key, value) for each top-level "key: value" line of a YAML
+     file, in order. A missing file is not an error (no calls). */
+  int bookidx_yaml_each(const char *yaml_path,
+                        void (*fn)(void *ud, const char *key, const char *value), void *ud);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_BOOKIDX_H */
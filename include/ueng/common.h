@@ -54,6 +54,7 @@
 /* Small wrapper so call sites don't need #ifdefs */
 static inline int make_dir(const char *p) { return _mkdir(p); }
 #else
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -71,19 +72,64 @@ extern "C"
 {
 #endif
 
+  /*------------------------------ Arena -------------------------------------*/
+  /* Region allocator: allocations are bump-pointer carves out of chunks that
+     double in size (4 KiB up to 1 MiB), and everything is released at once by
+     ueng_arena_free. A zeroed UengArena is ready to use. Not thread-safe; give
+     each thread its own arena. */
+  typedef struct UengArenaChunk UengArenaChunk;
+  typedef struct
+  {
+    UengArenaChunk *head; /* newest chunk; older ones follow */
+    size_t allocs;        /* carves so far */
+    size_t used;          /* bytes handed out */
+  } UengArena;
+
+  void *ueng_arena_alloc(UengArena *a, size_t n); /* pointer-aligned; NULL when out of memory */
+  char *ueng_arena_strndup(UengArena *a, const char *s, size_t n);
+  char *ueng_arena_strdup(UengArena *a, const char *s);
+  void ueng_arena_free(UengArena *a);
+
+  /* Interned strings: one copy of each distinct string, stored in the
+     table's arena, so equal strings share one pointer and lookups are one
+     hash probe. A zeroed UengStrTab is ready to use. */
+  typedef struct
+  {
+    UengArena mem;
+    const char **slots; /* open addressing, power-of-two size */
+    size_t count, cap;
+    size_t calls; /* ueng_strtab_intern calls (count of them were new) */
+  } UengStrTab;
+
+  const char *ueng_strtab_intern(UengStrTab *t, const char *s, size_t n); /* NULL on OOM */
+  const char *ueng_strtab_find(const UengStrTab *t, const char *s, size_t n); /* NULL: absent */
+  void ueng_strtab_free(UengStrTab *t);
+
+  /* Allocation counters (arenas, chunks, interning, StrList). Off unless
+     enabled; call ueng_alloc_stats_enable from main before any thread starts
+     (main does when UENG_ALLOC_STATS is set). Counts land when an arena or
+     table is freed. */
+  void ueng_alloc_stats_enable(void);
+  void ueng_alloc_stats_dump(FILE *out);
+
   /*------------------------------ String list ---------------------------------*/
-  /* A tiny dynamically-growing array of C strings (heap-owns its items).
-     sl_init/sl_free manage memory; sl_push appends a copy of the string. */
+  /* A dynamically-growing array of C strings. Item text lives in the list's
+     arena, so a scan of thousands of files costs a handful of allocations;
+     items stay valid until sl_free, which releases them all at once. Never
+     free() an item. */
   typedef struct
   {
     char **items;
     size_t count;
     size_t cap;
+    UengArena mem; /* backs the item strings */
   } StrList;
 
   void sl_init(StrList *sl);
   void sl_free(StrList *sl);
   int sl_push(StrList *sl, const char *s);
+  int sl_push_n(StrList *sl, const char *s, size_t n); /* first n bytes of s */
+  int sl_contains(const StrList *sl, const char *s); /* 1 if an item equals s (linear) */
   int qsort_nat_ci_cmp(const void *A, const void *B); /* natural case-insensitive sort comparator */
 
   /*------------------------------ Filesystem ----------------------------------*/
@@ -97,12 +143,32 @@ extern "C"
   int write_text_file(const char *path, const char *content);
 
   int write_text_file_if_absent(const char *path, const char *content);
+  /* read_file_alloc: whole file into a malloc'd, NUL-terminated buffer (NULL on error). */
+  char *read_file_alloc(const char *path, size_t *out_len);
   int write_file(const char *path, const char *content);
   int copy_file_binary(const char *src, const char *dst);
+  /* replace_file: rename 'from' over 'to' (atomic on POSIX). Writers that
+     readers may have mmap'd write a temp file first, then replace. */
+  int replace_file(const char *from, const char *to);
+
+  /* Read-only memory map of a whole file. An empty file maps to data == NULL,
+     len == 0 (still a success). Always pair with ueng_unmap_file. */
+  typedef struct
+  {
+    const unsigned char *data;
+    size_t len;
+    void *handle; /* platform bookkeeping */
+  } UengMap;
+  int ueng_map_file(const char *path, UengMap *m);
+  void ueng_unmap_file(UengMap *m);
   int write_gitkeep(const char *dir);
   int mkpath(const char *path);            /* mkdir -p */
   int mkpath_parent(const char *filepath); /* mkdir -p for parent dir only */
   int clean_dir(const char *dir);          /* rm -rf children */
+  /* list_tree_files: append the regular files under 'root' (recursively) to
+     'out' as root-relative paths using PATH_SEP. Symlinks/reparse points are
+     skipped, not followed. Order is unspecified. */
+  int list_tree_files(const char *root, StrList *out);
 
   /*------------------------------ Time/format --------------------------------*/
   /* build_date_utc: "YYYY-MM-DD", build_timestamp_utc: "YYYY-MM-DDThh-mm-ssZ" */
@@ -121,12 +187,52 @@ extern "C"
   /*------------------------------ Exec/helpers -------------------------------*/
   /* exec_cmd: uses system(); returns 0 on success, 1 on non-zero exit, -1 on OS error. */
   int exec_cmd(const char *cmdline);
+  /* tool_on_path: 1 if 'name' is an executable on PATH (probed once per
+     process; UENG_HAVE_<NAME>=0|1 in the environment overrides the probe). */
+  int tool_on_path(const char *name);
   /* path_abs: resolve to absolute path; path_to_file_url: make file:// URL browsers understand. */
   int path_abs(const char *in, char *out, size_t outsz);
   void path_to_file_url(const char *abs, char *out, size_t outsz);
   /* open_in_browser: launch default browser for file or URL. */
   int open_in_browser(const char *path_or_url);
 
+  /*------------------------------ Threads ------------------------------------*/
+  /* Minimal portable threading shims (Win32 threads / pthreads) so parallel
+     stages don't sprinkle #ifdefs. Mutex/cond types are plain structs that
+     callers embed; init before use and destroy when done. */
+#ifdef _WIN32
+  typedef HANDLE ueng_thread_t;
+  typedef CRITICAL_SECTION ueng_mutex_t;
+  typedef CONDITION_VARIABLE ueng_cond_t;
+#else
+  typedef pthread_t ueng_thread_t;
+  typedef pthread_mutex_t ueng_mutex_t;
+  typedef pthread_cond_t ueng_cond_t;
+#endif
+
+  int ueng_thread_start(ueng_thread_t *t, void (*fn)(void *), void *arg);
+  void ueng_thread_join(ueng_thread_t t);
+  void ueng_mutex_init(ueng_mutex_t *m);
+  void ueng_mutex_lock(ueng_mutex_t *m);
+  void ueng_mutex_unlock(ueng_mutex_t *m);
+  void ueng_mutex_destroy(ueng_mutex_t *m);
+  void ueng_cond_init(ueng_cond_t *c);
+  void ueng_cond_wait(ueng_cond_t *c, ueng_mutex_t *m);
+  /* Wait at most 'ms' milliseconds; may return early or spuriously, so
+     callers re-check their condition (and the clock). */
+  void ueng_cond_timedwait(ueng_cond_t *c, ueng_mutex_t *m, double ms);
+  void ueng_cond_broadcast(ueng_cond_t *c);
+  void ueng_cond_destroy(ueng_cond_t *c);
+
+  /* ueng_cpu_count: number of online CPUs (>= 1). */
+  int ueng_cpu_count(void);
+  /* ueng_parallel_for: run fn(ud, i) for i in [0, n) on up to 'jobs' threads
+     (jobs <= 0 means ueng_jobs(), see pool.h). Runs on the shared work-stealing
+     pool, so it may be nested. Returns once every index has run. */
+  void ueng_parallel_for(size_t n, int jobs, void (*fn)(void *ud, size_t i), void *ud);
+  /* ueng_now_ms: monotonic clock in milliseconds, for timing reports. */
+  double ueng_now_ms(void);
+
 #ifdef _WIN32
   /* Optional: switch Windows console to UTF-8 (call early in main if desired). */
   void ueng_console_utf8(void);
@@ -57,7 +57,15 @@ extern "C"
     char ollama_host[128]; /* e.g., "http://127.0.0.1:11434" */
 
     /* llama.cpp (fully in-process) */
-    char llama_model_path[256]; /* path to .gguf model (if embedding llama.cpp) */
+    char llama_model_path[256];       /* path to .gguf model (if embedding llama.cpp) */
+    char llama_draft_model_path[256]; /* small .gguf with the same vocabulary ("" : none) */
+    int llama_draft_max;              /* most tokens drafted per step (0: 8) */
+    int llama_max_tokens;             /* tokens generated per prompt (0: 64) */
+    int llama_n_batch;                /* prompt tokens per llama_decode call (0: 512) */
+    int llama_n_ubatch;               /* physical batch, <= n_batch (0: same as n_batch) */
+    int llama_n_threads;              /* CPU threads for decoding (0: llama.cpp default) */
+    char llama_session_dir[256];      /* saved prompt-prefix state ("" : off) */
+    int llama_session_max_mb;         /* session_dir bound, oldest files go (0: 2048) */
 
     /* Dev server knobs (used by 'serve') */
     char serve_host[64]; /* e.g., "127.0.0.1" */
@@ -82,6 +90,9 @@ extern "C"
    *   - OPENAI_API_KEY, UENG_OPENAI_BASE_URL
    *   - UENG_OLLAMA_HOST
    *   - UENG_LLAMA_MODEL_PATH
+   *   - UENG_LLAMA_DRAFT_MODEL_PATH, UENG_LLAMA_DRAFT_MAX
+   *   - UENG_LLAMA_N_BATCH, UENG_LLAMA_N_UBATCH, UENG_LLAMA_N_THREADS
+   *   - UENG_LLAMA_SESSION_DIR
    *   - UENG_SERVE_HOST, UENG_SERVE_PORT
    *   - UENG_WORKSPACE_DIR, UENG_SITE_ROOT */
   void ueng_config_apply_env(UengConfig *c);
@@ -91,6 +102,13 @@ extern "C"
    * to work without any further changes. */
   void ueng_config_export_env(const UengConfig *c, int overwrite);
 
+  /* Set 'n' keys of a config file to new values in place: the line of each
+   * key gets the new value (spacing and a trailing '# comment' are kept);
+   * missing keys are appended. The file is created if absent.
+   * RETURNS: 0 on success; non-zero if it could not be read or written. */
+  int ueng_config_update_file(const char *path, const char *const *keys, const char *const *values,
+                              size_t n);
+
   /* Convenience helper: load defaults, then file (if present), then env.
    * RETURNS: 0 (even if file missing) to keep it non-fatal; >0 if critical
    * error (currently always 0). */
@@ -0,0 +1,93 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/dedup.h
+ * Purpose: Near-duplicate chapter detection (MinHash + LSH)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Each chapter is normalized (textnorm), split into lower-cased word
+ *     tokens and fingerprinted with a DEDUP_K-value one-permutation MinHash
+ *     over 5-word shingles (one hash per shingle, not one per value).
+ *     Matching values estimate the Jaccard similarity of the shingle sets,
+ *     so reworded revisions still match.
+ *   - LSH: the signature is cut into DEDUP_BANDS bands; chapters sharing any
+ *     whole band become candidates, and only candidates are compared. With
+ *     32 bands of 2 rows, pairs at the default 0.5 similarity become
+ *     candidates 99.99% of the time while unrelated chapters (similarity
+ *     near 0) rarely meet, so the cost grows with the number of chapters,
+ *     not with the number of pairs.
+ *   - 0.5 on 5-word shingles is roughly "7% of the words changed", or half
+ *     the paragraphs rewritten: a revision, not a different chapter.
+ *   - Fingerprints are cached in workspace/.cache/minhash.bin keyed by file
+ *     name, size and mtime, so repeat runs only read and hash new files.
+ *   - In each cluster the most recently modified chapter is kept (the latest
+ *     revision); the others are reported, and with "dedup: collapse" in
+ *     book.yaml the build leaves them out.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_DEDUP_H
+#define UENG_DEDUP_H
+
+#include "ueng/common.h" /* StrList */
+
+#include <stddef.h> /* size_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define DEDUP_K 64
+#define DEDUP_BANDS 32
+#define DEDUP_SHINGLE 5
+#define DEDUP_THRESHOLD 0.5
+
+  typedef enum
+  {
+    DEDUP_OFF = 0,
+    DEDUP_FLAG,    /* report near-duplicates (default) */
+    DEDUP_COLLAPSE /* report them and build only the newest of each cluster */
+  } DedupMode;
+
+  typedef struct
+  {
+    size_t n;        /* chapters considered */
+    char **names;    /* chapter file names, natural order */
+    StrList files;   /* owns the text of 'names' */
+    int *cluster;    /* cluster id per chapter, -1 when it has no near-duplicate */
+    int *keep;       /* 1 for the chapter kept from its cluster (and for singletons) */
+    double *sim;     /* estimated similarity to the kept chapter of its cluster */
+    size_t clusters; /* clusters with 2+ chapters */
+    size_t dropped;  /* chapters that are not kept */
+    size_t hashed;   /* fingerprints computed this run */
+    size_t cached;   /* fingerprints reused from the cache */
+    size_t candidates; /* LSH candidate pairs checked */
+    double ms;
+  } DedupReport;
+
+  /* Parse "off" / "flag" / "collapse" (book.yaml "dedup:"); NULL or unknown
+     values give DEDUP_FLAG. */
+  DedupMode dedup_mode_parse(const char *s);
+
+  /* Fingerprint every chapter of 'chapters_dir' (except _frontmatter.md and
+     acknowledgements.md) and cluster those at or above 'threshold'
+     (<= 0 means DEDUP_THRESHOLD). 'cache_path' may be NULL for no cache.
+     Returns 0 on success; free the report with dedup_report_free. */
+  int dedup_scan(const char *chapters_dir, const char *cache_path, double threshold, int jobs,
+                 DedupReport *rep);
+  void dedup_report_free(DedupReport *rep);
+
+  /* A summary line plus one line per cluster, prefixed with "[tag]". */
+  void dedup_print(const DedupReport *rep, const char *tag, DedupMode mode);
+
+  /* Append the names of chapters that are not kept to 'out'. */
+  int dedup_dropped(const DedupReport *rep, StrList *out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_DEDUP_H */
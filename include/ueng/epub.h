@@ -0,0 +1,61 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/epub.h
+ * Purpose: Native EPUB 3 packager (no pandoc, no external processes)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Chapters (workspace/chapters/<name>.md) are converted to XHTML with a small
+ *     Markdown subset (headings, paragraphs, lists, fenced code, inline
+ *     code/emphasis/links) and deflated straight into the ZIP container.
+ *   - Conversion + compression runs on worker threads in bounded windows;
+ *     members are appended to the archive in chapter order.
+ *   - Layout: mimetype (stored, first), META-INF/container.xml,
+ *     OEBPS/{content.opf,nav.xhtml,style.css,cover.svg,cover.xhtml,text/chNNNN.xhtml}.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_EPUB_H
+#define UENG_EPUB_H
+
+#include "ueng/common.h" /* StrList */
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    const char *title;
+    const char *author;
+    const char *slug;         /* used for the book identifier */
+    const char *chapters_dir; /* e.g. "workspace/chapters" */
+    const char *cover_svg;    /* optional; skipped when missing */
+    const char *css_path;     /* optional; a minimal stylesheet is used when missing */
+    const char *out_path;     /* e.g. "outputs/<slug>/<day>/epub/<slug>.epub" */
+    int jobs;                 /* worker threads; <= 0 means ueng_jobs() */
+    const StrList *chapters;  /* file names to include, in order; NULL lists chapters_dir */
+  } EpubOptions;
+
+  typedef struct
+  {
+    size_t chapters;
+    uint64_t bytes_in;  /* Markdown read */
+    uint64_t bytes_out; /* archive size */
+    double ms;          /* wall time */
+  } EpubStats;
+
+  /* Write the EPUB described by 'o'. Returns 0 on success; 'st' may be NULL. */
+  int epub_write_book(const EpubOptions *o, EpubStats *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_EPUB_H */
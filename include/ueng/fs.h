@@ -42,16 +42,35 @@ extern "C"
   /* cover.svg placed in workspace/ for reuse across export/site. */
   int generate_cover_svg(const char *title, const char *author, const char *slug);
 
+  /* Chapter discovery
+     list_md_dir: appends the *.md file names (not paths) found in 'dir' to 'out',
+     sorted naturally and case-insensitively (ch2.md < ch10.md). */
+  int list_md_dir(const char *dir, StrList *out);
+
   /* Build helpers
-     pack_book_draft: concatenates workspace/chapters/*.md => workspace/book-draft.md */
-  int pack_book_draft(const char *title, const char *outputs_root, int *out_has_draft);
+     pack_book_draft: concatenates workspace/chapters/*.md => workspace/book-draft.md.
+     'chapters' names the files to pack, in order (e.g. from the book index);
+     NULL lists the directory. */
+  int pack_book_draft(const char *title, const char *outputs_root, const StrList *chapters,
+                      int *out_has_draft);
+  /* concat_md_dir: the chapter part of the draft. Writes each named file of
+     'dir' (NULL = every *.md, sorted) to 'out' behind a <!-- name --> marker,
+     normalized to UTF-8 with LF line endings. */
+  int concat_md_dir(const char *dir, const StrList *chapters, FILE *out);
 
   /* Theme and site generation
      copy_theme_into_html_dir ensures html/style.css exists and returns "style.css" in out_rel_css.
-     write_site_index generates a minimal landing page linking to HTML draft. */
+     write_site_index generates a minimal landing page linking to HTML draft
+     (plus a search box backed by search.js/search.idx when has_search). */
   int copy_theme_into_html_dir(const char *html_dir, char *out_rel_css, size_t outsz);
   int write_site_index(const char *site_dir, const char *title, const char *author,
-                       const char *slug, const char *stamp, int has_cover, int has_draft);
+                       const char *slug, const char *stamp, int has_cover, int has_draft,
+                       int has_search);
+
+  /* Fallback exporter when Pandoc is missing or fails: md_path as escaped
+     <pre> text in html_dir/book.html (path returned in out_html). */
+  int light_export_html(const char *title, const char *author, const char *html_dir,
+                        const char *md_path, char *out_html, size_t out_html_sz);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,52 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/hash.h
+ * Purpose: Checksums and content hashes shared by packagers and caches
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - CRC-32 and SHA-256 are incremental: feed data in any chunking and the
+ *     result is the same as hashing the concatenation.
+ *   - No global state; safe to call from worker threads.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_HASH_H
+#define UENG_HASH_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /* CRC-32 (IEEE 802.3, as used by ZIP/PNG). Start with crc = 0 and pass the
+     previous return value back in to continue a running checksum. */
+  uint32_t ueng_crc32(uint32_t crc, const void *data, size_t len);
+
+  /* 64-bit non-cryptographic hash (XXH64) for hash tables and quick content
+     fingerprints. One-shot; not suitable where collisions must be impossible. */
+  uint64_t ueng_hash64(const void *data, size_t len, uint64_t seed);
+
+  /* SHA-256 (FIPS 180-4) for content addressing, where identical digests must
+     mean identical bytes. init, update any number of times, then final. */
+  typedef struct
+  {
+    uint32_t h[8];
+    uint64_t len;
+    unsigned char buf[64];
+    size_t n;
+  } UengSha256;
+  void ueng_sha256_init(UengSha256 *c);
+  void ueng_sha256_update(UengSha256 *c, const void *data, size_t len);
+  void ueng_sha256_final(UengSha256 *c, unsigned char out[32]);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_HASH_H */
@@ -0,0 +1,68 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/ingest.h
+ * Purpose: Parallel dropzone -> workspace/chapters ingestion pipeline
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Stages: discovery (one task per top-level dropzone folder), then decode
+ *     and normalize on worker threads, then an in-order commit on the
+ *     calling thread. Files move through in windows of a few per worker,
+ *     so memory is bounded by the window, not by the dropzone size.
+ *   - Every source goes through textnorm (UTF-8 validation, BOM/CRLF and
+ *     UTF-16/Windows-1252 transcoding) before conversion.
+ *   - Accepted inputs: .md/.markdown (kept), .txt (kept, titled from the
+ *     file name when it has no heading) and .html/.htm (converted to
+ *     Markdown). Other files are ignored.
+ *   - Output names are the slugified dropzone-relative path, e.g.
+ *     part-2/ch10.md -> part-2-ch10.md, so they keep the natural order of
+ *     the sources and stay the same from run to run.
+ *   - workspace/.ingest-manifest records "<hash> <chapter> <source>" per
+ *     ingested file. Content already listed there (or seen earlier in the
+ *     same run) is skipped.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_INGEST_H
+#define UENG_INGEST_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    const char *dropzone;     /* default "dropzone" */
+    const char *chapters_dir; /* default "workspace/chapters" */
+    const char *manifest;     /* default "workspace/.ingest-manifest" */
+    int jobs;                 /* worker threads, <= 0 = ueng_jobs() */
+    int progress;             /* print a live progress line (TTY only) */
+  } IngestOptions;
+
+  typedef struct
+  {
+    size_t found;      /* candidate files discovered */
+    size_t ingested;   /* chapters written */
+    size_t unchanged;  /* same source, same content as last time */
+    size_t duplicate;  /* content already ingested from another source */
+    size_t failed;     /* unreadable or unwritable */
+    size_t transcoded; /* ingested from UTF-16 or Windows-1252 text */
+    uint64_t bytes_in, bytes_out;
+    double ms;
+  } IngestStats;
+
+  /* Run the pipeline. Returns 0 unless the dropzone could not be scanned or
+     nothing could be written (individual failures are counted in st). */
+  int ingest_run(const IngestOptions *opt, IngestStats *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_INGEST_H */
@@ -19,8 +19,26 @@
  *   - Keep the main binary linkable even when no backend is compiled in (open returns NULL +
  error).
 
+ * Streaming:
+ *   - ueng_llm_prompt_stream hands each piece of text to a callback as soon as
+ *     the backend produces it (a decoded token for llama.cpp, an SSE delta for
+ *     the HTTP providers). The callback returns non-zero to stop generation;
+ *     the call then returns UENG_LLM_CANCELLED.
+ *   - Pieces are UTF-8 but not NUL-terminated and may split a multi-byte
+ *     character across two calls; concatenate before interpreting.
+ *   - ueng_llm_prompt is the blocking form: it collects the same pieces into
+ *     'out' and stops generation once 'out' is full.
+
+ * Providers:
+ *   - llm.c implements this header and picks the provider per context from
+ *     UENG_LLM_PROVIDER, an ordered list ("mistral,openai") that doubles as
+ *     a fallback chain. UENG_LLM_HEDGE=1 also sends a slow streamed prompt to
+ *     the next provider and keeps whichever answers first.
+
  * Extending:
- *   - Add new providers by implementing the three functions in a new llm_*.c translation unit.
+ *   - Add new providers in a new llm_*.c translation unit: declare its entry
+ *     points in llm_backend.h and add a row to llm.c's provider table. An
+ *     OpenAI-compatible API only needs an opener for ueng_llm_open_chat.
  *   - Keep this header vendor-neutral; avoid leaking provider-specific types here.
  *---------------------------------------------------------------------------*/
 
@@ -49,8 +67,8 @@ extern "C"
     UENG_LLM_BACKEND_OLLAMA = 3  /* local: Ollama HTTP API    */
   } ueng_llm_backend_t;
 
-  /* Opaque handle for an in-process LLM session. Concrete definition lives in
-   * the backend .c (llm_llama.c when llama.cpp is enabled). */
+  /* Opaque handle for an LLM session. Concrete definition lives in llm.c,
+   * which holds one backend context per configured provider. */
   typedef struct ueng_llm_ctx ueng_llm_ctx;
 
   /* Create a new LLM context.
@@ -65,6 +83,91 @@ extern "C"
   /* Generate a short completion for 'prompt' into 'out' (NUL-terminated). */
   int ueng_llm_prompt(ueng_llm_ctx *ctx, const char *prompt, char *out, size_t outsz);
 
+  /* Describe everything that determines this context's output: provider,
+   * model (for local files also size and mtime), endpoint and sampling
+   * parameters, as one line. Equal strings mean the same prompt gets the same
+   * completion, which is what llm_cache.h keys on. With several providers it
+   * describes the first one that opened; a reply from any other is flagged
+   * with 'fallback' in its stats or batch item. Returns 0, or -1. */
+  int ueng_llm_identity(ueng_llm_ctx *ctx, char *out, size_t outsz);
+
+  /* Streaming ---------------------------------------------------------------*/
+
+  /* Returned by ueng_llm_prompt_stream when the callback asked to stop. */
+#define UENG_LLM_CANCELLED 1
+
+  /* Called once per generated piece; return 0 to continue, non-zero to stop. */
+  typedef int (*ueng_llm_piece_fn)(void *user, const char *piece, size_t len);
+
+  typedef struct ueng_llm_stream_stats
+  {
+    double ttft_ms;     /* prompt sent -> first piece delivered (0 if none) */
+    double total_ms;    /* prompt sent -> generation finished */
+    int pieces;         /* callback invocations */
+    int tokens;         /* tokens generated, when the backend knows (else 0) */
+    int prompt_tokens;  /* prompt length in tokens, when the backend knows (else 0) */
+    int cached_tokens;  /* of those, reused from the KV cache or a saved session */
+    double prefill_ms;  /* prompt evaluation time (in-process backends; else 0) */
+    int draft_tokens;   /* speculative decoding: tokens the draft model proposed */
+    int draft_accepted; /* of those, confirmed by the model (and delivered) */
+    int fallback;       /* 1: answered by a provider other than the one
+                           ueng_llm_identity describes (fallback, hedge winner) */
+  } ueng_llm_stream_stats;
+
+  /* Generate a completion for 'prompt', delivering it through 'fn' as it is
+   * produced. 'stats' is optional. Returns 0 when generation finished,
+   * UENG_LLM_CANCELLED when 'fn' returned non-zero, negative on error. */
+  int ueng_llm_prompt_stream(ueng_llm_ctx *ctx, const char *prompt, ueng_llm_piece_fn fn,
+                             void *user, ueng_llm_stream_stats *stats);
+
+  /* Batch -------------------------------------------------------------------*/
+
+  /* Per-prompt sampling; zero fields keep the backend's default. Backends
+   * ignore what their API lacks (top_k over the Mistral API, for one). */
+  typedef struct ueng_llm_sampling
+  {
+    float temperature; /* 0: backend default (llama.cpp: greedy); < 0: greedy */
+    int top_k;         /* 0: off */
+    float top_p;       /* 0: off */
+    int max_tokens;    /* 0: backend default (llama.cpp: llama.max_tokens, 64) */
+    unsigned seed;     /* 0: fixed default, so runs repeat */
+  } ueng_llm_sampling;
+
+  typedef struct ueng_llm_batch_item
+  {
+    const char *prompt; /* in */
+    char *text;         /* out: completion, malloc'd (caller frees); NULL on failure */
+    int status;         /* out: 0, or the non-zero code ueng_llm_prompt would return */
+    long http_status;   /* out: HTTP status (0: in-process backend or no response) */
+    double latency_ms;  /* out: request sent -> reply complete */
+    const ueng_llm_sampling *sampling; /* in, optional: NULL for the defaults */
+    int fallback;       /* out: as in ueng_llm_stream_stats */
+  } ueng_llm_batch_item;
+
+  /* Run the prompts of 'items', at most 'max_parallel' at a time (<= 0: the
+   * UENG_LLM_PARALLEL environment variable, else 8). HTTP backends keep that
+   * many requests in flight on one event loop. llama.cpp decodes that many
+   * sequences together in each llama_decode call and starts a waiting prompt
+   * as soon as one finishes (continuous batching). Results are written into
+   * each item, so they stay in input order. Returns the number of failed
+   * items, or -1 on bad arguments. */
+  int ueng_llm_prompt_batch(ueng_llm_ctx *ctx, ueng_llm_batch_item *items, size_t n,
+                            int max_parallel);
+
+  /* Connection reuse (HTTP backends) ---------------------------------------*/
+
+  typedef struct ueng_llm_conn_stats
+  {
+    long requests;     /* HTTP requests sent on this context */
+    long connects;     /* new connections opened (DNS + TCP + TLS) */
+    long reused;       /* requests served on an already open connection */
+    double connect_ms; /* total time spent opening connections */
+  } ueng_llm_conn_stats;
+
+  /* Counters since ueng_llm_open. Returns 0, or -1 for in-process backends
+   * (llama.cpp) that have no connections. */
+  int ueng_llm_get_conn_stats(ueng_llm_ctx *ctx, ueng_llm_conn_stats *out);
+
   /* Destroy a context (safe to call with NULL). */
   void ueng_llm_close(ueng_llm_ctx *ctx);
 
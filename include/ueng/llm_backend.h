@@ -0,0 +1,80 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/llm_backend.h
+ * Purpose: Provider entry points behind the llm.h facade (internal)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Only llm.c calls these. The public ueng_llm_* functions live there and
+ *     pick a provider per context (UENG_LLM_PROVIDER), so every backend is
+ *     linked into every build and names its functions with a suffix.
+ *   - Two implementations: llama.cpp in-process (llm_llama.c, a stub without
+ *     the submodule) and an OpenAI-style Chat Completions client over libcurl
+ *     (llm_mistral.c). Mistral, OpenAI and Ollama (its /v1 endpoint) are
+ *     three configurations of the latter; llm_openai.c and llm_ollama.c
+ *     only read their settings and open it.
+ *   - Same arguments, return values and threading rules as the llm.h
+ *     function of the same name.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_LLM_BACKEND_H
+#define UENG_LLM_BACKEND_H
+
+#include "ueng/llm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /* llama.cpp (llm_llama.c) -------------------------------------------------*/
+
+  typedef struct ueng_llm_llama ueng_llm_llama;
+
+  ueng_llm_llama *ueng_llm_open_llama(const char *model_path, int ctx_tokens, char *err,
+                                      size_t errsz);
+  int ueng_llm_prompt_stream_llama(ueng_llm_llama *L, const char *prompt, ueng_llm_piece_fn fn,
+                                   void *user, ueng_llm_stream_stats *stats);
+  int ueng_llm_prompt_batch_llama(ueng_llm_llama *L, ueng_llm_batch_item *items, size_t n,
+                                  int max_parallel);
+  int ueng_llm_identity_llama(ueng_llm_llama *L, char *out, size_t outsz);
+  void ueng_llm_close_llama(ueng_llm_llama *L);
+
+  /* Chat Completions over HTTP (llm_mistral.c) ------------------------------*/
+
+  typedef struct ueng_llm_chat ueng_llm_chat;
+
+  typedef struct ueng_llm_chat_endpoint
+  {
+    const char *provider; /* "mistral", "openai", "ollama": messages and identity */
+    const char *base_url; /* requests go to <base_url>/v1/chat/completions */
+    const char *api_key;  /* sent as a bearer token */
+    const char *model;
+    const char *seed_key; /* JSON name of the sampling seed ("seed", "random_seed") */
+  } ueng_llm_chat_endpoint;
+
+  ueng_llm_chat *ueng_llm_open_chat(const ueng_llm_chat_endpoint *e, int ctx_tokens, char *err,
+                                    size_t errsz);
+  int ueng_llm_prompt_chat(ueng_llm_chat *C, const char *prompt, char *out, size_t outsz);
+  int ueng_llm_prompt_stream_chat(ueng_llm_chat *C, const char *prompt, ueng_llm_piece_fn fn,
+                                  void *user, ueng_llm_stream_stats *stats);
+  int ueng_llm_prompt_batch_chat(ueng_llm_chat *C, ueng_llm_batch_item *items, size_t n,
+                                 int max_parallel);
+  int ueng_llm_identity_chat(ueng_llm_chat *C, char *out, size_t outsz);
+  int ueng_llm_get_conn_stats_chat(ueng_llm_chat *C, ueng_llm_conn_stats *out);
+  void ueng_llm_close_chat(ueng_llm_chat *C);
+
+  /* Provider settings -> ueng_llm_open_chat. 'model' may be NULL for the
+     provider's default. */
+  ueng_llm_chat *ueng_llm_open_mistral(const char *model, int ctx_tokens, char *err, size_t errsz);
+  ueng_llm_chat *ueng_llm_open_openai(const char *model, int ctx_tokens, char *err, size_t errsz);
+  ueng_llm_chat *ueng_llm_open_ollama(const char *model, int ctx_tokens, char *err, size_t errsz);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_LLM_BACKEND_H */
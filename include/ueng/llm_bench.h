@@ -0,0 +1,75 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/llm_bench.h
+ * Purpose: `uaengine llm-bench`: inference speed of the configured LLM backend
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Works through the llm.h facade only, so it measures whichever provider
+ *     the context opens (UENG_LLM_PROVIDER). A backend with connection counters
+ *     (ueng_llm_get_conn_stats == 0) is remote; anything else is in-process.
+ *   - In-process (llama.cpp): every point of the threads x n_batch x context
+ *     sweep opens a fresh context (the knobs are read at ueng_llm_open via
+ *     UENG_LLAMA_N_*), times the load, then streams a synthetic prompt
+ *     'runs' times. Each run starts with a different word so the prefix
+ *     cache cannot help, and generates 'gen_tokens' tokens (set through
+ *     UENG_LLAMA_MAX_TOKENS) so decode speed is measured over the same,
+ *     long enough stretch at every point. Reported per point: load ms,
+ *     prefill and decode tokens/s, tokens generated, time to first token,
+ *     total time and the process's peak RSS (a high-water mark, so contexts
+ *     are swept smallest first).
+ *   - The best point is the one with the lowest mean total time; its
+ *     llama.n_threads / n_batch / n_ubatch can be written into a ueng.yaml.
+ *     The context size is reported but never written: it is a property of
+ *     the prompts, not of the machine.
+ *   - Remote: 'requests' prompts one after another, then (parallel > 1) the
+ *     same number as one ueng_llm_prompt_batch; reported as p50/p90/p95/p99
+ *     of time to first token and of total latency, plus requests/s.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_LLM_BENCH_H
+#define UENG_LLM_BENCH_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LLM_BENCH_MAX_SWEEP 8
+
+  typedef struct
+  {
+    const char *model; /* path (llama.cpp) or model name */
+    /* Sweep lists; empty ones default to half the CPUs and all of them,
+       n_batch 128 and 512, and a 4096-token context. */
+    int threads[LLM_BENCH_MAX_SWEEP];
+    int n_threads;
+    int batch[LLM_BENCH_MAX_SWEEP];
+    int n_batch;
+    int ctx[LLM_BENCH_MAX_SWEEP];
+    int n_ctx;
+    int prompt_words;         /* synthetic prompt length (0: 400, ~512 tokens) */
+    int gen_tokens;           /* in-process: tokens generated per run (0: 256) */
+    int runs;                 /* per sweep point (0: 2) */
+    int requests;             /* remote backends (0: 20) */
+    int parallel;             /* remote: > 1 also times one batch of 'requests' */
+    int json;                 /* JSON on stdout instead of tables */
+    const char *write_config; /* ueng.yaml to update with the best point, or NULL */
+  } LlmBenchOptions;
+
+  /* Parse "1,2,4" into out[] (at most LLM_BENCH_MAX_SWEEP positive values).
+     Returns the count, or -1 on a malformed list. */
+  int llm_bench_parse_list(const char *s, int *out);
+
+  /* Run the benchmark. Returns 0, or non-zero when the backend could not be
+     opened or no point completed. */
+  int llm_bench_run(const LlmBenchOptions *o);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_LLM_BENCH_H */
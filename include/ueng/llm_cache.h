@@ -0,0 +1,102 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/llm_cache.h
+ * Purpose: Content-addressed on-disk cache of LLM completions
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Opt-in layer in front of the ueng_llm_* calls: the same prompt against
+ *     the same backend identity (ueng_llm_identity: provider, model,
+ *     endpoint, sampling parameters) is answered from disk instead of paying
+ *     for it again. The key is the SHA-256 of identity and prompt, so it works
+ *     the same for every backend. A NULL cache passes straight through.
+ *     Replies that came from a fallback provider or a hedge winner (the
+ *     'fallback' flag) are passed on but never stored under that identity.
+ *   - <dir>/llm-cache.log is append-only: one record per completion
+ *     (48-byte header: "ULC1", u32 length, i64 unix time, 32-byte key; then
+ *     the UTF-8 text). Each record is appended with unbuffered writes to
+ *     the O_APPEND descriptor.
+ *   - <dir>/llm-cache.lock holds the log generation. Appends, index rewrites
+ *     and compaction run under a lock on it (fcntl / LockFileEx), so
+ *     processes sharing a directory never interleave records or lose them
+ *     to a compaction; compaction bumps the generation and the others reopen
+ *     the new log when they see it change. Readers do not lock. On Windows a
+ *     log another process has open cannot be replaced; compaction then fails
+ *     and is tried again by a later append.
+ *   - <dir>/llm-cache.idx is an open-addressing hash table (key prefix ->
+ *     log offset, time) that is mmap'd read-only. Records appended since it
+ *     was written live in a small in-memory table; the index is rewritten
+ *     (temp file + replace) when that grows or the cache is closed. A
+ *     missing or stale index is rebuilt from the log. Every hit is checked
+ *     against the full key in the log record.
+ *     All integers little-endian.
+ *   - ttl_s drops entries older than that many seconds; max_bytes bounds the
+ *     log: once it is exceeded, the log is rewritten with the newest live
+ *     entries that fit in three quarters of the limit.
+ *   - Identical requests in flight at the same time are coalesced: in one
+ *     process, the first caller asks the backend and the others wait for its
+ *     answer; a batch sends each distinct prompt once.
+ *   - Thread-safe; the backend context itself is still one caller at a time.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_LLM_CACHE_H
+#define UENG_LLM_CACHE_H
+
+#include "ueng/llm.h"
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct ueng_llm_cache ueng_llm_cache;
+
+  typedef struct ueng_llm_cache_opts
+  {
+    const char *dir;    /* created if missing */
+    long long ttl_s;    /* 0: entries never expire */
+    uint64_t max_bytes; /* 0: unbounded log */
+  } ueng_llm_cache_opts;
+
+  typedef struct ueng_llm_cache_stats
+  {
+    uint64_t hits, misses;
+    uint64_t coalesced; /* requests answered by an identical one in flight */
+    uint64_t stores;    /* completions written by this process */
+    uint64_t evicted;   /* entries dropped by TTL or size limits */
+    uint64_t entries;   /* live entries now */
+    uint64_t log_bytes; /* size of llm-cache.log now */
+  } ueng_llm_cache_stats;
+
+  /* Open (or create) the cache in o->dir. Returns NULL with 'err' filled on
+     failure. */
+  ueng_llm_cache *ueng_llm_cache_open(const ueng_llm_cache_opts *o, char *err, size_t errsz);
+  /* From the environment: UENG_LLM_CACHE=<dir> enables it,
+     UENG_LLM_CACHE_TTL (seconds) and UENG_LLM_CACHE_MAX_MB set the limits.
+     NULL when unset, "0" or unusable (with a warning). */
+  ueng_llm_cache *ueng_llm_cache_open_env(void);
+  /* Write the index and free (safe with NULL). */
+  void ueng_llm_cache_close(ueng_llm_cache *c);
+  void ueng_llm_cache_get_stats(ueng_llm_cache *c, ueng_llm_cache_stats *out);
+
+  /* Cached versions of the llm.h calls, same arguments and return values.
+     A hit is delivered to the stream callback as one piece. Failed or
+     cancelled completions are not stored. */
+  int ueng_llm_cache_prompt(ueng_llm_cache *c, ueng_llm_ctx *ctx, const char *prompt, char *out,
+                            size_t outsz);
+  int ueng_llm_cache_prompt_stream(ueng_llm_cache *c, ueng_llm_ctx *ctx, const char *prompt,
+                                   ueng_llm_piece_fn fn, void *user,
+                                   ueng_llm_stream_stats *stats);
+  int ueng_llm_cache_prompt_batch(ueng_llm_cache *c, ueng_llm_ctx *ctx, ueng_llm_batch_item *items,
+                                  size_t n, int max_parallel);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_LLM_CACHE_H */
@@ -0,0 +1,72 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/multibook.h
+ * Purpose: Run one command over every book under a directory (--all)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - A book is a directory holding a book.yaml. multibook_find walks a root
+ *     for them, without descending into a book or into outputs/, workspace/,
+ *     node_modules/ and hidden directories.
+ *   - Every command assumes the book is the current directory, so each book
+ *     runs as its own uaengine process started in the book directory. A pool
+ *     of 'jobs' threads keeps that many processes going; books whose last run
+ *     took longest start first, so one big book does not finish alone at the
+ *     end.
+ *   - Tool probes are done once by the parent and passed down in the
+ *     environment (UENG_HAVE_PANDOC=0|1, see tool_on_path). A traced run
+ *     (trace.h) sets UENG_TRACE so each book writes
+ *     workspace/logs/<label>.trace.json.
+ *   - Output of each book goes to <book>/workspace/logs/<label>.log; the
+ *     run time is kept next to it (<label>.ms) for the next schedule.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_MULTIBOOK_H
+#define UENG_MULTIBOOK_H
+
+#include "ueng/common.h" /* StrList */
+
+#include <stddef.h> /* size_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    const char *exe;          /* uaengine binary (absolute, or found on PATH) */
+    const char *label;        /* names the log and progress lines, e.g. "build" */
+    const char *const *steps; /* commands run in order per book, e.g. {"build"} */
+    size_t n_steps;           /* a failing step skips the rest for that book */
+    int jobs;                 /* books at a time; 0 = ueng_jobs() */
+    int quiet;                /* 1 = no per-book progress lines */
+  } MultiBookOptions;
+
+  typedef struct
+  {
+    const char *dir; /* points into the list given to multibook_run */
+    char log[1024];
+    int rc; /* exit code of the book's process; -1 when it could not start */
+    double ms;
+  } MultiBookResult;
+
+  /* Append the book directories under 'root' (root itself included) to
+     'out', sorted. Returns 0 on success. */
+  int multibook_find(const char *root, StrList *out);
+
+  /* Run o->steps in each of 'books'; res must hold books->count entries.
+     Returns the number of books that failed, or -1 on a setup error. */
+  int multibook_run(const MultiBookOptions *o, const StrList *books, MultiBookResult *res);
+
+  /* Path of the running executable into 'out' (falls back to argv0). */
+  int multibook_self_exe(const char *argv0, char *out, size_t outsz);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_MULTIBOOK_H */
@@ -0,0 +1,75 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/pool.h
+ * Purpose: Work-stealing task pool shared by every parallel stage
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - One process-wide pool (ueng_pool_global) of ueng_jobs() - 1 workers;
+ *     the thread that waits on a group works too, so ueng_jobs() threads run
+ *     tasks in total. ueng_parallel_for (common.h) is built on it.
+ *   - Each worker owns a Chase-Lev deque (Le et al., "Correct and Efficient
+ *     Work-Stealing for Weak Memory Models", PPoPP 2013): it pushes and pops
+ *     its own end without locks, idle workers steal from the other end.
+ *     Tasks spawned from outside the pool go through a locked injection
+ *     queue. Idle workers sleep on a condition variable, never spin.
+ *   - Tasks belong to a group; ueng_group_wait runs queued tasks (its own
+ *     group's or anyone's) until the group is done, so nested parallelism
+ *     cannot deadlock the pool. Cancelling a group drops its tasks that have
+ *     not started; running ones can poll ueng_group_cancelled.
+ *   - Concurrency comes from -j N on the command line (ueng_set_jobs) or
+ *     UENG_JOBS, else one per CPU.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_POOL_H
+#define UENG_POOL_H
+
+#include <stddef.h> /* size_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct UengPool UengPool;
+
+  typedef struct
+  {
+    UengPool *pool;
+    volatile long pending; /* tasks spawned and not finished; atomic access only */
+    volatile long cancelled;
+  } UengTaskGroup;
+
+  /* Threads to use for parallel stages: ueng_set_jobs value, else UENG_JOBS,
+     else ueng_cpu_count(). Always >= 1. */
+  int ueng_jobs(void);
+  /* Override ueng_jobs (0 = back to UENG_JOBS / CPU count). Call before the
+     global pool is first used. */
+  void ueng_set_jobs(int jobs);
+
+  /* Pool with 'workers' threads (0 is valid: tasks then run in the threads
+     that wait for them). NULL when out of memory. */
+  UengPool *ueng_pool_create(int workers);
+  /* Waits for queued tasks to finish, then joins the workers. */
+  void ueng_pool_destroy(UengPool *p);
+  int ueng_pool_workers(const UengPool *p);
+  /* The shared pool (created on first use, destroyed at exit). */
+  UengPool *ueng_pool_global(void);
+
+  void ueng_group_init(UengTaskGroup *g, UengPool *p);
+  /* Queue fn(arg). Returns 0, or -1 when out of memory (fn then runs inline,
+     so the work is never lost). */
+  int ueng_group_spawn(UengTaskGroup *g, void (*fn)(void *arg), void *arg);
+  /* Run tasks until every task of the group has finished. */
+  void ueng_group_wait(UengTaskGroup *g);
+  void ueng_group_cancel(UengTaskGroup *g);
+  int ueng_group_cancelled(const UengTaskGroup *g);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_POOL_H */
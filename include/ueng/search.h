@@ -0,0 +1,103 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/search.h
+ * Purpose: Build-time full-text search index for the generated site
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - The indexed unit ("doc") is a section of the packed draft: the text
+ *     between two Markdown headings. Each doc records its chapter, its
+ *     pandoc-style anchor id and its byte range in the draft.
+ *   - Tokens are runs of ASCII letters/digits or non-ASCII bytes (UTF-8
+ *     letters), lower-cased in ASCII only, 2..48 bytes long. Non-ASCII
+ *     spaces and punctuation (NBSP, guillemets, curly quotes, dashes,
+ *     ellipsis: the General Punctuation block) separate tokens.
+ *   - On-disk layout (all integers little-endian, offsets from file start):
+ *       header      SearchIdxHeader (64 bytes)
+ *       docs        n_docs   x SearchIdxDoc (24 bytes)
+ *       chapters    n_chapters x u32 string offsets
+ *       blocks      n_blocks x { u32 term_off, u32 post_off }
+ *       strings     NUL-terminated UTF-8 strings (anchors, titles, names)
+ *       terms       front-coded blocks of SEARCH_IDX_BLOCK sorted terms:
+ *                     first:  varint len, bytes
+ *                     others: varint shared, varint suffix_len, suffix bytes
+ *                     each followed by varint df, varint posting_bytes
+ *       postings    per term, per doc: varint doc_delta, varint tf
+ *   - site/search.js reads the same format in the browser; `serve` answers
+ *     /__search?q= from the mmap'd file (search_open/search_query_json).
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_SEARCH_H
+#define UENG_SEARCH_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SEARCH_IDX_MAGIC "UENGSIX1"
+#define SEARCH_IDX_VERSION 2u
+#define SEARCH_IDX_BLOCK 16u
+#define SEARCH_TERM_MIN 2
+#define SEARCH_TERM_MAX 48
+
+  typedef struct
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_docs, n_terms, n_chapters, n_blocks;
+    uint32_t docs_off, chapters_off, blocks_off, strings_off, terms_off, post_off;
+    uint32_t source_str; /* string offset: draft path relative to the index file */
+    uint32_t file_len;
+    uint32_t reserved;
+  } SearchIdxHeader; /* 64 bytes on disk */
+
+  typedef struct
+  {
+    uint32_t src_off, src_len; /* byte range of the section in the draft */
+    uint32_t n_tokens;
+    uint32_t chapter;
+    uint32_t anchor_str, title_str; /* offsets into the string pool */
+  } SearchIdxDoc;
+
+  typedef struct
+  {
+    uint64_t bytes_in;
+    uint32_t n_docs, n_terms, n_chapters;
+    uint64_t index_bytes;
+    double ms;
+  } SearchBuildStats;
+
+  /* Index 'draft_path' into 'index_path'. 'source_rel' is stored in the header
+     so readers can find the draft for snippets (relative to the index dir).
+     Returns 0 on success. */
+  int search_build_index(const char *draft_path, const char *index_path, const char *source_rel,
+                         SearchBuildStats *st);
+
+  /* Write the small browser-side query shim (search.js) into 'site_dir'. */
+  int search_write_js(const char *site_dir);
+
+  /* Read side (used by `serve`): both the index and the draft it names are
+     mmap'd, so opening is cheap and queries never copy the manuscript.
+     search_open returns NULL if the file is missing or malformed. */
+  typedef struct SearchIndex SearchIndex;
+  SearchIndex *search_open(const char *index_path);
+  void search_close(SearchIndex *ix);
+
+  /* AND query ranked with BM25. Writes a malloc'd, NUL-terminated JSON object
+     {query,total,results:[{title,anchor,chapter,score,snippet}],ms} with at
+     most 'limit' results. Returns 0 on success (caller frees *out). */
+  int search_query_json(const SearchIndex *ix, const char *query, size_t limit, char **out,
+                        size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_SEARCH_H */
@@ -21,6 +21,19 @@ extern "C"
 {
 #endif
 
+  typedef struct
+  {
+    char method[8];
+    char path[2048];   /* without the query string */
+    char version[16];  /* "HTTP/1.1" */
+    const char *query; /* points into path's storage; NULL when absent */
+    int head_only;
+  } ServeRequest;
+
+  /* Parse the request line of 'req'. Returns 0 for GET/HEAD, 1 when the line
+     is malformed (400), 2 for any other method (405). */
+  int serve_parse_request(const char *req, ServeRequest *r);
+
   /* Serve files under 'root' (must contain index.html). host: "127.0.0.1", port: 8080.
      Blocks in the accept loop; Ctrl+C to stop (Windows handler installed). */
   int serve_run(const char *root, const char *host, int port);
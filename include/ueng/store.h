@@ -0,0 +1,77 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/store.h
+ * Purpose: Content-addressed object store that deduplicates output trees
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Objects live at <store>/objects/ab/cdef... named by the SHA-256 of their
+ *     bytes. <store> is UENG_CACHE_DIR, or outputs/.store by default (it must
+ *     be on the same filesystem as outputs/ for links to work).
+ *   - After a build, every file of outputs/<slug>/<day>/ is replaced by a
+ *     reflink (copy-on-write clone) or, failing that, a hardlink to its
+ *     object. Objects are read-only; hardlinked outputs share that mode.
+ *   - Because hardlinked files share one inode, a tree must be detached
+ *     (store_detach_tree) before anything rewrites it in place.
+ *   - <store>/refs/<id>.ref lists the objects each tree uses; store_gc keeps
+ *     objects referenced by trees that still exist and deletes the rest.
+ *   - Set UENG_STORE=0 to disable the store entirely.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_STORE_H
+#define UENG_STORE_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    size_t files;         /* regular files visited */
+    size_t linked;        /* files now sharing an object that already existed */
+    size_t new_objects;   /* objects added by this commit */
+    size_t unlinkable;    /* files left as plain copies (no reflink/hardlink) */
+    uint64_t bytes;       /* logical bytes of the tree */
+    uint64_t bytes_saved; /* bytes not stored again thanks to existing objects */
+    double ms;
+  } StoreStats;
+
+  typedef struct
+  {
+    size_t refs, stale_refs;     /* live trees / refs dropped (tree deleted) */
+    size_t objects, removed;     /* objects kept / deleted */
+    uint64_t bytes;              /* bytes held by kept objects */
+    uint64_t bytes_removed;      /* bytes freed */
+    uint64_t bytes_referenced;   /* logical bytes of all live trees */
+  } StoreGcStats;
+
+  /* 1 unless UENG_STORE=0. */
+  int store_enabled(void);
+  /* Store root directory (see module notes). */
+  void store_dir(char *out, size_t outsz);
+
+  /* Give every shared (hardlinked or read-only) file under 'root' its own
+     private, writable copy so it can be rewritten safely. */
+  int store_detach_tree(const char *root);
+
+  /* Move the files of 'root' into the store and link them back; records the
+     tree in refs/. Returns 0 on success (files that cannot be linked are
+     left as they are and counted in st->unlinkable). */
+  int store_commit_tree(const char *root, StoreStats *st);
+
+  /* Mark and sweep: drop refs whose tree no longer exists and delete objects
+     no remaining ref mentions. */
+  int store_gc(StoreGcStats *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_STORE_H */
@@ -0,0 +1,84 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/textnorm.h
+ * Purpose: UTF-8 validation and text normalization for manuscript sources
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Output is always valid UTF-8 with LF line endings, no BOM and no NUL
+ *     bytes, whatever the input was:
+ *       UTF-8 (BOM optional)       validated, BOM dropped
+ *       UTF-16 LE/BE               by BOM, or sniffed from NUL byte patterns
+ *       Windows-1252 / Latin-1     any byte that is not part of a valid UTF-8
+ *                                  sequence is read as CP1252 and transcoded
+ *   - CRLF and lone CR become LF.
+ *   - Pure-ASCII spans are checked and copied 16/32 bytes at a time (SSE2 or
+ *     AVX2 on x86, picked at run time; NEON on ARM; 8-byte SWAR elsewhere),
+ *     so typical English manuscripts go through at memory speed.
+ *   - The same state machine backs the one-shot and streaming entry points;
+ *     sequences split across chunk boundaries are carried over.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_TEXTNORM_H
+#define UENG_TEXTNORM_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h>  /* FILE */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef enum
+  {
+    TEXTNORM_UTF8 = 0,
+    TEXTNORM_UTF16LE,
+    TEXTNORM_UTF16BE
+  } TextNormEncoding;
+
+  typedef struct
+  {
+    TextNormEncoding encoding; /* detected source encoding */
+    int had_bom;
+    uint64_t bytes_in, bytes_out;
+    uint64_t line_endings; /* CRLF / CR folded to LF */
+    uint64_t transcoded;   /* bytes re-read as Windows-1252 */
+    uint64_t replaced;     /* NULs dropped, broken UTF-16 replaced by U+FFFD */
+  } TextNormStats;
+
+  typedef struct
+  {
+    int started;
+    int cr; /* last character was CR: swallow a following LF */
+    unsigned char carry[8];
+    size_t ncarry;
+    TextNormStats st;
+  } TextNorm;
+
+  void textnorm_init(TextNorm *tn);
+
+  /* Worst-case output size for n input bytes (one step). */
+  size_t textnorm_bound(size_t n);
+
+  /* Normalize the next n bytes of a stream into 'out' (at least
+     textnorm_bound(n) bytes). Pass final=1 with the last chunk (n may be 0).
+     Returns the number of bytes written. */
+  size_t textnorm_step(TextNorm *tn, const void *in, size_t n, int final, char *out);
+
+  /* One-shot: *out is malloc'd and NUL-terminated. Returns 0 on success. */
+  int textnorm_buffer(const void *in, size_t n, char **out, size_t *out_len, TextNormStats *st);
+
+  /* Streaming filter used by the draft packer: copies 'in' to 'out' through
+     the normalizer with bounded memory. Returns 0 on success. */
+  int textnorm_copy_stream(FILE *in, FILE *out, TextNormStats *st);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_TEXTNORM_H */
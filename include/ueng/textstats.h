@@ -0,0 +1,69 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/textstats.h
+ * Purpose: Single-pass manuscript statistics (words, sentences, structure)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Input is normalized text (textnorm: UTF-8, LF line endings).
+ *   - The scanner classifies 64 bytes at a time into bit masks (whitespace,
+ *     newline, sentence punctuation, digits, closing quotes) with AVX2 or
+ *     SSE2 on x86 (picked at run time), NEON on ARM and a scalar loop
+ *     elsewhere. Words and sentence ends are then popcounts over those
+ *     masks; only line starts are looked at one by one, for Markdown
+ *     structure (headings, fences, blank lines).
+ *   - Definitions:
+ *       word        a run of non-whitespace bytes outside fenced code,
+ *                   except Markdown markers at a line start: heading '#'s
+ *                   (and a closing "##"), "> ", "- ", "* ", "+ ", "1. "
+ *       sentence    '.', '!' or '?' (not right after a digit, so "1." list
+ *                   markers do not count), optionally followed by one
+ *                   closing quote, bracket or emphasis mark, then whitespace
+ *                   or the end of the text
+ *       paragraph   a run of non-blank lines that are not headings or code
+ *       heading     an ATX heading ("#".."######") outside fenced code
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_TEXTSTATS_H
+#define UENG_TEXTSTATS_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Reading speed used for reading-time estimates (silent reading of
+   non-fiction by adults, words per minute). */
+#define TEXTSTATS_WPM 238
+
+  typedef struct
+  {
+    uint64_t bytes, lines;
+    uint64_t words, sentences, paragraphs, headings;
+    uint64_t code_lines; /* lines inside fenced code blocks, fences included */
+  } TextStats;
+
+  /* Called for each heading: byte offset of its line, level 1..6 and the
+     title text (trimmed, closing '#'s removed; not NUL-terminated). */
+  typedef void (*TextStatsHeadingFn)(void *ud, size_t offset, int level, const char *title,
+                                     size_t len);
+
+  /* Scan n bytes of normalized text into *st (overwritten). on_heading may
+     be NULL. */
+  void textstats_scan(const char *s, size_t n, TextStats *st, TextStatsHeadingFn on_heading,
+                      void *ud);
+
+  /* Accumulate 'b' into 'a'. */
+  void textstats_add(TextStats *a, const TextStats *b);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_TEXTSTATS_H */
@@ -0,0 +1,57 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/trace.h
+ * Purpose: Timed spans written as a Chrome trace-event file (--trace)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - `uaengine --trace out.json <command>` or UENG_TRACE=out.json records
+ *     where a command spends its time. The file uses the JSON array form of
+ *     the Chrome trace-event format (complete "X" events, one track per
+ *     thread); open it in https://ui.perfetto.dev or chrome://tracing.
+ *   - A span is a pair: t0 = ueng_trace_begin(); ...; ueng_trace_end(cat,
+ *     name, t0). Spans on one thread nest by time. 'cat' and 'name' are kept
+ *     by pointer and must be string literals; the optional detail string is
+ *     copied.
+ *   - Each thread records into its own buffer (no locks, no I/O); buffers
+ *     are written when the process exits. Long-running loops (serve) call
+ *     ueng_trace_flush to write their own thread's events as they go; the
+ *     closing ']' is optional in this format, so a killed server still
+ *     leaves a readable file.
+ *   - With tracing off every call is a load and a branch.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_TRACE_H
+#define UENG_TRACE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /* Start recording to 'path' (truncated now, completed at exit). Call once,
+     before other threads start. Returns 0, or -1 when the file cannot be
+     created. */
+  int ueng_trace_start(const char *path);
+  int ueng_trace_on(void);
+
+  /* Span start time, or 0 when tracing is off. */
+  double ueng_trace_begin(void);
+  void ueng_trace_end(const char *cat, const char *name, double t0);
+  /* Same, with a detail string (a path, a command line) shown as args. */
+  void ueng_trace_end_arg(const char *cat, const char *name, double t0, const char *detail);
+
+  /* Label the calling thread's track (copied; default "thread N"). */
+  void ueng_trace_thread_name(const char *name);
+
+  /* Append the calling thread's events to the file now. */
+  void ueng_trace_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_TRACE_H */
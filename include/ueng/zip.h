@@ -0,0 +1,72 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: include/ueng/zip.h
+ * Purpose: Minimal streaming ZIP writer (stored + deflate entries)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Entries are prepared as "blobs": the payload is fed in chunks while the
+ *     CRC-32 is updated and (optionally) deflated on the fly. Blobs are plain
+ *     memory, so workers can prepare them in parallel.
+ *   - The archive itself is written sequentially by one thread: blobs are
+ *     appended in the order the caller wants, then zip_close() writes the
+ *     central directory.
+ *   - Deflate needs zlib (UENG_HAVE_ZLIB); without it blobs fall back to
+ *     "stored", which every ZIP reader accepts.
+ *   - No Zip64: archives are limited to 65535 entries and 4 GiB.
+ *---------------------------------------------------------------------------*/
+
+#ifndef UENG_ZIP_H
+#define UENG_ZIP_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  enum
+  {
+    UENG_ZIP_STORED = 0,
+    UENG_ZIP_DEFLATE = 8
+  };
+
+  /* One archive member, prepared in memory. */
+  typedef struct
+  {
+    unsigned char *data; /* payload exactly as it goes into the archive */
+    size_t len, cap;
+    uint64_t raw_size; /* uncompressed size */
+    uint32_t crc;      /* CRC-32 of the uncompressed bytes */
+    int method;        /* UENG_ZIP_STORED or UENG_ZIP_DEFLATE */
+    void *z;           /* deflate stream while the blob is open */
+  } UengZipBlob;
+
+  /* Blob lifecycle: begin -> write* -> end; free releases memory.
+     'method' is a request: DEFLATE silently degrades to STORED without zlib. */
+  int zip_blob_begin(UengZipBlob *b, int method);
+  int zip_blob_write(UengZipBlob *b, const void *data, size_t len);
+  int zip_blob_end(UengZipBlob *b);
+  void zip_blob_free(UengZipBlob *b);
+
+  typedef struct UengZip UengZip;
+
+  /* Create/truncate 'path' and start a new archive. NULL on failure. */
+  UengZip *zip_create(const char *path);
+  /* Append a finished blob as member 'name' (forward slashes). */
+  int zip_add_blob(UengZip *z, const char *name, const UengZipBlob *b);
+  /* Convenience: append a small in-memory member in one call. */
+  int zip_add_bytes(UengZip *z, const char *name, const void *data, size_t len, int method);
+  /* Write the central directory and close. Returns 0 on success; frees 'z' either way. */
+  int zip_close(UengZip *z);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UENG_ZIP_H */
@@ -0,0 +1,909 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/bookdiff.c
+ * Purpose: Chapter-level change report between two packed drafts
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "ueng/bookdiff.h"
+#include "ueng/hash.h"
+#include "ueng/pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int is_ws(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+/*------------------------------ Myers diff ----------------------------------*/
+/* Linear-space O(ND) diff over 64-bit hashes: find the middle snake by
+   running the greedy search from both ends, split there and recurse
+   (Myers 1986, section 4b; structured like diff-match-patch's bisect).
+   Results are flags: del[i] for a[i], ins[j] for b[j]. */
+
+static void mark_all(unsigned char *f, size_t from, size_t to)
+{
+  for (size_t i = from; i < to; ++i)
+    f[i] = 1;
+}
+
+static void diff_range(const uint64_t *a, size_t a0, size_t a1, const uint64_t *b, size_t b0,
+                       size_t b1, unsigned char *del, unsigned char *ins);
+
+/* Returns 1 and the split point in (*sx, *sy) relative to a0/b0. */
+static int bisect(const uint64_t *t1, long len1, const uint64_t *t2, long len2, long *sx, long *sy)
+{
+  long max_d = (len1 + len2 + 1) / 2;
+  long v_off = max_d, v_len = 2 * max_d + 2;
+  long *v1 = (long *)malloc((size_t)v_len * 2 * sizeof(long));
+  if (!v1)
+    return 0;
+  long *v2 = v1 + v_len;
+  for (long i = 0; i < v_len; ++i)
+    v1[i] = v2[i] = -1;
+  v1[v_off + 1] = 0;
+  v2[v_off + 1] = 0;
+  long delta = len1 - len2;
+  int front = (delta & 1) != 0;
+  long k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+  for (long d = 0; d < max_d; ++d)
+  {
+    for (long k1 = -d + k1start; k1 <= d - k1end; k1 += 2)
+    {
+      long k1o = v_off + k1, x1;
+      if (k1 == -d || (k1 != d && v1[k1o - 1] < v1[k1o + 1]))
+        x1 = v1[k1o + 1];
+      else
+        x1 = v1[k1o - 1] + 1;
+      long y1 = x1 - k1;
+      while (x1 < len1 && y1 < len2 && t1[x1] == t2[y1])
+      {
+        x1++;
+        y1++;
+      }
+      v1[k1o] = x1;
+      if (x1 > len1)
+        k1end += 2;
+      else if (y1 > len2)
+        k1start += 2;
+      else if (front)
+      {
+        long k2o = v_off + delta - k1;
+        if (k2o >= 0 && k2o < v_len && v2[k2o] != -1 && x1 >= len1 - v2[k2o])
+        {
+          *sx = x1;
+          *sy = y1;
+          free(v1);
+          return 1;
+        }
+      }
+    }
+    for (long k2 = -d + k2start; k2 <= d - k2end; k2 += 2)
+    {
+      long k2o = v_off + k2, x2;
+      if (k2 == -d || (k2 != d && v2[k2o - 1] < v2[k2o + 1]))
+        x2 = v2[k2o + 1];
+      else
+        x2 = v2[k2o - 1] + 1;
+      long y2 = x2 - k2;
+      while (x2 < len1 && y2 < len2 && t1[len1 - x2 - 1] == t2[len2 - y2 - 1])
+      {
+        x2++;
+        y2++;
+      }
+      v2[k2o] = x2;
+      if (x2 > len1)
+        k2end += 2;
+      else if (y2 > len2)
+        k2start += 2;
+      else if (!front)
+      {
+        long k1o = v_off + delta - k2;
+        if (k1o >= 0 && k1o < v_len && v1[k1o] != -1)
+        {
+          long x1 = v1[k1o], y1 = v_off + x1 - k1o;
+          if (x1 >= len1 - x2)
+          {
+            *sx = x1;
+            *sy = y1;
+            free(v1);
+            return 1;
+          }
+        }
+      }
+    }
+  }
+  free(v1);
+  return 0;
+}
+
+static void diff_range(const uint64_t *a, size_t a0, size_t a1, const uint64_t *b, size_t b0,
+                       size_t b1, unsigned char *del, unsigned char *ins)
+{
+  while (a0 < a1 && b0 < b1 && a[a0] == b[b0])
+  {
+    a0++;
+    b0++;
+  }
+  while (a0 < a1 && b0 < b1 && a[a1 - 1] == b[b1 - 1])
+  {
+    a1--;
+    b1--;
+  }
+  if (a0 == a1 || b0 == b1)
+  {
+    mark_all(del, a0, a1);
+    mark_all(ins, b0, b1);
+    return;
+  }
+  long sx, sy;
+  if (!bisect(a + a0, (long)(a1 - a0), b + b0, (long)(b1 - b0), &sx, &sy))
+  {
+    mark_all(del, a0, a1);
+    mark_all(ins, b0, b1);
+    return;
+  }
+  diff_range(a, a0, a0 + (size_t)sx, b, b0, b0 + (size_t)sy, del, ins);
+  diff_range(a, a0 + (size_t)sx, a1, b, b0 + (size_t)sy, b1, del, ins);
+}
+
+/*------------------------------ words ---------------------------------------*/
+
+typedef struct
+{
+  uint32_t *off, *len;
+  uint64_t *h;
+  size_t n, cap;
+} Words;
+
+static int words_split(const char *s, size_t n, Words *w)
+{
+  w->n = 0;
+  for (size_t i = 0; i < n;)
+  {
+    while (i < n && is_ws((unsigned char)s[i]))
+      i++;
+    if (i == n)
+      break;
+    size_t st = i;
+    while (i < n && !is_ws((unsigned char)s[i]))
+      i++;
+    if (w->n == w->cap)
+    {
+      size_t nc = w->cap ? w->cap * 2 : 64;
+      uint32_t *no = (uint32_t *)realloc(w->off, nc * sizeof(uint32_t));
+      if (no)
+        w->off = no;
+      uint32_t *nl = (uint32_t *)realloc(w->len, nc * sizeof(uint32_t));
+      if (nl)
+        w->len = nl;
+      uint64_t *nh = (uint64_t *)realloc(w->h, nc * sizeof(uint64_t));
+      if (nh)
+        w->h = nh;
+      if (!no || !nl || !nh)
+        return -1;
+      w->cap = nc;
+    }
+    w->off[w->n] = (uint32_t)st;
+    w->len[w->n] = (uint32_t)(i - st);
+    w->h[w->n] = ueng_hash64(s + st, i - st, 0);
+    w->n++;
+  }
+  return 0;
+}
+
+static void words_free(Words *w)
+{
+  free(w->off);
+  free(w->len);
+  free(w->h);
+  memset(w, 0, sizeof(*w));
+}
+
+/* Word-level diff of two paragraphs; flags are allocated for the caller. */
+typedef struct
+{
+  Words a, b;
+  unsigned char *del, *ins;
+} WordDiff;
+
+static int word_diff(const char *sa, size_t na, const char *sb, size_t nb, WordDiff *wd)
+{
+  memset(wd, 0, sizeof(*wd));
+  if (words_split(sa, na, &wd->a) != 0 || words_split(sb, nb, &wd->b) != 0)
+    return -1;
+  wd->del = (unsigned char *)calloc(wd->a.n + 1, 1);
+  wd->ins = (unsigned char *)calloc(wd->b.n + 1, 1);
+  if (!wd->del || !wd->ins)
+    return -1;
+  diff_range(wd->a.h, 0, wd->a.n, wd->b.h, 0, wd->b.n, wd->del, wd->ins);
+  return 0;
+}
+
+static void word_diff_free(WordDiff *wd)
+{
+  words_free(&wd->a);
+  words_free(&wd->b);
+  free(wd->del);
+  free(wd->ins);
+}
+
+/*------------------------------ drafts --------------------------------------*/
+
+typedef struct
+{
+  char name[256];
+  size_t off, end; /* byte range of the chapter body */
+  int used;
+} Seg;
+
+typedef struct
+{
+  Seg *s;
+  size_t n, cap;
+} SegList;
+
+static int seg_push(SegList *l, const char *name, size_t len, size_t off)
+{
+  if (l->n == l->cap)
+  {
+    size_t nc = l->cap ? l->cap * 2 : 64;
+    Seg *ns = (Seg *)realloc(l->s, nc * sizeof(Seg));
+    if (!ns)
+      return -1;
+    l->s = ns;
+    l->cap = nc;
+  }
+  Seg *s = &l->s[l->n++];
+  memset(s, 0, sizeof(*s));
+  if (len >= sizeof(s->name))
+    len = sizeof(s->name) - 1;
+  memcpy(s->name, name, len);
+  s->off = s->end = off;
+  return 0;
+}
+
+/* Split a draft at its "<!-- name -->" marker lines; only lines starting
+   with '<' are looked at, so this runs at memchr speed. */
+static int draft_split(const UengMap *m, SegList *l)
+{
+  memset(l, 0, sizeof(*l));
+  if (seg_push(l, "(front matter)", 14, 0) != 0)
+    return -1;
+  const char *s = (const char *)m->data;
+  size_t n = m->len;
+  for (size_t i = 0; i < n;)
+  {
+    const char *eol = (const char *)memchr(s + i, '\n', n - i);
+    size_t le = eol ? (size_t)(eol - s) : n, ll = le - i;
+    if (s[i] == '<' && ll >= 9 && memcmp(s + i, "<!-- ", 5) == 0 &&
+        memcmp(s + le - 4, " -->", 4) == 0)
+    {
+      l->s[l->n - 1].end = i;
+      if (seg_push(l, s + i + 5, ll - 9, eol ? le + 1 : n) != 0)
+        return -1;
+    }
+    i = le + (eol ? 1 : 0);
+  }
+  l->s[l->n - 1].end = n;
+  return 0;
+}
+
+typedef struct
+{
+  BookDiffPara *p;
+  size_t n, cap;
+} ParaList;
+
+static int para_push(ParaList *l, const char *base, size_t off, size_t end)
+{
+  if (l->n == l->cap)
+  {
+    size_t nc = l->cap ? l->cap * 2 : 64;
+    BookDiffPara *np = (BookDiffPara *)realloc(l->p, nc * sizeof(BookDiffPara));
+    if (!np)
+      return -1;
+    l->p = np;
+    l->cap = nc;
+  }
+  BookDiffPara *p = &l->p[l->n++];
+  p->off = (uint32_t)off;
+  p->len = (uint32_t)(end - off);
+  p->words = 0;
+  /* Hash the words, not the bytes (FNV-1a with each whitespace run folded
+     to one space), so re-wrapping a paragraph is not a change. */
+  uint64_t h = 0xCBF29CE484222325ull;
+  int in_word = 0;
+  for (size_t i = off; i < end; ++i)
+  {
+    unsigned char c = (unsigned char)base[i];
+    if (is_ws(c))
+    {
+      in_word = 0;
+      continue;
+    }
+    if (!in_word)
+    {
+      h = (h ^ ' ') * 0x100000001B3ull;
+      p->words++;
+      in_word = 1;
+    }
+    h = (h ^ c) * 0x100000001B3ull;
+  }
+  p->hash = h;
+  return 0;
+}
+
+/* Cut base[off, end) into paragraphs (runs of non-blank lines). */
+static int split_paras(const char *base, size_t off, size_t end, BookDiffPara **out, size_t *n)
+{
+  ParaList l = {NULL, 0, 0};
+  size_t para = SIZE_MAX, para_end = 0;
+  for (size_t i = off; i < end;)
+  {
+    const char *eol = (const char *)memchr(base + i, '\n', end - i);
+    size_t le = eol ? (size_t)(eol - base) : end;
+    int blank = 1;
+    for (size_t k = i; k < le && blank; ++k)
+      blank = is_ws((unsigned char)base[k]);
+    if (!blank)
+    {
+      if (para == SIZE_MAX)
+        para = i;
+      para_end = le;
+    }
+    else if (para != SIZE_MAX)
+    {
+      if (para_push(&l, base, para, para_end) != 0)
+        goto fail;
+      para = SIZE_MAX;
+    }
+    i = le + (eol ? 1 : 0);
+  }
+  if (para != SIZE_MAX && para_push(&l, base, para, para_end) != 0)
+    goto fail;
+  *out = l.p;
+  *n = l.n;
+  return 0;
+fail:
+  free(l.p);
+  return -1;
+}
+
+static int seg_name_cmp(const void *A, const void *B)
+{
+  const Seg *a = *(const Seg *const *)A, *b = *(const Seg *const *)B;
+  int c = strcmp(a->name, b->name);
+  if (c)
+    return c;
+  return (a > b) - (a < b); /* keep draft order among duplicates */
+}
+
+/*------------------------------ run -----------------------------------------*/
+
+typedef struct
+{
+  const Seg *a, *b; /* NULL when the chapter is only on one side */
+} Pair;
+
+typedef struct
+{
+  BookDiff *d;
+  const Pair *pairs;
+  int failed;
+} RunCtx;
+
+static void count_words(BookDiffChapter *c, const char *sa, const char *sb)
+{
+  /* Replaced paragraphs pair up and only their changed words count; the
+     rest count whole. */
+  size_t x = 0, y = 0;
+  while (x < c->na || y < c->nb)
+  {
+    if (x < c->na && y < c->nb && !c->del[x] && !c->ins[y])
+    {
+      x++;
+      y++;
+      continue;
+    }
+    size_t x0 = x, y0 = y;
+    while (x < c->na && c->del[x])
+      x++;
+    while (y < c->nb && c->ins[y])
+      y++;
+    if (x == x0 && y == y0)
+      break; /* cannot happen with consistent flags; never loop forever */
+    c->para_del += x - x0;
+    c->para_ins += y - y0;
+    size_t pairs = (x - x0) < (y - y0) ? (x - x0) : (y - y0);
+    for (size_t k = 0; k < pairs; ++k)
+    {
+      const BookDiffPara *pa = &c->a[x0 + k], *pb = &c->b[y0 + k];
+      WordDiff wd;
+      if (word_diff(sa + pa->off, pa->len, sb + pb->off, pb->len, &wd) == 0)
+      {
+        for (size_t w = 0; w < wd.a.n; ++w)
+          c->words_del += wd.del[w];
+        for (size_t w = 0; w < wd.b.n; ++w)
+          c->words_ins += wd.ins[w];
+      }
+      else
+      {
+        c->words_del += pa->words;
+        c->words_ins += pb->words;
+      }
+      word_diff_free(&wd);
+    }
+    for (size_t k = x0 + pairs; k < x; ++k)
+      c->words_del += c->a[k].words;
+    for (size_t k = y0 + pairs; k < y; ++k)
+      c->words_ins += c->b[k].words;
+  }
+}
+
+static void chapter_worker(void *ud, size_t i)
+{
+  RunCtx *rc = (RunCtx *)ud;
+  BookDiff *d = rc->d;
+  BookDiffChapter *c = &d->ch[i];
+  const Pair *pr = &rc->pairs[i];
+  const char *sa = (const char *)d->ma.data, *sb = (const char *)d->mb.data;
+  if (c->status == BOOKDIFF_SAME)
+    return;
+  if ((pr->a && split_paras(sa, pr->a->off, pr->a->end, &c->a, &c->na) != 0) ||
+      (pr->b && split_paras(sb, pr->b->off, pr->b->end, &c->b, &c->nb) != 0))
+  {
+    rc->failed = 1;
+    return;
+  }
+  c->del = (unsigned char *)calloc(c->na + 1, 1);
+  c->ins = (unsigned char *)calloc(c->nb + 1, 1);
+  if (!c->del || !c->ins)
+  {
+    rc->failed = 1;
+    return;
+  }
+  if (c->status == BOOKDIFF_CHANGED && c->na == c->nb)
+  {
+    size_t k = 0;
+    while (k < c->na && c->a[k].hash == c->b[k].hash)
+      k++;
+    if (k == c->na)
+    {
+      c->status = BOOKDIFF_SAME; /* only whitespace or wrapping moved */
+      return;
+    }
+  }
+
+  uint64_t *ha = (uint64_t *)malloc((c->na + 1) * sizeof(uint64_t));
+  uint64_t *hb = (uint64_t *)malloc((c->nb + 1) * sizeof(uint64_t));
+  if (ha && hb)
+  {
+    for (size_t k = 0; k < c->na; ++k)
+      ha[k] = c->a[k].hash;
+    for (size_t k = 0; k < c->nb; ++k)
+      hb[k] = c->b[k].hash;
+    diff_range(ha, 0, c->na, hb, 0, c->nb, c->del, c->ins);
+  }
+  else
+  {
+    mark_all(c->del, 0, c->na);
+    mark_all(c->ins, 0, c->nb);
+  }
+  free(ha);
+  free(hb);
+  count_words(c, sa, sb);
+}
+
+int bookdiff_run(const char *draft_a, const char *draft_b, int jobs, BookDiff *d)
+{
+  if (!draft_a || !draft_b || !d)
+    return -1;
+  memset(d, 0, sizeof(*d));
+  double t0 = ueng_now_ms();
+  if (ueng_map_file(draft_a, &d->ma) != 0 || ueng_map_file(draft_b, &d->mb) != 0 ||
+      d->ma.len > 0xFFFFFFFFu || d->mb.len > 0xFFFFFFFFu)
+  {
+    bookdiff_free(d);
+    return -1;
+  }
+  SegList A = {NULL, 0, 0}, B = {NULL, 0, 0};
+  int ok = draft_split(&d->ma, &A) == 0 && draft_split(&d->mb, &B) == 0;
+  Seg **byname = ok ? (Seg **)malloc(A.n * sizeof(Seg *)) : NULL;
+  Pair *pairs = ok ? (Pair *)calloc(A.n + B.n, sizeof(Pair)) : NULL;
+  d->ch = ok ? (BookDiffChapter *)calloc(A.n + B.n, sizeof(BookDiffChapter)) : NULL;
+  if (!ok || !byname || !pairs || !d->ch)
+  {
+    free(byname);
+    free(pairs);
+    free(A.s);
+    free(B.s);
+    bookdiff_free(d);
+    return -1;
+  }
+  for (size_t i = 0; i < A.n; ++i)
+    byname[i] = &A.s[i];
+  qsort(byname, A.n, sizeof(Seg *), seg_name_cmp);
+
+  /* New draft order first; chapters that disappeared go last. Chapters with
+     identical bytes are settled here without being split into paragraphs. */
+  const char *sa = (const char *)d->ma.data, *sb = (const char *)d->mb.data;
+  for (size_t i = 0; i < B.n; ++i)
+  {
+    Seg *gb = &B.s[i], *ga = NULL;
+    size_t lo = 0, hi = A.n;
+    while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (strcmp(byname[mid]->name, gb->name) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    for (; lo < A.n && strcmp(byname[lo]->name, gb->name) == 0; ++lo)
+      if (!byname[lo]->used)
+      {
+        ga = byname[lo];
+        ga->used = 1;
+        break;
+      }
+    pairs[d->n].a = ga;
+    pairs[d->n].b = gb;
+    BookDiffChapter *c = &d->ch[d->n++];
+    snprintf(c->name, sizeof(c->name), "%s", gb->name);
+    if (!ga)
+      c->status = BOOKDIFF_ADDED;
+    else if (ga->end - ga->off == gb->end - gb->off &&
+             memcmp(sa + ga->off, sb + gb->off, ga->end - ga->off) == 0)
+      c->status = BOOKDIFF_SAME;
+    else
+      c->status = BOOKDIFF_CHANGED;
+  }
+  for (size_t i = 0; i < A.n; ++i)
+  {
+    if (A.s[i].used)
+      continue;
+    pairs[d->n].a = &A.s[i];
+    BookDiffChapter *c = &d->ch[d->n++];
+    snprintf(c->name, sizeof(c->name), "%s", A.s[i].name);
+    c->status = BOOKDIFF_REMOVED;
+  }
+  free(byname);
+
+  RunCtx rc = {d, pairs, 0};
+  ueng_parallel_for(d->n, jobs > 0 ? jobs : ueng_jobs(), chapter_worker, &rc);
+  free(pairs);
+  free(A.s);
+  free(B.s);
+  if (rc.failed)
+  {
+    bookdiff_free(d);
+    return -1;
+  }
+
+  /* A chapter (e.g. empty front matter) with no paragraphs on either side
+     is not worth a line in the report. */
+  size_t keep = 0;
+  for (size_t i = 0; i < d->n; ++i)
+  {
+    BookDiffChapter *c = &d->ch[i];
+    if (c->status != BOOKDIFF_SAME && c->na == 0 && c->nb == 0)
+    {
+      free(c->a);
+      free(c->b);
+      free(c->del);
+      free(c->ins);
+      continue;
+    }
+    d->ch[keep++] = *c;
+  }
+  d->n = keep;
+  for (size_t i = 0; i < d->n; ++i)
+  {
+    const BookDiffChapter *c = &d->ch[i];
+    d->same += c->status == BOOKDIFF_SAME;
+    d->changed += c->status == BOOKDIFF_CHANGED;
+    d->added += c->status == BOOKDIFF_ADDED;
+    d->removed += c->status == BOOKDIFF_REMOVED;
+    d->words_del += c->words_del;
+    d->words_ins += c->words_ins;
+  }
+  d->ms = ueng_now_ms() - t0;
+  return 0;
+}
+
+void bookdiff_free(BookDiff *d)
+{
+  if (!d)
+    return;
+  for (size_t i = 0; d->ch && i < d->n; ++i)
+  {
+    free(d->ch[i].a);
+    free(d->ch[i].b);
+    free(d->ch[i].del);
+    free(d->ch[i].ins);
+  }
+  free(d->ch);
+  ueng_unmap_file(&d->ma);
+  ueng_unmap_file(&d->mb);
+  memset(d, 0, sizeof(*d));
+}
+
+/*------------------------------ writers -------------------------------------*/
+
+static const char *status_name(BookDiffStatus s)
+{
+  switch (s)
+  {
+  case BOOKDIFF_CHANGED:
+    return "changed";
+  case BOOKDIFF_ADDED:
+    return "added";
+  case BOOKDIFF_REMOVED:
+    return "removed";
+  default:
+    return "unchanged";
+  }
+}
+
+static void json_text(FILE *out, const char *s, size_t n)
+{
+  fputc('"', out);
+  for (size_t i = 0; i < n; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c == '\n')
+      fputs("\\n", out);
+    else if (c < 0x20)
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+static void html_text(FILE *out, const char *s, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    switch (s[i])
+    {
+    case '&':
+      fputs("&amp;", out);
+      break;
+    case '<':
+      fputs("&lt;", out);
+      break;
+    case '>':
+      fputs("&gt;", out);
+      break;
+    case '"':
+      fputs("&quot;", out);
+      break;
+    default:
+      fputc(s[i], out);
+    }
+  }
+}
+
+int bookdiff_write_json(const BookDiff *d, const char *label_a, const char *label_b, FILE *out)
+{
+  if (!d || !out)
+    return -1;
+  const char *sa = (const char *)d->ma.data, *sb = (const char *)d->mb.data;
+  fputs("{\"from\":", out);
+  json_text(out, label_a ? label_a : "", label_a ? strlen(label_a) : 0);
+  fputs(",\"to\":", out);
+  json_text(out, label_b ? label_b : "", label_b ? strlen(label_b) : 0);
+  fprintf(out,
+          ",\"summary\":{\"chapters\":%zu,\"unchanged\":%zu,\"changed\":%zu,\"added\":%zu,"
+          "\"removed\":%zu,\"words_added\":%zu,\"words_removed\":%zu},\"chapters\":[",
+          d->n, d->same, d->changed, d->added, d->removed, d->words_ins, d->words_del);
+  int first = 1;
+  for (size_t i = 0; i < d->n; ++i)
+  {
+    const BookDiffChapter *c = &d->ch[i];
+    if (c->status == BOOKDIFF_SAME)
+      continue;
+    fputs(first ? "{\"name\":" : ",{\"name\":", out);
+    first = 0;
+    json_text(out, c->name, strlen(c->name));
+    fprintf(out,
+            ",\"status\":\"%s\",\"paragraphs_added\":%zu,\"paragraphs_removed\":%zu,"
+            "\"words_added\":%zu,\"words_removed\":%zu",
+            status_name(c->status), c->para_ins, c->para_del, c->words_ins, c->words_del);
+    if (c->status == BOOKDIFF_CHANGED)
+    {
+      fputs(",\"hunks\":[", out);
+      size_t x = 0, y = 0;
+      int fh = 1;
+      while (x < c->na || y < c->nb)
+      {
+        if (x < c->na && y < c->nb && !c->del[x] && !c->ins[y])
+        {
+          x++;
+          y++;
+          continue;
+        }
+        size_t x0 = x, y0 = y;
+        while (x < c->na && c->del[x])
+          x++;
+        while (y < c->nb && c->ins[y])
+          y++;
+        if (x == x0 && y == y0)
+          break;
+        fprintf(out, "%s{\"paragraph\":%zu,\"removed\":[", fh ? "" : ",", y0 + 1);
+        fh = 0;
+        for (size_t k = x0; k < x; ++k)
+        {
+          if (k > x0)
+            fputc(',', out);
+          json_text(out, sa + c->a[k].off, c->a[k].len);
+        }
+        fputs("],\"added\":[", out);
+        for (size_t k = y0; k < y; ++k)
+        {
+          if (k > y0)
+            fputc(',', out);
+          json_text(out, sb + c->b[k].off, c->b[k].len);
+        }
+        fputs("]}", out);
+      }
+      fputc(']', out);
+    }
+    fputc('}', out);
+  }
+  fputs("]}\n", out);
+  return ferror(out) ? -1 : 0;
+}
+
+/* One replaced paragraph with the changed words marked up. */
+static void html_word_diff(FILE *out, const char *sa, const BookDiffPara *pa, const char *sb,
+                           const BookDiffPara *pb)
+{
+  WordDiff wd;
+  if (word_diff(sa + pa->off, pa->len, sb + pb->off, pb->len, &wd) != 0)
+  {
+    fputs("<p><del>", out);
+    html_text(out, sa + pa->off, pa->len);
+    fputs("</del> <ins>", out);
+    html_text(out, sb + pb->off, pb->len);
+    fputs("</ins></p>\n", out);
+    word_diff_free(&wd);
+    return;
+  }
+  const char *ta = sa + pa->off, *tb = sb + pb->off;
+  fputs("<p>", out);
+  size_t x = 0, y = 0;
+  while (x < wd.a.n || y < wd.b.n)
+  {
+    if (x < wd.a.n && y < wd.b.n && !wd.del[x] && !wd.ins[y])
+    {
+      html_text(out, tb + wd.b.off[y], wd.b.len[y]);
+      fputc(' ', out);
+      x++;
+      y++;
+      continue;
+    }
+    size_t x0 = x, y0 = y;
+    while (x < wd.a.n && wd.del[x])
+      x++;
+    while (y < wd.b.n && wd.ins[y])
+      y++;
+    if (x == x0 && y == y0)
+      break;
+    if (x > x0)
+    {
+      fputs("<del>", out);
+      html_text(out, ta + wd.a.off[x0], wd.a.off[x - 1] + wd.a.len[x - 1] - wd.a.off[x0]);
+      fputs("</del> ", out);
+    }
+    if (y > y0)
+    {
+      fputs("<ins>", out);
+      html_text(out, tb + wd.b.off[y0], wd.b.off[y - 1] + wd.b.len[y - 1] - wd.b.off[y0]);
+      fputs("</ins> ", out);
+    }
+  }
+  fputs("</p>\n", out);
+  word_diff_free(&wd);
+}
+
+int bookdiff_write_html(const BookDiff *d, const char *title, const char *label_a,
+                        const char *label_b, FILE *out)
+{
+  if (!d || !out)
+    return -1;
+  const char *sa = (const char *)d->ma.data, *sb = (const char *)d->mb.data;
+  const char *la = label_a ? label_a : "A", *lb = label_b ? label_b : "B";
+  fputs("<!doctype html>\n<html lang=\"en\">\n<head>\n<meta charset=\"utf-8\">\n<title>", out);
+  html_text(out, title ? title : "", title ? strlen(title) : 0);
+  fputs(": changes</title>\n<style>\n"
+        "body{font:16px/1.5 system-ui,sans-serif;max-width:56rem;margin:2rem auto;padding:0 1rem}\n"
+        "table{border-collapse:collapse}td,th{padding:.2rem .8rem;text-align:right}"
+        "td:first-child,th:first-child{text-align:left}\n"
+        "del{background:#fdd;color:#900}ins{background:#dfd;color:#060;text-decoration:none}\n"
+        "p.rm{background:#fee}p.add{background:#efe}.at{color:#888;font-size:.85em}\n"
+        "section{border-top:1px solid #ddd;margin-top:1.5rem}\n"
+        "</style>\n</head>\n<body>\n<h1>",
+        out);
+  html_text(out, title ? title : "", title ? strlen(title) : 0);
+  fputs("</h1>\n<p>Changes from <b>", out);
+  html_text(out, la, strlen(la));
+  fputs("</b> to <b>", out);
+  html_text(out, lb, strlen(lb));
+  fprintf(out,
+          "</b>: %zu changed, %zu added, %zu removed, %zu unchanged chapters; "
+          "<ins>+%zu</ins> <del>-%zu</del> words.</p>\n",
+          d->changed, d->added, d->removed, d->same, d->words_ins, d->words_del);
+
+  fputs("<table>\n<tr><th>Chapter</th><th>Status</th><th>+words</th><th>-words</th></tr>\n", out);
+  for (size_t i = 0; i < d->n; ++i)
+  {
+    const BookDiffChapter *c = &d->ch[i];
+    if (c->status == BOOKDIFF_SAME)
+      continue;
+    fprintf(out, "<tr><td><a href=\"#c%zu\">", i);
+    html_text(out, c->name, strlen(c->name));
+    fprintf(out, "</a></td><td>%s</td><td>%zu</td><td>%zu</td></tr>\n", status_name(c->status),
+            c->words_ins, c->words_del);
+  }
+  fputs("</table>\n", out);
+
+  for (size_t i = 0; i < d->n; ++i)
+  {
+    const BookDiffChapter *c = &d->ch[i];
+    if (c->status == BOOKDIFF_SAME)
+      continue;
+    fprintf(out, "<section id=\"c%zu\">\n<h2>", i);
+    html_text(out, c->name, strlen(c->name));
+    fprintf(out, " <small>(%s)</small></h2>\n", status_name(c->status));
+    if (c->status != BOOKDIFF_CHANGED)
+    {
+      fprintf(out, "<p class=\"at\">%zu paragraphs, %zu words</p>\n",
+              c->status == BOOKDIFF_ADDED ? c->nb : c->na,
+              c->status == BOOKDIFF_ADDED ? c->words_ins : c->words_del);
+      fputs("</section>\n", out);
+      continue;
+    }
+    size_t x = 0, y = 0;
+    while (x < c->na || y < c->nb)
+    {
+      if (x < c->na && y < c->nb && !c->del[x] && !c->ins[y])
+      {
+        x++;
+        y++;
+        continue;
+      }
+      size_t x0 = x, y0 = y;
+      while (x < c->na && c->del[x])
+        x++;
+      while (y < c->nb && c->ins[y])
+        y++;
+      if (x == x0 && y == y0)
+        break;
+      fprintf(out, "<p class=\"at\">paragraph %zu</p>\n", y0 + 1);
+      size_t pairs = (x - x0) < (y - y0) ? (x - x0) : (y - y0);
+      for (size_t k = 0; k < pairs; ++k)
+        html_word_diff(out, sa, &c->a[x0 + k], sb, &c->b[y0 + k]);
+      for (size_t k = x0 + pairs; k < x; ++k)
+      {
+        fputs("<p class=\"rm\"><del>", out);
+        html_text(out, sa + c->a[k].off, c->a[k].len);
+        fputs("</del></p>\n", out);
+      }
+      for (size_t k = y0 + pairs; k < y; ++k)
+      {
+        fputs("<p class=\"add\"><ins>", out);
+        html_text(out, sb + c->b[k].off, c->b[k].len);
+        fputs("</ins></p>\n", out);
+      }
+    }
+    fputs("</section>\n", out);
+  }
+  fputs("</body>\n</html>\n", out);
+  return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,589 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/bookidx.c
+ * Purpose: Binary book index (config, chapters, outline, per-chapter stats)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "ueng/bookidx.h"
+#include "ueng/fs.h"
+#include "ueng/hash.h"
+#include "ueng/pool.h"
+#include "ueng/textnorm.h"
+#include "ueng/textstats.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HDR_BYTES 64
+#define CFG_BYTES 8
+#define CHAP_BYTES 64
+#define HEAD_BYTES 12
+
+/*------------------------------ byte buffers --------------------------------*/
+
+typedef struct
+{
+  unsigned char *p;
+  size_t n, cap;
+  int oom;
+} Buf;
+
+static int buf_reserve(Buf *b, size_t extra)
+{
+  if (b->n + extra <= b->cap)
+    return 0;
+  size_t nc = b->cap ? b->cap * 2 : 256;
+  while (nc < b->n + extra)
+    nc *= 2;
+  unsigned char *np = (unsigned char *)realloc(b->p, nc);
+  if (!np)
+  {
+    b->oom = 1;
+    return -1;
+  }
+  b->p = np;
+  b->cap = nc;
+  return 0;
+}
+
+static void buf_put(Buf *b, const void *p, size_t n)
+{
+  if (buf_reserve(b, n) != 0)
+    return;
+  memcpy(b->p + b->n, p, n);
+  b->n += n;
+}
+
+static void buf_le(Buf *b, uint64_t v, int bytes)
+{
+  unsigned char t[8];
+  for (int i = 0; i < bytes; ++i)
+    t[i] = (unsigned char)(v >> (8 * i));
+  buf_put(b, t, (size_t)bytes);
+}
+
+/* Append a string to the pool and return its offset. */
+static uint32_t pool_add(Buf *pool, const char *s, size_t n)
+{
+  uint32_t off = (uint32_t)pool->n;
+  buf_put(pool, s, n);
+  buf_put(pool, "", 1);
+  return off;
+}
+
+static uint64_t rd(const unsigned char *p, int bytes)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i)
+    v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+/*------------------------------ book.yaml -----------------------------------*/
+
+int bookidx_yaml_each(const char *yaml_path,
+                      void (*fn)(void *ud, const char *key, const char *value), void *ud)
+{
+  if (!yaml_path || !fn)
+    return -1;
+  size_t len = 0;
+  char *s = read_file_alloc(yaml_path, &len);
+  if (!s)
+    return 0;
+  char *line = s;
+  while (line < s + len)
+  {
+    char *eol = memchr(line, '\n', (size_t)(s + len - line));
+    char *next = eol ? eol + 1 : s + len;
+    if (!eol)
+      eol = s + len;
+    while (eol > line && (eol[-1] == '\r' || eol[-1] == '\n'))
+      eol--;
+    *eol = '\0';
+    /* Top-level "key: value" only: no indentation, comments or list items. */
+    char *p = line;
+    if (*p && *p != '#' && *p != '-' && *p != ' ' && *p != '\t')
+    {
+      while (*p && *p != ':' && *p != ' ' && *p != '\t')
+        p++;
+      char *kend = p;
+      while (*p == ' ' || *p == '\t')
+        p++;
+      if (*p == ':' && kend > line)
+      {
+        *kend = '\0';
+        p++;
+        while (*p == ' ' || *p == '\t')
+          p++;
+        fn(ud, line, p);
+      }
+    }
+    line = next;
+  }
+  free(s);
+  return 0;
+}
+
+static uint64_t yaml_hash(const char *yaml_path)
+{
+  size_t len = 0;
+  char *s = yaml_path ? read_file_alloc(yaml_path, &len) : NULL;
+  if (!s)
+    return 0;
+  uint64_t h = ueng_hash64(s, len, 0x79616d6cull);
+  free(s);
+  return h;
+}
+
+/*------------------------------ reader --------------------------------------*/
+
+static const char *ix_str(const BookIndex *ix, uint64_t off)
+{
+  size_t n = ix->map.len - ix->strings_off;
+  return off < n ? (const char *)ix->map.data + ix->strings_off + off : "";
+}
+
+int bookidx_open(const char *index_path, BookIndex *ix)
+{
+  if (!ix)
+    return -1;
+  memset(ix, 0, sizeof(*ix));
+  if (!index_path || ueng_map_file(index_path, &ix->map) != 0)
+    return -1;
+  const unsigned char *d = ix->map.data;
+  size_t len = ix->map.len;
+  if (len < HDR_BYTES || memcmp(d, BOOKIDX_MAGIC, 8) != 0 || rd(d + 8, 4) != BOOKIDX_VERSION ||
+      rd(d + 40, 4) != len)
+  {
+    bookidx_close(ix);
+    return -1;
+  }
+  ix->n_cfg = (uint32_t)rd(d + 12, 4);
+  ix->n_chapters = (uint32_t)rd(d + 16, 4);
+  ix->n_headings = (uint32_t)rd(d + 20, 4);
+  ix->cfg_off = (uint32_t)rd(d + 24, 4);
+  ix->chapters_off = (uint32_t)rd(d + 28, 4);
+  ix->headings_off = (uint32_t)rd(d + 32, 4);
+  ix->strings_off = (uint32_t)rd(d + 36, 4);
+  ix->yaml_hash = rd(d + 48, 8);
+  ix->built = (int64_t)rd(d + 56, 8);
+  /* Sections must be in order and match their declared sizes. */
+  if (ix->cfg_off != HDR_BYTES ||
+      ix->chapters_off != ix->cfg_off + (uint64_t)ix->n_cfg * CFG_BYTES ||
+      ix->headings_off != ix->chapters_off + (uint64_t)ix->n_chapters * CHAP_BYTES ||
+      ix->strings_off != ix->headings_off + (uint64_t)ix->n_headings * HEAD_BYTES ||
+      ix->strings_off >= len || d[len - 1] != '\0')
+  {
+    bookidx_close(ix);
+    return -1;
+  }
+  return 0;
+}
+
+void bookidx_close(BookIndex *ix)
+{
+  if (!ix)
+    return;
+  ueng_unmap_file(&ix->map);
+  memset(ix, 0, sizeof(*ix));
+}
+
+int bookidx_config_current(const BookIndex *ix, const char *yaml_path)
+{
+  return ix && ix->map.data && ix->yaml_hash == yaml_hash(yaml_path);
+}
+
+int bookidx_cfg_at(const BookIndex *ix, size_t i, const char **key, const char **value)
+{
+  if (!ix || i >= ix->n_cfg)
+    return -1;
+  const unsigned char *r = ix->map.data + ix->cfg_off + i * CFG_BYTES;
+  if (key)
+    *key = ix_str(ix, rd(r, 4));
+  if (value)
+    *value = ix_str(ix, rd(r + 4, 4));
+  return 0;
+}
+
+int bookidx_chapter(const BookIndex *ix, size_t i, BookIdxChapter *out)
+{
+  if (!ix || !out || i >= ix->n_chapters)
+    return -1;
+  const unsigned char *r = ix->map.data + ix->chapters_off + i * CHAP_BYTES;
+  out->name = ix_str(ix, rd(r, 4));
+  out->title = ix_str(ix, rd(r + 4, 4));
+  out->size = rd(r + 8, 8);
+  out->mtime = (int64_t)rd(r + 16, 8);
+  out->hash = rd(r + 24, 8);
+  out->words = (uint32_t)rd(r + 32, 4);
+  out->lines = (uint32_t)rd(r + 36, 4);
+  out->head_first = (uint32_t)rd(r + 40, 4);
+  out->head_count = (uint32_t)rd(r + 44, 4);
+  out->sentences = (uint32_t)rd(r + 48, 4);
+  out->paragraphs = (uint32_t)rd(r + 52, 4);
+  out->code_lines = (uint32_t)rd(r + 56, 4);
+  if (out->head_first > ix->n_headings || out->head_count > ix->n_headings - out->head_first)
+    out->head_first = out->head_count = 0;
+  return 0;
+}
+
+int bookidx_heading(const BookIndex *ix, size_t i, BookIdxHeading *out)
+{
+  if (!ix || !out || i >= ix->n_headings)
+    return -1;
+  const unsigned char *r = ix->map.data + ix->headings_off + i * HEAD_BYTES;
+  out->offset = (uint32_t)rd(r, 4);
+  out->level = (uint32_t)rd(r + 4, 4);
+  out->title = ix_str(ix, rd(r + 8, 4));
+  return 0;
+}
+
+int bookidx_chapter_names(const BookIndex *ix, StrList *out)
+{
+  if (!ix || !out)
+    return -1;
+  BookIdxChapter c;
+  for (size_t i = 0; i < ix->n_chapters; ++i)
+    if (bookidx_chapter(ix, i, &c) != 0 || sl_push(out, c.name) != 0)
+      return -1;
+  return 0;
+}
+
+/*------------------------------ chapter scan --------------------------------*/
+
+typedef struct
+{
+  uint32_t offset, level;
+  char *title;
+} ScanHeading;
+
+typedef struct
+{
+  char path[PATH_MAX];
+  const char *name;
+  long long size, mtime;
+  int old;  /* record in the previous index to reuse, -1 when the chapter must be read */
+  int prev; /* record with the same name (maybe stale), -1 when there is none */
+  uint64_t prev_hash;
+  int rc;
+  uint64_t hash;
+  TextStats ts;
+  ScanHeading *heads;
+  size_t nheads, cap;
+} ScanDoc;
+
+static void add_heading(void *ud, size_t off, int level, const char *t, size_t n)
+{
+  ScanDoc *d = (ScanDoc *)ud;
+  if (d->nheads == d->cap)
+  {
+    size_t nc = d->cap ? d->cap * 2 : 8;
+    ScanHeading *nh = (ScanHeading *)realloc(d->heads, nc * sizeof(*nh));
+    if (!nh)
+      return;
+    d->heads = nh;
+    d->cap = nc;
+  }
+  char *s = (char *)malloc(n + 1);
+  if (!s)
+    return;
+  memcpy(s, t, n);
+  s[n] = '\0';
+  d->heads[d->nheads].offset = (uint32_t)off;
+  d->heads[d->nheads].level = (uint32_t)level;
+  d->heads[d->nheads].title = s;
+  d->nheads++;
+}
+
+static void scan_worker(void *ud, size_t i)
+{
+  ScanDoc *d = ((ScanDoc **)ud)[i];
+  size_t len = 0;
+  char *raw = read_file_alloc(d->path, &len);
+  if (!raw)
+  {
+    d->rc = -1;
+    d->mtime = -1; /* never reuse this record */
+    return;
+  }
+  d->hash = ueng_hash64(raw, len, 0);
+  if (d->prev >= 0 && d->hash == d->prev_hash)
+  {
+    /* Touched or copied back, but the same bytes: the stats still hold. */
+    d->old = d->prev;
+    free(raw);
+    return;
+  }
+  char *txt = NULL;
+  int rc = textnorm_buffer(raw, len, &txt, &len, NULL);
+  free(raw);
+  if (rc != 0)
+  {
+    d->rc = -1;
+    return;
+  }
+  textstats_scan(txt, len, &d->ts, add_heading, d);
+  free(txt);
+}
+
+static void free_docs(ScanDoc *docs, size_t n)
+{
+  for (size_t i = 0; docs && i < n; ++i)
+  {
+    for (size_t h = 0; h < docs[i].nheads; ++h)
+      free(docs[i].heads[h].title);
+    free(docs[i].heads);
+  }
+  free(docs);
+}
+
+/*------------------------------ writer --------------------------------------*/
+
+typedef struct
+{
+  Buf *cfg, *pool;
+  uint32_t n;
+} CfgSink;
+
+static void cfg_collect(void *ud, const char *key, const char *value)
+{
+  CfgSink *s = (CfgSink *)ud;
+  buf_le(s->cfg, pool_add(s->pool, key, strlen(key)), 4);
+  buf_le(s->cfg, pool_add(s->pool, value, strlen(value)), 4);
+  s->n++;
+}
+
+static int write_index(const BookIdxOptions *o, const BookIndex *old, ScanDoc *docs, size_t n,
+                       uint64_t yhash, size_t *out_heads)
+{
+  Buf cfg = {0}, chap = {0}, head = {0}, pool = {0};
+  buf_put(&pool, "", 1); /* offset 0 is the empty string */
+  CfgSink sink = {&cfg, &pool, 0};
+  (void)bookidx_yaml_each(o->book_yaml, cfg_collect, &sink);
+
+  uint32_t nh = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    ScanDoc *d = &docs[i];
+    uint32_t first = nh, title = 0;
+    if (d->old >= 0)
+    {
+      BookIdxChapter c;
+      (void)bookidx_chapter(old, (size_t)d->old, &c);
+      d->hash = c.hash;
+      d->ts.words = c.words;
+      d->ts.lines = c.lines;
+      d->ts.sentences = c.sentences;
+      d->ts.paragraphs = c.paragraphs;
+      d->ts.code_lines = c.code_lines;
+      title = pool_add(&pool, c.title, strlen(c.title));
+      for (uint32_t h = 0; h < c.head_count; ++h)
+      {
+        BookIdxHeading hd;
+        (void)bookidx_heading(old, c.head_first + h, &hd);
+        buf_le(&head, hd.offset, 4);
+        buf_le(&head, hd.level, 4);
+        buf_le(&head, pool_add(&pool, hd.title, strlen(hd.title)), 4);
+        nh++;
+      }
+    }
+    else
+    {
+      for (size_t h = 0; h < d->nheads; ++h)
+      {
+        uint32_t t = pool_add(&pool, d->heads[h].title, strlen(d->heads[h].title));
+        if (h == 0)
+          title = t;
+        buf_le(&head, d->heads[h].offset, 4);
+        buf_le(&head, d->heads[h].level, 4);
+        buf_le(&head, t, 4);
+        nh++;
+      }
+    }
+    buf_le(&chap, pool_add(&pool, d->name, strlen(d->name)), 4);
+    buf_le(&chap, title, 4);
+    buf_le(&chap, (uint64_t)d->size, 8);
+    buf_le(&chap, (uint64_t)d->mtime, 8);
+    buf_le(&chap, d->hash, 8);
+    buf_le(&chap, d->ts.words, 4);
+    buf_le(&chap, d->ts.lines, 4);
+    buf_le(&chap, first, 4);
+    buf_le(&chap, nh - first, 4);
+    buf_le(&chap, d->ts.sentences, 4);
+    buf_le(&chap, d->ts.paragraphs, 4);
+    buf_le(&chap, d->ts.code_lines, 4);
+    buf_le(&chap, 0, 4); /* reserved */
+  }
+
+  int rc = -1;
+  uint64_t total = HDR_BYTES + cfg.n + chap.n + head.n + pool.n;
+  if (!cfg.oom && !chap.oom && !head.oom && !pool.oom && total < UINT32_MAX &&
+      mkpath_parent(o->index_path) == 0)
+  {
+    Buf hdr = {0};
+    buf_put(&hdr, BOOKIDX_MAGIC, 8);
+    buf_le(&hdr, BOOKIDX_VERSION, 4);
+    buf_le(&hdr, sink.n, 4);
+    buf_le(&hdr, n, 4);
+    buf_le(&hdr, nh, 4);
+    buf_le(&hdr, HDR_BYTES, 4);
+    buf_le(&hdr, HDR_BYTES + cfg.n, 4);
+    buf_le(&hdr, HDR_BYTES + cfg.n + chap.n, 4);
+    buf_le(&hdr, HDR_BYTES + cfg.n + chap.n + head.n, 4);
+    buf_le(&hdr, total, 4);
+    buf_le(&hdr, 0, 4); /* reserved */
+    buf_le(&hdr, yhash, 8);
+    buf_le(&hdr, (uint64_t)time(NULL), 8);
+
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", o->index_path);
+    FILE *f = ueng_fopen(tmp, "wb");
+    if (f && !hdr.oom)
+    {
+      const Buf *parts[] = {&hdr, &cfg, &chap, &head, &pool};
+      rc = 0;
+      for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i)
+        if (parts[i]->n && fwrite(parts[i]->p, 1, parts[i]->n, f) != parts[i]->n)
+          rc = -1;
+      if (fclose(f) != 0)
+        rc = -1;
+      if (rc == 0 && replace_file(tmp, o->index_path) != 0)
+        rc = -1;
+      if (rc != 0)
+        remove(tmp);
+    }
+    else if (f)
+    {
+      fclose(f);
+      remove(tmp);
+    }
+    free(hdr.p);
+  }
+  free(cfg.p);
+  free(chap.p);
+  free(head.p);
+  free(pool.p);
+  *out_heads = nh;
+  return rc;
+}
+
+/*------------------------------ update --------------------------------------*/
+
+int bookidx_update(const BookIdxOptions *o, BookIdxStats *st)
+{
+  if (!o || !o->index_path || !o->chapters_dir)
+    return -1;
+  double t0 = ueng_now_ms();
+  BookIdxStats local;
+  if (!st)
+    st = &local;
+  memset(st, 0, sizeof(*st));
+
+  BookIndex old;
+  int have_old = bookidx_open(o->index_path, &old) == 0;
+
+  StrList names;
+  sl_init(&names);
+  (void)list_md_dir(o->chapters_dir, &names);
+  size_t n = names.count;
+  ScanDoc *docs = n ? (ScanDoc *)calloc(n, sizeof(ScanDoc)) : NULL;
+  ScanDoc **todo = n ? (ScanDoc **)calloc(n, sizeof(ScanDoc *)) : NULL;
+  if (n && (!docs || !todo))
+  {
+    free(docs);
+    free(todo);
+    sl_free(&names);
+    bookidx_close(&old);
+    return -1;
+  }
+
+  /* Previous records by name (open addressing, slot = record index + 1). */
+  size_t cap = 16;
+  while (have_old && cap < 2 * (size_t)old.n_chapters)
+    cap <<= 1;
+  size_t mask = cap - 1;
+  uint32_t *slot = have_old ? (uint32_t *)calloc(cap, sizeof(uint32_t)) : NULL;
+  BookIdxChapter c;
+  for (uint32_t r = 0; slot && r < old.n_chapters; ++r)
+  {
+    (void)bookidx_chapter(&old, r, &c);
+    size_t h = ueng_hash64(c.name, strlen(c.name), 0) & mask;
+    while (slot[h])
+      h = (h + 1) & mask;
+    slot[h] = r + 1;
+  }
+
+  size_t nt = 0;
+  int same = have_old && old.n_chapters == n;
+  for (size_t i = 0; i < n; ++i)
+  {
+    ScanDoc *d = &docs[i];
+    d->name = names.items[i];
+    d->old = d->prev = -1;
+    snprintf(d->path, sizeof(d->path), "%s%c%s", o->chapters_dir, PATH_SEP, d->name);
+    struct stat sb;
+    if (stat(d->path, &sb) == 0)
+    {
+      d->size = (long long)sb.st_size;
+      d->mtime = (long long)sb.st_mtime;
+    }
+    size_t h = slot ? ueng_hash64(d->name, strlen(d->name), 0) & mask : 0;
+    while (slot && slot[h])
+    {
+      (void)bookidx_chapter(&old, slot[h] - 1, &c);
+      if (strcmp(c.name, d->name) == 0)
+      {
+        d->prev = (int)(slot[h] - 1);
+        d->prev_hash = c.hash;
+        /* Trust size+mtime only for files older than the index itself. */
+        if ((long long)c.size == d->size && c.mtime == d->mtime && d->mtime < old.built)
+          d->old = (int)(slot[h] - 1);
+        break;
+      }
+      h = (h + 1) & mask;
+    }
+    if (d->old < 0)
+      todo[nt++] = d;
+    else if ((size_t)d->old != i)
+      same = 0;
+  }
+  free(slot);
+
+  if (nt)
+  {
+    ueng_parallel_for(nt, o->jobs > 0 ? o->jobs : ueng_jobs(), scan_worker, todo);
+    for (size_t i = 0; i < nt; ++i)
+      if (todo[i]->rc != 0)
+        fprintf(stderr, "[index] WARN: could not read %s\n", todo[i]->path);
+  }
+  st->chapters = n;
+  st->scanned = nt;
+  st->reused = n - nt;
+
+  uint64_t yhash = yaml_hash(o->book_yaml);
+  int rc = 0;
+  if (same && nt == 0 && yhash == old.yaml_hash)
+  {
+    st->headings = old.n_headings;
+  }
+  else
+  {
+    rc = write_index(o, have_old ? &old : NULL, docs, n, yhash, &st->headings);
+    st->written = rc == 0;
+  }
+
+  free_docs(docs, n);
+  free(todo);
+  sl_free(&names);
+  bookidx_close(&old);
+  st->ms = ueng_now_ms() - t0;
+  return rc;
+}
@@ -13,6 +13,9 @@
 #endif
 #endif
 #include "ueng/common.h"
+#include "ueng/hash.h" /* ueng_hash64 for interning */
+#include "ueng/pool.h" /* ueng_parallel_for runs on the shared pool */
+#include "ueng/trace.h"
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -22,6 +25,9 @@
 #pragma comment(lib, "Shlwapi.lib")
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -39,46 +45,249 @@
 #define PATH_MAX 4096
 #endif
 
-/*---------------------------- string list -----------------------------------*/
-/* NOTE: StrList helpers are declared in the header; keep simple utilities here */
-static char *s_dup(const char *s)
+/*------------------------------ arena ---------------------------------------*/
+
+struct UengArenaChunk
 {
-  if (!s)
+  UengArenaChunk *next;
+  size_t size, used; /* payload bytes after the header */
+};
+#define ARENA_HDR ((sizeof(UengArenaChunk) + 15) & ~(size_t)15)
+#define ARENA_MIN ((size_t)4 << 10)
+#define ARENA_MAX ((size_t)1 << 20)
+
+static int g_stats_on;
+static ueng_mutex_t g_stats_mu;
+static struct
+{
+  size_t arenas, chunks, chunk_bytes, allocs, used;
+  size_t tables, interned, intern_calls;
+} g_stats;
+
+static void *arena_carve(UengArena *a, size_t n, size_t align)
+{
+  UengArenaChunk *c = a->head;
+  if (c)
+  {
+    size_t off = (c->used + align - 1) & ~(align - 1);
+    if (off <= c->size && n <= c->size - off)
+    {
+      c->used = off + n;
+      a->allocs++;
+      a->used += n;
+      return (char *)c + ARENA_HDR + off;
+    }
+  }
+  size_t sz = c ? c->size * 2 : ARENA_MIN;
+  if (sz > ARENA_MAX)
+    sz = ARENA_MAX;
+  int solo = n > sz / 4; /* big block: own chunk, keep filling the current one */
+  if (solo)
+    sz = n;
+  UengArenaChunk *nc = (UengArenaChunk *)malloc(ARENA_HDR + sz);
+  if (!nc)
+    return NULL;
+  nc->size = sz;
+  nc->used = n;
+  if (solo && c)
+  {
+    nc->next = c->next;
+    c->next = nc;
+  }
+  else
+  {
+    nc->next = c;
+    a->head = nc;
+  }
+  a->allocs++;
+  a->used += n;
+  return (char *)nc + ARENA_HDR;
+}
+
+void *ueng_arena_alloc(UengArena *a, size_t n)
+{
+  return a ? arena_carve(a, n ? n : 1, sizeof(void *)) : NULL;
+}
+
+char *ueng_arena_strndup(UengArena *a, const char *s, size_t n)
+{
+  if (!a || !s)
+    return NULL;
+  char *d = (char *)arena_carve(a, n + 1, 1);
+  if (!d)
+    return NULL;
+  memcpy(d, s, n);
+  d[n] = '\0';
+  return d;
+}
+
+char *ueng_arena_strdup(UengArena *a, const char *s)
+{
+  return s ? ueng_arena_strndup(a, s, strlen(s)) : NULL;
+}
+
+void ueng_arena_free(UengArena *a)
+{
+  if (!a)
+    return;
+  size_t chunks = 0, bytes = 0;
+  for (UengArenaChunk *c = a->head, *next; c; c = next)
+  {
+    next = c->next;
+    chunks++;
+    bytes += ARENA_HDR + c->size;
+    free(c);
+  }
+  if (g_stats_on && chunks)
+  {
+    ueng_mutex_lock(&g_stats_mu);
+    g_stats.arenas++;
+    g_stats.chunks += chunks;
+    g_stats.chunk_bytes += bytes;
+    g_stats.allocs += a->allocs;
+    g_stats.used += a->used;
+    ueng_mutex_unlock(&g_stats_mu);
+  }
+  memset(a, 0, sizeof(*a));
+}
+
+/*------------------------------ interning -----------------------------------*/
+
+static uint64_t str_hash(const char *s, size_t n) { return ueng_hash64(s, n, 0x5157u); }
+
+static int strtab_grow(UengStrTab *t)
+{
+  size_t ncap = t->cap ? t->cap * 2 : 64;
+  const char **ns = (const char **)calloc(ncap, sizeof(const char *));
+  if (!ns)
+    return -1;
+  for (size_t i = 0; i < t->cap; ++i)
+  {
+    const char *p = t->slots[i];
+    if (!p)
+      continue;
+    size_t j = (size_t)str_hash(p, strlen(p)) & (ncap - 1);
+    while (ns[j])
+      j = (j + 1) & (ncap - 1);
+    ns[j] = p;
+  }
+  free(t->slots);
+  t->slots = ns;
+  t->cap = ncap;
+  return 0;
+}
+
+const char *ueng_strtab_find(const UengStrTab *t, const char *s, size_t n)
+{
+  if (!t || !s || !t->cap)
     return NULL;
-  size_t n = strlen(s);
-  char *d = (char *)malloc(n + 1);
+  size_t j = (size_t)str_hash(s, n) & (t->cap - 1);
+  for (const char *p; (p = t->slots[j]) != NULL; j = (j + 1) & (t->cap - 1))
+    if (memcmp(p, s, n) == 0 && p[n] == '\0')
+      return p;
+  return NULL;
+}
+
+const char *ueng_strtab_intern(UengStrTab *t, const char *s, size_t n)
+{
+  if (!t || !s)
+    return NULL;
+  t->calls++;
+  if ((t->count + 1) * 4 > t->cap * 3 && strtab_grow(t) != 0)
+    return NULL;
+  size_t j = (size_t)str_hash(s, n) & (t->cap - 1);
+  for (const char *p; (p = t->slots[j]) != NULL; j = (j + 1) & (t->cap - 1))
+    if (memcmp(p, s, n) == 0 && p[n] == '\0')
+      return p;
+  char *d = ueng_arena_strndup(&t->mem, s, n);
   if (!d)
     return NULL;
-  memcpy(d, s, n + 1);
+  t->slots[j] = d;
+  t->count++;
   return d;
 }
+
+void ueng_strtab_free(UengStrTab *t)
+{
+  if (!t)
+    return;
+  if (g_stats_on && t->calls)
+  {
+    ueng_mutex_lock(&g_stats_mu);
+    g_stats.tables++;
+    g_stats.interned += t->count;
+    g_stats.intern_calls += t->calls;
+    ueng_mutex_unlock(&g_stats_mu);
+  }
+  ueng_arena_free(&t->mem);
+  free(t->slots);
+  memset(t, 0, sizeof(*t));
+}
+
+void ueng_alloc_stats_enable(void)
+{
+  if (g_stats_on)
+    return;
+  ueng_mutex_init(&g_stats_mu);
+  g_stats_on = 1;
+}
+
+void ueng_alloc_stats_dump(FILE *out)
+{
+  if (!g_stats_on || !out)
+    return;
+  ueng_mutex_lock(&g_stats_mu);
+  fprintf(out,
+          "[alloc] arenas: %zu freed, %zu chunks (%.1f KiB), %zu allocations (%.1f KiB used), "
+          "%.0f allocations per malloc\n",
+          g_stats.arenas, g_stats.chunks, (double)g_stats.chunk_bytes / 1024.0, g_stats.allocs,
+          (double)g_stats.used / 1024.0,
+          g_stats.chunks ? (double)g_stats.allocs / (double)g_stats.chunks : 0.0);
+  fprintf(out, "[alloc] strtab: %zu tables, %zu strings interned, %zu lookups deduplicated\n",
+          g_stats.tables, g_stats.interned, g_stats.intern_calls - g_stats.interned);
+  ueng_mutex_unlock(&g_stats_mu);
+}
+
+/*---------------------------- string list -----------------------------------*/
+/* NOTE: StrList helpers are declared in the header; keep simple utilities here */
 void sl_init(StrList *s) { memset(s, 0, sizeof(*s)); }
 void sl_free(StrList *s)
 {
   if (!s)
     return;
-  for (size_t i = 0; i < s->count; ++i)
-    free(s->items[i]);
   free(s->items);
+  ueng_arena_free(&s->mem);
   memset(s, 0, sizeof(*s));
 }
-int sl_push(StrList *s, const char *str)
+int sl_push_n(StrList *s, const char *str, size_t n)
 {
   if (!s || !str)
     return -1;
-  char *d = s_dup(str);
-  if (!d)
-    return -1;
-  char **ni = (char **)realloc(s->items, (s->count + 1) * sizeof(char *));
-  if (!ni)
+  if (s->count == s->cap)
   {
-    free(d);
-    return -1;
+    size_t nc = s->cap ? s->cap * 2 : 16;
+    char **ni = (char **)realloc(s->items, nc * sizeof(char *));
+    if (!ni)
+      return -1;
+    s->items = ni;
+    s->cap = nc;
   }
-  s->items = ni;
+  char *d = ueng_arena_strndup(&s->mem, str, n);
+  if (!d)
+    return -1;
   s->items[s->count++] = d;
   return 0;
 }
+int sl_push(StrList *s, const char *str) { return str ? sl_push_n(s, str, strlen(str)) : -1; }
+int sl_contains(const StrList *s, const char *str)
+{
+  if (!s || !str)
+    return 0;
+  for (size_t i = 0; i < s->count; ++i)
+    if (s->items[i] && strcmp(s->items[i], str) == 0)
+      return 1;
+  return 0;
+}
 
 /*------------------------------ small strings -------------------------------*/
 int str_eq_ci(const char *a, const char *b)
@@ -323,6 +532,122 @@ int read_text_file(const char *path, char *out, size_t outsz)
   return 0;
 }
 
+char *read_file_alloc(const char *path, size_t *out_len)
+{
+  if (out_len)
+    *out_len = 0;
+  FILE *f = ueng_fopen(path, "rb");
+  if (!f)
+    return NULL;
+  size_t cap = 64 * 1024, n = 0;
+  char *buf = (char *)malloc(cap + 1);
+  if (!buf)
+  {
+    fclose(f);
+    return NULL;
+  }
+  for (;;)
+  {
+    if (n == cap)
+    {
+      char *nb = (char *)realloc(buf, cap * 2 + 1);
+      if (!nb)
+      {
+        free(buf);
+        fclose(f);
+        return NULL;
+      }
+      buf = nb;
+      cap *= 2;
+    }
+    size_t got = fread(buf + n, 1, cap - n, f);
+    if (got == 0)
+      break;
+    n += got;
+  }
+  fclose(f);
+  buf[n] = '\0';
+  if (out_len)
+    *out_len = n;
+  return buf;
+}
+
+int ueng_map_file(const char *path, UengMap *m)
+{
+  if (!path || !m)
+    return -1;
+  memset(m, 0, sizeof(*m));
+#ifdef _WIN32
+  wchar_t wpath[PATH_MAX];
+  MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, PATH_MAX);
+  HANDLE f = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (f == INVALID_HANDLE_VALUE)
+    return -1;
+  LARGE_INTEGER sz;
+  if (!GetFileSizeEx(f, &sz))
+  {
+    CloseHandle(f);
+    return -1;
+  }
+  if (sz.QuadPart > 0)
+  {
+    HANDLE mh = CreateFileMappingW(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mh)
+    {
+      m->data = (const unsigned char *)MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mh); /* the view keeps the mapping alive */
+    }
+    if (!m->data)
+    {
+      CloseHandle(f);
+      return -1;
+    }
+    m->len = (size_t)sz.QuadPart;
+  }
+  CloseHandle(f);
+  return 0;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+  {
+    close(fd);
+    return -1;
+  }
+  if (st.st_size > 0)
+  {
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+    {
+      close(fd);
+      return -1;
+    }
+    m->data = (const unsigned char *)p;
+    m->len = (size_t)st.st_size;
+  }
+  close(fd); /* the mapping stays valid after close */
+  return 0;
+#endif
+}
+
+void ueng_unmap_file(UengMap *m)
+{
+  if (!m)
+    return;
+  if (m->data)
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(m->data);
+#else
+    munmap((void *)m->data, m->len);
+#endif
+  }
+  memset(m, 0, sizeof(*m));
+}
+
 /* Copy file binary (makes parent dir) */
 int copy_file_binary(const char *src, const char *dst)
 {
@@ -358,6 +683,20 @@ int copy_file_binary(const char *src, const char *dst)
   return 0;
 }
 
+int replace_file(const char *from, const char *to)
+{
+  if (!from || !to)
+    return -1;
+#ifdef _WIN32
+  wchar_t wfrom[PATH_MAX], wto[PATH_MAX];
+  MultiByteToWideChar(CP_UTF8, 0, from, -1, wfrom, PATH_MAX);
+  MultiByteToWideChar(CP_UTF8, 0, to, -1, wto, PATH_MAX);
+  return MoveFileExW(wfrom, wto, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+  return rename(from, to) == 0 ? 0 : -1;
+#endif
+}
+
 /* Ensure dir and write empty .gitkeep */
 int write_gitkeep(const char *dir)
 {
@@ -370,6 +709,82 @@ int write_gitkeep(const char *dir)
   return write_text_file_if_absent(p, "");
 }
 
+/* Recursive worker for list_tree_files. One path buffer serves the whole
+   walk: each level appends an entry name and truncates back, and files are
+   pushed as the root-relative tail of it. */
+static void tree_walk(char *path, size_t len, size_t root_len, StrList *out)
+{
+#ifdef _WIN32
+  if (len + 3 >= PATH_MAX)
+    return;
+  memcpy(path + len, "\\*", 3);
+  WIN32_FIND_DATAA f;
+  HANDLE h = FindFirstFileA(path, &f);
+  path[len] = '\0';
+  if (h == INVALID_HANDLE_VALUE)
+    return;
+  do
+  {
+    const char *n = f.cFileName;
+    if (strcmp(n, ".") == 0 || strcmp(n, "..") == 0 ||
+        (f.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+      continue;
+    size_t ln = strlen(n);
+    if (len + 1 + ln >= PATH_MAX)
+      continue;
+    path[len] = '\\';
+    memcpy(path + len + 1, n, ln + 1);
+    if (f.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      tree_walk(path, len + 1 + ln, root_len, out);
+    else
+      sl_push_n(out, path + root_len + 1, len + ln - root_len);
+    path[len] = '\0';
+  } while (FindNextFileA(h, &f));
+  FindClose(h);
+#else
+  DIR *d = opendir(path);
+  if (!d)
+    return;
+  struct dirent *e;
+  while ((e = readdir(d)))
+  {
+    const char *n = e->d_name;
+    if (strcmp(n, ".") == 0 || strcmp(n, "..") == 0)
+      continue;
+    size_t ln = strlen(n);
+    if (len + 1 + ln >= PATH_MAX)
+      continue;
+    path[len] = '/';
+    memcpy(path + len + 1, n, ln + 1);
+    struct stat st;
+    if (lstat(path, &st) == 0)
+    {
+      if (S_ISDIR(st.st_mode))
+        tree_walk(path, len + 1 + ln, root_len, out);
+      else if (S_ISREG(st.st_mode))
+        sl_push_n(out, path + root_len + 1, len + ln - root_len);
+    }
+    path[len] = '\0';
+  }
+  closedir(d);
+#endif
+}
+
+int list_tree_files(const char *root, StrList *out)
+{
+  if (!root || !out)
+    return -1;
+  if (!dir_exists(root))
+    return 0;
+  char path[PATH_MAX];
+  size_t len = strlen(root);
+  if (len >= PATH_MAX)
+    return -1;
+  memcpy(path, root, len + 1);
+  tree_walk(path, len, len, out);
+  return 0;
+}
+
 /* Clean directory contents, keep the directory itself */
 int clean_dir(const char *dir)
 {
@@ -436,7 +851,7 @@ int clean_dir(const char *dir)
 }
 
 /*------------------------------ Exec/helpers --------------------------------*/
-int exec_cmd(const char *cmdline)
+static int exec_child(const char *cmdline)
 {
 #ifdef _WIN32
   STARTUPINFOA si;
@@ -467,6 +882,69 @@ int exec_cmd(const char *cmdline)
 #endif
 }
 
+int exec_cmd(const char *cmdline)
+{
+  double t0 = ueng_trace_begin();
+  int rc = exec_child(cmdline);
+  ueng_trace_end_arg("exec", "exec_cmd", t0, cmdline);
+  return rc;
+}
+
+/* Probe results are cached per process and can be handed down by a parent as
+   UENG_HAVE_<NAME>=0|1, so a multi-book run looks tools up only once. */
+static struct
+{
+  char name[32];
+  int found;
+} g_tools[8];
+static size_t g_ntools;
+
+int tool_on_path(const char *name)
+{
+  if (!name || !*name || strlen(name) >= sizeof(g_tools[0].name))
+    return 0;
+  for (size_t i = 0; i < g_ntools; ++i)
+    if (strcmp(g_tools[i].name, name) == 0)
+      return g_tools[i].found;
+
+  char env[48] = "UENG_HAVE_";
+  size_t k = strlen(env);
+  for (const char *p = name; *p && k + 1 < sizeof(env); ++p)
+    env[k++] = isalnum((unsigned char)*p) ? (char)toupper((unsigned char)*p) : '_';
+  env[k] = '\0';
+  int found = 0;
+  const char *e = getenv(env);
+  if (e && (*e == '0' || *e == '1'))
+    found = *e == '1';
+  else
+  {
+#ifdef _WIN32
+    char exe[MAX_PATH];
+    found = SearchPathA(NULL, name, ".exe", MAX_PATH, exe, NULL) > 0;
+#else
+    const char *path = getenv("PATH");
+    while (path && *path && !found)
+    {
+      const char *end = strchr(path, ':');
+      size_t len = end ? (size_t)(end - path) : strlen(path);
+      char cand[PATH_MAX];
+      if (len == 0)
+        snprintf(cand, sizeof(cand), "./%s", name);
+      else
+        snprintf(cand, sizeof(cand), "%.*s/%s", (int)len, path, name);
+      found = access(cand, X_OK) == 0;
+      path = end ? end + 1 : NULL;
+    }
+#endif
+  }
+  if (g_ntools < sizeof(g_tools) / sizeof(g_tools[0]))
+  {
+    snprintf(g_tools[g_ntools].name, sizeof(g_tools[0].name), "%s", name);
+    g_tools[g_ntools++].found = found;
+  }
+  return found;
+}
+
 int path_abs(const char *in, char *out, size_t outsz)
 {
 #ifdef _WIN32
@@ -501,8 +979,10 @@ void path_to_file_url(const char *abs, char *out, size_t outsz)
 
 int browse_file_or_url(const char *what)
 {
+  double t0 = ueng_trace_begin();
 #ifdef _WIN32
-  return (int)(intptr_t)ShellExecuteA(NULL, "open", what, NULL, NULL, SW_SHOWNORMAL) > 32 ? 0 : -1;
+  HINSTANCE h = ShellExecuteA(NULL, "open", what, NULL, NULL, SW_SHOWNORMAL);
+  int rc = (int)(intptr_t)h > 32 ? 0 : -1;
 #else
   char cmd[PATH_MAX + 64];
 #ifdef __APPLE__
@@ -510,8 +990,10 @@ int browse_file_or_url(const char *what)
 #else
   snprintf(cmd, sizeof(cmd), "xdg-open '%s' >/dev/null 2>&1", what);
 #endif
-  return exec_cmd(cmd);
+  int rc = exec_cmd(cmd);
 #endif
+  ueng_trace_end_arg("open", "browser", t0, what);
+  return rc;
 }
 
 /* --- Added for main.c link errors --- */
@@ -564,4 +1046,201 @@ void ueng_console_utf8(void)
 }
 #endif
 
+/*------------------------------ Threads -------------------------------------*/
+#ifdef _WIN32
+typedef struct
+{
+  void (*fn)(void *);
+  void *arg;
+} ThreadTramp;
+
+static DWORD WINAPI thread_tramp(LPVOID p)
+{
+  ThreadTramp t = *(ThreadTramp *)p;
+  free(p);
+  t.fn(t.arg);
+  return 0;
+}
+
+int ueng_thread_start(ueng_thread_t *t, void (*fn)(void *), void *arg)
+{
+  ThreadTramp *tt = (ThreadTramp *)malloc(sizeof(*tt));
+  if (!tt)
+    return -1;
+  tt->fn = fn;
+  tt->arg = arg;
+  *t = CreateThread(NULL, 0, thread_tramp, tt, 0, NULL);
+  if (!*t)
+  {
+    free(tt);
+    return -1;
+  }
+  return 0;
+}
+void ueng_thread_join(ueng_thread_t t)
+{
+  WaitForSingleObject(t, INFINITE);
+  CloseHandle(t);
+}
+void ueng_mutex_init(ueng_mutex_t *m) { InitializeCriticalSection(m); }
+void ueng_mutex_lock(ueng_mutex_t *m) { EnterCriticalSection(m); }
+void ueng_mutex_unlock(ueng_mutex_t *m) { LeaveCriticalSection(m); }
+void ueng_mutex_destroy(ueng_mutex_t *m) { DeleteCriticalSection(m); }
+void ueng_cond_init(ueng_cond_t *c) { InitializeConditionVariable(c); }
+void ueng_cond_wait(ueng_cond_t *c, ueng_mutex_t *m) { SleepConditionVariableCS(c, m, INFINITE); }
+void ueng_cond_timedwait(ueng_cond_t *c, ueng_mutex_t *m, double ms)
+{
+  SleepConditionVariableCS(c, m, ms > 0 ? (DWORD)(ms + 0.5) : 0);
+}
+void ueng_cond_broadcast(ueng_cond_t *c) { WakeAllConditionVariable(c); }
+void ueng_cond_destroy(ueng_cond_t *c) { (void)c; }
+int ueng_cpu_count(void)
+{
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+double ueng_now_ms(void)
+{
+  LARGE_INTEGER f, c;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&c);
+  return (double)c.QuadPart * 1000.0 / (double)f.QuadPart;
+}
+#else
+typedef struct
+{
+  void (*fn)(void *);
+  void *arg;
+} ThreadTramp;
+
+static void *thread_tramp(void *p)
+{
+  ThreadTramp t = *(ThreadTramp *)p;
+  free(p);
+  t.fn(t.arg);
+  return NULL;
+}
+
+int ueng_thread_start(ueng_thread_t *t, void (*fn)(void *), void *arg)
+{
+  ThreadTramp *tt = (ThreadTramp *)malloc(sizeof(*tt));
+  if (!tt)
+    return -1;
+  tt->fn = fn;
+  tt->arg = arg;
+  if (pthread_create(t, NULL, thread_tramp, tt) != 0)
+  {
+    free(tt);
+    return -1;
+  }
+  return 0;
+}
+void ueng_thread_join(ueng_thread_t t) { pthread_join(t, NULL); }
+void ueng_mutex_init(ueng_mutex_t *m) { pthread_mutex_init(m, NULL); }
+void ueng_mutex_lock(ueng_mutex_t *m) { pthread_mutex_lock(m); }
+void ueng_mutex_unlock(ueng_mutex_t *m) { pthread_mutex_unlock(m); }
+void ueng_mutex_destroy(ueng_mutex_t *m) { pthread_mutex_destroy(m); }
+void ueng_cond_init(ueng_cond_t *c) { pthread_cond_init(c, NULL); }
+void ueng_cond_wait(ueng_cond_t *c, ueng_mutex_t *m) { pthread_cond_wait(c, m); }
+void ueng_cond_timedwait(ueng_cond_t *c, ueng_mutex_t *m, double ms)
+{
+  struct timespec ts; /* pthread_cond_timedwait takes a CLOCK_REALTIME deadline */
+  clock_gettime(CLOCK_REALTIME, &ts);
+  long long ns = (long long)ts.tv_nsec + (long long)((ms > 0 ? ms : 0) * 1e6);
+  ts.tv_sec += (time_t)(ns / 1000000000LL);
+  ts.tv_nsec = (long)(ns % 1000000000LL);
+  pthread_cond_timedwait(c, m, &ts);
+}
+void ueng_cond_broadcast(ueng_cond_t *c) { pthread_cond_broadcast(c); }
+void ueng_cond_destroy(ueng_cond_t *c) { pthread_cond_destroy(c); }
+int ueng_cpu_count(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+double ueng_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+#endif
+
+/* Shared state for ueng_parallel_for: workers pull the next index under a lock.
+   Items are coarse (a file, a chapter), so lock traffic is negligible. */
+typedef struct
+{
+  ueng_mutex_t mu;
+  size_t next, n;
+  void (*fn)(void *ud, size_t i);
+  void *ud;
+} ParFor;
+
+static void parfor_worker(void *p)
+{
+  ParFor *pf = (ParFor *)p;
+  double t0 = ueng_trace_begin();
+  for (;;)
+  {
+    ueng_mutex_lock(&pf->mu);
+    size_t i = pf->next++;
+    ueng_mutex_unlock(&pf->mu);
+    if (i >= pf->n)
+      break;
+    pf->fn(pf->ud, i);
+  }
+  ueng_trace_end("pool", "parallel_for", t0);
+}
+
+void ueng_parallel_for(size_t n, int jobs, void (*fn)(void *ud, size_t i), void *ud)
+{
+  if (!fn || n == 0)
+    return;
+  if (jobs <= 0)
+    jobs = ueng_jobs();
+  if ((size_t)jobs > n)
+    jobs = (int)n;
+  if (jobs <= 1)
+  {
+    for (size_t i = 0; i < n; ++i)
+      fn(ud, i);
+    return;
+  }
+  ParFor pf;
+  ueng_mutex_init(&pf.mu);
+  pf.next = 0;
+  pf.n = n;
+  pf.fn = fn;
+  pf.ud = ud;
+  UengPool *pool = ueng_pool_global();
+  if (pool && jobs - 1 <= ueng_pool_workers(pool))
+  {
+    /* jobs - 1 pool tasks plus this thread pull indices; nested calls from
+       inside a task share the same workers instead of adding threads. */
+    UengTaskGroup g;
+    ueng_group_init(&g, pool);
+    for (int k = 1; k < jobs; ++k)
+      (void)ueng_group_spawn(&g, parfor_worker, &pf);
+    parfor_worker(&pf);
+    ueng_group_wait(&g);
+  }
+  else
+  {
+    /* More jobs than pool threads: callers that block (child processes,
+       network) asked for that concurrency, so give them their own threads. */
+    ueng_thread_t th[64];
+    int started = 0;
+    for (int k = 1; k < jobs && started < 64; ++k)
+    {
+      if (ueng_thread_start(&th[started], parfor_worker, &pf) == 0)
+        started++;
+    }
+    parfor_worker(&pf);
+    for (int k = 0; k < started; ++k)
+      ueng_thread_join(th[k]);
+  }
+  ueng_mutex_destroy(&pf.mu);
+}
+
 /*------------------------------ End of file --------------------------------*/
\ No newline at end of file
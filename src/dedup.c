@@ -0,0 +1,510 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/dedup.c
+ * Purpose: Near-duplicate chapter detection (MinHash + LSH)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "ueng/dedup.h"
+#include "ueng/fs.h"
+#include "ueng/hash.h"
+#include "ueng/pool.h"
+#include "ueng/textnorm.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROWS (DEDUP_K / DEDUP_BANDS)
+#define CACHE_MAGIC "UENGMH01"
+
+typedef struct
+{
+  char path[PATH_MAX];
+  const char *name;
+  long long size, mtime;
+  uint64_t sig[DEDUP_K];
+  int empty; /* fewer tokens than one shingle: never clustered */
+  int have;  /* signature valid (from cache or computed) */
+  int rc;
+} DedupDoc;
+
+/*------------------------------ MinHash -------------------------------------*/
+/* One-permutation MinHash (Li, Owen & Zhang 2012) with optimal densification
+   (Shrivastava 2017): each shingle hash is dropped into one of DEDUP_K bins
+   by its top bits and each bin keeps its minimum, so a shingle costs one
+   hash instead of DEDUP_K. Empty bins borrow from a pseudo-randomly chosen
+   filled bin; the choice depends only on the bin number, so it is the same
+   for every document and equal bins still estimate Jaccard similarity. */
+
+#define BIN_BITS 6 /* log2(DEDUP_K) */
+
+static uint64_t mix64(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+static inline int tok_byte(unsigned char c) { return isalnum(c) || c >= 0x80; }
+
+static void densify(uint64_t *sig)
+{
+  for (uint64_t j = 0; j < DEDUP_K; ++j)
+  {
+    if (sig[j] != UINT64_MAX)
+      continue;
+    for (uint64_t t = 1;; ++t)
+    {
+      uint64_t k = mix64(j * 0x9E3779B97F4A7C15ull + t) >> (64 - BIN_BITS);
+      if (!(sig[k] >> 63)) /* filled by a shingle (empty and borrowed bins have bit 63) */
+      {
+        sig[j] = sig[k] | (1ull << 63);
+        break;
+      }
+      if (t > 64 * DEDUP_K)
+        break; /* cannot happen with at least one filled bin; stay safe */
+    }
+  }
+}
+
+/* MinHash of the 5-word shingles of 'text'. Returns the number of tokens. */
+static size_t minhash_text(const char *text, size_t n, uint64_t *sig)
+{
+  for (int k = 0; k < DEDUP_K; ++k)
+    sig[k] = UINT64_MAX;
+  uint64_t win[DEDUP_SHINGLE];
+  size_t ntok = 0;
+  char tok[64];
+  size_t i = 0;
+  while (i < n)
+  {
+    while (i < n && !tok_byte((unsigned char)text[i]))
+      i++;
+    size_t tl = 0;
+    while (i < n && tok_byte((unsigned char)text[i]))
+    {
+      if (tl < sizeof(tok))
+        tok[tl++] = (char)tolower((unsigned char)text[i]);
+      i++;
+    }
+    if (!tl)
+      break;
+    win[ntok % DEDUP_SHINGLE] = ueng_hash64(tok, tl, 0);
+    ntok++;
+    if (ntok >= DEDUP_SHINGLE)
+    {
+      /* Order-sensitive combination of the last DEDUP_SHINGLE tokens. */
+      uint64_t h = 0;
+      for (size_t j = ntok - DEDUP_SHINGLE; j < ntok; ++j)
+        h = mix64(h ^ win[j % DEDUP_SHINGLE]);
+      uint64_t bin = h >> (64 - BIN_BITS);
+      uint64_t v = h & ((1ull << (64 - BIN_BITS)) - 1);
+      if (v < sig[bin])
+        sig[bin] = v;
+    }
+  }
+  if (ntok >= DEDUP_SHINGLE)
+    densify(sig);
+  return ntok;
+}
+
+static void fingerprint_worker(void *ud, size_t i)
+{
+  DedupDoc *d = ((DedupDoc **)ud)[i];
+  size_t len = 0;
+  char *raw = read_file_alloc(d->path, &len);
+  if (!raw)
+  {
+    d->rc = -1;
+    return;
+  }
+  char *txt = NULL;
+  int rc = textnorm_buffer(raw, len, &txt, &len, NULL);
+  free(raw);
+  if (rc != 0)
+  {
+    d->rc = -1;
+    return;
+  }
+  d->empty = minhash_text(txt, len, d->sig) < DEDUP_SHINGLE;
+  d->have = 1;
+  free(txt);
+}
+
+static double sig_similarity(const uint64_t *a, const uint64_t *b)
+{
+  int eq = 0;
+  for (int k = 0; k < DEDUP_K; ++k)
+    eq += a[k] == b[k];
+  return (double)eq / DEDUP_K;
+}
+
+/*------------------------------ cache ---------------------------------------*/
+/* Layout (little-endian): magic[8], u32 K, u32 count, then per record:
+   u16 name_len, name, i64 size, i64 mtime, u8 empty, u64 sig[K]. */
+
+static void put_le(unsigned char *p, uint64_t v, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+    p[i] = (unsigned char)(v >> (8 * i));
+}
+static uint64_t get_le(const unsigned char *p, int bytes)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i)
+    v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+static size_t cache_load(const char *path, DedupDoc *docs, size_t n)
+{
+  size_t len = 0, reused = 0;
+  unsigned char *d = (unsigned char *)read_file_alloc(path, &len);
+  if (!d)
+    return 0;
+  if (len < 16 || memcmp(d, CACHE_MAGIC, 8) != 0 || get_le(d + 8, 4) != DEDUP_K)
+  {
+    free(d);
+    return 0;
+  }
+  size_t count = (size_t)get_le(d + 12, 4), off = 16;
+  const size_t fixed = 8 + 8 + 1 + 8 * DEDUP_K;
+  /* Open-addressed name index over docs (slot = doc index + 1). */
+  size_t cap = 16;
+  while (cap < 2 * n)
+    cap <<= 1;
+  size_t mask = cap - 1;
+  size_t *slot = (size_t *)calloc(cap, sizeof(size_t));
+  if (!slot)
+  {
+    free(d);
+    return 0;
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    size_t h = ueng_hash64(docs[i].name, strlen(docs[i].name), 0) & mask;
+    while (slot[h])
+      h = (h + 1) & mask;
+    slot[h] = i + 1;
+  }
+  for (size_t r = 0; r < count; ++r)
+  {
+    if (off + 2 > len)
+      break;
+    size_t nl = (size_t)get_le(d + off, 2);
+    if (off + 2 + nl + fixed > len)
+      break;
+    const char *name = (const char *)d + off + 2;
+    const unsigned char *rec = d + off + 2 + nl;
+    off += 2 + nl + fixed;
+    for (size_t h = ueng_hash64(name, nl, 0) & mask;; h = (h + 1) & mask)
+    {
+      if (!slot[h])
+        break;
+      DedupDoc *doc = slot[h] - 1 + docs;
+      if (doc->have || strlen(doc->name) != nl || memcmp(doc->name, name, nl) != 0)
+        continue;
+      if ((long long)get_le(rec, 8) != doc->size || (long long)get_le(rec + 8, 8) != doc->mtime)
+        break;
+      doc->empty = rec[16];
+      for (int k = 0; k < DEDUP_K; ++k)
+        doc->sig[k] = get_le(rec + 17 + 8 * k, 8);
+      doc->have = 1;
+      reused++;
+      break;
+    }
+  }
+  free(slot);
+  free(d);
+  return reused;
+}
+
+static int cache_save(const char *path, const DedupDoc *docs, size_t n)
+{
+  if (mkpath_parent(path) != 0)
+    return -1;
+  char tmp[PATH_MAX];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *f = ueng_fopen(tmp, "wb");
+  if (!f)
+    return -1;
+  unsigned char hdr[16];
+  memcpy(hdr, CACHE_MAGIC, 8);
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i)
+    count += docs[i].have;
+  put_le(hdr + 8, DEDUP_K, 4);
+  put_le(hdr + 12, count, 4);
+  int ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr);
+  unsigned char rec[8 + 8 + 1 + 8 * DEDUP_K];
+  for (size_t i = 0; i < n && ok; ++i)
+  {
+    if (!docs[i].have)
+      continue;
+    size_t nl = strlen(docs[i].name);
+    unsigned char l2[2];
+    put_le(l2, nl, 2);
+    put_le(rec, (uint64_t)docs[i].size, 8);
+    put_le(rec + 8, (uint64_t)docs[i].mtime, 8);
+    rec[16] = (unsigned char)docs[i].empty;
+    for (int k = 0; k < DEDUP_K; ++k)
+      put_le(rec + 17 + 8 * k, docs[i].sig[k], 8);
+    ok = fwrite(l2, 1, 2, f) == 2 && fwrite(docs[i].name, 1, nl, f) == nl &&
+         fwrite(rec, 1, sizeof(rec), f) == sizeof(rec);
+  }
+  if (fclose(f) != 0)
+    ok = 0;
+  if (!ok || replace_file(tmp, path) != 0)
+  {
+    remove(tmp);
+    return -1;
+  }
+  return 0;
+}
+
+/*------------------------------ LSH + clustering ----------------------------*/
+
+typedef struct
+{
+  uint64_t key;
+  uint32_t doc;
+} BandKey;
+
+static int bandkey_cmp(const void *A, const void *B)
+{
+  const BandKey *a = (const BandKey *)A, *b = (const BandKey *)B;
+  if (a->key != b->key)
+    return a->key < b->key ? -1 : 1;
+  return (a->doc > b->doc) - (a->doc < b->doc);
+}
+
+static size_t uf_find(size_t *parent, size_t x)
+{
+  while (parent[x] != x)
+  {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+static int is_special(const char *name)
+{
+  return strcmp(name, "_frontmatter.md") == 0 || strcmp(name, "acknowledgements.md") == 0;
+}
+
+DedupMode dedup_mode_parse(const char *s)
+{
+  if (s && (strcmp(s, "off") == 0 || strcmp(s, "false") == 0 || strcmp(s, "no") == 0))
+    return DEDUP_OFF;
+  if (s && strcmp(s, "collapse") == 0)
+    return DEDUP_COLLAPSE;
+  return DEDUP_FLAG;
+}
+
+int dedup_scan(const char *chapters_dir, const char *cache_path, double threshold, int jobs,
+               DedupReport *rep)
+{
+  if (!chapters_dir || !rep)
+    return -1;
+  memset(rep, 0, sizeof(*rep));
+  double t0 = ueng_now_ms();
+  if (threshold <= 0.0)
+    threshold = DEDUP_THRESHOLD;
+
+  StrList all;
+  sl_init(&all);
+  (void)list_md_dir(chapters_dir, &all);
+  size_t n = 0;
+  for (size_t i = 0; i < all.count; ++i)
+    n += !is_special(all.items[i]);
+
+  rep->names = n ? (char **)calloc(n, sizeof(char *)) : NULL;
+  rep->cluster = n ? (int *)malloc(n * sizeof(int)) : NULL;
+  rep->keep = n ? (int *)malloc(n * sizeof(int)) : NULL;
+  rep->sim = n ? (double *)calloc(n, sizeof(double)) : NULL;
+  DedupDoc *docs = n ? (DedupDoc *)calloc(n, sizeof(DedupDoc)) : NULL;
+  DedupDoc **todo = n ? (DedupDoc **)calloc(n, sizeof(DedupDoc *)) : NULL;
+  size_t *parent = n ? (size_t *)malloc(n * sizeof(size_t)) : NULL;
+  BandKey *keys = n ? (BandKey *)malloc(n * DEDUP_BANDS * sizeof(BandKey)) : NULL;
+  if (n && (!rep->names || !rep->cluster || !rep->keep || !rep->sim || !docs || !todo ||
+            !parent || !keys))
+  {
+    free(docs);
+    free(todo);
+    free(parent);
+    free(keys);
+    sl_free(&all);
+    dedup_report_free(rep);
+    return -1;
+  }
+
+  size_t k = 0;
+  for (size_t i = 0; i < all.count; ++i)
+  {
+    if (is_special(all.items[i]))
+      continue;
+    rep->names[k] = all.items[i]; /* text stays in rep->files */
+    DedupDoc *d = &docs[k];
+    d->name = rep->names[k];
+    snprintf(d->path, sizeof(d->path), "%s%c%s", chapters_dir, PATH_SEP, d->name);
+    struct stat st;
+    if (stat(d->path, &st) == 0)
+    {
+      d->size = (long long)st.st_size;
+      d->mtime = (long long)st.st_mtime;
+    }
+    rep->cluster[k] = -1;
+    rep->keep[k] = 1;
+    k++;
+  }
+  rep->n = n;
+  rep->files = all; /* backs rep->names */
+
+  /* Fingerprints: cached ones first, then the rest in parallel. */
+  if (cache_path)
+    rep->cached = cache_load(cache_path, docs, n);
+  size_t nt = 0;
+  for (size_t i = 0; i < n; ++i)
+    if (!docs[i].have)
+      todo[nt++] = &docs[i];
+  if (nt)
+  {
+    ueng_parallel_for(nt, jobs > 0 ? jobs : ueng_jobs(), fingerprint_worker, todo);
+    rep->hashed = nt;
+    if (cache_path && cache_save(cache_path, docs, n) != 0)
+      fprintf(stderr, "[dedup] WARN: could not write %s\n", cache_path);
+  }
+
+  /* LSH: one key per band; equal keys are candidate pairs. */
+  size_t nk = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    parent[i] = i;
+    if (!docs[i].have || docs[i].empty)
+      continue;
+    for (int b = 0; b < DEDUP_BANDS; ++b)
+    {
+      keys[nk].key = ueng_hash64(docs[i].sig + b * ROWS, ROWS * sizeof(uint64_t), (uint64_t)b);
+      keys[nk].doc = (uint32_t)i;
+      nk++;
+    }
+  }
+  if (nk > 1)
+    qsort(keys, nk, sizeof(BandKey), bandkey_cmp);
+  for (size_t s = 0; s < nk;)
+  {
+    size_t e = s + 1;
+    while (e < nk && keys[e].key == keys[s].key)
+      e++;
+    for (size_t x = s; x < e; ++x)
+      for (size_t y = x + 1; y < e; ++y)
+      {
+        size_t a = keys[x].doc, b = keys[y].doc;
+        if (a == b || uf_find(parent, a) == uf_find(parent, b))
+          continue;
+        rep->candidates++;
+        if (sig_similarity(docs[a].sig, docs[b].sig) >= threshold)
+          parent[uf_find(parent, a)] = uf_find(parent, b);
+      }
+    s = e;
+  }
+
+  /* Clusters: keep the newest file (ties: the later name). */
+  size_t *best = n ? (size_t *)malloc(n * sizeof(size_t)) : NULL;
+  size_t *size = n ? (size_t *)calloc(n, sizeof(size_t)) : NULL;
+  if (n && best && size)
+  {
+    for (size_t i = 0; i < n; ++i)
+      best[i] = SIZE_MAX;
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t r = uf_find(parent, i);
+      size[r]++;
+      if (best[r] == SIZE_MAX || docs[i].mtime >= docs[best[r]].mtime)
+        best[r] = i;
+    }
+    int next_id = 0;
+    int *ids = (int *)malloc(n * sizeof(int));
+    for (size_t i = 0; ids && i < n; ++i)
+      ids[i] = -1;
+    for (size_t i = 0; ids && i < n; ++i)
+    {
+      size_t r = uf_find(parent, i);
+      if (size[r] < 2)
+        continue;
+      if (ids[r] < 0)
+      {
+        ids[r] = next_id++;
+        rep->clusters++;
+      }
+      rep->cluster[i] = ids[r];
+      rep->keep[i] = best[r] == i;
+      rep->sim[i] = sig_similarity(docs[i].sig, docs[best[r]].sig);
+      if (!rep->keep[i])
+        rep->dropped++;
+    }
+    free(ids);
+  }
+  free(best);
+  free(size);
+  free(keys);
+  free(parent);
+  free(todo);
+  free(docs);
+  rep->ms = ueng_now_ms() - t0;
+  return 0;
+}
+
+void dedup_report_free(DedupReport *rep)
+{
+  if (!rep)
+    return;
+  sl_free(&rep->files);
+  free(rep->names);
+  free(rep->cluster);
+  free(rep->keep);
+  free(rep->sim);
+  memset(rep, 0, sizeof(*rep));
+}
+
+void dedup_print(const DedupReport *rep, const char *tag, DedupMode mode)
+{
+  if (!rep)
+    return;
+  printf("[%s] dedup: %zu chapters (%zu fingerprinted, %zu cached), %zu candidate pairs, "
+         "%zu near-duplicate groups, %.0f ms\n",
+         tag, rep->n, rep->hashed, rep->cached, rep->candidates, rep->clusters, rep->ms);
+  for (size_t c = 0; c < rep->clusters; ++c)
+  {
+    const char *kept = NULL;
+    for (size_t i = 0; i < rep->n; ++i)
+      if (rep->cluster[i] == (int)c && rep->keep[i])
+        kept = rep->names[i];
+    printf("[%s] near-duplicates of %s (newest):", tag, kept ? kept : "?");
+    for (size_t i = 0; i < rep->n; ++i)
+      if (rep->cluster[i] == (int)c && !rep->keep[i])
+        printf(" %s (%.0f%%)", rep->names[i], rep->sim[i] * 100.0);
+    puts(mode == DEDUP_COLLAPSE ? " - left out of the build" : "");
+  }
+  if (rep->clusters && mode == DEDUP_FLAG)
+    printf("[%s] set 'dedup: collapse' in book.yaml to build only the newest of each\n", tag);
+}
+
+int dedup_dropped(const DedupReport *rep, StrList *out)
+{
+  if (!rep || !out)
+    return -1;
+  for (size_t i = 0; i < rep->n; ++i)
+    if (!rep->keep[i] && sl_push(out, rep->names[i]) != 0)
+      return -1;
+  return 0;
+}
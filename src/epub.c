@@ -0,0 +1,688 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/epub.c
+ * Purpose: Native EPUB 3 packager (no pandoc, no external processes)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *
+ * Notes for contributors:
+ * - The Markdown converter is deliberately small. It only has to produce
+ *   well-formed XHTML (EPUB readers are strict XML parsers); anything it does
+ *   not understand is emitted as escaped paragraph text.
+ * - Memory stays bounded: chapters are converted in windows of a few per
+ *   worker, and each window is flushed to the archive before the next starts.
+ *---------------------------------------------------------------------------*/
+#include "ueng/epub.h"
+#include "ueng/common.h"
+#include "ueng/fs.h"
+#include "ueng/pool.h"
+#include "ueng/textnorm.h"
+#include "ueng/zip.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*------------------------------ output sink ---------------------------------*/
+/* Small write buffer in front of a ZIP blob so the converter can emit many
+   tiny strings without paying a CRC/deflate call for each one. */
+typedef struct
+{
+  UengZipBlob *blob;
+  char buf[16 * 1024];
+  size_t n;
+  int failed;
+} Sink;
+
+static void sink_flush(Sink *s)
+{
+  if (s->n && !s->failed && zip_blob_write(s->blob, s->buf, s->n) != 0)
+    s->failed = 1;
+  s->n = 0;
+}
+
+static void sink_write(Sink *s, const char *p, size_t len)
+{
+  if (len >= sizeof(s->buf))
+  {
+    sink_flush(s);
+    if (!s->failed && zip_blob_write(s->blob, p, len) != 0)
+      s->failed = 1;
+    return;
+  }
+  if (s->n + len > sizeof(s->buf))
+    sink_flush(s);
+  memcpy(s->buf + s->n, p, len);
+  s->n += len;
+}
+
+static void sink_puts(Sink *s, const char *p) { sink_write(s, p, strlen(p)); }
+
+/* XML-escape text (also used for attribute values, hence the quote). */
+static void sink_escape(Sink *s, const char *p, size_t len)
+{
+  size_t run = 0;
+  for (size_t i = 0; i < len; ++i)
+  {
+    const char *rep = NULL;
+    switch (p[i])
+    {
+    case '&':
+      rep = "&amp;";
+      break;
+    case '<':
+      rep = "&lt;";
+      break;
+    case '>':
+      rep = "&gt;";
+      break;
+    case '"':
+      rep = "&quot;";
+      break;
+    default:
+      break;
+    }
+    if (rep)
+    {
+      sink_write(s, p + run, i - run);
+      sink_puts(s, rep);
+      run = i + 1;
+    }
+  }
+  sink_write(s, p + run, len - run);
+}
+
+/*--------------------------- Markdown -> XHTML ------------------------------*/
+
+/* Find 'delim' in [p, end) and return its position, or NULL. */
+static const char *find_delim(const char *p, const char *end, const char *delim)
+{
+  size_t dl = strlen(delim);
+  for (; p + dl <= end; ++p)
+    if (memcmp(p, delim, dl) == 0)
+      return p;
+  return NULL;
+}
+
+/* Inline spans: `code`, **strong**, *em*, [text](url), ![alt](src) -> alt.
+   A span is only converted when its closing delimiter is on the same line,
+   so unbalanced markup degrades to literal text instead of broken XML. */
+static void emit_inline(Sink *s, const char *p, size_t len)
+{
+  const char *end = p + len;
+  const char *run = p;
+  while (p < end)
+  {
+    const char *close = NULL;
+    if (*p == '`' && (close = find_delim(p + 1, end, "`")) != NULL)
+    {
+      sink_escape(s, run, (size_t)(p - run));
+      sink_puts(s, "<code>");
+      sink_escape(s, p + 1, (size_t)(close - p - 1));
+      sink_puts(s, "</code>");
+      p = run = close + 1;
+      continue;
+    }
+    if (p + 1 < end && p[0] == '*' && p[1] == '*' &&
+        (close = find_delim(p + 2, end, "**")) != NULL && close > p + 2)
+    {
+      sink_escape(s, run, (size_t)(p - run));
+      sink_puts(s, "<strong>");
+      emit_inline(s, p + 2, (size_t)(close - p - 2));
+      sink_puts(s, "</strong>");
+      p = run = close + 2;
+      continue;
+    }
+    if (*p == '*' && p + 1 < end && p[1] != ' ' && (close = find_delim(p + 1, end, "*")) != NULL &&
+        close > p + 1)
+    {
+      sink_escape(s, run, (size_t)(p - run));
+      sink_puts(s, "<em>");
+      emit_inline(s, p + 1, (size_t)(close - p - 1));
+      sink_puts(s, "</em>");
+      p = run = close + 1;
+      continue;
+    }
+    int is_img = (*p == '!' && p + 1 < end && p[1] == '[');
+    if (*p == '[' || is_img)
+    {
+      const char *lb = p + (is_img ? 1 : 0);
+      const char *rb = find_delim(lb + 1, end, "](");
+      const char *rp = rb ? find_delim(rb + 2, end, ")") : NULL;
+      if (rb && rp)
+      {
+        sink_escape(s, run, (size_t)(p - run));
+        if (is_img)
+        {
+          /* Images are not packaged; keep the alt text so nothing is lost. */
+          sink_escape(s, lb + 1, (size_t)(rb - lb - 1));
+        }
+        else
+        {
+          sink_puts(s, "<a href=\"");
+          sink_escape(s, rb + 2, (size_t)(rp - rb - 2));
+          sink_puts(s, "\">");
+          emit_inline(s, lb + 1, (size_t)(rb - lb - 1));
+          sink_puts(s, "</a>");
+        }
+        p = run = rp + 1;
+        continue;
+      }
+    }
+    ++p;
+  }
+  sink_escape(s, run, (size_t)(end - run));
+}
+
+enum
+{
+  BLK_NONE,
+  BLK_PARA,
+  BLK_LIST
+};
+
+static void close_block(Sink *s, int *blk)
+{
+  if (*blk == BLK_PARA)
+    sink_puts(s, "</p>\n");
+  else if (*blk == BLK_LIST)
+    sink_puts(s, "</ul>\n");
+  *blk = BLK_NONE;
+}
+
+static void md_to_xhtml(Sink *s, const char *md, size_t len)
+{
+  const char *p = md, *end = md + len;
+  int blk = BLK_NONE, in_code = 0;
+  while (p < end)
+  {
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol)
+      eol = end;
+    const char *le = eol;
+    if (le > p && le[-1] == '\r')
+      le--;
+    size_t ll = (size_t)(le - p);
+
+    if (ll >= 3 && memcmp(p, "```", 3) == 0)
+    {
+      if (in_code)
+        sink_puts(s, "</code></pre>\n");
+      else
+      {
+        close_block(s, &blk);
+        sink_puts(s, "<pre><code>");
+      }
+      in_code = !in_code;
+    }
+    else if (in_code)
+    {
+      sink_escape(s, p, ll);
+      sink_puts(s, "\n");
+    }
+    else
+    {
+      const char *t = p;
+      while (t < le && (*t == ' ' || *t == '\t'))
+        t++;
+      size_t tl = (size_t)(le - t);
+      int hashes = 0;
+      while (hashes < (int)tl && t[hashes] == '#')
+        hashes++;
+
+      if (tl == 0)
+        close_block(s, &blk);
+      else if (tl >= 4 && memcmp(t, "<!--", 4) == 0)
+        ; /* packer markers and HTML comments are dropped */
+      else if (hashes >= 1 && hashes <= 6 && (size_t)hashes < tl && t[hashes] == ' ')
+      {
+        close_block(s, &blk);
+        char tag[16];
+        snprintf(tag, sizeof(tag), "<h%d>", hashes);
+        sink_puts(s, tag);
+        emit_inline(s, t + hashes + 1, tl - (size_t)hashes - 1);
+        snprintf(tag, sizeof(tag), "</h%d>", hashes);
+        sink_puts(s, tag);
+        sink_puts(s, "\n");
+      }
+      else if (tl >= 2 && (t[0] == '-' || t[0] == '*' || t[0] == '+') && t[1] == ' ')
+      {
+        if (blk != BLK_LIST)
+        {
+          close_block(s, &blk);
+          sink_puts(s, "<ul>\n");
+          blk = BLK_LIST;
+        }
+        sink_puts(s, "<li>");
+        emit_inline(s, t + 2, tl - 2);
+        sink_puts(s, "</li>\n");
+      }
+      else
+      {
+        if (t[0] == '>')
+        {
+          t++;
+          tl--;
+          if (tl && *t == ' ')
+          {
+            t++;
+            tl--;
+          }
+        }
+        if (blk != BLK_PARA)
+        {
+          close_block(s, &blk);
+          sink_puts(s, "<p>");
+          blk = BLK_PARA;
+        }
+        else
+          sink_puts(s, "\n");
+        emit_inline(s, t, tl);
+      }
+    }
+    p = (eol < end) ? eol + 1 : end;
+  }
+  if (in_code)
+    sink_puts(s, "</code></pre>\n");
+  close_block(s, &blk);
+}
+
+/* First "# heading" line of a chapter, used for <title> and the nav entry. */
+static void md_first_heading(const char *md, size_t len, char *out, size_t outsz)
+{
+  const char *p = md, *end = md + len;
+  out[0] = '\0';
+  while (p < end)
+  {
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol)
+      eol = end;
+    if (*p == '#')
+    {
+      while (p < eol && *p == '#')
+        p++;
+      while (p < eol && *p == ' ')
+        p++;
+      size_t n = (size_t)(eol - p);
+      if (n && p[n - 1] == '\r')
+        n--;
+      if (n >= outsz)
+        n = outsz - 1;
+      memcpy(out, p, n);
+      out[n] = '\0';
+      if (out[0])
+        return;
+    }
+    p = eol + 1;
+  }
+}
+
+/*------------------------------ chapter jobs --------------------------------*/
+
+typedef struct
+{
+  char path[PATH_MAX];
+  char name[256]; /* file name, used as title fallback */
+  char title[256];
+  UengZipBlob blob;
+  size_t in_bytes;
+  int rc;
+} ChapterJob;
+
+static const char *XHTML_HEAD =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!DOCTYPE html>\n"
+    "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\" "
+    "lang=\"en\" xml:lang=\"en\">\n<head>\n<meta charset=\"utf-8\"/>\n<title>";
+
+static void chapter_worker(void *ud, size_t i)
+{
+  ChapterJob *job = &((ChapterJob *)ud)[i];
+  size_t len = 0;
+  char *raw = read_file_alloc(job->path, &len);
+  if (!raw)
+  {
+    job->rc = -1;
+    return;
+  }
+  job->in_bytes = len;
+  /* XHTML must be well-formed UTF-8 whatever the chapter was saved as. */
+  char *md = NULL;
+  int nrc = textnorm_buffer(raw, len, &md, &len, NULL);
+  free(raw);
+  if (nrc != 0)
+  {
+    job->rc = -1;
+    return;
+  }
+  md_first_heading(md, len, job->title, sizeof(job->title));
+  if (!job->title[0])
+  {
+    snprintf(job->title, sizeof(job->title), "%s", job->name);
+    char *dot = strrchr(job->title, '.');
+    if (dot)
+      *dot = '\0';
+  }
+
+  if (zip_blob_begin(&job->blob, UENG_ZIP_DEFLATE) != 0)
+  {
+    free(md);
+    job->rc = -1;
+    return;
+  }
+  Sink *s = (Sink *)malloc(sizeof(Sink));
+  if (!s)
+  {
+    free(md);
+    job->rc = -1;
+    return;
+  }
+  s->blob = &job->blob;
+  s->n = 0;
+  s->failed = 0;
+  sink_puts(s, XHTML_HEAD);
+  sink_escape(s, job->title, strlen(job->title));
+  sink_puts(s, "</title>\n<link rel=\"stylesheet\" type=\"text/css\" href=\"../style.css\"/>\n"
+               "</head>\n<body>\n<section epub:type=\"chapter\">\n");
+  md_to_xhtml(s, md, len);
+  sink_puts(s, "</section>\n</body>\n</html>\n");
+  sink_flush(s);
+  job->rc = s->failed ? -1 : zip_blob_end(&job->blob);
+  free(s);
+  free(md);
+}
+
+/*------------------------------ static members ------------------------------*/
+
+/* Append a small generated document built through a Sink. */
+typedef void (*DocFn)(Sink *s, const void *ud);
+
+static int add_doc(UengZip *z, const char *name, DocFn fn, const void *ud)
+{
+  UengZipBlob b;
+  if (zip_blob_begin(&b, UENG_ZIP_DEFLATE) != 0)
+    return -1;
+  Sink *s = (Sink *)malloc(sizeof(Sink));
+  if (!s)
+  {
+    zip_blob_free(&b);
+    return -1;
+  }
+  s->blob = &b;
+  s->n = 0;
+  s->failed = 0;
+  fn(s, ud);
+  sink_flush(s);
+  int rc = s->failed ? -1 : zip_blob_end(&b);
+  free(s);
+  if (rc == 0)
+    rc = zip_add_blob(z, name, &b);
+  zip_blob_free(&b);
+  return rc;
+}
+
+typedef struct
+{
+  const EpubOptions *o;
+  const ChapterJob *const *titles; /* chapter order; only title is used */
+  size_t count;
+  int has_cover;
+  char modified[32];
+} BookDoc;
+
+static void chapter_href(char *out, size_t outsz, size_t i)
+{
+  snprintf(out, outsz, "text/ch%04zu.xhtml", i + 1);
+}
+
+static void doc_container(Sink *s, const void *ud)
+{
+  (void)ud;
+  sink_puts(s, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+               "<rootfiles>\n<rootfile full-path=\"OEBPS/content.opf\" "
+               "media-type=\"application/oebps-package+xml\"/>\n</rootfiles>\n</container>\n");
+}
+
+static void doc_opf(Sink *s, const void *ud)
+{
+  const BookDoc *d = (const BookDoc *)ud;
+  char buf[128];
+  sink_puts(s, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"3.0\" "
+               "unique-identifier=\"bookid\" xml:lang=\"en\">\n"
+               "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+               "<dc:identifier id=\"bookid\">urn:uaengine:");
+  sink_escape(s, d->o->slug, strlen(d->o->slug));
+  sink_puts(s, "</dc:identifier>\n<dc:title>");
+  sink_escape(s, d->o->title, strlen(d->o->title));
+  sink_puts(s, "</dc:title>\n<dc:creator>");
+  sink_escape(s, d->o->author, strlen(d->o->author));
+  sink_puts(s, "</dc:creator>\n<dc:language>en</dc:language>\n"
+               "<meta property=\"dcterms:modified\">");
+  sink_puts(s, d->modified);
+  sink_puts(s, "</meta>\n</metadata>\n<manifest>\n"
+               "<item id=\"nav\" href=\"nav.xhtml\" media-type=\"application/xhtml+xml\" "
+               "properties=\"nav\"/>\n"
+               "<item id=\"css\" href=\"style.css\" media-type=\"text/css\"/>\n");
+  if (d->has_cover)
+    sink_puts(s, "<item id=\"cover-image\" href=\"cover.svg\" media-type=\"image/svg+xml\" "
+                 "properties=\"cover-image\"/>\n"
+                 "<item id=\"cover\" href=\"cover.xhtml\" media-type=\"application/xhtml+xml\"/>\n");
+  for (size_t i = 0; i < d->count; ++i)
+  {
+    char href[64];
+    chapter_href(href, sizeof(href), i);
+    snprintf(buf, sizeof(buf), "<item id=\"ch%04zu\" href=\"%s\" ", i + 1, href);
+    sink_puts(s, buf);
+    sink_puts(s, "media-type=\"application/xhtml+xml\"/>\n");
+  }
+  sink_puts(s, "</manifest>\n<spine>\n");
+  if (d->has_cover)
+    sink_puts(s, "<itemref idref=\"cover\"/>\n");
+  sink_puts(s, "<itemref idref=\"nav\"/>\n");
+  for (size_t i = 0; i < d->count; ++i)
+  {
+    snprintf(buf, sizeof(buf), "<itemref idref=\"ch%04zu\"/>\n", i + 1);
+    sink_puts(s, buf);
+  }
+  sink_puts(s, "</spine>\n</package>\n");
+}
+
+static void doc_nav(Sink *s, const void *ud)
+{
+  const BookDoc *d = (const BookDoc *)ud;
+  sink_puts(s, XHTML_HEAD);
+  sink_escape(s, d->o->title, strlen(d->o->title));
+  sink_puts(s, "</title>\n<link rel=\"stylesheet\" type=\"text/css\" href=\"style.css\"/>\n"
+               "</head>\n<body>\n<nav epub:type=\"toc\" id=\"toc\">\n<h1>Contents</h1>\n<ol>\n");
+  for (size_t i = 0; i < d->count; ++i)
+  {
+    char href[64];
+    chapter_href(href, sizeof(href), i);
+    sink_puts(s, "<li><a href=\"");
+    sink_puts(s, href);
+    sink_puts(s, "\">");
+    sink_escape(s, d->titles[i]->title, strlen(d->titles[i]->title));
+    sink_puts(s, "</a></li>\n");
+  }
+  sink_puts(s, "</ol>\n</nav>\n</body>\n</html>\n");
+}
+
+static void doc_cover(Sink *s, const void *ud)
+{
+  const BookDoc *d = (const BookDoc *)ud;
+  sink_puts(s, XHTML_HEAD);
+  sink_escape(s, d->o->title, strlen(d->o->title));
+  sink_puts(s, "</title>\n</head>\n<body>\n<section epub:type=\"cover\">\n"
+               "<img src=\"cover.svg\" alt=\"Cover\" style=\"max-width:100%\"/>\n"
+               "</section>\n</body>\n</html>\n");
+}
+
+/*--------------------------------- driver -----------------------------------*/
+
+/* Chapter order matches pack_book_draft: front matter, chapters, acknowledgements. */
+static int chapter_rank(const char *name)
+{
+  if (strcmp(name, "_frontmatter.md") == 0)
+    return 0;
+  if (strcmp(name, "acknowledgements.md") == 0)
+    return 2;
+  return 1;
+}
+
+int epub_write_book(const EpubOptions *o, EpubStats *st)
+{
+  if (!o || !o->out_path || !o->chapters_dir)
+    return -1;
+  double t0 = ueng_now_ms();
+  if (st)
+    memset(st, 0, sizeof(*st));
+
+  StrList names;
+  sl_init(&names);
+  if (o->chapters)
+  {
+    for (size_t i = 0; i < o->chapters->count; ++i)
+      if (sl_push(&names, o->chapters->items[i]) != 0)
+      {
+        sl_free(&names);
+        return -1;
+      }
+  }
+  else
+  {
+    (void)list_md_dir(o->chapters_dir, &names);
+  }
+  size_t n = names.count;
+
+  ChapterJob *jobs = n ? (ChapterJob *)calloc(n, sizeof(ChapterJob)) : NULL;
+  const ChapterJob **order = n ? (const ChapterJob **)calloc(n, sizeof(*order)) : NULL;
+  if (n && (!jobs || !order))
+  {
+    free(jobs);
+    free((void *)order);
+    sl_free(&names);
+    return -1;
+  }
+  /* Stable three-bucket ordering on top of the natural sort. */
+  size_t k = 0;
+  for (int rank = 0; rank < 3; ++rank)
+    for (size_t i = 0; i < n; ++i)
+      if (chapter_rank(names.items[i]) == rank)
+      {
+        ChapterJob *j = &jobs[k++];
+        snprintf(j->name, sizeof(j->name), "%s", names.items[i]);
+        snprintf(j->path, sizeof(j->path), "%s%c%s", o->chapters_dir, PATH_SEP, names.items[i]);
+      }
+  sl_free(&names);
+
+  UengZip *z = zip_create(o->out_path);
+  if (!z)
+  {
+    fprintf(stderr, "[epub] ERROR: cannot write %s\n", o->out_path);
+    free(jobs);
+    free((void *)order);
+    return -1;
+  }
+
+  int rc = 0;
+  /* 'mimetype' must be the first member and stored uncompressed (OCF 3.0 4.3). */
+  static const char mimetype[] = "application/epub+zip";
+  rc |= zip_add_bytes(z, "mimetype", mimetype, sizeof(mimetype) - 1, UENG_ZIP_STORED);
+  rc |= add_doc(z, "META-INF/container.xml", doc_container, NULL);
+
+  /* Convert + compress chapters in windows; append each window in order. */
+  int nthreads = o->jobs > 0 ? o->jobs : ueng_jobs();
+  size_t window = (size_t)nthreads * 4;
+  if (window < 16)
+    window = 16;
+  uint64_t bytes_in = 0;
+  for (size_t base = 0; base < n && rc == 0; base += window)
+  {
+    size_t cnt = (n - base < window) ? n - base : window;
+    ueng_parallel_for(cnt, nthreads, chapter_worker, jobs + base);
+    for (size_t i = base; i < base + cnt; ++i)
+    {
+      char href[64], member[96];
+      chapter_href(href, sizeof(href), i);
+      snprintf(member, sizeof(member), "OEBPS/%s", href);
+      if (jobs[i].rc != 0)
+      {
+        fprintf(stderr, "[epub] ERROR: could not convert %s\n", jobs[i].path);
+        rc = -1;
+      }
+      else if (zip_add_blob(z, member, &jobs[i].blob) != 0)
+        rc = -1;
+      bytes_in += jobs[i].in_bytes;
+      zip_blob_free(&jobs[i].blob); /* keep memory bounded to one window */
+      order[i] = &jobs[i];
+    }
+  }
+
+  /* Stylesheet and cover are copied verbatim from the build tree. */
+  size_t css_len = 0;
+  char *css = o->css_path ? read_file_alloc(o->css_path, &css_len) : NULL;
+  static const char fallback_css[] = "body{color:#111;background:#fff}"
+                                     "h1,h2,h3{line-height:1.25}"
+                                     "pre{white-space:pre-wrap}";
+  if (css)
+    rc |= zip_add_bytes(z, "OEBPS/style.css", css, css_len, UENG_ZIP_DEFLATE);
+  else
+    rc |= zip_add_bytes(z, "OEBPS/style.css", fallback_css, sizeof(fallback_css) - 1,
+                        UENG_ZIP_DEFLATE);
+  free(css);
+
+  size_t svg_len = 0;
+  char *svg = o->cover_svg ? read_file_alloc(o->cover_svg, &svg_len) : NULL;
+  BookDoc doc;
+  memset(&doc, 0, sizeof(doc));
+  doc.o = o;
+  doc.titles = order;
+  doc.count = n;
+  doc.has_cover = svg != NULL;
+  {
+    time_t now = time(NULL);
+    struct tm *g = gmtime(&now);
+    strftime(doc.modified, sizeof(doc.modified), "%Y-%m-%dT%H:%M:%SZ", g);
+  }
+  if (svg)
+  {
+    rc |= zip_add_bytes(z, "OEBPS/cover.svg", svg, svg_len, UENG_ZIP_DEFLATE);
+    rc |= add_doc(z, "OEBPS/cover.xhtml", doc_cover, &doc);
+    free(svg);
+  }
+  if (rc == 0)
+  {
+    rc |= add_doc(z, "OEBPS/nav.xhtml", doc_nav, &doc);
+    rc |= add_doc(z, "OEBPS/content.opf", doc_opf, &doc);
+  }
+  if (zip_close(z) != 0)
+    rc = -1;
+
+  free(jobs);
+  free((void *)order);
+  if (rc != 0)
+  {
+    remove(o->out_path); /* never leave a half-written container behind */
+    return -1;
+  }
+  if (st)
+  {
+    st->chapters = n;
+    st->bytes_in = bytes_in;
+    FILE *f = ueng_fopen(o->out_path, "rb");
+    if (f)
+    {
+      fseek(f, 0, SEEK_END);
+      long sz = ftell(f);
+      st->bytes_out = sz > 0 ? (uint64_t)sz : 0;
+      fclose(f);
+    }
+    st->ms = ueng_now_ms() - t0;
+  }
+  return 0;
+}
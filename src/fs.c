@@ -9,6 +9,8 @@
  *---------------------------------------------------------------------------*/
 #include "ueng/fs.h"
 #include "ueng/common.h"
+#include "ueng/textnorm.h"
+#include "ueng/trace.h"
 
 #include <errno.h>
 #include <stdio.h>
@@ -33,6 +35,7 @@
 
 int copy_theme_into_html_dir(const char *html_dir, char *rel_css, size_t rel_css_sz)
 {
+  double t0 = ueng_trace_begin();
   if (mkpath(html_dir) != 0)
     return -1;
   char css[PATH_MAX];
@@ -40,23 +43,25 @@ int copy_theme_into_html_dir(const char *html_dir, char *rel_css, size_t rel_css
   const char *minimal_css = "body{color:#111;background:#fff}"
                             "h1,h2,h3{line-height:1.25}"
                             "pre{white-space:pre-wrap}";
-  if (write_text_file_if_absent(css, minimal_css) != 0)
-    return -1;
-  if (rel_css && rel_css_sz)
+  int rc = write_text_file_if_absent(css, minimal_css);
+  if (rc == 0 && rel_css && rel_css_sz)
   {
     strncpy(rel_css, "style.css", rel_css_sz - 1);
     rel_css[rel_css_sz - 1] = '\0';
   }
-  return 0;
+  ueng_trace_end_arg("fs", "copy_theme", t0, html_dir);
+  return rc != 0 ? -1 : 0;
 }
 
 /*---------------------------- Chapter packaging -----------------------------*/
 
-/* Concatenate *.md from `dir` in natural case-insensitive order. */
-static int concat_md_dir(const char *dir, FILE *out)
+/* List *.md from `dir` in natural case-insensitive order. */
+int list_md_dir(const char *dir, StrList *list)
 {
-  StrList list;
-  sl_init(&list);
+  if (!dir || !list)
+    return -1;
+  double t0 = ueng_trace_begin();
+  size_t first = list->count;
 
 #ifdef _WIN32
   char pattern[PATH_MAX];
@@ -69,7 +74,7 @@ static int concat_md_dir(const char *dir, FILE *out)
     {
       if (f.cFileName[0] == '\0')
         continue;
-      sl_push(&list, f.cFileName);
+      sl_push(list, f.cFileName);
     } while (FindNextFileA(h, &f));
     FindClose(h);
   }
@@ -84,7 +89,7 @@ static int concat_md_dir(const char *dir, FILE *out)
       size_t ln = n ? strlen(n) : 0;
       if (ln >= 4 && strcmp(n + ln - 3, ".md") == 0)
       {
-        sl_push(&list, n);
+        sl_push(list, n);
       }
     }
     closedir(d);
@@ -92,37 +97,65 @@ static int concat_md_dir(const char *dir, FILE *out)
 #endif
 
   /* Sort: natural, case-insensitive (e.g., ch2.md < ch10.md) */
-  if (list.count > 1)
+  if (list->count - first > 1)
+  {
+    qsort(list->items + first, list->count - first, sizeof(char *), qsort_nat_ci_cmp);
+  }
+  ueng_trace_end_arg("fs", "list_md_dir", t0, dir);
+  return 0;
+}
+
+/* Append 'path' to 'out' through the text normalizer (valid UTF-8, LF line
+   endings, no BOM), and say so when the file was not clean UTF-8. */
+static int append_normalized(const char *path, FILE *out)
+{
+  FILE *in = ueng_fopen(path, "rb");
+  if (!in)
+    return -1;
+  TextNormStats ts;
+  int rc = textnorm_copy_stream(in, out, &ts);
+  fclose(in);
+  if (rc == 0 && ts.encoding != TEXTNORM_UTF8)
+    printf("[build] note: %s is UTF-16; transcoded to UTF-8\n", path);
+  else if (rc == 0 && ts.transcoded)
+    printf("[build] note: %s: %llu byte(s) were not UTF-8 (read as Windows-1252)\n", path,
+           (unsigned long long)ts.transcoded);
+  return rc;
+}
+
+int concat_md_dir(const char *dir, const StrList *chapters, FILE *out)
+{
+  StrList list;
+  sl_init(&list);
+  if (!chapters)
   {
-    qsort(list.items, list.count, sizeof(char *), qsort_nat_ci_cmp);
+    (void)list_md_dir(dir, &list);
+    chapters = &list;
   }
 
-  for (size_t i = 0; i < list.count; ++i)
+  for (size_t i = 0; i < chapters->count; ++i)
   {
     char p[PATH_MAX];
 #ifdef _WIN32
-    snprintf(p, sizeof(p), "%s\\%s", dir, list.items[i]);
+    snprintf(p, sizeof(p), "%s\\%s", dir, chapters->items[i]);
 #else
-    snprintf(p, sizeof(p), "%s/%s", dir, list.items[i]);
+    snprintf(p, sizeof(p), "%s/%s", dir, chapters->items[i]);
 #endif
-    FILE *in = ueng_fopen(p, "rb");
-    if (!in)
+    if (!file_exists(p))
       continue;
-    fprintf(out, "\n\n<!-- %s -->\n\n", list.items[i]);
-    char buf[65536];
-    size_t nrd;
-    while ((nrd = fread(buf, 1, sizeof(buf), in)) > 0)
-      fwrite(buf, 1, nrd, out);
-    fclose(in);
+    fprintf(out, "\n\n<!-- %s -->\n\n", chapters->items[i]);
+    (void)append_normalized(p, out);
   }
 
   sl_free(&list);
   return 0;
 }
 
-int pack_book_draft(const char *title, const char *outputs_root, int *out_has_draft)
+int pack_book_draft(const char *title, const char *outputs_root, const StrList *chapters,
+                    int *out_has_draft)
 {
   (void)outputs_root; /* draft always under workspace/ */
+  double t0 = ueng_trace_begin();
   (void)mkpath("workspace");
   char draft[PATH_MAX];
   snprintf(draft, sizeof(draft), "workspace%cbook-draft.md", PATH_SEP);
@@ -134,38 +167,23 @@ int pack_book_draft(const char *title, const char *outputs_root, int *out_has_dr
   /* frontmatter */
   if (file_exists("workspace/chapters/_frontmatter.md"))
   {
-    FILE *in = ueng_fopen("workspace/chapters/_frontmatter.md", "rb");
-    if (in)
-    {
-      char buf[65536];
-      size_t nrd;
-      while ((nrd = fread(buf, 1, sizeof(buf), in)) > 0)
-        fwrite(buf, 1, nrd, out);
-      fclose(in);
+    if (append_normalized("workspace/chapters/_frontmatter.md", out) == 0)
       fputs("\n\n", out);
-    }
   }
   /* chapters (deterministic order) */
-  (void)concat_md_dir("workspace/chapters", out);
+  (void)concat_md_dir("workspace/chapters", chapters, out);
 
   /* acknowledgements */
   if (file_exists("workspace/chapters/acknowledgements.md"))
   {
-    FILE *in = ueng_fopen("workspace/chapters/acknowledgements.md", "rb");
-    if (in)
-    {
-      fputs("\n\n", out);
-      char buf[65536];
-      size_t nrd;
-      while ((nrd = fread(buf, 1, sizeof(buf), in)) > 0)
-        fwrite(buf, 1, nrd, out);
-      fclose(in);
-    }
+    fputs("\n\n", out);
+    (void)append_normalized("workspace/chapters/acknowledgements.md", out);
   }
 
   fclose(out);
   if (out_has_draft)
     *out_has_draft = 1;
+  ueng_trace_end_arg("fs", "pack_book_draft", t0, draft);
   return 0;
 }
 
@@ -187,7 +205,10 @@ int generate_cover_svg(const char *title, const char *author, const char *slug)
            "%s</text>\n"
            "</svg>\n",
            title, author);
-  return write_text_file(path, buf);
+  double t0 = ueng_trace_begin();
+  int rc = write_text_file(path, buf);
+  ueng_trace_end_arg("fs", "cover_svg", t0, path);
+  return rc;
 }
 
 int generate_frontcover_md(const char *title, const char *author, const char *slug)
@@ -205,10 +226,84 @@ int generate_frontcover_md(const char *title, const char *author, const char *sl
   return write_text_file(path, buf);
 }
 
+/*------------------------------ Light HTML ----------------------------------*/
+
+static void html_escape_into(const char *in, FILE *out)
+{
+  for (const unsigned char *p = (const unsigned char *)in; *p; ++p)
+  {
+    switch (*p)
+    {
+    case '&':
+      fputs("&amp;", out);
+      break;
+    case '<':
+      fputs("&lt;", out);
+      break;
+    case '>':
+      fputs("&gt;", out);
+      break;
+    default:
+      fputc(*p, out);
+      break;
+    }
+  }
+}
+
+int light_export_html(const char *title, const char *author, const char *html_dir,
+                      const char *md_path, char *out_html, size_t out_html_sz)
+{
+  if (mkpath(html_dir) != 0)
+  {
+    fprintf(stderr, "[export] ERROR: cannot create %s\n", html_dir);
+    return 1;
+  }
+  double t0 = ueng_trace_begin();
+  char rel_css[32];
+  rel_css[0] = '\0';
+  (void)copy_theme_into_html_dir(html_dir, rel_css, sizeof(rel_css)); /* writes style.css */
+
+  snprintf(out_html, out_html_sz, "%s%cbook.html", html_dir, PATH_SEP);
+  FILE *in = ueng_fopen(md_path, "rb");
+  if (!in)
+  {
+    fprintf(stderr, "[export] ERROR: missing %s\n", md_path);
+    return 1;
+  }
+  FILE *out = ueng_fopen(out_html, "wb");
+  if (!out)
+  {
+    fclose(in);
+    fprintf(stderr, "[export] ERROR: cannot write %s\n", out_html);
+    return 1;
+  }
+
+  fputs("<!doctype html><meta charset=\"utf-8\">", out);
+  fprintf(out, "<title>%s - %s</title>", title, author);
+  fprintf(out, "<link rel=\"stylesheet\" href=\"style.css\">");
+  fputs("<body style=\"margin:2rem auto;max-width:860px;font-family:system-ui,-apple-system,Segoe "
+        "UI,Roboto,Ubuntu,Arial,sans-serif;line-height:1.6\">",
+        out);
+  fprintf(out, "<h1>%s</h1><p>Author: %s</p>", title, author);
+  fputs("<pre>", out);
+  char buf[8192];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf) - 1, in)) > 0)
+  {
+    buf[n] = '\0';
+    html_escape_into(buf, out);
+  }
+  fputs("</pre></body>", out);
+  fclose(in);
+  fclose(out);
+  ueng_trace_end_arg("fs", "light_html", t0, out_html);
+  return 0;
+}
+
 /*------------------------------- Site helpers -------------------------------*/
 
 int write_site_index(const char *site_dir, const char *title, const char *author, const char *slug,
-                     const char *stamp, int has_cover, int has_draft)
+                     const char *stamp, int has_cover, int has_draft, int has_search)
 {
   if (mkpath(site_dir) != 0)
     return -1;
@@ -249,6 +344,17 @@ int write_site_index(const char *site_dir, const char *title, const char *author
       return -1;
     used += (size_t)n;
   }
+  if (has_search)
+  {
+    /* search.js loads search.idx lazily on the first keystroke. */
+    n = snprintf(buf + used, sizeof(buf) - used,
+                 "<p><input id=\"uae-search-q\" type=\"search\" placeholder=\"Search the book...\" "
+                 "style=\"width:100%%\"></p>\n<ol id=\"uae-results\"></ol>\n"
+                 "<script src=\"search.js\"></script>\n");
+    if (n < 0)
+      return -1;
+    used += (size_t)n;
+  }
 
   n = snprintf(buf + used, sizeof(buf) - used,
                "<p>Generated by Umicom AuthorEngine AI.</p>\n"
@@ -257,6 +363,9 @@ int write_site_index(const char *site_dir, const char *title, const char *author
     return -1;
 
   /* Use the canonical write_text_file from common.c */
-  return write_text_file(html, buf);
+  double t0 = ueng_trace_begin();
+  int rc = write_text_file(html, buf);
+  ueng_trace_end_arg("fs", "site_index", t0, html);
+  return rc;
 }
 /*------------------------------ Path helpers -------------------------------*/
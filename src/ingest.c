@@ -0,0 +1,1104 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/ingest.c
+ * Purpose: Parallel dropzone -> workspace/chapters ingestion pipeline
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "ueng/ingest.h"
+#include "ueng/common.h"
+#include "ueng/hash.h"
+#include "ueng/pool.h"
+#include "ueng/textnorm.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define ueng_isatty(fd) _isatty(fd)
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ueng_isatty(fd) isatty(fd)
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------ byte buffer ---------------------------------*/
+
+typedef struct
+{
+  char *p;
+  size_t n, cap;
+} IBuf;
+
+static int ib_reserve(IBuf *b, size_t extra)
+{
+  if (b->n + extra + 1 <= b->cap)
+    return 0;
+  size_t cap = b->cap ? b->cap : 4096;
+  while (cap < b->n + extra + 1)
+    cap *= 2;
+  char *np = (char *)realloc(b->p, cap);
+  if (!np)
+    return -1;
+  b->p = np;
+  b->cap = cap;
+  return 0;
+}
+static void ib_put(IBuf *b, const char *s, size_t n)
+{
+  if (ib_reserve(b, n) != 0)
+    return;
+  memcpy(b->p + b->n, s, n);
+  b->n += n;
+  b->p[b->n] = '\0';
+}
+static void ib_puts(IBuf *b, const char *s) { ib_put(b, s, strlen(s)); }
+static void ib_putc(IBuf *b, char c) { ib_put(b, &c, 1); }
+
+/* Number of '\n' at the end of the buffer (ignoring trailing spaces). */
+static int ib_trailing_newlines(const IBuf *b)
+{
+  size_t i = b->n;
+  while (i > 0 && b->p[i - 1] == ' ')
+    i--;
+  int nl = 0;
+  while (i > 0 && b->p[i - 1] == '\n')
+  {
+    nl++;
+    i--;
+  }
+  return i == 0 ? 2 : nl; /* start of document counts as a blank line */
+}
+static void ib_trim_spaces(IBuf *b)
+{
+  while (b->n > 0 && b->p[b->n - 1] == ' ')
+    b->n--;
+  if (b->p)
+    b->p[b->n] = '\0';
+}
+/* Ensure the output ends with at least 'want' newlines (1 = new line, 2 = new block). */
+static void ib_break(IBuf *b, int want)
+{
+  ib_trim_spaces(b);
+  for (int have = ib_trailing_newlines(b); have < want; ++have)
+    ib_putc(b, '\n');
+}
+
+/*------------------------------ entities ------------------------------------*/
+
+/* Append 'cp' as UTF-8. */
+static void put_utf8(IBuf *b, unsigned long cp)
+{
+  char u[4];
+  if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    cp = 0xFFFD;
+  if (cp < 0x80)
+    ib_putc(b, (char)cp);
+  else if (cp < 0x800)
+  {
+    u[0] = (char)(0xC0 | (cp >> 6));
+    u[1] = (char)(0x80 | (cp & 0x3F));
+    ib_put(b, u, 2);
+  }
+  else if (cp < 0x10000)
+  {
+    u[0] = (char)(0xE0 | (cp >> 12));
+    u[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    u[2] = (char)(0x80 | (cp & 0x3F));
+    ib_put(b, u, 3);
+  }
+  else
+  {
+    u[0] = (char)(0xF0 | (cp >> 18));
+    u[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    u[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    u[3] = (char)(0x80 | (cp & 0x3F));
+    ib_put(b, u, 4);
+  }
+}
+
+/* Decode the entity starting at s[0] == '&'. Returns bytes consumed (0 if
+   it is not an entity we know, in which case '&' is literal). */
+static size_t html_entity(const char *s, size_t n, IBuf *out)
+{
+  static const struct
+  {
+    const char *name;
+    unsigned long cp;
+  } named[] = {{"amp", '&'},     {"lt", '<'},       {"gt", '>'},       {"quot", '"'},
+               {"apos", '\''},   {"nbsp", 0xA0},    {"ndash", 0x2013}, {"mdash", 0x2014},
+               {"lsquo", 0x2018}, {"rsquo", 0x2019}, {"ldquo", 0x201C}, {"rdquo", 0x201D},
+               {"hellip", 0x2026}, {"copy", 0xA9},   {"reg", 0xAE},     {"trade", 0x2122}};
+  size_t end = 1;
+  while (end < n && end < 12 && s[end] != ';')
+    end++;
+  if (end >= n || s[end] != ';' || end == 1)
+    return 0;
+  if (s[1] == '#')
+  {
+    unsigned long cp = 0;
+    int hex = (s[2] == 'x' || s[2] == 'X');
+    size_t k = hex ? 3 : 2;
+    if (k >= end)
+      return 0;
+    for (; k < end; ++k)
+    {
+      int c = (unsigned char)s[k];
+      int d = isdigit(c) ? c - '0' : (hex && isxdigit(c)) ? (tolower(c) - 'a' + 10) : -1;
+      if (d < 0)
+        return 0;
+      cp = cp * (hex ? 16u : 10u) + (unsigned long)d;
+      if (cp > 0x10FFFF)
+        cp = 0x110000;
+    }
+    put_utf8(out, cp);
+    return end + 1;
+  }
+  for (size_t k = 0; k < sizeof(named) / sizeof(named[0]); ++k)
+  {
+    size_t ln = strlen(named[k].name);
+    if (ln == end - 1 && memcmp(s + 1, named[k].name, ln) == 0)
+    {
+      put_utf8(out, named[k].cp);
+      return end + 1;
+    }
+  }
+  return 0;
+}
+
+/* 1 if the first n bytes of a and b match ignoring ASCII case. */
+static int ascii_ieq(const char *a, const char *b, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+      return 0;
+  return 1;
+}
+
+/* Read attribute 'name' from the inside of a tag (between '<' and '>'). */
+static void tag_attr(const char *tag, size_t n, const char *name, char *out, size_t outsz)
+{
+  size_t ln = strlen(name);
+  out[0] = '\0';
+  for (size_t i = 0; i + ln < n; ++i)
+  {
+    if ((i == 0 || isspace((unsigned char)tag[i - 1])) && ascii_ieq(tag + i, name, ln) &&
+        (tag[i + ln] == '=' || isspace((unsigned char)tag[i + ln])))
+    {
+      size_t k = i + ln;
+      while (k < n && isspace((unsigned char)tag[k]))
+        k++;
+      if (k >= n || tag[k] != '=')
+        continue;
+      k++;
+      while (k < n && isspace((unsigned char)tag[k]))
+        k++;
+      char q = (k < n && (tag[k] == '"' || tag[k] == '\'')) ? tag[k++] : '\0';
+      size_t j = 0;
+      while (k < n && j + 1 < outsz && (q ? tag[k] != q : !isspace((unsigned char)tag[k])))
+        out[j++] = tag[k++];
+      out[j] = '\0';
+      return;
+    }
+  }
+}
+
+/*------------------------------ HTML -> Markdown ----------------------------*/
+
+typedef struct
+{
+  IBuf *out;
+  int pre;           /* inside <pre>: copy text verbatim */
+  int space;         /* collapsed whitespace waiting to be written */
+  int lists[8];      /* list stack: 0 = bullets, >0 = next ordered number */
+  int depth;
+  char href[512];    /* open <a href>, written at </a> */
+  int in_link;
+} HtmlConv;
+
+static void hc_space(HtmlConv *c)
+{
+  if (c->space && c->out->n > 0 && c->out->p[c->out->n - 1] != '\n')
+    ib_putc(c->out, ' ');
+  c->space = 0;
+}
+
+static int tag_is(const char *name, const char *const *set)
+{
+  for (; *set; ++set)
+    if (strcmp(name, *set) == 0)
+      return 1;
+  return 0;
+}
+
+/* Skip the body of <script>/<style>/... up to and including its end tag. */
+static size_t skip_element(const char *s, size_t n, size_t i, const char *name)
+{
+  size_t ln = strlen(name);
+  for (; i + 2 + ln <= n; ++i)
+    if (s[i] == '<' && s[i + 1] == '/' && ascii_ieq(s + i + 2, name, ln))
+    {
+      const char *gt = memchr(s + i, '>', n - i);
+      return gt ? (size_t)(gt - s) + 1 : n;
+    }
+  return n;
+}
+
+static void html_tag(HtmlConv *c, const char *name, int closing, const char *attrs, size_t alen)
+{
+  static const char *const blocks[] = {"p",      "div",    "section", "article", "header",
+                                       "footer", "main",   "aside",   "nav",     "blockquote",
+                                       "table",  "figure", "dl",      "dd",      "dt",
+                                       "body",   "figcaption", NULL};
+  IBuf *o = c->out;
+  if (name[0] == 'h' && name[1] >= '1' && name[1] <= '6' && !name[2])
+  {
+    ib_break(o, 2);
+    if (!closing)
+    {
+      for (int k = 0; k < name[1] - '0'; ++k)
+        ib_putc(o, '#');
+      ib_putc(o, ' ');
+    }
+    c->space = 0;
+  }
+  else if (tag_is(name, blocks))
+  {
+    ib_break(o, 2);
+    c->space = 0;
+  }
+  else if (strcmp(name, "ul") == 0 || strcmp(name, "ol") == 0)
+  {
+    if (!closing && c->depth < 8)
+      c->lists[c->depth++] = (name[0] == 'o') ? 1 : 0;
+    else if (closing && c->depth > 0)
+      c->depth--;
+    ib_break(o, c->depth ? 1 : 2);
+    c->space = 0;
+  }
+  else if (strcmp(name, "li") == 0)
+  {
+    ib_break(o, 1);
+    c->space = 0;
+    if (closing)
+      return;
+    int d = c->depth ? c->depth : 1;
+    for (int k = 1; k < d; ++k)
+      ib_puts(o, "  ");
+    if (c->depth && c->lists[c->depth - 1] > 0)
+    {
+      char num[16];
+      snprintf(num, sizeof(num), "%d. ", c->lists[c->depth - 1]++);
+      ib_puts(o, num);
+    }
+    else
+      ib_puts(o, "- ");
+  }
+  else if (strcmp(name, "tr") == 0)
+  {
+    ib_break(o, 1);
+    c->space = 0;
+  }
+  else if (strcmp(name, "td") == 0 || strcmp(name, "th") == 0)
+    c->space = 1;
+  else if (strcmp(name, "br") == 0)
+  {
+    ib_trim_spaces(o);
+    ib_puts(o, c->pre ? "\n" : "  \n");
+    c->space = 0;
+  }
+  else if (strcmp(name, "hr") == 0)
+  {
+    ib_break(o, 2);
+    ib_puts(o, "---");
+    ib_break(o, 2);
+    c->space = 0;
+  }
+  else if (strcmp(name, "pre") == 0)
+  {
+    if (!closing)
+    {
+      ib_break(o, 2);
+      ib_puts(o, "```\n");
+      c->pre = 1;
+    }
+    else if (c->pre)
+    {
+      ib_break(o, 1);
+      ib_puts(o, "```");
+      ib_break(o, 2);
+      c->pre = 0;
+    }
+    c->space = 0;
+  }
+  else if (c->pre)
+    return; /* inline markup inside <pre> is dropped */
+  else if (strcmp(name, "em") == 0 || strcmp(name, "i") == 0 || strcmp(name, "strong") == 0 ||
+           strcmp(name, "b") == 0 || strcmp(name, "code") == 0)
+  {
+    const char *mark = (name[0] == 'c') ? "`" : (name[0] == 'e' || name[0] == 'i') ? "*" : "**";
+    if (!closing)
+      hc_space(c);
+    ib_puts(o, mark);
+  }
+  else if (strcmp(name, "a") == 0)
+  {
+    if (!closing)
+    {
+      tag_attr(attrs, alen, "href", c->href, sizeof(c->href));
+      c->in_link = c->href[0] != '\0' && c->href[0] != '#';
+      if (c->in_link)
+      {
+        hc_space(c);
+        ib_putc(o, '[');
+      }
+    }
+    else if (c->in_link)
+    {
+      ib_puts(o, "](");
+      ib_puts(o, c->href);
+      ib_putc(o, ')');
+      c->in_link = 0;
+    }
+  }
+  else if (strcmp(name, "img") == 0)
+  {
+    char src[512], alt[256];
+    tag_attr(attrs, alen, "src", src, sizeof(src));
+    tag_attr(attrs, alen, "alt", alt, sizeof(alt));
+    if (src[0])
+    {
+      hc_space(c);
+      ib_puts(o, "![");
+      ib_puts(o, alt);
+      ib_puts(o, "](");
+      ib_puts(o, src);
+      ib_putc(o, ')');
+    }
+  }
+}
+
+/* Small, forgiving HTML -> Markdown converter for dropped-in pages: headings,
+   paragraphs, lists, emphasis, code, links and images survive; scripts,
+   styles and the <head> are dropped; everything else keeps only its text. */
+static void html_to_md(const char *s, size_t n, IBuf *out)
+{
+  static const char *const skipped[] = {"script", "style",    "head",  "title",
+                                        "noscript", "template", "svg", NULL};
+  HtmlConv c;
+  memset(&c, 0, sizeof(c));
+  c.out = out;
+  size_t i = 0;
+  while (i < n)
+  {
+    char ch = s[i];
+    if (ch == '<')
+    {
+      if (i + 4 <= n && memcmp(s + i, "<!--", 4) == 0)
+      {
+        const char *e = NULL;
+        for (size_t k = i + 4; k + 3 <= n; ++k)
+          if (memcmp(s + k, "-->", 3) == 0)
+          {
+            e = s + k + 3;
+            break;
+          }
+        i = e ? (size_t)(e - s) : n;
+        continue;
+      }
+      const char *gt = memchr(s + i, '>', n - i);
+      if (!gt)
+        break;
+      size_t end = (size_t)(gt - s);
+      size_t k = i + 1;
+      int closing = (k < end && s[k] == '/');
+      if (closing)
+        k++;
+      char name[16];
+      size_t nl = 0;
+      while (k < end && isalnum((unsigned char)s[k]))
+      {
+        if (nl + 1 < sizeof(name))
+          name[nl++] = (char)tolower((unsigned char)s[k]);
+        k++;
+      }
+      name[nl] = '\0';
+      i = end + 1;
+      if (!nl) /* <!DOCTYPE>, <?xml?>, stray '<' */
+        continue;
+      if (!closing && tag_is(name, skipped) && s[end - 1] != '/')
+      {
+        i = skip_element(s, n, i, name);
+        continue;
+      }
+      html_tag(&c, name, closing, s + k, end - k);
+      continue;
+    }
+    if (c.pre)
+    {
+      size_t used = (ch == '&') ? html_entity(s + i, n - i, out) : 0;
+      if (used)
+        i += used;
+      else
+        ib_putc(out, s[i++]);
+      continue;
+    }
+    if (isspace((unsigned char)ch))
+    {
+      c.space = 1;
+      i++;
+      continue;
+    }
+    hc_space(&c);
+    size_t used = (ch == '&') ? html_entity(s + i, n - i, out) : 0;
+    if (used)
+      i += used;
+    else
+      ib_putc(out, s[i++]);
+  }
+  ib_break(out, 1);
+  while (out->n > 0 && out->p[out->n - 1] == '\n' && out->n > 1 && out->p[out->n - 2] == '\n')
+    out->p[--out->n] = '\0';
+}
+
+/*------------------------------ manifest ------------------------------------*/
+
+typedef struct
+{
+  uint64_t hash;
+  char *out; /* chapter file name */
+  char *rel; /* dropzone-relative source path, '/' separated */
+} MEntry;
+
+/* Open-addressing map from a 64-bit key to entry index + 1 (0 = empty). */
+typedef struct
+{
+  uint64_t *keys;
+  uint32_t *vals;
+  size_t cap; /* power of two */
+  size_t used;
+} IMap;
+
+static int imap_grow(IMap *m)
+{
+  size_t ncap = m->cap ? m->cap * 2 : 1024;
+  uint64_t *nk = (uint64_t *)calloc(ncap, sizeof(uint64_t));
+  uint32_t *nv = (uint32_t *)calloc(ncap, sizeof(uint32_t));
+  if (!nk || !nv)
+  {
+    free(nk);
+    free(nv);
+    return -1;
+  }
+  for (size_t i = 0; i < m->cap; ++i)
+    if (m->vals[i])
+    {
+      size_t j = (size_t)m->keys[i] & (ncap - 1);
+      while (nv[j])
+        j = (j + 1) & (ncap - 1);
+      nk[j] = m->keys[i];
+      nv[j] = m->vals[i];
+    }
+  free(m->keys);
+  free(m->vals);
+  m->keys = nk;
+  m->vals = nv;
+  m->cap = ncap;
+  return 0;
+}
+/* Insert or overwrite. */
+static void imap_put(IMap *m, uint64_t key, uint32_t val)
+{
+  if ((m->used + 1) * 2 > m->cap && imap_grow(m) != 0)
+    return;
+  size_t j = (size_t)key & (m->cap - 1);
+  while (m->vals[j] && m->keys[j] != key)
+    j = (j + 1) & (m->cap - 1);
+  if (!m->vals[j])
+    m->used++;
+  m->keys[j] = key;
+  m->vals[j] = val;
+}
+static uint32_t imap_get(const IMap *m, uint64_t key)
+{
+  if (!m->cap)
+    return 0;
+  size_t j = (size_t)key & (m->cap - 1);
+  while (m->vals[j])
+  {
+    if (m->keys[j] == key)
+      return m->vals[j];
+    j = (j + 1) & (m->cap - 1);
+  }
+  return 0;
+}
+static void imap_free(IMap *m)
+{
+  free(m->keys);
+  free(m->vals);
+  memset(m, 0, sizeof(*m));
+}
+
+typedef struct
+{
+  MEntry *e;
+  size_t n, cap;
+  IMap by_rel;  /* hash64(rel)  -> latest entry for that source */
+  IMap by_hash; /* content hash -> latest entry with that content */
+  IMap by_out;  /* hash64(out)  -> latest entry writing that chapter */
+} Manifest;
+
+static uint64_t str_key(const char *s) { return ueng_hash64(s, strlen(s), 0x696e67657374ull); }
+
+static int mf_add(Manifest *mf, uint64_t hash, const char *out, const char *rel)
+{
+  if (mf->n == mf->cap)
+  {
+    size_t ncap = mf->cap ? mf->cap * 2 : 256;
+    MEntry *ne = (MEntry *)realloc(mf->e, ncap * sizeof(MEntry));
+    if (!ne)
+      return -1;
+    mf->e = ne;
+    mf->cap = ncap;
+  }
+  MEntry *e = &mf->e[mf->n];
+  e->hash = hash;
+  e->out = strdup(out);
+  e->rel = strdup(rel);
+  if (!e->out || !e->rel)
+  {
+    free(e->out);
+    free(e->rel);
+    return -1;
+  }
+  uint32_t v = (uint32_t)++mf->n;
+  imap_put(&mf->by_rel, str_key(rel), v);
+  imap_put(&mf->by_hash, hash, v);
+  imap_put(&mf->by_out, str_key(out), v);
+  return 0;
+}
+
+/* Latest entry for source 'rel', or NULL. */
+static const MEntry *mf_for_rel(const Manifest *mf, const char *rel)
+{
+  uint32_t v = imap_get(&mf->by_rel, str_key(rel));
+  return (v && strcmp(mf->e[v - 1].rel, rel) == 0) ? &mf->e[v - 1] : NULL;
+}
+/* An entry is live while it is still the latest one for its source. */
+static int mf_live(const Manifest *mf, const MEntry *e) { return mf_for_rel(mf, e->rel) == e; }
+
+static void mf_load(Manifest *mf, const char *path)
+{
+  size_t len = 0;
+  char *txt = read_file_alloc(path, &len);
+  if (!txt)
+    return;
+  char *save = txt;
+  for (char *line = txt; line && *line;)
+  {
+    char *nl = strchr(line, '\n');
+    if (nl)
+      *nl = '\0';
+    if (line[0] != '#' && strlen(line) > 18 && line[16] == ' ')
+    {
+      char *out = line + 17;
+      char *sp = strchr(out, ' ');
+      if (sp && sp[1])
+      {
+        *sp = '\0';
+        line[16] = '\0';
+        uint64_t h = strtoull(line, NULL, 16);
+        (void)mf_add(mf, h, out, sp + 1);
+      }
+    }
+    line = nl ? nl + 1 : NULL;
+  }
+  free(save);
+}
+
+static void mf_free(Manifest *mf)
+{
+  for (size_t i = 0; i < mf->n; ++i)
+  {
+    free(mf->e[i].out);
+    free(mf->e[i].rel);
+  }
+  free(mf->e);
+  imap_free(&mf->by_rel);
+  imap_free(&mf->by_hash);
+  imap_free(&mf->by_out);
+  memset(mf, 0, sizeof(*mf));
+}
+
+/*------------------------------ discovery -----------------------------------*/
+
+enum
+{
+  KIND_MD = 1,
+  KIND_TXT,
+  KIND_HTML
+};
+
+static int input_kind(const char *rel)
+{
+  const char *dot = strrchr(rel, '.');
+  const char *slash = strrchr(rel, '/');
+  if (!dot || (slash && dot < slash))
+    return 0;
+  char ext[12];
+  size_t n = 0;
+  for (const char *p = dot + 1; *p && n + 1 < sizeof(ext); ++p)
+    ext[n++] = (char)tolower((unsigned char)*p);
+  ext[n] = '\0';
+  if (strcmp(ext, "md") == 0 || strcmp(ext, "markdown") == 0)
+    return KIND_MD;
+  if (strcmp(ext, "txt") == 0)
+    return KIND_TXT;
+  if (strcmp(ext, "html") == 0 || strcmp(ext, "htm") == 0)
+    return KIND_HTML;
+  return 0;
+}
+
+/* Hidden files/folders (".git", ".DS_Store") and names we could not record
+   in the line-based manifest are ignored. */
+static int rel_usable(const char *rel)
+{
+  if (rel[0] == '.' || strstr(rel, "/.") || strchr(rel, '\n'))
+    return 0;
+  return 1;
+}
+
+/* Top-level entries of 'dir', split into files and folders. */
+static int list_top(const char *dir, StrList *files, StrList *dirs)
+{
+#ifdef _WIN32
+  char pattern[PATH_MAX];
+  snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+  WIN32_FIND_DATAA f;
+  HANDLE h = FindFirstFileA(pattern, &f);
+  if (h == INVALID_HANDLE_VALUE)
+    return -1;
+  do
+  {
+    const char *n = f.cFileName;
+    if (n[0] == '.' || (f.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+      continue;
+    sl_push((f.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? dirs : files, n);
+  } while (FindNextFileA(h, &f));
+  FindClose(h);
+#else
+  DIR *d = opendir(dir);
+  if (!d)
+    return -1;
+  struct dirent *e;
+  while ((e = readdir(d)))
+  {
+    const char *n = e->d_name;
+    if (n[0] == '.')
+      continue;
+    char p[PATH_MAX];
+    snprintf(p, sizeof(p), "%s/%s", dir, n);
+    struct stat st;
+    if (lstat(p, &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode))
+      sl_push(dirs, n);
+    else if (S_ISREG(st.st_mode))
+      sl_push(files, n);
+  }
+  closedir(d);
+#endif
+  return 0;
+}
+
+typedef struct
+{
+  const char *root;
+  const StrList *dirs;
+  StrList *found; /* one list per folder */
+} DiscoverCtx;
+
+static void discover_worker(void *ud, size_t i)
+{
+  DiscoverCtx *dc = (DiscoverCtx *)ud;
+  char p[PATH_MAX];
+  snprintf(p, sizeof(p), "%s%c%s", dc->root, PATH_SEP, dc->dirs->items[i]);
+  (void)list_tree_files(p, &dc->found[i]);
+}
+
+/* Every candidate under 'root' as a '/'-separated relative path, natural order. */
+static int discover(const char *root, int jobs, StrList *out)
+{
+  StrList files, dirs;
+  sl_init(&files);
+  sl_init(&dirs);
+  if (list_top(root, &files, &dirs) != 0)
+  {
+    sl_free(&files);
+    sl_free(&dirs);
+    return -1;
+  }
+  for (size_t i = 0; i < files.count; ++i)
+    if (input_kind(files.items[i]))
+      sl_push(out, files.items[i]);
+
+  StrList *found = dirs.count ? (StrList *)calloc(dirs.count, sizeof(StrList)) : NULL;
+  if (dirs.count && found)
+  {
+    DiscoverCtx dc = {root, &dirs, found};
+    ueng_parallel_for(dirs.count, jobs, discover_worker, &dc);
+    for (size_t d = 0; d < dirs.count; ++d)
+    {
+      for (size_t i = 0; i < found[d].count; ++i)
+      {
+        char rel[PATH_MAX];
+        snprintf(rel, sizeof(rel), "%s/%s", dirs.items[d], found[d].items[i]);
+        for (char *q = rel; *q; ++q)
+          if (*q == '\\')
+            *q = '/';
+        if (rel_usable(rel) && input_kind(rel))
+          sl_push(out, rel);
+      }
+      sl_free(&found[d]);
+    }
+  }
+  free(found);
+  sl_free(&files);
+  sl_free(&dirs);
+  if (out->count > 1)
+    qsort(out->items, out->count, sizeof(char *), qsort_nat_ci_cmp);
+  return 0;
+}
+
+/*------------------------------ workers -------------------------------------*/
+
+typedef struct
+{
+  const char *rel;
+  int kind;
+  uint64_t hash;
+  size_t in_bytes;
+  IBuf md;
+  TextNormStats norm;
+  int unchanged; /* decided early: same source, same bytes, chapter still there */
+  int rc;
+} IngestJob;
+
+typedef struct
+{
+  IngestJob *jobs;
+  const Manifest *mf; /* read-only while a window is in flight */
+  const char *dropzone;
+  const char *chapters_dir;
+} IngestWindow;
+
+/* "part-2/the_end.txt" -> "the end" */
+static void title_from_rel(const char *rel, char *out, size_t outsz)
+{
+  const char *base = strrchr(rel, '/');
+  base = base ? base + 1 : rel;
+  snprintf(out, outsz, "%s", base);
+  char *dot = strrchr(out, '.');
+  if (dot && dot != out)
+    *dot = '\0';
+  for (char *p = out; *p; ++p)
+    if (*p == '_' || *p == '-')
+      *p = ' ';
+}
+
+static int starts_with_heading(const char *s, size_t n)
+{
+  size_t i = 0;
+  while (i < n && (s[i] == '\n' || s[i] == ' ' || s[i] == '\t'))
+    i++;
+  return i < n && s[i] == '#';
+}
+
+static void ingest_worker(void *ud, size_t i)
+{
+  IngestWindow *w = (IngestWindow *)ud;
+  IngestJob *j = &w->jobs[i];
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s%c%s", w->dropzone, PATH_SEP, j->rel);
+  size_t len = 0;
+  char *raw = read_file_alloc(path, &len);
+  if (!raw)
+  {
+    j->rc = -1;
+    return;
+  }
+  j->in_bytes = len;
+  j->hash = ueng_hash64(raw, len, 0);
+
+  const MEntry *prev = mf_for_rel(w->mf, j->rel);
+  if (prev && prev->hash == j->hash)
+  {
+    char out[PATH_MAX];
+    snprintf(out, sizeof(out), "%s%c%s", w->chapters_dir, PATH_SEP, prev->out);
+    if (file_exists(out))
+    {
+      j->unchanged = 1;
+      free(raw);
+      return;
+    }
+  }
+
+  char *txt = NULL;
+  int nrc = textnorm_buffer(raw, len, &txt, &len, &j->norm);
+  free(raw);
+  if (nrc != 0)
+  {
+    j->rc = -1;
+    return;
+  }
+  if (j->kind == KIND_HTML)
+    html_to_md(txt, len, &j->md);
+  else
+  {
+    if (j->kind == KIND_TXT && !starts_with_heading(txt, len))
+    {
+      char title[256];
+      title_from_rel(j->rel, title, sizeof(title));
+      ib_puts(&j->md, "# ");
+      ib_puts(&j->md, title);
+      ib_puts(&j->md, "\n\n");
+    }
+    ib_put(&j->md, txt, len);
+    ib_break(&j->md, 1);
+  }
+  free(txt);
+  if (!j->md.p)
+    j->rc = -1;
+}
+
+/*------------------------------ commit --------------------------------------*/
+
+/* Pick the chapter name for a new source: its previous name if it had one,
+   else the slugified relative path, suffixed -2, -3, ... while taken by
+   another source or by a chapter the author wrote by hand. */
+static void chapter_name(const Manifest *mf, const char *chapters_dir, const char *rel, char *out,
+                         size_t outsz)
+{
+  const MEntry *prev = mf_for_rel(mf, rel);
+  if (prev)
+  {
+    snprintf(out, outsz, "%s", prev->out);
+    return;
+  }
+  char stem[PATH_MAX];
+  snprintf(stem, sizeof(stem), "%s", rel);
+  char *dot = strrchr(stem, '.');
+  if (dot && dot != stem)
+    *dot = '\0';
+  char slug[200];
+  slugify(stem, slug, sizeof(slug));
+  if (!slug[0])
+    snprintf(slug, sizeof(slug), "chapter");
+  for (int k = 1;; ++k)
+  {
+    if (k == 1)
+      snprintf(out, outsz, "%s.md", slug);
+    else
+      snprintf(out, outsz, "%s-%d.md", slug, k);
+    uint32_t v = imap_get(&mf->by_out, str_key(out));
+    if (v && mf_live(mf, &mf->e[v - 1]))
+      continue;
+    char p[PATH_MAX];
+    snprintf(p, sizeof(p), "%s%c%s", chapters_dir, PATH_SEP, out);
+    if (v || !file_exists(p)) /* a dead entry's leftover file is ours to reuse */
+      return;
+  }
+}
+
+static int write_chapter(const char *path, const IBuf *md)
+{
+  char tmp[PATH_MAX + 8];
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    return -1;
+  FILE *f = ueng_fopen(tmp, "wb");
+  if (!f)
+    return -1;
+  size_t wr = md->n ? fwrite(md->p, 1, md->n, f) : 0;
+  int rc = (wr == md->n) ? 0 : -1;
+  if (fclose(f) != 0)
+    rc = -1;
+  if (rc == 0)
+    rc = replace_file(tmp, path);
+  if (rc != 0)
+    remove(tmp);
+  return rc;
+}
+
+static void print_progress(const IngestStats *st, size_t done, double t0)
+{
+  double secs = (ueng_now_ms() - t0) / 1000.0;
+  double mb = (double)st->bytes_in / (1024.0 * 1024.0);
+  fprintf(stderr, "\r[ingest] %zu/%zu files, %.1f MiB, %.1f MiB/s   ", done, st->found, mb,
+          secs > 0 ? mb / secs : 0.0);
+  fflush(stderr);
+}
+
+int ingest_run(const IngestOptions *opt, IngestStats *st)
+{
+  IngestStats local;
+  if (!st)
+    st = &local;
+  memset(st, 0, sizeof(*st));
+  double t0 = ueng_now_ms();
+  const char *dropzone = (opt && opt->dropzone) ? opt->dropzone : "dropzone";
+  const char *chapters = (opt && opt->chapters_dir) ? opt->chapters_dir : "workspace/chapters";
+  const char *mpath = (opt && opt->manifest) ? opt->manifest : "workspace/.ingest-manifest";
+  int jobs = (opt && opt->jobs > 0) ? opt->jobs : ueng_jobs();
+  int progress = opt && opt->progress && ueng_isatty(2);
+
+  if (!dir_exists(dropzone))
+    return 0;
+  StrList files;
+  sl_init(&files);
+  if (discover(dropzone, jobs, &files) != 0)
+  {
+    fprintf(stderr, "[ingest] ERROR: cannot read %s\n", dropzone);
+    return -1;
+  }
+  st->found = files.count;
+  if (files.count == 0)
+  {
+    sl_free(&files);
+    st->ms = ueng_now_ms() - t0;
+    return 0;
+  }
+  if (mkpath(chapters) != 0 && !dir_exists(chapters))
+  {
+    fprintf(stderr, "[ingest] ERROR: cannot create %s\n", chapters);
+    sl_free(&files);
+    return -1;
+  }
+
+  Manifest mf;
+  memset(&mf, 0, sizeof(mf));
+  mf_load(&mf, mpath);
+  int new_manifest = !file_exists(mpath);
+  IMap present; /* sources found this run */
+  memset(&present, 0, sizeof(present));
+  for (size_t i = 0; i < files.count; ++i)
+    imap_put(&present, str_key(files.items[i]), 1);
+
+  size_t window = (size_t)jobs * 4;
+  if (window < 16)
+    window = 16;
+  IngestJob *win = (IngestJob *)calloc(window, sizeof(IngestJob));
+  if (!win)
+  {
+    imap_free(&present);
+    mf_free(&mf);
+    sl_free(&files);
+    return -1;
+  }
+
+  double last_report = t0;
+  int reported = 0, on_line = 0; /* progress shown at all / line still open */
+  for (size_t base = 0; base < files.count; base += window)
+  {
+    size_t cnt = (files.count - base < window) ? files.count - base : window;
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      memset(&win[i], 0, sizeof(IngestJob));
+      win[i].rel = files.items[base + i];
+      win[i].kind = input_kind(win[i].rel);
+    }
+    IngestWindow w = {win, &mf, dropzone, chapters};
+    ueng_parallel_for(cnt, jobs, ingest_worker, &w);
+
+    /* Commit in source order so names and the manifest are deterministic. */
+    FILE *mfo = NULL;
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      IngestJob *j = &win[i];
+      st->bytes_in += j->in_bytes;
+      if (j->rc != 0)
+      {
+        fprintf(stderr, "%s[ingest] WARN: could not read %s\n", on_line ? "\n" : "", j->rel);
+        on_line = 0;
+        st->failed++;
+        continue;
+      }
+      if (j->unchanged)
+      {
+        st->unchanged++;
+        continue;
+      }
+      /* Same bytes as another source that is still in the dropzone? (A
+         renamed file is not a duplicate of its own old name.) */
+      uint32_t v = imap_get(&mf.by_hash, j->hash);
+      const MEntry *same = v ? &mf.e[v - 1] : NULL;
+      if (same && mf_live(&mf, same) && strcmp(same->rel, j->rel) != 0 &&
+          imap_get(&present, str_key(same->rel)))
+      {
+        st->duplicate++;
+        free(j->md.p);
+        continue;
+      }
+      char name[256], out[PATH_MAX];
+      chapter_name(&mf, chapters, j->rel, name, sizeof(name));
+      snprintf(out, sizeof(out), "%s%c%s", chapters, PATH_SEP, name);
+      if (write_chapter(out, &j->md) != 0)
+      {
+        fprintf(stderr, "%s[ingest] WARN: could not write %s\n", on_line ? "\n" : "", out);
+        on_line = 0;
+        st->failed++;
+        free(j->md.p);
+        continue;
+      }
+      st->ingested++;
+      st->bytes_out += j->md.n;
+      if (j->norm.encoding != TEXTNORM_UTF8 || j->norm.transcoded)
+        st->transcoded++;
+      free(j->md.p);
+      (void)mf_add(&mf, j->hash, name, j->rel);
+      if (!mfo)
+      {
+        mfo = ueng_fopen(mpath, "ab");
+        if (mfo && new_manifest)
+        {
+          fputs("# uaengine ingest manifest: <xxh64 of source> <chapter> <source>\n", mfo);
+          new_manifest = 0;
+        }
+      }
+      if (mfo)
+        fprintf(mfo, "%016llx %s %s\n", (unsigned long long)j->hash, name, j->rel);
+    }
+    if (mfo)
+      fclose(mfo);
+
+    double now = ueng_now_ms();
+    if (progress && now - last_report >= 500.0)
+    {
+      print_progress(st, base + cnt, t0);
+      last_report = now;
+      reported = on_line = 1;
+    }
+  }
+  if (reported)
+  {
+    print_progress(st, files.count, t0);
+    fputc('\n', stderr);
+  }
+
+  free(win);
+  imap_free(&present);
+  mf_free(&mf);
+  sl_free(&files);
+  st->ms = ueng_now_ms() - t0;
+  return (st->failed && !st->ingested && !st->unchanged && !st->duplicate) ? -1 : 0;
+}
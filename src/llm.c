@@ -0,0 +1,778 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/llm.c
+ * PURPOSE: The llm.h facade: provider selection, fallback and hedging.
+ *
+ * Every backend is linked in (llm_backend.h); a context picks among them at
+ * runtime:
+ *   UENG_LLM_PROVIDER  ordered, comma-separated list of llama (or llamacpp),
+ *                      mistral, openai, ollama. Default: the CMake option
+ *                      UAENG_LLM_PROVIDER (llama unless configured).
+ *   UENG_LLM_HEDGE     1 (or a percentile, 50-99): hedge streamed prompts.
+ *
+ * Fallback: providers are opened in list order until one works; the others
+ * are opened when first needed. A prompt that fails before any text reached
+ * the caller is retried on the next provider; so are the failed items of a
+ * batch. Text already delivered is never taken back, so a stream that fails
+ * half-way still fails.
+ *
+ * Hedging: every streamed prompt records the provider's time to first piece
+ * (the last LLM_TTFT_WINDOW of them). Once there are LLM_HEDGE_MIN_SAMPLES,
+ * a prompt that has produced nothing after the p95 of those times is sent to
+ * the next provider too, and whichever produces the first piece wins. The
+ * loser is told to stop at its next piece (HTTP: the transfer is aborted;
+ * llama.cpp: decoding ends). Both run on their own threads while the caller's
+ * thread relays the winner's pieces, so callbacks still run on the caller's
+ * thread. A loser that is still waiting for its first byte when the call
+ * returns is left to finish; its provider is skipped until it has.
+ * Batches are not hedged: they are throughput work, and duplicating them
+ * doubles the cost for no gain in the tail.
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* strdup */
+#endif
+#include "ueng/llm_backend.h"
+#include "ueng/common.h" /* threads, ueng_now_ms */
+#include "ueng/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef UENG_LLM_DEFAULT_PROVIDER
+#define UENG_LLM_DEFAULT_PROVIDER "llama"
+#endif
+
+#define LLM_MAX_PROVIDERS 4
+#define LLM_TTFT_WINDOW 64      /* first-piece times kept per provider */
+#define LLM_HEDGE_MIN_SAMPLES 16 /* before that, no percentile to trust */
+
+typedef struct
+{
+  const char *name;
+  ueng_llm_chat *(*open_chat)(const char *model, int ctx_tokens, char *err, size_t errsz);
+} Provider; /* open_chat NULL: llama.cpp */
+
+static const Provider PROVIDERS[] = {
+    {"llama", NULL},
+    {"mistral", ueng_llm_open_mistral},
+    {"openai", ueng_llm_open_openai},
+    {"ollama", ueng_llm_open_ollama},
+};
+
+typedef struct Hedge Hedge;
+
+typedef struct
+{
+  const Provider *p;
+  ueng_llm_llama *llama; /* one of these two once opened */
+  ueng_llm_chat *chat;
+  int tried; /* open attempted */
+  double ttft[LLM_TTFT_WINDOW];
+  int n_ttft, next_ttft;
+  Hedge *busy; /* a hedged prompt this provider lost may still be running */
+  int busy_slot;
+} Backend;
+
+struct ueng_llm_ctx
+{
+  Backend b[LLM_MAX_PROVIDERS];
+  int n;
+  int hedge_pct; /* 0: hedging off */
+  int ctx_tokens;
+  char *model;
+};
+
+/*------------------------------ providers -----------------------------------*/
+
+static const Provider *find_provider(const char *name, size_t len)
+{
+  if (len == 8 && strncmp(name, "llamacpp", 8) == 0)
+    return &PROVIDERS[0];
+  for (size_t i = 0; i < sizeof(PROVIDERS) / sizeof(PROVIDERS[0]); ++i)
+    if (strlen(PROVIDERS[i].name) == len && strncmp(name, PROVIDERS[i].name, len) == 0)
+      return &PROVIDERS[i];
+  return NULL;
+}
+
+/* Fill ctx->b from "mistral, openai". Returns 0, or -1 with 'err' filled. */
+static int parse_providers(ueng_llm_ctx *ctx, const char *list, char *err, size_t errsz)
+{
+  const char *s = list;
+  while (*s)
+  {
+    while (*s == ',' || *s == ' ')
+      s++;
+    size_t len = strcspn(s, ", ");
+    if (len == 0)
+      break;
+    const Provider *p = find_provider(s, len);
+    if (!p)
+    {
+      if (err && errsz)
+        snprintf(err, errsz, "unknown LLM provider '%.*s' (llama, mistral, openai, ollama)",
+                 (int)len, s);
+      return -1;
+    }
+    int dup = 0;
+    for (int i = 0; i < ctx->n; ++i)
+      dup |= ctx->b[i].p == p;
+    if (!dup && ctx->n < LLM_MAX_PROVIDERS)
+      ctx->b[ctx->n++].p = p;
+    s += len;
+  }
+  if (ctx->n == 0)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "UENG_LLM_PROVIDER names no provider");
+    return -1;
+  }
+  return 0;
+}
+
+static int is_gguf(const char *path)
+{
+  size_t n = path ? strlen(path) : 0;
+  return n > 5 && strcmp(path + n - 5, ".gguf") == 0;
+}
+
+/* The model argument is a .gguf path for llama.cpp or a model name for the
+   HTTP providers; a list mixing both takes the other kind from the
+   environment (UENG_LLAMA_MODEL_PATH; each provider's default model). */
+static int backend_open(ueng_llm_ctx *ctx, Backend *B, char *err, size_t errsz)
+{
+  const char *m = ctx->model;
+  if (!B->p->open_chat)
+  {
+    const char *env = getenv("UENG_LLAMA_MODEL_PATH");
+    if (!is_gguf(m) && env && *env)
+      m = env;
+    B->llama = ueng_llm_open_llama(m, ctx->ctx_tokens, err, errsz);
+    return B->llama ? 0 : -1;
+  }
+  B->chat = B->p->open_chat(is_gguf(m) ? NULL : m, ctx->ctx_tokens, err, errsz);
+  return B->chat ? 0 : -1;
+}
+
+static int hedge_reap(Backend *B, int wait);
+
+/* The provider ueng_llm_identity describes: the first one with a handle.
+   Providers are never closed before the context is, so this is fixed once
+   ueng_llm_open has returned. */
+static int identity_backend(const ueng_llm_ctx *ctx)
+{
+  for (int i = 0; i < ctx->n; ++i)
+    if (ctx->b[i].llama || ctx->b[i].chat)
+      return i;
+  return -1;
+}
+
+/* Open provider i on first use and say whether it can take a prompt now. */
+static int backend_ready(ueng_llm_ctx *ctx, int i)
+{
+  Backend *B = &ctx->b[i];
+  if (B->busy && !hedge_reap(B, 0))
+    return 0;
+  if (!B->tried)
+  {
+    B->tried = 1;
+    char err[256] = {0};
+    if (backend_open(ctx, B, err, sizeof(err)) != 0)
+      fprintf(stderr, "[llm] WARN: %s unavailable: %s\n", B->p->name, err);
+  }
+  return B->llama || B->chat;
+}
+
+static int backend_stream(Backend *B, const char *prompt, ueng_llm_piece_fn fn, void *user,
+                          ueng_llm_stream_stats *st)
+{
+  if (B->llama)
+    return ueng_llm_prompt_stream_llama(B->llama, prompt, fn, user, st);
+  return ueng_llm_prompt_stream_chat(B->chat, prompt, fn, user, st);
+}
+
+static int backend_batch(Backend *B, ueng_llm_batch_item *items, size_t n, int max_parallel)
+{
+  if (B->llama)
+    return ueng_llm_prompt_batch_llama(B->llama, items, n, max_parallel);
+  return ueng_llm_prompt_batch_chat(B->chat, items, n, max_parallel);
+}
+
+static void record_ttft(Backend *B, double ms)
+{
+  B->ttft[B->next_ttft] = ms;
+  B->next_ttft = (B->next_ttft + 1) % LLM_TTFT_WINDOW;
+  if (B->n_ttft < LLM_TTFT_WINDOW)
+    B->n_ttft++;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of the recorded first-piece times. */
+static double ttft_percentile(const Backend *B, int pct)
+{
+  double v[LLM_TTFT_WINDOW];
+  memcpy(v, B->ttft, (size_t)B->n_ttft * sizeof(double));
+  qsort(v, (size_t)B->n_ttft, sizeof(double), cmp_double);
+  int k = (pct * B->n_ttft + 99) / 100;
+  return v[k > 0 ? k - 1 : 0];
+}
+
+/*------------------------------ open / close --------------------------------*/
+
+ueng_llm_ctx *ueng_llm_open(const char *model_path, int ctx_tokens, char *err, size_t errsz)
+{
+  ueng_llm_ctx *ctx = (ueng_llm_ctx *)calloc(1, sizeof(*ctx));
+  if (!ctx)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "out of memory");
+    return NULL;
+  }
+  const char *list = getenv("UENG_LLM_PROVIDER");
+  if (parse_providers(ctx, (list && *list) ? list : UENG_LLM_DEFAULT_PROVIDER, err, errsz) != 0)
+  {
+    free(ctx);
+    return NULL;
+  }
+  ctx->ctx_tokens = ctx_tokens;
+  if (model_path && *model_path)
+    ctx->model = strdup(model_path);
+
+  const char *h = getenv("UENG_LLM_HEDGE");
+  int pct = h ? atoi(h) : 0;
+  ctx->hedge_pct = pct <= 0 ? 0 : (pct >= 50 && pct <= 99) ? pct : 95;
+
+  /* The first provider that opens serves; with hedging, so will the next. */
+  char last[256] = {0};
+  int open = -1;
+  for (int i = 0; i < ctx->n && open < 0; ++i)
+  {
+    ctx->b[i].tried = 1;
+    if (backend_open(ctx, &ctx->b[i], last, sizeof(last)) == 0)
+      open = i;
+    else if (i + 1 < ctx->n)
+      fprintf(stderr, "[llm] WARN: %s unavailable: %s\n", ctx->b[i].p->name, last);
+  }
+  if (open < 0)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "%s", last);
+    ueng_llm_close(ctx);
+    return NULL;
+  }
+  if (ctx->hedge_pct && open + 1 < ctx->n)
+    (void)backend_ready(ctx, open + 1);
+  return ctx;
+}
+
+void ueng_llm_close(ueng_llm_ctx *ctx)
+{
+  if (!ctx)
+    return;
+  for (int i = 0; i < ctx->n; ++i)
+  {
+    Backend *B = &ctx->b[i];
+    if (B->busy)
+      (void)hedge_reap(B, 1);
+    if (B->llama)
+      ueng_llm_close_llama(B->llama);
+    if (B->chat)
+      ueng_llm_close_chat(B->chat);
+  }
+  free(ctx->model);
+  free(ctx);
+}
+
+/* The first provider that is open now answers for the context; replies from
+   any other are marked 'fallback' so the cache does not file them under it. */
+int ueng_llm_identity(ueng_llm_ctx *ctx, char *out, size_t outsz)
+{
+  if (!ctx || !out || outsz == 0)
+    return -1;
+  int i = identity_backend(ctx);
+  if (i < 0)
+    return -1;
+  Backend *B = &ctx->b[i];
+  return B->llama ? ueng_llm_identity_llama(B->llama, out, outsz)
+                  : ueng_llm_identity_chat(B->chat, out, outsz);
+}
+
+int ueng_llm_get_conn_stats(ueng_llm_ctx *ctx, ueng_llm_conn_stats *out)
+{
+  if (out)
+    memset(out, 0, sizeof(*out));
+  if (!ctx || !out)
+    return -1;
+  int any = 0;
+  for (int i = 0; i < ctx->n; ++i)
+  {
+    ueng_llm_conn_stats s;
+    if (!ctx->b[i].chat || ueng_llm_get_conn_stats_chat(ctx->b[i].chat, &s) != 0)
+      continue;
+    out->requests += s.requests;
+    out->connects += s.connects;
+    out->reused += s.reused;
+    out->connect_ms += s.connect_ms;
+    any = 1;
+  }
+  return any ? 0 : -1;
+}
+
+/*------------------------------ hedging -------------------------------------*/
+
+typedef struct
+{
+  Hedge *h;
+  int slot;
+  Backend *B;
+  ueng_thread_t th;
+  int started, threaded, done, rc;
+  double t0, ttft; /* ttft > 0 once a first piece arrived */
+  ueng_llm_stream_stats st;
+} Attempt;
+
+struct Hedge
+{
+  ueng_mutex_t mu;
+  ueng_cond_t cv;
+  int refs; /* the caller plus every attempt not joined yet */
+  char *prompt;
+  Attempt a[2];
+  int winner; /* slot whose pieces go to the caller; -1 until one has a piece */
+  int stop;   /* the caller's callback returned non-zero */
+  /* Winner's pieces not yet relayed: records of (size_t length, bytes). */
+  char *q;
+  size_t q_head, q_len, q_cap;
+};
+
+static void hedge_unref(Hedge *h)
+{
+  ueng_mutex_lock(&h->mu);
+  int last = --h->refs == 0;
+  ueng_mutex_unlock(&h->mu);
+  if (!last)
+    return;
+  ueng_mutex_destroy(&h->mu);
+  ueng_cond_destroy(&h->cv);
+  free(h->prompt);
+  free(h->q);
+  free(h);
+}
+
+/* Append one piece to the queue (locked). */
+static int q_push(Hedge *h, const char *piece, size_t len)
+{
+  if (h->q_head == h->q_len)
+    h->q_head = h->q_len = 0;
+  size_t need = h->q_len + sizeof(size_t) + len;
+  if (need > h->q_cap)
+  {
+    size_t cap = h->q_cap ? h->q_cap * 2 : 4096;
+    while (cap < need)
+      cap *= 2;
+    char *q = (char *)realloc(h->q, cap);
+    if (!q)
+      return -1;
+    h->q = q;
+    h->q_cap = cap;
+  }
+  memcpy(h->q + h->q_len, &len, sizeof(size_t));
+  memcpy(h->q + h->q_len + sizeof(size_t), piece, len);
+  h->q_len = need;
+  return 0;
+}
+
+/* Runs on an attempt's thread: the first piece of either attempt decides
+   the winner; the other is told to stop. */
+static int hedge_piece(void *user, const char *piece, size_t len)
+{
+  Attempt *A = (Attempt *)user;
+  Hedge *h = A->h;
+  ueng_mutex_lock(&h->mu);
+  if (A->ttft <= 0)
+    A->ttft = ueng_now_ms() - A->t0;
+  if (h->winner < 0)
+    h->winner = A->slot;
+  int keep = h->winner == A->slot && !h->stop && q_push(h, piece, len) == 0;
+  ueng_cond_broadcast(&h->cv);
+  ueng_mutex_unlock(&h->mu);
+  return keep ? 0 : 1;
+}
+
+static void hedge_main(void *arg)
+{
+  Attempt *A = (Attempt *)arg;
+  Hedge *h = A->h;
+  ueng_llm_stream_stats st;
+  int rc = backend_stream(A->B, h->prompt, hedge_piece, A, &st);
+  ueng_mutex_lock(&h->mu);
+  A->rc = rc;
+  A->st = st;
+  A->done = 1;
+  ueng_cond_broadcast(&h->cv);
+  ueng_mutex_unlock(&h->mu);
+}
+
+/* Start attempt 'slot' on B (locked). A thread that cannot start counts as
+   a failed attempt. */
+static void hedge_start(Hedge *h, int slot, Backend *B)
+{
+  Attempt *A = &h->a[slot];
+  A->h = h;
+  A->slot = slot;
+  A->B = B;
+  A->started = 1;
+  A->t0 = ueng_now_ms();
+  h->refs++;
+  A->threaded = ueng_thread_start(&A->th, hedge_main, A) == 0;
+  if (!A->threaded)
+  {
+    A->done = 1;
+    A->rc = -1;
+  }
+}
+
+/* Join a hedged attempt left running on B. With wait == 0, only when it
+   has finished. Returns 1 when B is free again. */
+static int hedge_reap(Backend *B, int wait)
+{
+  Hedge *h = B->busy;
+  Attempt *A = &h->a[B->busy_slot];
+  ueng_mutex_lock(&h->mu);
+  int done = A->done;
+  ueng_mutex_unlock(&h->mu);
+  if (!done && !wait)
+    return 0;
+  if (A->threaded)
+    ueng_thread_join(A->th);
+  if (A->ttft > 0)
+    record_ttft(B, A->ttft);
+  B->busy = NULL;
+  hedge_unref(h);
+  return 1;
+}
+
+/* Primary and secondary providers for a hedged prompt, and the delay.
+   Returns 0 when this prompt should not be hedged. */
+static int hedge_plan(ueng_llm_ctx *ctx, int *primary, int *secondary, double *delay_ms)
+{
+  if (!ctx->hedge_pct)
+    return 0;
+  int p = -1, s = -1;
+  for (int i = 0; i < ctx->n && s < 0; ++i)
+    if (backend_ready(ctx, i))
+    {
+      if (p < 0)
+        p = i;
+      else
+        s = i;
+    }
+  if (s < 0 || ctx->b[p].n_ttft < LLM_HEDGE_MIN_SAMPLES)
+    return 0;
+  *primary = p;
+  *secondary = s;
+  *delay_ms = ttft_percentile(&ctx->b[p], ctx->hedge_pct);
+  return 1;
+}
+
+static int hedged_stream(ueng_llm_ctx *ctx, int primary, int secondary, double delay_ms,
+                         const char *prompt, ueng_llm_piece_fn fn, void *user,
+                         ueng_llm_stream_stats *stats)
+{
+  Hedge *h = (Hedge *)calloc(1, sizeof(*h));
+  char *prompt_copy = strdup(prompt);
+  if (!h || !prompt_copy)
+  {
+    free(h);
+    free(prompt_copy);
+    return -2;
+  }
+  ueng_mutex_init(&h->mu);
+  ueng_cond_init(&h->cv);
+  h->refs = 1;
+  h->prompt = prompt_copy;
+  h->winner = -1;
+
+  double t0 = ueng_now_ms(), tt = ueng_trace_begin();
+  double ttft = 0;
+  int pieces = 0, rc = -1;
+  char *buf = NULL;
+  size_t buf_cap = 0;
+
+  ueng_mutex_lock(&h->mu);
+  hedge_start(h, 0, &ctx->b[primary]);
+  for (;;)
+  {
+    /* Relay the winner's pieces, unlocked while the callback runs. */
+    while (h->winner >= 0 && h->q_head < h->q_len && !h->stop)
+    {
+      size_t len;
+      memcpy(&len, h->q + h->q_head, sizeof(size_t));
+      if (len > buf_cap)
+      {
+        char *nb = (char *)realloc(buf, len);
+        if (!nb)
+        {
+          h->stop = 1;
+          break;
+        }
+        buf = nb;
+        buf_cap = len;
+      }
+      memcpy(buf, h->q + h->q_head + sizeof(size_t), len);
+      h->q_head += sizeof(size_t) + len;
+      ueng_mutex_unlock(&h->mu);
+      if (pieces++ == 0)
+        ttft = ueng_now_ms() - t0;
+      int stop = fn(user, buf, len) != 0;
+      ueng_mutex_lock(&h->mu);
+      h->stop |= stop;
+    }
+    if (h->winner >= 0)
+    {
+      if (h->a[h->winner].done && (h->stop || h->q_head == h->q_len))
+      {
+        rc = h->stop ? UENG_LLM_CANCELLED : h->a[h->winner].rc;
+        break;
+      }
+    }
+    else
+    {
+      /* No piece yet: an attempt that finished cleanly answered with
+         nothing; one that failed hands over to the other. */
+      int live = 0;
+      for (int s = 0; s < 2 && h->winner < 0; ++s)
+      {
+        Attempt *A = &h->a[s];
+        if (A->done && A->rc >= 0)
+          h->winner = s;
+        live += A->started && !A->done;
+      }
+      if (h->winner >= 0)
+        continue;
+      double waited = ueng_now_ms() - t0;
+      if (!h->a[1].started && (live == 0 || waited >= delay_ms))
+      {
+        ueng_trace_end_arg("llm", "hedge", tt, ctx->b[secondary].p->name);
+        hedge_start(h, 1, &ctx->b[secondary]);
+        continue;
+      }
+      if (live == 0)
+      {
+        rc = h->a[1].done ? h->a[1].rc : h->a[0].rc;
+        break;
+      }
+      if (!h->a[1].started)
+      {
+        ueng_cond_timedwait(&h->cv, &h->mu, delay_ms - waited);
+        continue;
+      }
+    }
+    ueng_cond_wait(&h->cv, &h->mu);
+  }
+
+  int last = h->winner >= 0 ? h->winner : h->a[1].started ? 1 : 0;
+  ueng_llm_stream_stats st = h->a[last].st;
+  ueng_mutex_unlock(&h->mu);
+  free(buf);
+  st.ttft_ms = ttft;
+  st.total_ms = ueng_now_ms() - t0;
+  st.pieces = pieces;
+  st.fallback = (last == 0 ? primary : secondary) != identity_backend(ctx);
+  if (stats)
+    *stats = st;
+
+  /* Join what has finished; a loser still waiting for its first byte keeps
+     its provider busy (and the hedge state alive) until it is reaped. */
+  for (int s = 0; s < 2; ++s)
+  {
+    Backend *B = &ctx->b[s == 0 ? primary : secondary];
+    if (!h->a[s].started)
+      continue;
+    ueng_mutex_lock(&h->mu);
+    int done = h->a[s].done;
+    ueng_mutex_unlock(&h->mu);
+    B->busy = h;
+    B->busy_slot = s;
+    if (done)
+      (void)hedge_reap(B, 1);
+  }
+  hedge_unref(h);
+  return rc;
+}
+
+/*------------------------------ prompts -------------------------------------*/
+
+/* Stream on the providers from 'first' on, falling back while nothing has
+   been delivered. */
+static int stream_from(ueng_llm_ctx *ctx, int first, const char *prompt, ueng_llm_piece_fn fn,
+                       void *user, ueng_llm_stream_stats *stats)
+{
+  int rc = -1;
+  for (int i = first; i < ctx->n; ++i)
+  {
+    if (!backend_ready(ctx, i))
+      continue;
+    Backend *B = &ctx->b[i];
+    ueng_llm_stream_stats st;
+    rc = backend_stream(B, prompt, fn, user, &st);
+    st.fallback = i != identity_backend(ctx);
+    if (stats)
+      *stats = st;
+    if (st.pieces > 0)
+      record_ttft(B, st.ttft_ms);
+    if (rc >= 0 || st.pieces > 0)
+      return rc;
+    if (i + 1 < ctx->n)
+      fprintf(stderr, "[llm] WARN: %s failed (rc=%d); trying the next provider\n", B->p->name,
+              rc);
+  }
+  return rc;
+}
+
+int ueng_llm_prompt_stream(ueng_llm_ctx *ctx, const char *prompt, ueng_llm_piece_fn fn,
+                           void *user, ueng_llm_stream_stats *stats)
+{
+  if (stats)
+    memset(stats, 0, sizeof(*stats));
+  if (!ctx || !prompt || !fn)
+    return -1;
+  int p, s;
+  double delay;
+  if (hedge_plan(ctx, &p, &s, &delay))
+    return hedged_stream(ctx, p, s, delay, prompt, fn, user, stats);
+  return stream_from(ctx, 0, prompt, fn, user, stats);
+}
+
+/* Blocking prompt on top of the streaming one. */
+typedef struct
+{
+  char *out;
+  size_t cap, used;
+} Collect;
+
+static int collect_piece(void *user, const char *piece, size_t len)
+{
+  Collect *c = (Collect *)user;
+  size_t room = c->cap - 1 - c->used;
+  int full = len >= room;
+  if (len > room)
+  {
+    len = room;
+    /* Do not leave half a UTF-8 character at the end. */
+    while (len > 0 && ((unsigned char)piece[len] & 0xC0) == 0x80)
+      len--;
+  }
+  memcpy(c->out + c->used, piece, len);
+  c->used += len;
+  c->out[c->used] = '\0';
+  return full;
+}
+
+/* HTTP providers answer a blocking prompt with one non-streamed request
+   (unless hedging, which needs the stream's first piece). */
+int ueng_llm_prompt(ueng_llm_ctx *ctx, const char *prompt, char *out, size_t outsz)
+{
+  if (!out || outsz == 0)
+    return -1;
+  out[0] = '\0';
+  if (!ctx || !prompt)
+    return -1;
+  Collect c = {out, outsz, 0};
+  if (ctx->hedge_pct)
+  {
+    int rc = ueng_llm_prompt_stream(ctx, prompt, collect_piece, &c, NULL);
+    return rc == UENG_LLM_CANCELLED ? 0 : rc; /* stopped because 'out' is full */
+  }
+  int rc = -1;
+  for (int i = 0; i < ctx->n; ++i)
+  {
+    if (!backend_ready(ctx, i))
+      continue;
+    Backend *B = &ctx->b[i];
+    if (B->llama)
+    {
+      out[0] = '\0';
+      rc = stream_from(ctx, i, prompt, collect_piece, &c, NULL);
+      return rc == UENG_LLM_CANCELLED ? 0 : rc;
+    }
+    rc = ueng_llm_prompt_chat(B->chat, prompt, out, outsz);
+    if (rc == 0)
+      return 0;
+    if (i + 1 < ctx->n)
+      fprintf(stderr, "[llm] WARN: %s failed (%s); trying the next provider\n", B->p->name, out);
+  }
+  return rc;
+}
+
+/* Run the failed items of a batch again on B. Returns how many still fail. */
+static int batch_retry(Backend *B, int fallback, ueng_llm_batch_item *items, size_t n,
+                       int max_parallel, int failed)
+{
+  ueng_llm_batch_item *sub = (ueng_llm_batch_item *)calloc((size_t)failed, sizeof(*sub));
+  size_t *idx = (size_t *)calloc((size_t)failed, sizeof(*idx));
+  if (!sub || !idx)
+  {
+    free(sub);
+    free(idx);
+    return failed;
+  }
+  size_t k = 0;
+  for (size_t i = 0; i < n && k < (size_t)failed; ++i)
+    if (items[i].status != 0)
+    {
+      idx[k] = i;
+      sub[k].prompt = items[i].prompt;
+      sub[k].sampling = items[i].sampling;
+      k++;
+    }
+  int rc = backend_batch(B, sub, k, max_parallel);
+  if (rc >= 0)
+  {
+    for (size_t j = 0; j < k; ++j)
+    {
+      free(items[idx[j]].text);
+      items[idx[j]] = sub[j];
+      items[idx[j]].fallback = fallback;
+    }
+    failed = rc;
+  }
+  free(sub);
+  free(idx);
+  return failed;
+}
+
+int ueng_llm_prompt_batch(ueng_llm_ctx *ctx, ueng_llm_batch_item *items, size_t n,
+                          int max_parallel)
+{
+  if (!ctx || (!items && n))
+    return -1;
+  int failed = -1;
+  for (int i = 0; i < ctx->n && failed != 0; ++i)
+  {
+    if (!backend_ready(ctx, i))
+      continue;
+    int fallback = i != identity_backend(ctx);
+    if (failed < 0)
+    {
+      failed = backend_batch(&ctx->b[i], items, n, max_parallel);
+      for (size_t k = 0; k < n; ++k)
+        items[k].fallback = fallback;
+    }
+    else
+    {
+      fprintf(stderr, "[llm] WARN: %d prompt(s) failed; retrying them on %s\n", failed,
+              ctx->b[i].p->name);
+      failed = batch_retry(&ctx->b[i], fallback, items, n, max_parallel, failed);
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,467 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/llm_bench.c
+ * Purpose: `uaengine llm-bench`: load time, prefill/decode speed, TTFT and
+ *          memory of the LLM backend; latency percentiles for remote ones
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* setenv, getrusage */
+#endif
+
+#include "ueng/llm_bench.h"
+#include "ueng/common.h"
+#include "ueng/config.h"
+#include "ueng/llm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define PSAPI_VERSION 2 /* GetProcessMemoryInfo from kernel32, no psapi.lib */
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/*------------------------------ helpers -------------------------------------*/
+
+int llm_bench_parse_list(const char *s, int *out)
+{
+  int n = 0;
+  while (s && *s)
+  {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || v <= 0 || v > 1 << 20 || n == LLM_BENCH_MAX_SWEEP ||
+        (*end != ',' && *end != '\0'))
+      return -1;
+    out[n++] = (int)v;
+    s = *end ? end + 1 : end;
+  }
+  return n > 0 ? n : -1;
+}
+
+/* Process high-water mark of resident memory, MiB. */
+static double peak_rss_mb(void)
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return (double)pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+  return 0.0;
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0.0;
+#ifdef __APPLE__
+  return (double)ru.ru_maxrss / (1024.0 * 1024.0); /* bytes */
+#else
+  return (double)ru.ru_maxrss / 1024.0; /* KiB */
+#endif
+#endif
+}
+
+static void set_env(const char *name, const char *value)
+{
+#ifdef _WIN32
+  _putenv_s(name, value);
+#else
+  setenv(name, value, 1);
+#endif
+}
+
+static void set_env_int(const char *name, int v)
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", v);
+  set_env(name, buf);
+}
+
+/* A prose-like prompt of 'words' words. 'run' goes first, so consecutive runs
+   share no prefix beyond the BOS token. */
+static char *make_prompt(int run, int words)
+{
+  static const char *const w[] = {
+      "the",   "river", "carried", "light",  "through", "a",      "quiet", "city",
+      "where", "she",   "wrote",   "letters", "to",     "nobody", "and",   "every",
+      "night", "her",   "window",  "opened", "onto",    "old",    "stone", "gardens"};
+  size_t nw = sizeof(w) / sizeof(w[0]), cap = 128 + (size_t)words * 9, len = 0;
+  char *p = (char *)malloc(cap);
+  if (!p)
+    return NULL;
+  len = (size_t)snprintf(p, cap, "Run %d. Continue this story in the same voice:\n", run + 1);
+  for (int i = 0; i < words && len + 10 < cap; ++i)
+  {
+    const char *s = w[((size_t)i * 7 + (size_t)run) % nw];
+    len += (size_t)snprintf(p + len, cap - len, "%s%s", s, (i % 12 == 11) ? ". " : " ");
+  }
+  return p;
+}
+
+static int sink(void *user, const char *piece, size_t len)
+{
+  (void)user;
+  (void)piece;
+  (void)len;
+  return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted v[0..n). */
+static double pct(const double *v, int n, double q)
+{
+  if (n <= 0)
+    return 0.0;
+  int i = (int)(q * n + 0.999999) - 1;
+  return v[i < 0 ? 0 : (i >= n ? n - 1 : i)];
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/*------------------------------ in-process sweep ----------------------------*/
+
+typedef struct
+{
+  int threads, batch, ctx;
+  int ok;
+  double load_ms, prefill_tps, decode_tps, ttft_ms, total_ms, rss_mb;
+  int prompt_tokens, gen_tokens; /* gen_tokens: mean per run (EOS may stop one early) */
+} Point;
+
+/* Set the knobs ueng_llm_open reads (see llm_llama.c) for one point. */
+static void point_env(const Point *p, const LlmBenchOptions *o)
+{
+  set_env_int("UENG_LLAMA_MAX_TOKENS", o->gen_tokens); /* same decode length everywhere */
+  set_env_int("UENG_LLAMA_N_THREADS", p->threads);
+  set_env_int("UENG_LLAMA_N_BATCH", p->batch);
+  set_env_int("UENG_LLAMA_N_UBATCH", p->batch);
+  set_env("UENG_LLAMA_SESSION_DIR", ""); /* saved prefixes would skew prefill */
+}
+
+/* Time 'runs' prompts on an open context into 'p'. */
+static void point_run(ueng_llm_ctx *L, const LlmBenchOptions *o, Point *p)
+{
+  double prefill_ms = 0, decode_ms = 0, ttft = 0, total = 0;
+  long evaluated = 0, generated = 0;
+  int done = 0;
+  for (int r = 0; r < o->runs; ++r)
+  {
+    char *prompt = make_prompt(r, o->prompt_words);
+    ueng_llm_stream_stats st;
+    int rc = prompt ? ueng_llm_prompt_stream(L, prompt, sink, NULL, &st) : -1;
+    free(prompt);
+    if (rc != 0)
+      break;
+    done++;
+    prefill_ms += st.prefill_ms;
+    evaluated += st.prompt_tokens - st.cached_tokens;
+    decode_ms += st.total_ms - st.prefill_ms;
+    generated += st.tokens;
+    ttft += st.ttft_ms;
+    total += st.total_ms;
+    p->prompt_tokens = st.prompt_tokens;
+  }
+  p->ok = done == o->runs;
+  if (!p->ok)
+    return;
+  p->prefill_tps = prefill_ms > 0 ? evaluated * 1000.0 / prefill_ms : 0;
+  p->decode_tps = decode_ms > 0 ? generated * 1000.0 / decode_ms : 0;
+  p->gen_tokens = (int)(generated / done);
+  p->ttft_ms = ttft / done;
+  p->total_ms = total / done;
+}
+
+static void print_point(const Point *p, int json, int first)
+{
+  if (json)
+  {
+    printf("%s{\"threads\":%d,\"n_batch\":%d,\"ctx\":%d,\"ok\":%s", first ? "" : ",",
+           p->threads, p->batch, p->ctx, p->ok ? "true" : "false");
+    if (p->ok)
+      printf(",\"load_ms\":%.1f,\"prompt_tokens\":%d,\"gen_tokens\":%d,\"prefill_tps\":%.1f,"
+             "\"decode_tps\":%.1f,\"ttft_ms\":%.1f,\"total_ms\":%.1f,\"peak_rss_mb\":%.1f",
+             p->load_ms, p->prompt_tokens, p->gen_tokens, p->prefill_tps, p->decode_tps,
+             p->ttft_ms, p->total_ms, p->rss_mb);
+    printf("}");
+    return;
+  }
+  if (!p->ok)
+  {
+    printf("%7d %7d %6d   failed\n", p->threads, p->batch, p->ctx);
+    return;
+  }
+  printf("%7d %7d %6d %8.0f %11.1f %10.1f %6d %8.0f %9.0f %8.0f\n", p->threads, p->batch,
+         p->ctx, p->load_ms, p->prefill_tps, p->decode_tps, p->gen_tokens, p->ttft_ms,
+         p->total_ms, p->rss_mb);
+}
+
+static int write_best(const char *path, const Point *b)
+{
+  char t[16], nb[16];
+  snprintf(t, sizeof(t), "%d", b->threads);
+  snprintf(nb, sizeof(nb), "%d", b->batch);
+  const char *keys[] = {"llama.n_threads", "llama.n_batch", "llama.n_ubatch"};
+  const char *vals[] = {t, nb, nb};
+  if (ueng_config_update_file(path, keys, vals, 3) != 0)
+  {
+    fprintf(stderr, "[llm-bench] ERROR: could not update %s\n", path);
+    return 1;
+  }
+  fprintf(stderr, "[llm-bench] %s: llama.n_threads %s, llama.n_batch %s, llama.n_ubatch %s\n",
+          path, t, nb, nb);
+  return 0;
+}
+
+static int sweep(ueng_llm_ctx *first, double first_load_ms, const LlmBenchOptions *o,
+                 Point *pts, int npts)
+{
+  if (!o->json)
+  {
+    fprintf(stderr, "[llm-bench] %s: %d points x %d runs, ~%d-word prompt, %d new tokens\n",
+            o->model, npts, o->runs, o->prompt_words, o->gen_tokens);
+    printf("%7s %7s %6s %8s %11s %10s %6s %8s %9s %8s\n", "threads", "n_batch", "ctx", "load ms",
+           "prefill t/s", "decode t/s", "tokens", "TTFT ms", "total ms", "RSS MiB");
+  }
+  else
+  {
+    printf("{\"backend\":\"in-process\",\"runs\":%d,\"gen_tokens\":%d,\"points\":[", o->runs,
+           o->gen_tokens);
+  }
+  int best = -1;
+  for (int i = 0; i < npts; ++i)
+  {
+    Point *p = &pts[i];
+    ueng_llm_ctx *L = first;
+    p->load_ms = first_load_ms;
+    if (i > 0)
+    {
+      char err[256] = {0};
+      point_env(p, o);
+      double t0 = ueng_now_ms();
+      L = ueng_llm_open(o->model, p->ctx, err, sizeof(err));
+      p->load_ms = ueng_now_ms() - t0;
+      if (!L)
+        fprintf(stderr, "[llm-bench] WARN: open failed: %s\n", err[0] ? err : "(unknown)");
+    }
+    if (L)
+    {
+      point_run(L, o, p);
+      ueng_llm_close(L);
+    }
+    p->rss_mb = peak_rss_mb();
+    print_point(p, o->json, i == 0);
+    fflush(stdout);
+    if (p->ok && (best < 0 || p->total_ms < pts[best].total_ms))
+      best = i;
+  }
+  if (o->json)
+  {
+    printf("],\"best\":");
+    if (best >= 0)
+      printf("{\"threads\":%d,\"n_batch\":%d,\"ctx\":%d,\"total_ms\":%.1f}", pts[best].threads,
+             pts[best].batch, pts[best].ctx, pts[best].total_ms);
+    else
+      printf("null");
+    printf("}\n");
+  }
+  if (best < 0)
+  {
+    fprintf(stderr, "[llm-bench] ERROR: no point completed\n");
+    return 1;
+  }
+  fprintf(stderr, "[llm-bench] best: threads %d, n_batch %d (ctx %d): %.0f ms per prompt\n",
+          pts[best].threads, pts[best].batch, pts[best].ctx, pts[best].total_ms);
+  if (o->write_config)
+    return write_best(o->write_config, &pts[best]);
+  fprintf(stderr, "[llm-bench] keep it with --write-config [config/ueng.yaml]\n");
+  return 0;
+}
+
+/*------------------------------ remote --------------------------------------*/
+
+static void print_pcts(const char *label, const char *key, double *v, int n, int json)
+{
+  qsort(v, (size_t)n, sizeof(double), cmp_double);
+  if (json)
+    printf(",\"%s\":{\"p50\":%.1f,\"p90\":%.1f,\"p95\":%.1f,\"p99\":%.1f}", key, pct(v, n, 0.50),
+           pct(v, n, 0.90), pct(v, n, 0.95), pct(v, n, 0.99));
+  else
+    printf("%-22s p50 %7.0f  p90 %7.0f  p95 %7.0f  p99 %7.0f\n", label, pct(v, n, 0.50),
+           pct(v, n, 0.90), pct(v, n, 0.95), pct(v, n, 0.99));
+}
+
+static int remote(ueng_llm_ctx *L, const LlmBenchOptions *o)
+{
+  int n = o->requests;
+  double *ttft = (double *)calloc((size_t)n, sizeof(double));
+  double *lat = (double *)calloc((size_t)n, sizeof(double));
+  char **prompts = (char **)calloc((size_t)n, sizeof(char *));
+  if (!ttft || !lat || !prompts)
+  {
+    free(ttft);
+    free(lat);
+    free(prompts);
+    return 1;
+  }
+  int ok = 0, failed = 0;
+  for (int i = 0; i < n; ++i)
+    prompts[i] = make_prompt(i, o->prompt_words);
+  if (!o->json)
+    fprintf(stderr, "[llm-bench] %s: %d requests, ~%d-word prompt\n", o->model, n,
+            o->prompt_words);
+
+  double t0 = ueng_now_ms();
+  for (int i = 0; i < n; ++i)
+  {
+    ueng_llm_stream_stats st;
+    if (prompts[i] && ueng_llm_prompt_stream(L, prompts[i], sink, NULL, &st) == 0)
+    {
+      ttft[ok] = st.ttft_ms;
+      lat[ok++] = st.total_ms;
+    }
+    else
+    {
+      failed++;
+    }
+  }
+  double wall = ueng_now_ms() - t0;
+  if (o->json)
+    printf("{\"backend\":\"remote\",\"requests\":%d,\"failed\":%d,\"rps\":%.2f", n, failed,
+           wall > 0 ? ok * 1000.0 / wall : 0.0);
+  else
+    printf("sequential: %d ok, %d failed, %.2f requests/s\n", ok, failed,
+           wall > 0 ? ok * 1000.0 / wall : 0.0);
+  print_pcts("  time to first token", "ttft_ms", ttft, ok, o->json);
+  print_pcts("  total latency", "latency_ms", lat, ok, o->json);
+
+  if (o->parallel > 1)
+  {
+    ueng_llm_batch_item *items = (ueng_llm_batch_item *)calloc((size_t)n, sizeof(*items));
+    if (items)
+    {
+      for (int i = 0; i < n; ++i)
+        items[i].prompt = prompts[i];
+      t0 = ueng_now_ms();
+      int bf = ueng_llm_prompt_batch(L, items, (size_t)n, o->parallel);
+      wall = ueng_now_ms() - t0;
+      int bok = 0;
+      for (int i = 0; i < n; ++i)
+      {
+        if (items[i].status == 0)
+          lat[bok++] = items[i].latency_ms;
+        free(items[i].text);
+      }
+      if (o->json)
+        printf(",\"batch\":{\"parallel\":%d,\"failed\":%d,\"rps\":%.2f", o->parallel, bf,
+               wall > 0 ? bok * 1000.0 / wall : 0.0);
+      else
+        printf("batch of %d, %d at a time: %d failed, %.2f requests/s\n", n, o->parallel, bf,
+               wall > 0 ? bok * 1000.0 / wall : 0.0);
+      print_pcts("  total latency", "latency_ms", lat, bok, o->json);
+      if (o->json)
+        printf("}");
+      free(items);
+    }
+  }
+  ueng_llm_conn_stats cs;
+  if (ueng_llm_get_conn_stats(L, &cs) == 0)
+  {
+    if (o->json)
+      printf(",\"connections\":{\"requests\":%ld,\"opened\":%ld,\"reused\":%ld,"
+             "\"connect_ms\":%.1f}",
+             cs.requests, cs.connects, cs.reused, cs.connect_ms);
+    else
+      printf("connections: %ld opened (%.0f ms), %ld reused for %ld requests\n", cs.connects,
+             cs.connect_ms, cs.reused, cs.requests);
+  }
+  if (o->json)
+    printf("}\n");
+  for (int i = 0; i < n; ++i)
+    free(prompts[i]);
+  free(prompts);
+  free(ttft);
+  free(lat);
+  return ok > 0 ? 0 : 1;
+}
+
+/*------------------------------ entry ---------------------------------------*/
+
+int llm_bench_run(const LlmBenchOptions *opts)
+{
+  if (!opts || !opts->model || !*opts->model)
+    return 2;
+  LlmBenchOptions o = *opts;
+  if (o.n_threads == 0)
+  {
+    int cpus = ueng_cpu_count();
+    o.threads[o.n_threads++] = cpus > 1 ? cpus / 2 : 1;
+    if (cpus > 1)
+      o.threads[o.n_threads++] = cpus;
+  }
+  if (o.n_batch == 0)
+  {
+    o.batch[o.n_batch++] = 128;
+    o.batch[o.n_batch++] = 512;
+  }
+  if (o.n_ctx == 0)
+    o.ctx[o.n_ctx++] = 4096;
+  if (o.prompt_words <= 0)
+    o.prompt_words = 400;
+  if (o.runs <= 0)
+    o.runs = 2;
+  if (o.gen_tokens <= 0)
+    o.gen_tokens = 256;
+  if (o.requests <= 0)
+    o.requests = 20;
+  /* Smallest context first: the RSS column is a high-water mark. */
+  qsort(o.ctx, (size_t)o.n_ctx, sizeof(int), cmp_int);
+
+  Point pts[LLM_BENCH_MAX_SWEEP * LLM_BENCH_MAX_SWEEP * LLM_BENCH_MAX_SWEEP];
+  int npts = 0;
+  for (int c = 0; c < o.n_ctx; ++c)
+    for (int b = 0; b < o.n_batch; ++b)
+      for (int t = 0; t < o.n_threads; ++t)
+      {
+        Point *p = &pts[npts++];
+        memset(p, 0, sizeof(*p));
+        p->threads = o.threads[t];
+        p->batch = o.batch[b];
+        p->ctx = o.ctx[c];
+      }
+
+  /* The first point's context also tells which kind of backend this is. */
+  char err[256] = {0};
+  point_env(&pts[0], &o);
+  double t0 = ueng_now_ms();
+  ueng_llm_ctx *L = ueng_llm_open(o.model, pts[0].ctx, err, sizeof(err));
+  double load_ms = ueng_now_ms() - t0;
+  if (!L)
+  {
+    fprintf(stderr, "[llm-bench] ERROR: open failed: %s\n", err[0] ? err : "(unknown)");
+    return 3;
+  }
+  ueng_llm_conn_stats cs;
+  if (ueng_llm_get_conn_stats(L, &cs) == 0)
+  {
+    int rc = remote(L, &o);
+    ueng_llm_close(L);
+    return rc;
+  }
+  return sweep(L, load_ms, &o, pts, npts);
+}
+
+/*------------------------------ End of file --------------------------------*/
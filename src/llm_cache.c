@@ -0,0 +1,1101 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/llm_cache.c
+ * Purpose: Content-addressed on-disk cache of LLM completions
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* fseeko/ftello, fileno */
+#endif
+#endif
+#include "ueng/llm_cache.h"
+#include "ueng/common.h"
+#include "ueng/hash.h"
+#include "ueng/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <io.h> /* _write, _get_osfhandle */
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>  /* fcntl record locks */
+#include <unistd.h> /* write */
+#endif
+
+#define LOG_NAME "llm-cache.log"
+#define IDX_NAME "llm-cache.idx"
+#define LOCK_NAME "llm-cache.lock" /* u64 log generation; locked while writing */
+#define REC_MAGIC "ULC1"
+#define REC_HDR 48 /* magic 4, length 4, time 8, key 32 */
+#define IDX_MAGIC "ULCIDX\0\0"
+#define IDX_VERSION 1
+#define IDX_HDR 64 /* magic 8, version 4, 0, log size 8, slots 8, entries 8, time 8 */
+#define SLOT_BYTES 32 /* key prefix 16, log offset + 1 (0: empty) 8, time 8 */
+#define OVERLAY_FLUSH 4096 /* rewrite the index after this many new entries */
+
+typedef struct
+{
+  unsigned char key[16];
+  uint64_t off1; /* log offset + 1; 0 marks an empty slot */
+  int64_t t;
+} Entry;
+
+typedef struct Inflight
+{
+  unsigned char key[32];
+  int done, status;
+  char *text;
+  size_t len;
+  int refs;
+  struct Inflight *next;
+} Inflight;
+
+struct ueng_llm_cache
+{
+  char log_path[PATH_MAX], idx_path[PATH_MAX], lock_path[PATH_MAX];
+  long long ttl_s;
+  uint64_t max_bytes;
+  ueng_mutex_t mu;
+  ueng_cond_t cv;
+  FILE *log;         /* "a+b": appends at the end, reads anywhere */
+  FILE *lock;        /* llm-cache.lock, NULL if it cannot be opened */
+  uint64_t gen;      /* generation of the log we have open */
+  uint64_t log_size; /* scanned (indexed) up to here */
+  int torn;          /* a partial record ends the log */
+  UengMap map;       /* llm-cache.idx */
+  uint64_t map_slots, map_entries;
+  Entry *ov; /* appended since the index was written */
+  size_t ov_cap, ov_n;
+  Inflight *inflight;
+  ueng_llm_cache_stats st;
+};
+
+/*------------------------------ encoding ------------------------------------*/
+
+static uint64_t rd(const unsigned char *p, int bytes)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i)
+    v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+static void wr(unsigned char *p, uint64_t v, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+    p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static int log_seek(FILE *f, uint64_t off)
+{
+#ifdef _WIN32
+  return _fseeki64(f, (long long)off, SEEK_SET);
+#else
+  return fseeko(f, (off_t)off, SEEK_SET);
+#endif
+}
+
+static uint64_t log_end(FILE *f)
+{
+  if (!f)
+    return 0;
+#ifdef _WIN32
+  if (_fseeki64(f, 0, SEEK_END) != 0)
+    return 0;
+  long long n = _ftelli64(f);
+#else
+  if (fseeko(f, 0, SEEK_END) != 0)
+    return 0;
+  long long n = (long long)ftello(f);
+#endif
+  return n > 0 ? (uint64_t)n : 0;
+}
+
+/* Append a whole record with unbuffered writes to the O_APPEND descriptor
+   behind c->log; the FILE buffer is only ever used for reading, and every
+   read seeks first. */
+static int log_append(FILE *f, const unsigned char *p, size_t n)
+{
+  while (n > 0)
+  {
+#ifdef _WIN32
+    int w = _write(_fileno(f), p, n > 0x40000000u ? 0x40000000u : (unsigned)n);
+#else
+    ssize_t w = write(fileno(f), p, n);
+#endif
+    if (w <= 0)
+      return -1;
+    p += w;
+    n -= (size_t)w;
+  }
+  return 0;
+}
+
+/* Inter-process lock on llm-cache.lock, held around every change to the log
+   and the index (appends, index rewrites, compaction). Readers do not take
+   it: records are immutable once written and the log is only ever replaced
+   whole. Within a process c->mu already serializes, so a record lock (owned
+   by the process) is enough. */
+static void cache_lock(ueng_llm_cache *c, int on)
+{
+  if (!c->lock)
+    return;
+#ifdef _WIN32
+  HANDLE h = (HANDLE)_get_osfhandle(_fileno(c->lock));
+  OVERLAPPED ov;
+  memset(&ov, 0, sizeof(ov));
+  if (on)
+    LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+  else
+    UnlockFileEx(h, 0, 1, 0, &ov);
+#else
+  struct flock fl;
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = on ? F_WRLCK : F_UNLCK;
+  fl.l_whence = SEEK_SET;
+  while (fcntl(fileno(c->lock), F_SETLKW, &fl) != 0 && errno == EINTR)
+    ;
+#endif
+}
+
+/* The log generation: compaction bumps it when it replaces the log. */
+static uint64_t lock_gen(ueng_llm_cache *c)
+{
+  unsigned char b[8];
+  if (!c->lock || fseek(c->lock, 0, SEEK_SET) != 0 || fread(b, 1, 8, c->lock) != 8)
+    return 0;
+  return rd(b, 8);
+}
+
+static void set_lock_gen(ueng_llm_cache *c, uint64_t gen)
+{
+  unsigned char b[8];
+  wr(b, gen, 8);
+  if (c->lock && fseek(c->lock, 0, SEEK_SET) == 0 && fwrite(b, 1, 8, c->lock) == 8)
+    fflush(c->lock);
+}
+
+static void make_key(const char *identity, const ueng_llm_sampling *s, const char *prompt,
+                     unsigned char key[32])
+{
+  static const char tag[] = "uaengine-llm-cache-v1\n";
+  UengSha256 h;
+  ueng_sha256_init(&h);
+  ueng_sha256_update(&h, tag, sizeof(tag) - 1);
+  ueng_sha256_update(&h, identity, strlen(identity));
+  if (s) /* per-item overrides are part of the identity */
+  {
+    char extra[160];
+    int n = snprintf(extra, sizeof(extra), "|sampling=%.9g,%d,%.9g,%d,%u", (double)s->temperature,
+                     s->top_k, (double)s->top_p, s->max_tokens, s->seed);
+    ueng_sha256_update(&h, extra, (size_t)n);
+  }
+  ueng_sha256_update(&h, "\n", 1);
+  ueng_sha256_update(&h, prompt, strlen(prompt));
+  ueng_sha256_final(&h, key);
+}
+
+static int expired(const ueng_llm_cache *c, int64_t t, int64_t now)
+{
+  return c->ttl_s > 0 && now - t > c->ttl_s;
+}
+
+/*------------------------------ hash tables ---------------------------------*/
+
+/* Insert or replace by key. */
+static int tab_put(Entry **tab, size_t *cap, size_t *n, const Entry *e)
+{
+  if ((*n + 1) * 10 > *cap * 7)
+  {
+    size_t ncap = *cap ? *cap * 2 : 64;
+    Entry *nt = (Entry *)calloc(ncap, sizeof(Entry));
+    if (!nt)
+      return -1;
+    for (size_t i = 0; i < *cap; ++i)
+    {
+      if (!(*tab)[i].off1)
+        continue;
+      size_t j = (size_t)rd((*tab)[i].key, 8) & (ncap - 1);
+      while (nt[j].off1)
+        j = (j + 1) & (ncap - 1);
+      nt[j] = (*tab)[i];
+    }
+    free(*tab);
+    *tab = nt;
+    *cap = ncap;
+  }
+  size_t j = (size_t)rd(e->key, 8) & (*cap - 1);
+  while ((*tab)[j].off1 && memcmp((*tab)[j].key, e->key, 16) != 0)
+    j = (j + 1) & (*cap - 1);
+  if (!(*tab)[j].off1)
+    (*n)++;
+  (*tab)[j] = *e;
+  return 0;
+}
+
+static const Entry *tab_get(const Entry *tab, size_t cap, const unsigned char *key)
+{
+  if (!cap)
+    return NULL;
+  size_t j = (size_t)rd(key, 8) & (cap - 1);
+  while (tab[j].off1)
+  {
+    if (memcmp(tab[j].key, key, 16) == 0)
+      return &tab[j];
+    j = (j + 1) & (cap - 1);
+  }
+  return NULL;
+}
+
+static int map_get(const ueng_llm_cache *c, const unsigned char *key, Entry *out)
+{
+  if (!c->map_slots)
+    return 0;
+  const unsigned char *slots = c->map.data + IDX_HDR;
+  size_t j = (size_t)rd(key, 8) & (c->map_slots - 1);
+  for (uint64_t probes = 0; probes < c->map_slots; ++probes)
+  {
+    const unsigned char *s = slots + j * SLOT_BYTES;
+    uint64_t off1 = rd(s + 16, 8);
+    if (!off1)
+      return 0;
+    if (memcmp(s, key, 16) == 0)
+    {
+      memcpy(out->key, s, 16);
+      out->off1 = off1;
+      out->t = (int64_t)rd(s + 24, 8);
+      return 1;
+    }
+    j = (j + 1) & (c->map_slots - 1);
+  }
+  return 0;
+}
+
+/*------------------------------ log -----------------------------------------*/
+
+/* Read the record at 'off'. With 'key' set it must match all 32 bytes;
+   'key_out' (optional) receives the record's key. */
+static int read_rec(ueng_llm_cache *c, uint64_t off, const unsigned char *key,
+                    unsigned char *key_out, char **text, size_t *len)
+{
+  unsigned char h[REC_HDR];
+  if (!c->log || log_seek(c->log, off) != 0 || fread(h, 1, REC_HDR, c->log) != REC_HDR ||
+      memcmp(h, REC_MAGIC, 4) != 0 || (key && memcmp(h + 16, key, 32) != 0))
+    return -1;
+  size_t n = (size_t)rd(h + 4, 4);
+  char *p = (char *)malloc(n + 1);
+  if (!p)
+    return -1;
+  if (fread(p, 1, n, c->log) != n)
+  {
+    free(p);
+    return -1;
+  }
+  p[n] = '\0';
+  if (key_out)
+    memcpy(key_out, h + 16, 32);
+  *text = p;
+  *len = n;
+  return 0;
+}
+
+/* Index the records from c->log_size to the end of the log. */
+static void scan_log(ueng_llm_cache *c)
+{
+  uint64_t end = log_end(c->log);
+  uint64_t pos = c->log_size;
+  unsigned char h[REC_HDR];
+  while (pos < end)
+  {
+    if (end - pos < REC_HDR || log_seek(c->log, pos) != 0 ||
+        fread(h, 1, REC_HDR, c->log) != REC_HDR || memcmp(h, REC_MAGIC, 4) != 0 ||
+        end - pos - REC_HDR < rd(h + 4, 4))
+    {
+      c->torn = 1;
+      break;
+    }
+    Entry e;
+    memcpy(e.key, h + 16, 16);
+    e.off1 = pos + 1;
+    e.t = (int64_t)rd(h + 8, 8);
+    if (tab_put(&c->ov, &c->ov_cap, &c->ov_n, &e) != 0)
+      break;
+    pos += REC_HDR + rd(h + 4, 4);
+  }
+  c->log_size = pos;
+}
+
+/*------------------------------ index ---------------------------------------*/
+
+static void map_index(ueng_llm_cache *c)
+{
+  ueng_unmap_file(&c->map);
+  c->map_slots = c->map_entries = 0;
+  if (ueng_map_file(c->idx_path, &c->map) != 0)
+    return;
+  const unsigned char *d = c->map.data;
+  uint64_t slots = c->map.len >= IDX_HDR ? rd(d + 24, 8) : 0;
+  if (c->map.len < IDX_HDR || memcmp(d, IDX_MAGIC, 8) != 0 || rd(d + 8, 4) != IDX_VERSION ||
+      slots == 0 || (slots & (slots - 1)) != 0 || c->map.len != IDX_HDR + slots * SLOT_BYTES)
+  {
+    ueng_unmap_file(&c->map); /* unusable: rebuilt from the log */
+    return;
+  }
+  c->map_slots = slots;
+  c->map_entries = rd(d + 32, 8);
+}
+
+/* Trust the index up to the log size it recorded; index the rest. */
+static void attach_log(ueng_llm_cache *c)
+{
+  free(c->ov);
+  c->ov = NULL;
+  c->ov_cap = c->ov_n = 0;
+  c->torn = 0;
+  map_index(c);
+  uint64_t end = log_end(c->log);
+  c->log_size = c->map_slots ? rd(c->map.data + 16, 8) : 0;
+  if (c->log_size > end)
+  {
+    ueng_unmap_file(&c->map); /* the log was replaced or truncated */
+    c->map_slots = c->map_entries = 0;
+    c->log_size = 0;
+  }
+  scan_log(c);
+}
+
+/* Caller holds the lock. Catch up with what other processes wrote: reopen
+   the log if one of them compacted it, else index their appends. */
+static int sync_log(ueng_llm_cache *c)
+{
+  uint64_t gen = lock_gen(c);
+  if (gen == c->gen && c->log)
+  {
+    scan_log(c);
+    return 0;
+  }
+  if (c->log)
+    fclose(c->log);
+  c->log = ueng_fopen(c->log_path, "a+b");
+  if (!c->log)
+    return -1;
+  c->gen = gen;
+  attach_log(c);
+  return 0;
+}
+
+/* Every live entry (index, then newer overlay), expired ones left out. */
+static int collect_live(ueng_llm_cache *c, int64_t now, Entry **tab, size_t *cap, size_t *n,
+                        uint64_t *n_expired)
+{
+  *tab = NULL;
+  *cap = *n = 0;
+  for (uint64_t i = 0; i < c->map_slots; ++i)
+  {
+    const unsigned char *s = c->map.data + IDX_HDR + i * SLOT_BYTES;
+    Entry e;
+    e.off1 = rd(s + 16, 8);
+    if (!e.off1)
+      continue;
+    memcpy(e.key, s, 16);
+    e.t = (int64_t)rd(s + 24, 8);
+    if (expired(c, e.t, now))
+      (*n_expired)++;
+    else if (tab_put(tab, cap, n, &e) != 0)
+      return -1;
+  }
+  for (size_t i = 0; i < c->ov_cap; ++i)
+  {
+    const Entry *e = &c->ov[i];
+    if (!e->off1)
+      continue;
+    if (expired(c, e->t, now))
+      (*n_expired)++;
+    else if (tab_put(tab, cap, n, e) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+/* Rewrite llm-cache.idx from the index plus the overlay, then map it. */
+static int write_index(ueng_llm_cache *c)
+{
+  double t0 = ueng_trace_begin();
+  int64_t now = (int64_t)time(NULL);
+  Entry *tab;
+  size_t cap, n;
+  uint64_t dropped = 0;
+  if (collect_live(c, now, &tab, &cap, &n, &dropped) != 0)
+  {
+    free(tab);
+    return -1;
+  }
+  uint64_t slots = 64;
+  while (slots < (uint64_t)n * 2)
+    slots *= 2;
+  size_t bytes = IDX_HDR + (size_t)slots * SLOT_BYTES;
+  unsigned char *buf = (unsigned char *)calloc(1, bytes);
+  if (!buf)
+  {
+    free(tab);
+    return -1;
+  }
+  memcpy(buf, IDX_MAGIC, 8);
+  wr(buf + 8, IDX_VERSION, 4);
+  wr(buf + 16, c->log_size, 8);
+  wr(buf + 24, slots, 8);
+  wr(buf + 32, n, 8);
+  wr(buf + 40, (uint64_t)now, 8);
+  for (size_t i = 0; i < cap; ++i)
+  {
+    if (!tab[i].off1)
+      continue;
+    size_t j = (size_t)rd(tab[i].key, 8) & (slots - 1);
+    while (rd(buf + IDX_HDR + j * SLOT_BYTES + 16, 8))
+      j = (j + 1) & (slots - 1);
+    unsigned char *s = buf + IDX_HDR + j * SLOT_BYTES;
+    memcpy(s, tab[i].key, 16);
+    wr(s + 16, tab[i].off1, 8);
+    wr(s + 24, (uint64_t)tab[i].t, 8);
+  }
+  free(tab);
+
+  char tmp[PATH_MAX + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", c->idx_path);
+  FILE *f = ueng_fopen(tmp, "wb");
+  int rc = -1;
+  if (f)
+  {
+    rc = fwrite(buf, 1, bytes, f) == bytes ? 0 : -1;
+    if (fclose(f) != 0)
+      rc = -1;
+    ueng_unmap_file(&c->map); /* Windows cannot replace a mapped file */
+    if (rc == 0 && replace_file(tmp, c->idx_path) != 0)
+      rc = -1;
+    if (rc != 0)
+      remove(tmp);
+  }
+  free(buf);
+  map_index(c);
+  if (rc == 0)
+  {
+    free(c->ov);
+    c->ov = NULL;
+    c->ov_cap = c->ov_n = 0;
+  }
+  ueng_trace_end("llm", "cache_index", t0);
+  return rc;
+}
+
+static int cmp_newest(const void *A, const void *B)
+{
+  const Entry *a = (const Entry *)A, *b = (const Entry *)B;
+  if (a->t != b->t)
+    return (a->t < b->t) - (a->t > b->t);
+  return (a->off1 < b->off1) - (a->off1 > b->off1); /* same second: later append first */
+}
+
+/* Rewrite the log with the newest live entries that fit in 3/4 of
+   max_bytes (all of them without a limit), dropping expired, superseded and
+   torn records, then index it. Caller holds the lock, so no other process
+   appends meanwhile; the generation bump sends them to the new log. */
+static int compact(ueng_llm_cache *c)
+{
+  double t0 = ueng_trace_begin();
+  int64_t now = (int64_t)time(NULL);
+  Entry *tab;
+  size_t cap, n;
+  uint64_t dropped = 0;
+  if (collect_live(c, now, &tab, &cap, &n, &dropped) != 0)
+  {
+    free(tab);
+    return -1;
+  }
+  size_t k = 0;
+  for (size_t i = 0; i < cap; ++i)
+    if (tab[i].off1)
+      tab[k++] = tab[i];
+  qsort(tab, k, sizeof(Entry), cmp_newest);
+
+  char tmp[PATH_MAX + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", c->log_path);
+  FILE *out = ueng_fopen(tmp, "wb");
+  if (!out)
+  {
+    free(tab);
+    return -1;
+  }
+  uint64_t budget = c->max_bytes ? c->max_bytes / 4 * 3 : UINT64_MAX, pos = 0;
+  size_t kept = 0;
+  int rc = 0;
+  for (size_t i = 0; i < k && rc == 0; ++i)
+  {
+    unsigned char key[32];
+    char *text = NULL;
+    size_t len = 0;
+    if (read_rec(c, tab[i].off1 - 1, NULL, key, &text, &len) != 0 ||
+        memcmp(key, tab[i].key, 16) != 0)
+    {
+      free(text);
+      dropped++;
+      continue;
+    }
+    if (pos + REC_HDR + len > budget)
+    {
+      free(text);
+      dropped++;
+      continue;
+    }
+    unsigned char h[REC_HDR];
+    memcpy(h, REC_MAGIC, 4);
+    wr(h + 4, len, 4);
+    wr(h + 8, (uint64_t)tab[i].t, 8);
+    memcpy(h + 16, key, 32);
+    if (fwrite(h, 1, REC_HDR, out) != REC_HDR || fwrite(text, 1, len, out) != len)
+      rc = -1;
+    free(text);
+    tab[kept] = tab[i];
+    tab[kept].off1 = pos + 1;
+    kept++;
+    pos += REC_HDR + len;
+  }
+  if (fclose(out) != 0)
+    rc = -1;
+  if (rc == 0)
+  {
+    /* Windows cannot replace a file that is open or mapped; there, another
+       process still using the log makes this fail and the log stays. */
+    fclose(c->log);
+    c->log = NULL;
+    ueng_unmap_file(&c->map);
+    rc = replace_file(tmp, c->log_path);
+    c->log = ueng_fopen(c->log_path, "a+b");
+    if (rc != 0)
+      map_index(c);
+  }
+  if (rc != 0)
+  {
+    remove(tmp);
+    free(tab);
+    return -1;
+  }
+  if (!c->log)
+  {
+    free(tab);
+    return -1;
+  }
+  set_lock_gen(c, ++c->gen);
+
+  /* The old index points into the old log: start over from 'tab'. */
+  free(c->ov);
+  c->ov = NULL;
+  c->ov_cap = c->ov_n = 0;
+  c->map_slots = c->map_entries = 0;
+  for (size_t i = 0; i < kept; ++i)
+    tab_put(&c->ov, &c->ov_cap, &c->ov_n, &tab[i]);
+  free(tab);
+  c->log_size = pos;
+  c->torn = 0;
+  c->st.evicted += dropped;
+  write_index(c);
+  ueng_trace_end("llm", "cache_compact", t0);
+  return 0;
+}
+
+/*------------------------------ lookup / store ------------------------------*/
+
+/* Caller holds c->mu. 1 on a hit with *text (malloc'd) and *len. */
+static int lookup(ueng_llm_cache *c, const unsigned char key[32], char **text, size_t *len)
+{
+  int64_t now = (int64_t)time(NULL);
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    Entry e;
+    const Entry *o = tab_get(c->ov, c->ov_cap, key);
+    int found = 1;
+    if (o)
+      e = *o;
+    else
+      found = map_get(c, key, &e);
+    if (found)
+    {
+      if (expired(c, e.t, now))
+        return 0;
+      return read_rec(c, e.off1 - 1, key, NULL, text, len) == 0;
+    }
+    if (pass != 0)
+      break;
+    /* Another process may have answered it (or compacted the log). */
+    if (lock_gen(c) == c->gen)
+      scan_log(c);
+    else
+    {
+      cache_lock(c, 1);
+      int rc = sync_log(c);
+      cache_lock(c, 0);
+      if (rc != 0)
+        return 0;
+    }
+  }
+  return 0;
+}
+
+/* Caller holds c->mu. */
+static int store(ueng_llm_cache *c, const unsigned char key[32], const char *text, size_t len)
+{
+  if (len > 0xFFFFFFFFu)
+    return -1;
+  unsigned char *rec = (unsigned char *)malloc(REC_HDR + len);
+  if (!rec)
+    return -1;
+  int64_t now = (int64_t)time(NULL);
+  memcpy(rec, REC_MAGIC, 4);
+  wr(rec + 4, len, 4);
+  wr(rec + 8, (uint64_t)now, 8);
+  memcpy(rec + 16, key, 32);
+  memcpy(rec + REC_HDR, text, len);
+  cache_lock(c, 1);
+  int rc = sync_log(c);
+  uint64_t off = rc == 0 ? log_end(c->log) : 0;
+  if (rc == 0)
+    rc = log_append(c->log, rec, REC_HDR + len);
+  free(rec);
+  if (rc != 0)
+  {
+    cache_lock(c, 0);
+    return -1;
+  }
+  Entry e;
+  memcpy(e.key, key, 16);
+  e.off1 = off + 1;
+  e.t = now;
+  tab_put(&c->ov, &c->ov_cap, &c->ov_n, &e);
+  if (off == c->log_size)
+    c->log_size = off + REC_HDR + len; /* else scan_log picks up the gap later */
+  c->st.stores++;
+  if (c->max_bytes && off + REC_HDR + len > c->max_bytes)
+    compact(c);
+  else if (c->ov_n >= OVERLAY_FLUSH)
+    write_index(c);
+  cache_lock(c, 0);
+  return 0;
+}
+
+/*------------------------------ open / close --------------------------------*/
+
+ueng_llm_cache *ueng_llm_cache_open(const ueng_llm_cache_opts *o, char *err, size_t errsz)
+{
+  if (!o || !o->dir || !*o->dir)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "no cache directory");
+    return NULL;
+  }
+  if (mkpath(o->dir) != 0)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "cannot create %s", o->dir);
+    return NULL;
+  }
+  ueng_llm_cache *c = (ueng_llm_cache *)calloc(1, sizeof(*c));
+  if (!c)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "out of memory");
+    return NULL;
+  }
+  snprintf(c->log_path, sizeof(c->log_path), "%s%c%s", o->dir, PATH_SEP, LOG_NAME);
+  snprintf(c->idx_path, sizeof(c->idx_path), "%s%c%s", o->dir, PATH_SEP, IDX_NAME);
+  snprintf(c->lock_path, sizeof(c->lock_path), "%s%c%s", o->dir, PATH_SEP, LOCK_NAME);
+  c->ttl_s = o->ttl_s;
+  c->max_bytes = o->max_bytes;
+  c->log = ueng_fopen(c->log_path, "a+b");
+  if (!c->log)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "cannot open %s", c->log_path);
+    free(c);
+    return NULL;
+  }
+  c->lock = ueng_fopen(c->lock_path, "r+b");
+  if (!c->lock)
+    c->lock = ueng_fopen(c->lock_path, "w+b");
+  if (!c->lock)
+    fprintf(stderr, "[llm-cache] WARN: cannot open %s; do not share %s between processes\n",
+            c->lock_path, o->dir);
+  ueng_mutex_init(&c->mu);
+  ueng_cond_init(&c->cv);
+
+  cache_lock(c, 1);
+  c->gen = lock_gen(c);
+  attach_log(c);
+  if (c->torn || (c->max_bytes && log_end(c->log) > c->max_bytes))
+    compact(c);
+  cache_lock(c, 0);
+  if (err && errsz)
+    err[0] = '\0';
+  return c;
+}
+
+ueng_llm_cache *ueng_llm_cache_open_env(void)
+{
+  const char *dir = getenv("UENG_LLM_CACHE");
+  if (!dir || !*dir || strcmp(dir, "0") == 0)
+    return NULL;
+  const char *ttl = getenv("UENG_LLM_CACHE_TTL");
+  const char *mb = getenv("UENG_LLM_CACHE_MAX_MB");
+  ueng_llm_cache_opts o;
+  o.dir = dir;
+  o.ttl_s = ttl ? atoll(ttl) : 0;
+  o.max_bytes = mb ? (uint64_t)atoll(mb) * 1024u * 1024u : 0;
+  char err[256];
+  ueng_llm_cache *c = ueng_llm_cache_open(&o, err, sizeof(err));
+  if (!c)
+    fprintf(stderr, "[llm-cache] WARN: %s; continuing without the cache\n", err);
+  return c;
+}
+
+void ueng_llm_cache_close(ueng_llm_cache *c)
+{
+  if (!c)
+    return;
+  if (c->ov_n > 0)
+  {
+    /* Only while our offsets still describe the current log. */
+    cache_lock(c, 1);
+    if (lock_gen(c) == c->gen)
+    {
+      scan_log(c);
+      write_index(c);
+    }
+    cache_lock(c, 0);
+  }
+  ueng_unmap_file(&c->map);
+  if (c->log)
+    fclose(c->log);
+  if (c->lock)
+    fclose(c->lock);
+  free(c->ov);
+  ueng_cond_destroy(&c->cv);
+  ueng_mutex_destroy(&c->mu);
+  free(c);
+}
+
+void ueng_llm_cache_get_stats(ueng_llm_cache *c, ueng_llm_cache_stats *out)
+{
+  if (!out)
+    return;
+  memset(out, 0, sizeof(*out));
+  if (!c)
+    return;
+  ueng_mutex_lock(&c->mu);
+  *out = c->st;
+  out->entries = c->map_entries + c->ov_n;
+  out->log_bytes = log_end(c->log);
+  ueng_mutex_unlock(&c->mu);
+}
+
+/*------------------------------ cached calls --------------------------------*/
+
+typedef struct
+{
+  char *p;
+  size_t n, cap;
+  ueng_llm_piece_fn fn; /* forwarded to, when set */
+  void *user;
+} Tee;
+
+static int tee_piece(void *user, const char *piece, size_t len)
+{
+  Tee *t = (Tee *)user;
+  if (t->n + len + 1 > t->cap)
+  {
+    size_t cap = t->cap ? t->cap * 2 : 1024;
+    while (t->n + len + 1 > cap)
+      cap *= 2;
+    char *p = (char *)realloc(t->p, cap);
+    if (!p)
+      return 1;
+    t->p = p;
+    t->cap = cap;
+  }
+  memcpy(t->p + t->n, piece, len);
+  t->n += len;
+  t->p[t->n] = '\0';
+  return t->fn ? t->fn(t->user, piece, len) : 0;
+}
+
+static void inflight_release(ueng_llm_cache *c, Inflight *f)
+{
+  if (--f->refs == 0)
+  {
+    free(f->text);
+    free(f);
+  }
+  (void)c;
+}
+
+int ueng_llm_cache_prompt_stream(ueng_llm_cache *c, ueng_llm_ctx *ctx, const char *prompt,
+                                 ueng_llm_piece_fn fn, void *user, ueng_llm_stream_stats *stats)
+{
+  char ident[1024];
+  if (!c || !prompt || !fn || ueng_llm_identity(ctx, ident, sizeof(ident)) != 0)
+    return ueng_llm_prompt_stream(ctx, prompt, fn, user, stats);
+  unsigned char key[32];
+  make_key(ident, NULL, prompt, key);
+  double t_start = ueng_now_ms();
+
+  for (;;)
+  {
+    char *text = NULL;
+    size_t len = 0;
+    ueng_mutex_lock(&c->mu);
+    int hit = lookup(c, key, &text, &len);
+    Inflight *f = NULL;
+    if (hit)
+      c->st.hits++;
+    else
+    {
+      for (f = c->inflight; f && memcmp(f->key, key, 32) != 0; f = f->next)
+        ;
+      if (f)
+      {
+        /* Same request already on its way: wait for that answer. */
+        f->refs++;
+        while (!f->done)
+          ueng_cond_wait(&c->cv, &c->mu);
+        if (f->status == 0)
+        {
+          text = (char *)malloc(f->len + 1);
+          if (text)
+          {
+            memcpy(text, f->text, f->len + 1);
+            len = f->len;
+            hit = 1;
+            c->st.coalesced++;
+          }
+        }
+        inflight_release(c, f);
+        if (!hit)
+        {
+          ueng_mutex_unlock(&c->mu);
+          continue; /* it failed or was cancelled: try again ourselves */
+        }
+      }
+    }
+    if (hit)
+    {
+      ueng_mutex_unlock(&c->mu);
+      int rc = (len && fn(user, text, len) != 0) ? UENG_LLM_CANCELLED : 0;
+      free(text);
+      if (stats)
+      {
+        memset(stats, 0, sizeof(*stats));
+        stats->total_ms = ueng_now_ms() - t_start;
+        stats->ttft_ms = len ? stats->total_ms : 0.0;
+        stats->pieces = len ? 1 : 0;
+      }
+      return rc;
+    }
+
+    /* Miss: this caller asks the backend; identical callers wait on 'f'. */
+    c->st.misses++;
+    f = (Inflight *)calloc(1, sizeof(*f));
+    if (f)
+    {
+      memcpy(f->key, key, 32);
+      f->refs = 1;
+      f->next = c->inflight;
+      c->inflight = f;
+    }
+    ueng_mutex_unlock(&c->mu);
+
+    Tee t = {NULL, 0, 0, fn, user};
+    ueng_llm_stream_stats st;
+    int rc = ueng_llm_prompt_stream(ctx, prompt, tee_piece, &t, &st);
+    if (stats)
+      *stats = st;
+
+    ueng_mutex_lock(&c->mu);
+    /* Another provider's reply is served but not filed under this identity. */
+    if (rc == 0 && !st.fallback)
+      store(c, key, t.p ? t.p : "", t.n);
+    if (f)
+    {
+      Inflight **pp = &c->inflight;
+      while (*pp != f)
+        pp = &(*pp)->next;
+      *pp = f->next;
+      f->done = 1;
+      f->status = rc;
+      if (rc == 0)
+      {
+        f->text = t.p;
+        f->len = t.n;
+        t.p = NULL;
+        if (!f->text)
+          f->text = (char *)calloc(1, 1);
+      }
+      inflight_release(c, f);
+      ueng_cond_broadcast(&c->cv);
+    }
+    ueng_mutex_unlock(&c->mu);
+    free(t.p);
+    return rc;
+  }
+}
+
+int ueng_llm_cache_prompt(ueng_llm_cache *c, ueng_llm_ctx *ctx, const char *prompt, char *out,
+                          size_t outsz)
+{
+  if (!c)
+    return ueng_llm_prompt(ctx, prompt, out, outsz);
+  if (!out || outsz == 0)
+    return -1;
+  out[0] = '\0';
+  /* Collect the whole reply so a short 'out' does not cancel (and so skip
+     storing) the completion. */
+  Tee t = {NULL, 0, 0, NULL, NULL};
+  int rc = ueng_llm_cache_prompt_stream(c, ctx, prompt, tee_piece, &t, NULL);
+  if (t.p)
+  {
+    size_t n = t.n;
+    if (n >= outsz)
+    {
+      n = outsz - 1;
+      while (n > 0 && ((unsigned char)t.p[n] & 0xC0) == 0x80)
+        n--;
+    }
+    memcpy(out, t.p, n);
+    out[n] = '\0';
+  }
+  free(t.p);
+  return rc;
+}
+
+int ueng_llm_cache_prompt_batch(ueng_llm_cache *c, ueng_llm_ctx *ctx, ueng_llm_batch_item *items,
+                                size_t n, int max_parallel)
+{
+  char ident[1024];
+  if (!c || ueng_llm_identity(ctx, ident, sizeof(ident)) != 0)
+    return ueng_llm_prompt_batch(ctx, items, n, max_parallel);
+  if (!items && n)
+    return -1;
+  unsigned char(*keys)[32] = (unsigned char(*)[32])malloc((n ? n : 1) * 32);
+  size_t *owner = (size_t *)malloc((n ? n : 1) * sizeof(size_t)); /* item that asks */
+  size_t *todo = (size_t *)malloc((n ? n : 1) * sizeof(size_t));
+  if (!keys || !owner || !todo)
+  {
+    free(keys);
+    free(owner);
+    free(todo);
+    return -1;
+  }
+
+  /* Answer what the cache has; send each distinct missing prompt once. */
+  size_t n_todo = 0;
+  int failed = 0;
+  ueng_mutex_lock(&c->mu);
+  for (size_t i = 0; i < n; ++i)
+  {
+    ueng_llm_batch_item *it = &items[i];
+    double t0 = ueng_now_ms();
+    it->text = NULL;
+    it->status = 0;
+    it->http_status = 0;
+    it->latency_ms = 0.0;
+    owner[i] = i;
+    if (!it->prompt)
+    {
+      todo[n_todo++] = i; /* left to the backend, which reports it */
+      continue;
+    }
+    make_key(ident, it->sampling, it->prompt, keys[i]);
+    size_t len = 0;
+    if (lookup(c, keys[i], &it->text, &len))
+    {
+      c->st.hits++;
+      it->latency_ms = ueng_now_ms() - t0;
+      owner[i] = (size_t)-1;
+      continue;
+    }
+    for (size_t k = 0; k < n_todo; ++k)
+    {
+      size_t j = todo[k];
+      if (memcmp(keys[j], keys[i], 32) == 0)
+      {
+        owner[i] = j;
+        break;
+      }
+    }
+    if (owner[i] == i)
+      todo[n_todo++] = i;
+    if (owner[i] != i)
+      c->st.coalesced++;
+    else
+      c->st.misses++;
+  }
+  ueng_mutex_unlock(&c->mu);
+
+  if (n_todo > 0)
+  {
+    ueng_llm_batch_item *sub = (ueng_llm_batch_item *)calloc(n_todo, sizeof(*sub));
+    if (!sub)
+    {
+      free(keys);
+      free(owner);
+      free(todo);
+      return -1;
+    }
+    for (size_t k = 0; k < n_todo; ++k)
+    {
+      sub[k].prompt = items[todo[k]].prompt;
+      sub[k].sampling = items[todo[k]].sampling;
+    }
+    ueng_llm_prompt_batch(ctx, sub, n_todo, max_parallel);
+    ueng_mutex_lock(&c->mu);
+    for (size_t k = 0; k < n_todo; ++k)
+    {
+      size_t i = todo[k];
+      items[i] = sub[k];
+      if (sub[k].status == 0 && sub[k].text && items[i].prompt && !sub[k].fallback)
+        store(c, keys[i], sub[k].text, strlen(sub[k].text));
+    }
+    ueng_mutex_unlock(&c->mu);
+    free(sub);
+  }
+
+  /* Duplicates share their owner's answer. */
+  for (size_t i = 0; i < n; ++i)
+  {
+    size_t j = owner[i];
+    if (j != (size_t)-1 && j != i)
+    {
+      items[i].status = items[j].status;
+      items[i].http_status = items[j].http_status;
+      items[i].latency_ms = items[j].latency_ms;
+      items[i].fallback = items[j].fallback;
+      items[i].text = items[j].text ? strdup(items[j].text) : NULL;
+      if (items[j].text && !items[i].text)
+        items[i].status = -1;
+    }
+    if (items[i].status != 0)
+      failed++;
+  }
+  free(keys);
+  free(owner);
+  free(todo);
+  return failed;
+}
+
+/*------------------------------ End of file --------------------------------*/
@@ -23,7 +23,9 @@
  * Date: 24-09-2025
  * License: MIT
  *---------------------------------------------------------------------------*/
-#include "ueng/llm.h"
+#include "ueng/llm_backend.h"
+#include "ueng/common.h" /* ueng_now_ms */
+#include "ueng/trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,27 +38,536 @@
    situation at runtime (helpful for contributors without the backend).
 ---------------------------------------------------------------------------- */
 
-struct ueng_llm_ctx
-{
-  int placeholder; /* unused in stub; real backend holds llama_* handles */
-};
-
 #if defined(UENG_WITH_LLAMA_EMBED) && defined(HAVE_LLAMA_H)
 /* -------------------------- REAL IMPLEMENTATION ---------------------------
    NOTE: We intentionally keep this minimal and readable. llama.cpp evolves,
-   so this code aims to use only the stable C API (llama.h). If the upstream
-   API shifts, this file is the only place we must adjust.
+   so this code aims to use only the stable C API (llama.h): the vocab,
+   sampler-chain and llama_memory_* calls of current releases. If the
+   upstream API shifts, this file is the only place we must adjust.
 --------------------------------------------------------------------------- */
+#include "ueng/hash.h" /* ueng_hash64 */
 #include <llama.h>
+#include <sys/stat.h>
+
+#define LLAMA_MAX_NEW_TOKENS 64 /* default reply length unless llama.max_tokens says */
+#define LLAMA_DEFAULT_N_BATCH 512
+#define LLAMA_SESSION_MIN_TOKENS 32 /* shorter shared prefixes are not worth a file */
+#define LLAMA_SESSION_MAX_MB 2048   /* session_dir bound unless llama.session_max_mb says */
+#define LLAMA_SAMPLING_SEED 1234u   /* ueng_llm_sampling.seed == 0: repeatable runs */
+#define LLAMA_MAX_SEQUENCES 63      /* batch width cap (sequence 0 is the prefix cache) */
+#define LLAMA_DEFAULT_DRAFT_MAX 8
+#define LLAMA_MAX_DRAFT 32
+
+/* Tuning knobs: config keys llama.n_batch / llama.n_ubatch / llama.n_threads
+   reach us as UENG_LLAMA_* through ueng_config_export_env. */
+static int env_int(const char *name, int dflt)
+{
+  const char *s = getenv(name);
+  long v = (s && *s) ? strtol(s, NULL, 10) : 0;
+  return (v > 0 && v <= 1 << 20) ? (int)v : dflt;
+}
 
-struct ueng_llm_ctx_real
+struct ueng_llm_llama
 {
   struct llama_model *model;
   struct llama_context *ctx;
+  const struct llama_vocab *vocab;
+  struct llama_sampler *smpl; /* greedy */
   int n_ctx;
+  int n_batch; /* most tokens one llama_decode call accepts */
+  int n_seq;   /* sequence ids: 0 for single prompts, 1.. for batches */
+  int max_new; /* tokens generated per prompt (items may override), <= n_ctx */
+  char identity[512]; /* see ueng_llm_identity */
+  llama_token *kv;    /* tokens whose K/V sequence 0 holds, in order (n_ctx slots) */
+  int kv_n;
+  char session_dir[PATH_MAX]; /* "" : no on-disk snapshots */
+  uint64_t session_max;       /* bytes the .kvs files there may take */
+  struct SessionFile *sess;   /* its .kvs files, oldest first (listed at open) */
+  size_t sess_n, sess_cap;
+  uint64_t sess_total; /* bytes of sess[] */
+  uint64_t model_key;         /* hash of 'identity'; snapshots never cross models */
+  /* Speculative decoding (draft == NULL: off), single prompts only. */
+  struct llama_model *draft_model;
+  struct llama_context *draft;
+  struct llama_sampler *draft_smpl; /* greedy */
+  llama_token *dkv;                 /* tokens the draft's sequence 0 holds (n_ctx slots) */
+  int dkv_n;
+  llama_batch verify; /* pending token + drafts, logits for every row */
+  int draft_max;      /* bound of draft_k */
+  int draft_k;        /* tokens to draft next step; adapts to acceptance */
 };
 
-ueng_llm_ctx *ueng_llm_open(const char *model_path, int ctx_tokens, char *err, size_t errsz)
+/* ---- on-disk session snapshots -------------------------------------------
+   When two prompts share a prefix of at least LLAMA_SESSION_MIN_TOKENS (the
+   system and style preamble every pass sends), the state of exactly that
+   prefix is saved as <dir>/<model key>-<prefix hash>-<n>.kvs. A fresh process
+   whose first prompt starts with a saved prefix loads it instead of
+   evaluating it. Layout: "UKVS", u32 version, i32 n, u32 0, u64 state size,
+   n tokens, llama_state_seq_get_data bytes. Native byte order: the state
+   blob is only valid for the same build and model anyway. After each save the
+   oldest snapshots (by mtime, whatever their model) are deleted until the
+   directory fits session_max again. The directory is listed once, at open,
+   into a table of {name, size, mtime, n, hash}; lookups and trims use it. */
+
+#define SESSION_HEADER 24
+
+/* One .kvs file of session_dir. Snapshots of other models count against
+   session_max too; for them (and for names we did not write) n is 0. */
+typedef struct SessionFile
+{
+  char *name;
+  uint64_t size;
+  long long mtime;
+  uint64_t hash; /* prefix hash from the name */
+  int n;         /* prefix length; 0: not a snapshot of this model */
+} SessionFile;
+
+static uint64_t session_hash(const struct ueng_llm_llama *R, const llama_token *toks, int n)
+{
+  return ueng_hash64(toks, (size_t)n * sizeof(llama_token), R->model_key);
+}
+
+static void session_path(const struct ueng_llm_llama *R, uint64_t h, int n, char *out,
+                         size_t outsz)
+{
+  snprintf(out, outsz, "%s%c%016llx-%016llx-%d.kvs", R->session_dir, PATH_SEP,
+           (unsigned long long)R->model_key, (unsigned long long)h, n);
+}
+
+static int cmp_session_age(const void *a, const void *b)
+{
+  const SessionFile *x = (const SessionFile *)a, *y = (const SessionFile *)b;
+  return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+/* Append session_dir/'name' to the table if it is a .kvs file. */
+static void session_add(struct ueng_llm_llama *R, const char *name)
+{
+  size_t len = strlen(name);
+  char path[PATH_MAX + 64];
+  struct stat st;
+  if (len < 5 || strcmp(name + len - 4, ".kvs") != 0 || strchr(name, PATH_SEP) ||
+      snprintf(path, sizeof(path), "%s%c%s", R->session_dir, PATH_SEP, name) >=
+          (int)sizeof(path) ||
+      stat(path, &st) != 0)
+    return;
+  if (R->sess_n == R->sess_cap)
+  {
+    size_t cap = R->sess_cap ? R->sess_cap * 2 : 64;
+    SessionFile *f = (SessionFile *)realloc(R->sess, cap * sizeof(*f));
+    if (!f)
+      return;
+    R->sess = f;
+    R->sess_cap = cap;
+  }
+  SessionFile *e = &R->sess[R->sess_n];
+  if (!(e->name = (char *)malloc(len + 1)))
+    return;
+  memcpy(e->name, name, len + 1);
+  e->size = (uint64_t)st.st_size;
+  e->mtime = (long long)st.st_mtime;
+  e->n = 0;
+  char want[20];
+  unsigned long long h;
+  int n, used = 0;
+  snprintf(want, sizeof(want), "%016llx-", (unsigned long long)R->model_key);
+  if (strncmp(name, want, 17) == 0 && sscanf(name + 17, "%16llx-%d.kvs%n", &h, &n, &used) == 2 &&
+      name[17 + used] == '\0' && n > 0)
+  {
+    e->hash = h;
+    e->n = n;
+  }
+  R->sess_total += e->size;
+  R->sess_n++;
+}
+
+static void session_drop(struct ueng_llm_llama *R, size_t i)
+{
+  R->sess_total -= R->sess[i].size;
+  free(R->sess[i].name);
+  memmove(&R->sess[i], &R->sess[i + 1], (R->sess_n - i - 1) * sizeof(*R->sess));
+  R->sess_n--;
+}
+
+/* List session_dir once, oldest first; saves and trims keep the table
+   current from then on. Files other processes write later go unseen until
+   the next open (and are never deleted by this one). */
+static void session_scan(struct ueng_llm_llama *R)
+{
+  StrList names;
+  sl_init(&names);
+  if (list_tree_files(R->session_dir, &names) == 0)
+    for (size_t i = 0; i < names.count; ++i)
+      session_add(R, names.items[i]);
+  sl_free(&names);
+  if (R->sess_n > 1)
+    qsort(R->sess, R->sess_n, sizeof(*R->sess), cmp_session_age);
+}
+
+static void session_free(struct ueng_llm_llama *R)
+{
+  for (size_t i = 0; i < R->sess_n; ++i)
+    free(R->sess[i].name);
+  free(R->sess);
+}
+
+/* Delete the oldest snapshots until the rest fit R->session_max. The table
+   is oldest first and the file just written is its last entry, which stays
+   even when it alone is over. */
+static void session_trim(struct ueng_llm_llama *R)
+{
+  char path[PATH_MAX + 64];
+  size_t i = 0;
+  while (R->sess_total > R->session_max && i + 1 < R->sess_n)
+  {
+    snprintf(path, sizeof(path), "%s%c%s", R->session_dir, PATH_SEP, R->sess[i].name);
+    if (remove(path) == 0 || !file_exists(path))
+      session_drop(R, i);
+    else
+      i++;
+  }
+}
+
+/* Snapshot sequence 0, which must hold exactly toks[0, n). */
+static void session_save(struct ueng_llm_llama *R, const llama_token *toks, int n)
+{
+  char path[PATH_MAX + 64], tmp[PATH_MAX + 72];
+  uint64_t h = session_hash(R, toks, n);
+  for (size_t i = 0; i < R->sess_n; ++i)
+    if (R->sess[i].n == n && R->sess[i].hash == h)
+      return;
+  session_path(R, h, n, path, sizeof(path));
+  if (file_exists(path)) /* another process saved it since we listed */
+  {
+    session_add(R, path + strlen(R->session_dir) + 1);
+    return;
+  }
+  double t0 = ueng_trace_begin();
+  size_t state = llama_state_seq_get_size(R->ctx, 0);
+  size_t ntok = (size_t)n * sizeof(llama_token);
+  unsigned char *buf = (unsigned char *)malloc(SESSION_HEADER + ntok + state);
+  if (!buf)
+    return;
+  uint32_t version = 1, zero = 0;
+  int32_t n32 = n;
+  uint64_t state64 = state;
+  memcpy(buf, "UKVS", 4);
+  memcpy(buf + 4, &version, 4);
+  memcpy(buf + 8, &n32, 4);
+  memcpy(buf + 12, &zero, 4);
+  memcpy(buf + 16, &state64, 8);
+  memcpy(buf + SESSION_HEADER, toks, ntok);
+  size_t got = llama_state_seq_get_data(R->ctx, buf + SESSION_HEADER + ntok, state, 0);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *f = got == state ? ueng_fopen(tmp, "wb") : NULL;
+  int ok = f && fwrite(buf, 1, SESSION_HEADER + ntok + state, f) == SESSION_HEADER + ntok + state;
+  if (f && fclose(f) != 0)
+    ok = 0;
+  if (ok && replace_file(tmp, path) != 0)
+    ok = 0;
+  if (!ok)
+  {
+    remove(tmp);
+    fprintf(stderr, "[llm] WARN: could not save session %s\n", path);
+  }
+  free(buf);
+  if (ok)
+  {
+    session_add(R, path + strlen(R->session_dir) + 1);
+    session_trim(R);
+  }
+  ueng_trace_end_arg("llm", "session_save", t0, path);
+}
+
+/* Load the longest saved prefix of toks[0, max_n) into sequence 0. Returns
+   its length; 0 when there is none (sequence 0 untouched); -1 when loading
+   failed (sequence 0 is then empty). Lengths are tried longest first and
+   each one is hashed once, however many snapshots share it. */
+static int session_load(struct ueng_llm_llama *R, const llama_token *toks, int max_n)
+{
+  int best = 0, below = max_n + 1;
+  uint64_t h = 0;
+  size_t at = 0;
+  while (best == 0)
+  {
+    int n = 0;
+    for (size_t i = 0; i < R->sess_n; ++i)
+      if (R->sess[i].n < below && R->sess[i].n > n)
+        n = R->sess[i].n;
+    if (n == 0)
+      return 0;
+    h = session_hash(R, toks, n);
+    for (size_t i = 0; i < R->sess_n && best == 0; ++i)
+      if (R->sess[i].n == n && R->sess[i].hash == h)
+        best = n, at = i;
+    below = n;
+  }
+
+  double t0 = ueng_trace_begin();
+  char path[PATH_MAX + 64];
+  session_path(R, h, best, path, sizeof(path));
+  size_t len = 0;
+  unsigned char *buf = (unsigned char *)read_file_alloc(path, &len);
+  size_t ntok = (size_t)best * sizeof(llama_token);
+  int32_t n32 = 0;
+  uint64_t state = 0;
+  if (buf && len >= SESSION_HEADER)
+  {
+    memcpy(&n32, buf + 8, 4);
+    memcpy(&state, buf + 16, 8);
+  }
+  int ok = buf && memcmp(buf, "UKVS", 4) == 0 && n32 == best &&
+           len == SESSION_HEADER + ntok + state &&
+           memcmp(buf + SESSION_HEADER, toks, ntok) == 0;
+  if (!buf)
+    session_drop(R, at); /* deleted by another process */
+  llama_memory_clear(llama_get_memory(R->ctx), true);
+  if (ok && llama_state_seq_set_data(R->ctx, buf + SESSION_HEADER + ntok, (size_t)state, 0) == 0)
+  {
+    fprintf(stderr, "[llm] WARN: session %s does not fit this context; ignored\n", path);
+    llama_memory_clear(llama_get_memory(R->ctx), true);
+    ok = 0;
+  }
+  free(buf);
+  ueng_trace_end_arg("llm", "session_load", t0, path);
+  return ok ? best : -1;
+}
+
+/* Tokenize 'prompt' into a malloc'd array (*out). Returns the token count,
+   -2 when it cannot be tokenized or does not fit the context, -1 when out of
+   memory. */
+static int tokenize(struct ueng_llm_llama *R, const char *prompt, llama_token **out)
+{
+  *out = NULL;
+  /* Sizing call first: llama_tokenize returns -(count) when the array is too
+     small. */
+  int32_t plen = (int32_t)strlen(prompt);
+  int n = -llama_tokenize(R->vocab, prompt, plen, NULL, 0, true, true);
+  if (n <= 0)
+    return -2;
+  if (n >= R->n_ctx)
+  {
+    fprintf(stderr, "[llm] ERROR: prompt is %d tokens; context holds %d\n", n, R->n_ctx);
+    return -2;
+  }
+  llama_token *toks = (llama_token *)malloc((size_t)n * sizeof(llama_token));
+  if (!toks)
+    return -1;
+  if (llama_tokenize(R->vocab, prompt, plen, toks, n, true, true) != n)
+  {
+    free(toks);
+    return -2;
+  }
+  *out = toks;
+  return n;
+}
+
+/* Make sequence 0 hold toks[0, n). The longest common prefix with what it
+   already holds is kept (at most max_keep tokens: a prompt's last token is
+   evaluated again for fresh logits), a saved session is tried when that is
+   short, and the rest is evaluated in n_batch chunks. Returns the number of
+   tokens reused, or -3 when decoding failed (sequence 0 is then empty). */
+static int seq0_prefill(struct ueng_llm_llama *R, const llama_token *toks, int n, int max_keep)
+{
+  llama_memory_t mem = llama_get_memory(R->ctx);
+  int keep = 0;
+  while (keep < R->kv_n && keep < max_keep && R->kv[keep] == toks[keep])
+    keep++;
+  if (keep < R->kv_n && !llama_memory_seq_rm(mem, 0, keep, -1))
+  {
+    llama_memory_clear(mem, true); /* e.g. recurrent models: no partial removal */
+    keep = 0;
+  }
+  R->kv_n = keep;
+  if (R->session_dir[0])
+  {
+    if (keep < LLAMA_SESSION_MIN_TOKENS)
+    {
+      int loaded = session_load(R, toks, max_keep);
+      if (loaded != 0)
+      {
+        keep = loaded > 0 ? loaded : 0;
+        memcpy(R->kv, toks, (size_t)keep * sizeof(llama_token));
+        R->kv_n = keep;
+      }
+    }
+    else if (keep < max_keep)
+    {
+      session_save(R, toks, keep); /* a preamble shared by two prompts */
+    }
+  }
+
+  /* Chunked prefill of the rest: positions continue from the cache. */
+  for (int i = keep; i < n; i += R->n_batch)
+  {
+    int m = n - i < R->n_batch ? n - i : R->n_batch;
+    if (llama_decode(R->ctx, llama_batch_get_one((llama_token *)toks + i, m)) != 0)
+    {
+      llama_memory_clear(mem, true);
+      R->kv_n = 0;
+      return -3;
+    }
+    memcpy(R->kv + R->kv_n, toks + i, (size_t)m * sizeof(llama_token));
+    R->kv_n += m;
+  }
+  return keep;
+}
+
+/* ---- speculative decoding ------------------------------------------------
+   A small draft model with the same vocabulary guesses the next draft_k
+   tokens one at a time, which is cheap; the model then evaluates the pending
+   token and all guesses in one llama_decode call, which costs about as much
+   as a single token on a CPU because decode is bound by reading the weights.
+   Guesses are kept while they equal the model's own greedy choice, so the
+   output is exactly what plain greedy decoding produces; each step yields
+   between 1 and draft_k + 1 tokens. draft_k grows while whole drafts are
+   accepted and falls back to just past the last accepted guess otherwise. */
+
+static void draft_free(struct ueng_llm_llama *R)
+{
+  if (R->verify.token)
+    llama_batch_free(R->verify);
+  if (R->draft_smpl)
+    llama_sampler_free(R->draft_smpl);
+  if (R->draft)
+    llama_free(R->draft);
+  if (R->draft_model)
+    llama_model_free(R->draft_model);
+  free(R->dkv);
+  memset(&R->verify, 0, sizeof(R->verify));
+  R->draft_smpl = NULL;
+  R->draft = NULL;
+  R->draft_model = NULL;
+  R->dkv = NULL;
+}
+
+/* Load UENG_LLAMA_DRAFT_MODEL_PATH, if set, next to the model. Problems are
+   warnings: the context then simply decodes without a draft. */
+static void draft_open(struct ueng_llm_llama *R, struct llama_model_params mp,
+                       struct llama_context_params cp)
+{
+  const char *path = getenv("UENG_LLAMA_DRAFT_MODEL_PATH");
+  if (!path || !*path)
+    return;
+  R->draft_max = env_int("UENG_LLAMA_DRAFT_MAX", LLAMA_DEFAULT_DRAFT_MAX);
+  if (R->draft_max > LLAMA_MAX_DRAFT)
+    R->draft_max = LLAMA_MAX_DRAFT;
+  if (R->draft_max > R->n_batch - 1) /* pending token + drafts in one decode call */
+    R->draft_max = R->n_batch - 1;
+  if (llama_model_is_recurrent(R->model) || R->draft_max < 1)
+  {
+    fprintf(stderr, "[llm] WARN: draft model %s unused with this model or n_batch\n", path);
+    return;
+  }
+  double t0 = ueng_trace_begin();
+  R->draft_model = llama_model_load_from_file(path, mp);
+  ueng_trace_end_arg("llm", "load_draft_model", t0, path);
+  if (!R->draft_model)
+  {
+    fprintf(stderr, "[llm] WARN: could not load draft model %s; decoding without it\n", path);
+    return;
+  }
+  const struct llama_vocab *dv = llama_model_get_vocab(R->draft_model);
+  if (llama_vocab_n_tokens(dv) != llama_vocab_n_tokens(R->vocab) ||
+      llama_vocab_bos(dv) != llama_vocab_bos(R->vocab) ||
+      llama_vocab_eos(dv) != llama_vocab_eos(R->vocab))
+  {
+    fprintf(stderr, "[llm] WARN: draft model %s has another vocabulary; decoding without it\n",
+            path);
+    draft_free(R);
+    return;
+  }
+  cp.n_seq_max = 1;
+  R->draft = llama_init_from_model(R->draft_model, cp);
+  R->draft_smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+  llama_sampler_chain_add(R->draft_smpl, llama_sampler_init_greedy());
+  R->dkv = (llama_token *)malloc((size_t)R->n_ctx * sizeof(llama_token));
+  R->verify = llama_batch_init(R->draft_max + 1, 0, 1);
+  if (!R->draft || !R->dkv || !R->verify.token)
+  {
+    fprintf(stderr, "[llm] WARN: no room for draft model %s; decoding without it\n", path);
+    draft_free(R);
+    return;
+  }
+  R->draft_k = R->draft_max;
+}
+
+/* Make the draft's sequence 0 hold toks[0, n), reusing the common prefix.
+   Returns 0, or -1 (draft cache then empty). */
+static int draft_sync(struct ueng_llm_llama *R, const llama_token *toks, int n)
+{
+  llama_memory_t mem = llama_get_memory(R->draft);
+  int keep = 0;
+  while (keep < R->dkv_n && keep < n && R->dkv[keep] == toks[keep])
+    keep++;
+  if (keep < R->dkv_n && !llama_memory_seq_rm(mem, 0, keep, -1))
+  {
+    llama_memory_clear(mem, true);
+    keep = 0;
+  }
+  R->dkv_n = keep;
+  int chunk = (int)llama_n_batch(R->draft);
+  for (int i = keep; i < n; i += chunk)
+  {
+    int m = n - i < chunk ? n - i : chunk;
+    if (llama_decode(R->draft, llama_batch_get_one((llama_token *)toks + i, m)) != 0)
+    {
+      llama_memory_clear(mem, true);
+      R->dkv_n = 0;
+      return -1;
+    }
+    memcpy(R->dkv + R->dkv_n, toks + i, (size_t)m * sizeof(llama_token));
+    R->dkv_n += m;
+  }
+  return 0;
+}
+
+/* Guess up to k tokens that follow the model's cache plus 'tok'. Returns how
+   many were written to out[] (fewer at an end-of-generation guess). */
+static int draft_propose(struct ueng_llm_llama *R, llama_token tok, int k, llama_token *out)
+{
+  if (draft_sync(R, R->kv, R->kv_n) != 0)
+    return 0;
+  int m = 0;
+  while (m < k)
+  {
+    if (llama_decode(R->draft, llama_batch_get_one(&tok, 1)) != 0)
+    {
+      llama_memory_clear(llama_get_memory(R->draft), true);
+      R->dkv_n = 0;
+      break;
+    }
+    R->dkv[R->dkv_n++] = tok;
+    tok = llama_sampler_sample(R->draft_smpl, R->draft, -1);
+    if (llama_vocab_is_eog(R->vocab, tok))
+      break;
+    out[m++] = tok;
+  }
+  return m;
+}
+
+/* Evaluate 'tok' and drafts[0, k) at the end of sequence 0, with logits for
+   each (row i predicts what follows drafts[i - 1]). */
+static int verify_decode(struct ueng_llm_llama *R, llama_token tok, const llama_token *drafts,
+                         int k)
+{
+  if (k == 0)
+    return llama_decode(R->ctx, llama_batch_get_one(&tok, 1));
+  llama_batch *b = &R->verify;
+  b->n_tokens = k + 1;
+  for (int i = 0; i <= k; ++i)
+  {
+    b->token[i] = i == 0 ? tok : drafts[i - 1];
+    b->pos[i] = R->kv_n + i;
+    b->n_seq_id[i] = 1;
+    b->seq_id[i][0] = 0;
+    b->logits[i] = 1;
+  }
+  return llama_decode(R->ctx, *b);
+}
+
+ueng_llm_llama *ueng_llm_open_llama(const char *model_path, int ctx_tokens, char *err,
+                                    size_t errsz)
 {
   if (!model_path || !*model_path)
   {
@@ -68,101 +579,545 @@ ueng_llm_ctx *ueng_llm_open(const char *model_path, int ctx_tokens, char *err, s
     ctx_tokens = 4096;
 
   llama_backend_init();
-  llama_numa_init(llama_numa_strategy::LLAMA_NUMA_STRATEGY_DISABLED);
+  llama_numa_init(GGML_NUMA_STRATEGY_DISABLED);
 
   struct llama_model_params mp = llama_model_default_params();
   struct llama_context_params cp = llama_context_default_params();
-  cp.n_ctx = ctx_tokens;
-  cp.seed = 0;
+  cp.n_ctx = (uint32_t)ctx_tokens;
+  /* Long prompts are evaluated n_batch tokens per llama_decode call, which
+     llama.cpp runs as n_ubatch-sized pieces; neither can exceed the context. */
+  int n_batch = env_int("UENG_LLAMA_N_BATCH", LLAMA_DEFAULT_N_BATCH);
+  if (n_batch > ctx_tokens)
+    n_batch = ctx_tokens;
+  int n_ubatch = env_int("UENG_LLAMA_N_UBATCH", n_batch);
+  if (n_ubatch > n_batch)
+    n_ubatch = n_batch;
+  cp.n_batch = (uint32_t)n_batch;
+  cp.n_ubatch = (uint32_t)n_ubatch;
+  /* Batches decode up to UENG_LLM_PARALLEL sequences at once; all of them
+     share one pool of KV cells, so a single prompt can still use it all. */
+  int width = env_int("UENG_LLM_PARALLEL", 8);
+  cp.n_seq_max = (uint32_t)(1 + (width < LLAMA_MAX_SEQUENCES ? width : LLAMA_MAX_SEQUENCES));
+  cp.kv_unified = true;
+  int n_threads = env_int("UENG_LLAMA_N_THREADS", 0);
+  if (n_threads > 0)
+  {
+    cp.n_threads = n_threads;
+    cp.n_threads_batch = n_threads;
+  }
 
-  struct llama_model *model = llama_load_model_from_file(model_path, mp);
+  double t0 = ueng_trace_begin();
+  struct llama_model *model = llama_model_load_from_file(model_path, mp);
+  ueng_trace_end_arg("llm", "load_model", t0, model_path);
   if (!model)
   {
     if (err && errsz)
       snprintf(err, errsz, "failed to load model: %s", model_path);
     return NULL;
   }
-  struct llama_context *lctx = llama_new_context_with_model(model, cp);
-  if (!lctx)
+  struct llama_context *lctx = llama_init_from_model(model, cp);
+  struct ueng_llm_llama *R = (struct ueng_llm_llama *)calloc(1, sizeof(*R));
+  if (!lctx || !R)
   {
     if (err && errsz)
       snprintf(err, errsz, "failed to create llama context");
-    llama_free_model(model);
+    if (lctx)
+      llama_free(lctx);
+    llama_model_free(model);
+    free(R);
     return NULL;
   }
-
-  struct ueng_llm_ctx_real *R = (struct ueng_llm_ctx_real *)calloc(1, sizeof(*R));
   R->model = model;
   R->ctx = lctx;
-  R->n_ctx = ctx_tokens;
-  return (ueng_llm_ctx *)R;
+  R->vocab = llama_model_get_vocab(model);
+  R->smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+  llama_sampler_chain_add(R->smpl, llama_sampler_init_greedy());
+  R->n_ctx = (int)llama_n_ctx(lctx);
+  R->n_batch = (int)llama_n_batch(lctx);
+  R->n_seq = (int)llama_n_seq_max(lctx);
+  R->max_new = env_int("UENG_LLAMA_MAX_TOKENS", LLAMA_MAX_NEW_TOKENS);
+  if (R->max_new > R->n_ctx)
+    R->max_new = R->n_ctx; /* generation stops at the context end anyway */
+  struct stat st;
+  if (stat(model_path, &st) != 0)
+    memset(&st, 0, sizeof(st));
+  snprintf(R->identity, sizeof(R->identity), "llama|%s|%lld|%lld|greedy|max_new=%d", model_path,
+           (long long)st.st_size, (long long)st.st_mtime, R->max_new);
+  R->model_key = ueng_hash64(R->identity, strlen(R->identity), 0);
+  R->kv = (llama_token *)malloc((size_t)R->n_ctx * sizeof(llama_token));
+  const char *sdir = getenv("UENG_LLAMA_SESSION_DIR");
+  if (sdir && *sdir)
+  {
+    if (mkpath(sdir) == 0)
+      snprintf(R->session_dir, sizeof(R->session_dir), "%s", sdir);
+    else
+      fprintf(stderr, "[llm] WARN: cannot create session dir %s; snapshots off\n", sdir);
+    R->session_max = (uint64_t)env_int("UENG_LLAMA_SESSION_MAX_MB", LLAMA_SESSION_MAX_MB) << 20;
+    if (R->session_dir[0])
+      session_scan(R);
+  }
+  if (!R->kv)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "out of memory");
+    ueng_llm_close_llama(R);
+    return NULL;
+  }
+  draft_open(R, mp, cp);
+  return R;
 }
 
-int ueng_llm_prompt(ueng_llm_ctx *handle, const char *prompt, char *out, size_t outsz)
+/* Count one generated token and deliver its text, if any. */
+static int emit_token(struct ueng_llm_llama *R, llama_token tok, ueng_llm_piece_fn fn,
+                      void *user, ueng_llm_stream_stats *st, double t_start)
 {
-  if (!handle || !prompt || !out || outsz == 0)
-    return -1;
-  struct ueng_llm_ctx_real *R = (struct ueng_llm_ctx_real *)handle;
+  st->tokens++;
+  char piece[256];
+  int L = llama_token_to_piece(R->vocab, tok, piece, (int32_t)sizeof(piece), 0, false);
+  if (L <= 0)
+    return 0;
+  if (st->pieces++ == 0)
+    st->ttft_ms = ueng_now_ms() - t_start;
+  return fn(user, piece, (size_t)L) != 0 ? UENG_LLM_CANCELLED : 0;
+}
 
-  /* Very small prompt-&-complete loop using llama.cpp helpers */
-  struct llama_batch batch = llama_batch_init(512, 0, 1);
+int ueng_llm_prompt_stream_llama(ueng_llm_llama *R, const char *prompt, ueng_llm_piece_fn fn,
+                                 void *user, ueng_llm_stream_stats *stats)
+{
+  ueng_llm_stream_stats st;
+  memset(&st, 0, sizeof(st));
+  if (stats)
+    *stats = st;
+  if (!R || !prompt || !fn)
+    return -1;
+  double t_start = ueng_now_ms();
 
-  int n_tokens = llama_tokenize(R->ctx, prompt, strlen(prompt), batch.tokens, 512, true, true);
-  if (n_tokens <= 0)
-  {
-    llama_batch_free(batch);
-    return -2;
-  }
+  llama_token *toks = NULL;
+  int n_prompt = tokenize(R, prompt, &toks);
+  if (n_prompt < 0)
+    return n_prompt;
 
-  batch.n_tokens = n_tokens;
-  if (llama_decode(R->ctx, batch) != 0)
+  llama_sampler_reset(R->smpl);
+  double t_prefill = ueng_now_ms();
+  double t0 = ueng_trace_begin();
+  int keep = seq0_prefill(R, toks, n_prompt, n_prompt - 1);
+  char detail[48];
+  snprintf(detail, sizeof(detail), "%d tokens, %d reused", n_prompt, keep < 0 ? 0 : keep);
+  ueng_trace_end_arg("llm", "prefill", t0, detail);
+  free(toks);
+  st.prompt_tokens = n_prompt;
+  st.cached_tokens = keep < 0 ? 0 : keep;
+  st.prefill_ms = ueng_now_ms() - t_prefill;
+  if (keep < 0)
   {
-    llama_batch_free(batch);
+    if (stats)
+      *stats = st;
     return -3;
   }
 
-  /* Greedy sample a few tokens for demonstration */
-  size_t used = 0;
-  for (int t = 0; t < 64 && used + 8 < outsz; ++t)
+  int rc = 0;
+  llama_memory_t mem = llama_get_memory(R->ctx);
+  llama_token drafts[LLAMA_MAX_DRAFT];
+  llama_token tok = llama_sampler_sample(R->smpl, R->ctx, -1);
+  t0 = ueng_trace_begin();
+  while (!llama_vocab_is_eog(R->vocab, tok))
   {
-    llama_token tok = llama_sample_token_greedy(R->ctx, NULL);
-    if (tok == llama_token_eos(R->ctx))
+    rc = emit_token(R, tok, fn, user, &st, t_start);
+    if (rc != 0 || st.tokens >= R->max_new || R->kv_n + 1 >= R->n_ctx)
       break;
-    const char *piece = llama_token_to_piece(R->ctx, tok);
-    size_t L = piece ? strlen(piece) : 0;
-    if (L > 0)
+    /* Feed the token back, with the draft's guesses of what follows; none
+       may pass the token or context limits. */
+    int k = 0;
+    if (R->draft)
     {
-      if (used + L >= outsz)
-        L = outsz - used - 1;
-      memcpy(out + used, piece, L);
-      used += L;
-      out[used] = '\0';
+      k = R->draft_k;
+      if (k > R->max_new - st.tokens - 1)
+        k = R->max_new - st.tokens - 1;
+      if (k > R->n_ctx - R->kv_n - 2)
+        k = R->n_ctx - R->kv_n - 2;
+      k = k > 0 ? draft_propose(R, tok, k, drafts) : 0;
     }
-    /* feed the token back */
-    batch.n_tokens = 1;
-    batch.tokens[0] = tok;
-    batch.pos[0] = n_tokens + t;
-    if (llama_decode(R->ctx, batch) != 0)
+    if (verify_decode(R, tok, drafts, k) != 0)
+    {
+      llama_memory_clear(mem, true);
+      R->kv_n = 0;
+      rc = -3;
       break;
+    }
+    R->kv[R->kv_n++] = tok;
+    int acc = 0;
+    tok = llama_sampler_sample(R->smpl, R->ctx, 0);
+    while (acc < k && tok == drafts[acc])
+    {
+      rc = emit_token(R, tok, fn, user, &st, t_start);
+      if (rc != 0)
+        break;
+      R->kv[R->kv_n++] = tok;
+      tok = llama_sampler_sample(R->smpl, R->ctx, ++acc);
+    }
+    if (k > 0)
+    {
+      st.draft_tokens += k;
+      st.draft_accepted += acc;
+      R->draft_k = acc == k ? (R->draft_k + 2 < R->draft_max ? R->draft_k + 2 : R->draft_max)
+                            : acc + 1;
+      /* Rejected guesses leave the cache. */
+      if (acc < k && !llama_memory_seq_rm(mem, 0, R->kv_n, -1))
+      {
+        llama_memory_clear(mem, true);
+        R->kv_n = 0;
+        rc = -3;
+      }
+    }
+    if (rc != 0)
+      break;
+  }
+  if (st.draft_tokens > 0)
+  {
+    char drafted[64];
+    snprintf(drafted, sizeof(drafted), "%d tokens, %d of %d drafted accepted", st.tokens,
+             st.draft_accepted, st.draft_tokens);
+    ueng_trace_end_arg("llm", "generate", t0, drafted);
+  }
+  else
+  {
+    ueng_trace_end("llm", "generate", t0);
+  }
+  st.total_ms = ueng_now_ms() - t_start;
+  if (stats)
+    *stats = st;
+  return rc;
+}
+
+/* Text of one batch item. */
+typedef struct
+{
+  char *p;
+  size_t n, cap;
+} Grow;
+
+static int grow_piece(void *user, const char *piece, size_t len)
+{
+  Grow *g = (Grow *)user;
+  if (g->n + len + 1 > g->cap)
+  {
+    size_t cap = g->cap ? g->cap * 2 : 256;
+    while (g->n + len + 1 > cap)
+      cap *= 2;
+    char *p = (char *)realloc(g->p, cap);
+    if (!p)
+      return 1;
+    g->p = p;
+    g->cap = cap;
   }
-  llama_batch_free(batch);
+  memcpy(g->p + g->n, piece, len);
+  g->n += len;
+  g->p[g->n] = '\0';
   return 0;
 }
 
-void ueng_llm_close(ueng_llm_ctx *handle)
+static struct llama_sampler *make_sampler(const ueng_llm_sampling *s)
+{
+  struct llama_sampler *c = llama_sampler_chain_init(llama_sampler_chain_default_params());
+  if (!s || s->temperature <= 0.0f)
+  {
+    llama_sampler_chain_add(c, llama_sampler_init_greedy());
+    return c;
+  }
+  if (s->top_k > 0)
+    llama_sampler_chain_add(c, llama_sampler_init_top_k(s->top_k));
+  if (s->top_p > 0.0f && s->top_p < 1.0f)
+    llama_sampler_chain_add(c, llama_sampler_init_top_p(s->top_p, 1));
+  llama_sampler_chain_add(c, llama_sampler_init_temp(s->temperature));
+  llama_sampler_chain_add(c, llama_sampler_init_dist(s->seed ? s->seed : LLAMA_SAMPLING_SEED));
+  return c;
+}
+
+/* One sequence of a batch: evaluating its prompt, then generating. */
+typedef struct
+{
+  long item; /* index into items; -1: free */
+  llama_seq_id seq;
+  int n_past;           /* cells this sequence holds */
+  int fed;              /* prompt tokens evaluated (or shared from sequence 0) */
+  int n_gen, max_new;   /* tokens generated, limit */
+  int reserved;         /* KV cells set aside for it */
+  llama_token next;     /* sampled, decoded in the next round */
+  int logit;            /* its row in the last batch's logits; -1: none */
+  struct llama_sampler *smpl;
+  Grow text;
+  double t0;
+} Seq;
+
+static void seq_finish(struct ueng_llm_llama *R, Seq *S, ueng_llm_batch_item *it, int status)
+{
+  llama_memory_seq_rm(llama_get_memory(R->ctx), S->seq, -1, -1);
+  llama_sampler_free(S->smpl);
+  S->smpl = NULL;
+  it->latency_ms = ueng_now_ms() - S->t0;
+  if (status == 0 && !S->text.p)
+    S->text.p = (char *)calloc(1, 1); /* empty reply */
+  it->status = (status == 0 && !S->text.p) ? -1 : status;
+  it->text = it->status == 0 ? S->text.p : NULL;
+  if (it->status != 0)
+    free(S->text.p);
+  memset(&S->text, 0, sizeof(S->text));
+  S->item = -1;
+}
+
+/* Continuous batching: up to 'width' prompts run as sequences 1..width of one
+   llama_decode call per round. Each round carries one new token for every
+   generating sequence plus as many prompt tokens of starting ones as fit in
+   n_batch; a finished sequence is replaced by the next waiting prompt. The
+   common prefix of all prompts is evaluated once into sequence 0 and shared. */
+int ueng_llm_prompt_batch_llama(ueng_llm_llama *R, ueng_llm_batch_item *items, size_t n,
+                                int max_parallel)
 {
-  if (!handle)
+  if (!R || (!items && n))
+    return -1;
+  int failed = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    items[i].text = NULL;
+    items[i].status = 0;
+    items[i].http_status = 0;
+    items[i].latency_ms = 0.0;
+  }
+  if (n == 0)
+    return 0;
+  int width = max_parallel > 0 ? max_parallel : env_int("UENG_LLM_PARALLEL", 8);
+  if (width > R->n_seq - 1)
+    width = R->n_seq - 1;
+  if (width > R->n_batch)
+    width = R->n_batch;
+  if ((size_t)width > n)
+    width = (int)n;
+
+  llama_token **toks = (llama_token **)calloc(n, sizeof(*toks));
+  int *ntok = (int *)calloc(n, sizeof(int));
+  Seq *seqs = (Seq *)calloc((size_t)width, sizeof(Seq));
+  if (!toks || !ntok || !seqs)
+  {
+    free(toks);
+    free(ntok);
+    free(seqs);
+    return -1;
+  }
+  double t_batch = ueng_trace_begin();
+
+  /* Tokenize up front; the prefix every prompt shares (but the last token of
+     each, which must be evaluated in its own sequence) goes to sequence 0.
+     A lone prompt shares nothing: its "prefix" would be the whole prompt. */
+  const llama_token *first = NULL;
+  int lcp = 0, tokenized = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    ntok[i] = items[i].prompt ? tokenize(R, items[i].prompt, &toks[i]) : -1;
+    if (ntok[i] < 0)
+      continue;
+    tokenized++;
+    if (!first)
+    {
+      first = toks[i];
+      lcp = ntok[i] - 1;
+    }
+    int k = 0;
+    while (k < lcp && k < ntok[i] - 1 && toks[i][k] == first[k])
+      k++;
+    lcp = k;
+  }
+  int shared = 0;
+  if (tokenized >= 2 && lcp >= LLAMA_SESSION_MIN_TOKENS && seq0_prefill(R, first, lcp, lcp) >= 0)
+  {
+    shared = lcp;
+    if (R->session_dir[0])
+      session_save(R, first, lcp);
+  }
+  else if (R->kv_n > 0)
+  {
+    /* Nothing to share: free the cells of the last single prompt. */
+    llama_memory_clear(llama_get_memory(R->ctx), true);
+    R->kv_n = 0;
+  }
+  int budget = R->n_ctx - R->kv_n, used = 0;
+
+  llama_memory_t mem = llama_get_memory(R->ctx);
+  llama_batch b = llama_batch_init(R->n_batch, 0, 1);
+  for (int s = 0; s < width; ++s)
+  {
+    seqs[s].item = -1;
+    seqs[s].seq = (llama_seq_id)(s + 1);
+  }
+  size_t next = 0;
+  for (;;)
+  {
+    /* Start waiting prompts in free sequences while their cells fit. */
+    int active = 0;
+    for (int s = 0; s < width; ++s)
+    {
+      Seq *S = &seqs[s];
+      while (S->item < 0 && next < n)
+      {
+        ueng_llm_batch_item *it = &items[next];
+        if (ntok[next] < 0)
+        {
+          it->status = ntok[next];
+          next++;
+          continue;
+        }
+        const ueng_llm_sampling *sp = it->sampling;
+        int max_new = (sp && sp->max_tokens > 0) ? sp->max_tokens : R->max_new;
+        int need = ntok[next] - shared + max_new;
+        if (need > R->n_ctx - shared)
+          need = R->n_ctx - shared; /* generation stops at the context end */
+        if (used + need > budget)
+          break;
+        memset(S, 0, sizeof(*S));
+        S->seq = (llama_seq_id)(s + 1);
+        S->item = (long)next++;
+        S->max_new = max_new;
+        S->reserved = need;
+        S->smpl = make_sampler(sp);
+        S->t0 = ueng_now_ms();
+        llama_memory_seq_rm(mem, S->seq, -1, -1);
+        if (shared > 0)
+          llama_memory_seq_cp(mem, 0, S->seq, -1, -1);
+        S->n_past = S->fed = shared;
+        used += need;
+      }
+      if (S->item >= 0)
+        active++;
+    }
+    if (active == 0)
+      break;
+
+    /* One token per generating sequence, then prompt chunks. */
+    b.n_tokens = 0;
+    for (int s = 0; s < width; ++s)
+    {
+      Seq *S = &seqs[s];
+      S->logit = -1;
+      if (S->item < 0 || S->fed < ntok[S->item])
+        continue;
+      int k = b.n_tokens++;
+      b.token[k] = S->next;
+      b.pos[k] = S->n_past++;
+      b.n_seq_id[k] = 1;
+      b.seq_id[k][0] = S->seq;
+      b.logits[k] = 1;
+      S->logit = k;
+    }
+    for (int s = 0; s < width && b.n_tokens < R->n_batch; ++s)
+    {
+      Seq *S = &seqs[s];
+      if (S->item < 0 || S->fed >= ntok[S->item])
+        continue;
+      const llama_token *t = toks[S->item];
+      while (S->fed < ntok[S->item] && b.n_tokens < R->n_batch)
+      {
+        int k = b.n_tokens++;
+        b.token[k] = t[S->fed++];
+        b.pos[k] = S->n_past++;
+        b.n_seq_id[k] = 1;
+        b.seq_id[k][0] = S->seq;
+        b.logits[k] = S->fed == ntok[S->item];
+        if (b.logits[k])
+          S->logit = k;
+      }
+    }
+
+    if (llama_decode(R->ctx, b) != 0)
+    {
+      /* Their cells are in an unknown state: fail the running sequences;
+         waiting prompts still get their turn. */
+      for (int s = 0; s < width; ++s)
+      {
+        Seq *S = &seqs[s];
+        if (S->item < 0)
+          continue;
+        used -= S->reserved;
+        seq_finish(R, S, &items[S->item], -3);
+      }
+      continue;
+    }
+
+    for (int s = 0; s < width; ++s)
+    {
+      Seq *S = &seqs[s];
+      if (S->item < 0 || S->logit < 0)
+        continue;
+      llama_token tok = llama_sampler_sample(S->smpl, R->ctx, S->logit);
+      int done = llama_vocab_is_eog(R->vocab, tok);
+      if (!done)
+      {
+        char piece[256];
+        int L = llama_token_to_piece(R->vocab, tok, piece, (int32_t)sizeof(piece), 0, false);
+        if (L > 0 && grow_piece(&S->text, piece, (size_t)L) != 0)
+        {
+          used -= S->reserved;
+          seq_finish(R, S, &items[S->item], -1);
+          continue;
+        }
+        S->next = tok;
+        done = ++S->n_gen >= S->max_new || S->n_past + 1 > shared + S->reserved;
+      }
+      if (done)
+      {
+        used -= S->reserved;
+        seq_finish(R, S, &items[S->item], 0);
+      }
+    }
+  }
+  llama_batch_free(b);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (i >= next && items[i].status == 0)
+      items[i].status = -2; /* never started (cannot happen: a lone prompt always fits) */
+    free(toks[i]);
+    if (items[i].status != 0)
+      failed++;
+  }
+  char detail[64];
+  snprintf(detail, sizeof(detail), "%zu prompts, %d sequences, %d shared", n, width, shared);
+  ueng_trace_end_arg("llm", "batch", t_batch, detail);
+  free(toks);
+  free(ntok);
+  free(seqs);
+  return failed;
+}
+
+int ueng_llm_identity_llama(ueng_llm_llama *R, char *out, size_t outsz)
+{
+  if (!R || !out || outsz == 0)
+    return -1;
+  int n = snprintf(out, outsz, "%s", R->identity);
+  return (n >= 0 && (size_t)n < outsz) ? 0 : -1;
+}
+
+void ueng_llm_close_llama(ueng_llm_llama *R)
+{
+  if (!R)
     return;
-  struct ueng_llm_ctx_real *R = (struct ueng_llm_ctx_real *)handle;
+  draft_free(R);
+  llama_sampler_free(R->smpl);
   llama_free(R->ctx);
-  llama_free_model(R->model);
+  llama_model_free(R->model);
+  free(R->kv);
+  session_free(R);
   free(R);
   llama_backend_free();
 }
 
 #else /* STUB (backend not compiled) --------------------------------------- */
 
-struct ueng_llm_ctx *ueng_llm_open(const char *model_path, int ctx_tokens, char *err, size_t errsz)
+struct ueng_llm_llama
+{
+  int placeholder; /* unused in stub; real backend holds llama_* handles */
+};
+
+ueng_llm_llama *ueng_llm_open_llama(const char *model_path, int ctx_tokens, char *err,
+                                    size_t errsz)
 {
   (void)model_path;
   (void)ctx_tokens;
@@ -175,17 +1130,35 @@ struct ueng_llm_ctx *ueng_llm_open(const char *model_path, int ctx_tokens, char
   return NULL;
 }
 
-int ueng_llm_prompt(struct ueng_llm_ctx *ctx, const char *prompt, char *out, size_t outsz)
+int ueng_llm_prompt_stream_llama(ueng_llm_llama *ctx, const char *prompt, ueng_llm_piece_fn fn,
+                                 void *user, ueng_llm_stream_stats *stats)
 {
   (void)ctx;
   (void)prompt;
+  (void)fn;
+  (void)user;
+  if (stats)
+    memset(stats, 0, sizeof(*stats));
+  return -1;
+}
+
+int ueng_llm_prompt_batch_llama(ueng_llm_llama *ctx, ueng_llm_batch_item *items, size_t n,
+                                int max_parallel)
+{
+  (void)max_parallel;
+  if (!ctx || (!items && n))
+    return -1;
+  return (int)n; /* unreachable: open never succeeds here */
+}
+
+int ueng_llm_identity_llama(ueng_llm_llama *ctx, char *out, size_t outsz)
+{
+  (void)ctx;
   if (out && outsz)
-  {
     out[0] = '\0';
-  }
   return -1;
 }
 
-void ueng_llm_close(struct ueng_llm_ctx *ctx) { (void)ctx; }
+void ueng_llm_close_llama(ueng_llm_llama *ctx) { (void)ctx; }
 
 #endif /* UENG_WITH_LLAMA_EMBED && HAVE_LLAMA_H */
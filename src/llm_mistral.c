@@ -1,160 +1,818 @@
 /*-----------------------------------------------------------------------------
  * Umicom AuthorEngine AI (uaengine)
  * File: src/llm_mistral.c
- * PURPOSE: Minimal Mistral (Codestral) backend using Chat Completions API.
+ * PURPOSE: Chat Completions client over libcurl (Mistral, OpenAI, Ollama).
  *
  * Created by: Umicom Foundation (https://umicom.foundation/)
- * Author: Sammy Hegab 
+ * Author: Sammy Hegab
  * Date: 28-09-2025
  * License: MIT
  *---------------------------------------------------------------------------*
  * Implementation notes:
  * - Zero external JSON deps to keep footprint small; naive string extraction.
- * - For production, swap to yyjson/cJSON and add streaming support.
- * - Reads configuration from environment variables:
+ * - For production, swap to yyjson/cJSON.
+ * - ueng_llm_prompt_stream asks for "stream":true and reads the server-sent
+ *   events as they arrive: each `data: {...}` line carries one delta.
+ * - One curl easy handle lives as long as the context, so consecutive
+ *   prompts reuse its open connection (no new DNS lookup, TCP or TLS
+ *   handshake). A CURLSH share holds the DNS cache, TLS sessions and
+ *   connection pool, so any other handle attached to it reuses them too.
+ *   URL and header lists are built once in ueng_llm_open.
+ *   ueng_llm_get_conn_stats reports how many requests reused a connection.
+ * - ueng_llm_prompt_batch runs many prompts on one curl_multi loop with a
+ *   bounded number in flight. Each slot keeps its own easy handle on the
+ *   share, so a batch opens at most 'width' connections and reuses them.
+ * - The endpoint (provider name, base URL, key, model, seed field) comes
+ *   from ueng_llm_open_chat; the llm_backend.h functions of this file are
+ *   called by the llm.c dispatcher. Mistral's settings are read here from
+ *   environment variables (llm_openai.c and llm_ollama.c do the same for
+ *   theirs):
  *     MISTRAL_API_KEY        (required)
- *     UENG_MISTRAL_BASE_URL  (optional, default: https://api.mistral.ai)
+ *     UENG_MISTRAL_BASE_URL  (optional, default: https://api.mistral.ai;
+ *                             point it at http://127.0.0.1:PORT for a mock)
  *     UENG_MISTRAL_MODEL     (optional, overrides model passed to open)
  *---------------------------------------------------------------------------*/
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <curl/curl.h>
+#include "ueng/common.h" /* ueng_now_ms */
+#include "ueng/llm_backend.h"
+#include "ueng/trace.h"
 
-typedef struct ueng_llm_ctx {
+struct ueng_llm_chat
+{
+  char *provider;
+  char *seed_key;
   char *base_url;
   char *api_key;
   char *model;
-  int   ctx_tokens;
-} ueng_llm_ctx;
+  int ctx_tokens;
+  char *url;                     /* <base_url>/v1/chat/completions */
+  CURL *h;                       /* kept open between prompts */
+  CURLSH *share;                 /* DNS, TLS sessions, connections */
+  struct curl_slist *hdr;        /* JSON request headers */
+  struct curl_slist *hdr_stream; /* same, plus Accept: text/event-stream */
+  ueng_llm_conn_stats stats;
+};
 
-static char *dupstr(const char *s){
+static char *dupstr(const char *s)
+{
   size_t n = s ? strlen(s) : 0;
-  char *p = (char*)malloc(n+1);
-  if(p){ if(s) memcpy(p,s,n); p[n]=0; }
+  char *p = (char *)malloc(n + 1);
+  if (p)
+  {
+    if (s)
+      memcpy(p, s, n);
+    p[n] = 0;
+  }
   return p;
 }
 
-static const char *getenv_def(const char *k, const char *defv){
+static const char *getenv_def(const char *k, const char *defv)
+{
   const char *v = getenv(k);
   return (v && *v) ? v : defv;
 }
 
 /* Write callback to collect HTTP response into dynamic buffer */
-struct membuf { char *p; size_t n; size_t cap; };
-static size_t mb_write(void *ptr, size_t sz, size_t nm, void *ud){
-  size_t n = sz*nm; struct membuf *b = (struct membuf*)ud;
-  if(!b->p){ b->cap = (n? n:1) + 4096; b->p = (char*)malloc(b->cap); b->n=0; }
-  if(b->n + n + 1 > b->cap){ size_t nc = (b->cap*2) + n + 1; char *np=(char*)realloc(b->p, nc); if(!np) return 0; b->p=np; b->cap=nc; }
-  memcpy(b->p + b->n, ptr, n); b->n += n; b->p[b->n] = 0; return n;
+struct membuf
+{
+  char *p;
+  size_t n;
+  size_t cap;
+};
+
+static size_t mb_write(void *ptr, size_t sz, size_t nm, void *ud)
+{
+  size_t n = sz * nm;
+  struct membuf *b = (struct membuf *)ud;
+  if (b->n + n + 1 > b->cap)
+  {
+    size_t nc = b->cap * 2 + n + 4096;
+    char *np = (char *)realloc(b->p, nc);
+    if (!np)
+      return 0;
+    b->p = np;
+    b->cap = nc;
+  }
+  memcpy(b->p + b->n, ptr, n);
+  b->n += n;
+  b->p[b->n] = 0;
+  return n;
+}
+
+/*------------------------------ context -------------------------------------*/
+
+/* An easy handle on the context's share, with the per-context options set. */
+static CURL *new_handle(ueng_llm_chat *ctx)
+{
+  CURL *h = curl_easy_init();
+  if (!h)
+    return NULL;
+  curl_easy_setopt(h, CURLOPT_SHARE, ctx->share);
+  curl_easy_setopt(h, CURLOPT_URL, ctx->url);
+  curl_easy_setopt(h, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(h, CURLOPT_TCP_KEEPALIVE, 1L);
+  return h;
+}
+
+void ueng_llm_close_chat(ueng_llm_chat *ctx)
+{
+  if (!ctx)
+    return;
+  if (ctx->h)
+    curl_easy_cleanup(ctx->h);
+  if (ctx->share)
+    curl_share_cleanup(ctx->share);
+  curl_slist_free_all(ctx->hdr);
+  curl_slist_free_all(ctx->hdr_stream);
+  free(ctx->url);
+  free(ctx->api_key);
+  free(ctx->base_url);
+  free(ctx->model);
+  free(ctx->seed_key);
+  free(ctx->provider);
+  free(ctx);
 }
 
-ueng_llm_ctx *ueng_llm_open(const char *model_or_null, int ctx_tokens, char *err, size_t errsz){
+ueng_llm_chat *ueng_llm_open_mistral(const char *model_or_null, int ctx_tokens, char *err,
+                                     size_t errsz)
+{
   const char *key = getenv("MISTRAL_API_KEY");
-  if(!key || !*key){
-    if(err && errsz) snprintf(err, errsz, "MISTRAL_API_KEY is not set");
+  if (!key || !*key)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "MISTRAL_API_KEY is not set");
     return NULL;
   }
-  const char *base = getenv_def("UENG_MISTRAL_BASE_URL", "https://api.mistral.ai");
-  const char *ovm  = getenv("UENG_MISTRAL_MODEL");
-  const char *mdl  = (ovm && *ovm) ? ovm : (model_or_null && *model_or_null ? model_or_null : "mistral-small-latest");
+  const char *ovm = getenv("UENG_MISTRAL_MODEL");
+  ueng_llm_chat_endpoint e;
+  e.provider = "mistral";
+  e.base_url = getenv_def("UENG_MISTRAL_BASE_URL", "https://api.mistral.ai");
+  e.api_key = key;
+  e.model = (ovm && *ovm) ? ovm
+            : (model_or_null && *model_or_null) ? model_or_null
+                                                : "mistral-small-latest";
+  e.seed_key = "random_seed";
+  return ueng_llm_open_chat(&e, ctx_tokens, err, errsz);
+}
 
-  ueng_llm_ctx *ctx = (ueng_llm_ctx*)calloc(1, sizeof(*ctx));
-  if(!ctx){ if(err && errsz) snprintf(err, errsz, "alloc failed"); return NULL; }
+ueng_llm_chat *ueng_llm_open_chat(const ueng_llm_chat_endpoint *e, int ctx_tokens, char *err,
+                                  size_t errsz)
+{
+  const char *base = e->base_url, *key = e->api_key;
+  ueng_llm_chat *ctx = (ueng_llm_chat *)calloc(1, sizeof(*ctx));
+  if (!ctx)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "alloc failed");
+    return NULL;
+  }
+  ctx->provider = dupstr(e->provider);
+  ctx->seed_key = dupstr(e->seed_key);
   ctx->api_key = dupstr(key);
   ctx->base_url = dupstr(base);
-  ctx->model = dupstr(mdl);
+  ctx->model = dupstr(e->model);
   ctx->ctx_tokens = ctx_tokens;
-  if(err && errsz) err[0]=0;
+  size_t ulen = strlen(base) + sizeof("/v1/chat/completions");
+  ctx->url = (char *)malloc(ulen);
+  if (ctx->url)
+    snprintf(ctx->url, ulen, "%s/v1/chat/completions", base);
+
+  /* Headers never change for a context; build them once. */
+  size_t alen = strlen(key) + sizeof("Authorization: Bearer ");
+  char *auth = (char *)malloc(alen);
+  if (auth)
+  {
+    snprintf(auth, alen, "Authorization: Bearer %s", key);
+    ctx->hdr = curl_slist_append(ctx->hdr, "Content-Type: application/json");
+    ctx->hdr = curl_slist_append(ctx->hdr, auth);
+    ctx->hdr_stream = curl_slist_append(ctx->hdr_stream, "Content-Type: application/json");
+    ctx->hdr_stream = curl_slist_append(ctx->hdr_stream, "Accept: text/event-stream");
+    ctx->hdr_stream = curl_slist_append(ctx->hdr_stream, auth);
+    free(auth);
+  }
+
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+  ctx->share = curl_share_init();
+  if (ctx->share)
+  {
+    curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 /* 7.57: shared connection pool */
+    curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    ctx->h = new_handle(ctx);
+  }
+  if (!ctx->provider || !ctx->seed_key || !ctx->api_key || !ctx->base_url || !ctx->model ||
+      !ctx->url || !ctx->hdr || !ctx->hdr_stream || !ctx->share || !ctx->h)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "curl/alloc init failed");
+    ueng_llm_close_chat(ctx);
+    return NULL;
+  }
+  if (err && errsz)
+    err[0] = 0;
   return ctx;
 }
 
-/* naive JSON string escaper for basic quotes/backslashes */
-static void json_escape(const char *in, char *out, size_t outsz){
-  size_t j=0;
-  for(size_t i=0; in && in[i] && j+2 < outsz; ++i){
-    unsigned char c = (unsigned char)in[i];
-    if(c=='\\' || c=='\"'){ if(j+2<outsz){ out[j++]='\\'; out[j++]=c; } }
-    else if(c=='\n'){ if(j+2<outsz){ out[j++]='\\'; out[j++]='n'; } }
-    else if(c=='\r'){ if(j+2<outsz){ out[j++]='\\'; out[j++]='r'; } }
-    else { out[j++]=c; }
+int ueng_llm_identity_chat(ueng_llm_chat *ctx, char *out, size_t outsz)
+{
+  if (!ctx || !out || outsz == 0)
+    return -1;
+  int n = snprintf(out, outsz, "%s|%s|%s|max_tokens=512|temperature=0.2", ctx->provider,
+                   ctx->base_url, ctx->model);
+  return (n >= 0 && (size_t)n < outsz) ? 0 : -1;
+}
+
+int ueng_llm_get_conn_stats_chat(ueng_llm_chat *ctx, ueng_llm_conn_stats *out)
+{
+  if (!ctx || !out)
+    return -1;
+  *out = ctx->stats;
+  return 0;
+}
+
+/* Fold one finished transfer into the context's counters. */
+static void count_transfer(ueng_llm_chat *ctx, CURL *h, CURLcode rc)
+{
+  long conns = 0;
+  double t_conn = 0.0, t_tls = 0.0;
+  curl_easy_getinfo(h, CURLINFO_NUM_CONNECTS, &conns);
+  curl_easy_getinfo(h, CURLINFO_CONNECT_TIME, &t_conn);
+  curl_easy_getinfo(h, CURLINFO_APPCONNECT_TIME, &t_tls);
+  ctx->stats.requests++;
+  if (conns > 0)
+  {
+    ctx->stats.connects += conns;
+    ctx->stats.connect_ms += (t_tls > t_conn ? t_tls : t_conn) * 1000.0;
   }
-  if(outsz) out[j<outsz?j:outsz-1]=0;
+  else if (rc == CURLE_OK)
+    ctx->stats.reused++;
 }
 
-int ueng_llm_prompt(ueng_llm_ctx *ctx, const char *prompt, char *out, size_t outsz){
-  if(!ctx || !prompt || !out || outsz==0) return 1;
+typedef size_t (*write_fn)(void *ptr, size_t sz, size_t nm, void *ud);
 
-  CURL *h = curl_easy_init();
-  if(!h){ snprintf(out, outsz, "curl init failed"); return 2; }
+/* One POST on the context's handle; only the body, headers and sink change
+   between requests. Returns the curl code, HTTP status in *code. */
+static CURLcode post(ueng_llm_chat *ctx, const char *body, int stream, write_fn fn, void *ud,
+                     long *code)
+{
+  curl_easy_setopt(ctx->h, CURLOPT_HTTPHEADER, stream ? ctx->hdr_stream : ctx->hdr);
+  curl_easy_setopt(ctx->h, CURLOPT_POSTFIELDS, body);
+  curl_easy_setopt(ctx->h, CURLOPT_WRITEFUNCTION, fn);
+  curl_easy_setopt(ctx->h, CURLOPT_WRITEDATA, ud);
+
+  double t0 = ueng_trace_begin();
+  CURLcode rc = curl_easy_perform(ctx->h);
+  ueng_trace_end_arg("llm", stream ? "chat_stream" : "chat", t0, ctx->model);
+  *code = 0;
+  curl_easy_getinfo(ctx->h, CURLINFO_RESPONSE_CODE, code);
+  count_transfer(ctx, ctx->h, rc);
+  return rc;
+}
 
-  char esc[8192]; json_escape(prompt, esc, sizeof esc);
+/* JSON-escape 'in' into a fresh buffer (caller frees). */
+static char *json_escape(const char *in)
+{
+  size_t n = 0;
+  for (const unsigned char *p = (const unsigned char *)in; *p; ++p)
+    n += (*p == '"' || *p == '\\' || *p == '\n' || *p == '\r' || *p == '\t') ? 2
+         : *p < 0x20                                                        ? 6
+                                                                            : 1;
+  char *out = (char *)malloc(n + 1), *o = out;
+  if (!out)
+    return NULL;
+  for (const unsigned char *p = (const unsigned char *)in; *p; ++p)
+  {
+    if (*p == '"' || *p == '\\')
+    {
+      *o++ = '\\';
+      *o++ = (char)*p;
+    }
+    else if (*p == '\n')
+      o += sprintf(o, "\\n");
+    else if (*p == '\r')
+      o += sprintf(o, "\\r");
+    else if (*p == '\t')
+      o += sprintf(o, "\\t");
+    else if (*p < 0x20)
+      o += sprintf(o, "\\u%04x", *p);
+    else
+      *o++ = (char)*p;
+  }
+  *o = 0;
+  return out;
+}
 
-  char body[9000];
-  snprintf(body, sizeof body,
-    "{"
-      "\"model\":\"%s\","
-      "\"messages\":[{\"role\":\"user\",\"content\":\"%s\"}],"
-      "\"max_tokens\":512,"
-      "\"temperature\":0.2"
-    "}",
-    ctx->model, esc);
+/* Chat Completions request body for one user message (caller frees). */
+/* 's' (optional) overrides max_tokens/temperature and adds top_p and the
+   seed; the API has no top_k. */
+static char *make_body(const ueng_llm_chat *ctx, const char *prompt, int stream,
+                       const ueng_llm_sampling *s)
+{
+  char *esc = json_escape(prompt);
+  if (!esc)
+    return NULL;
+  static const char fmt[] = "{"
+                            "\"model\":\"%s\","
+                            "\"messages\":[{\"role\":\"user\",\"content\":\"%s\"}],"
+                            "\"max_tokens\":%d,"
+                            "\"temperature\":%g%s%s"
+                            "}";
+  int max_tokens = (s && s->max_tokens > 0) ? s->max_tokens : 512;
+  double temp = !s || s->temperature == 0.0f ? 0.2 : (s->temperature < 0 ? 0.0 : s->temperature);
+  char extra[96] = "";
+  if (s && s->top_p > 0.0f && s->top_p < 1.0f)
+    snprintf(extra, sizeof(extra), ",\"top_p\":%g", (double)s->top_p);
+  if (s && s->seed)
+    snprintf(extra + strlen(extra), sizeof(extra) - strlen(extra), ",\"%s\":%u", ctx->seed_key,
+             s->seed);
+  size_t n = sizeof(fmt) + strlen(ctx->model) + strlen(esc) + sizeof(extra) + 64;
+  char *body = (char *)malloc(n);
+  if (body)
+    snprintf(body, n, fmt, ctx->model, esc, max_tokens, temp, extra,
+             stream ? ",\"stream\":true" : "");
+  free(esc);
+  return body;
+}
 
-  char url[512];
-  snprintf(url, sizeof url, "%s/v1/chat/completions", ctx->base_url);
+/*------------------------------ response parsing ----------------------------*/
 
-  struct curl_slist *hdr = NULL;
-  char auth[512]; snprintf(auth, sizeof auth, "Authorization: Bearer %s", ctx->api_key);
-  hdr = curl_slist_append(hdr, "Content-Type: application/json");
-  hdr = curl_slist_append(hdr, auth);
+static int hex4(const char *p, unsigned long *cp)
+{
+  unsigned long v = 0;
+  for (int k = 0; k < 4; ++k)
+  {
+    char c = p[k];
+    int d = (c >= '0' && c <= '9') ? c - '0'
+            : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+            : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+                                     : -1;
+    if (d < 0)
+      return -1;
+    v = v * 16 + (unsigned long)d;
+  }
+  *cp = v;
+  return 0;
+}
 
-  struct membuf mb = {0};
-  curl_easy_setopt(h, CURLOPT_URL, url);
-  curl_easy_setopt(h, CURLOPT_HTTPHEADER, hdr);
-  curl_easy_setopt(h, CURLOPT_POSTFIELDS, body);
-  curl_easy_setopt(h, CURLOPT_WRITEFUNCTION, mb_write);
-  curl_easy_setopt(h, CURLOPT_WRITEDATA, &mb);
-
-  CURLcode rc = curl_easy_perform(h);
-  long code = 0; curl_easy_getinfo(h, CURLINFO_RESPONSE_CODE, &code);
-  curl_slist_free_all(hdr);
-  curl_easy_cleanup(h);
-
-  if(rc != CURLE_OK || code/100 != 2){
-    snprintf(out, outsz, "HTTP %ld (curl rc=%d)", code, (int)rc);
-    if(mb.p){ free(mb.p); }
+static size_t put_utf8(char *out, unsigned long cp)
+{
+  if (cp < 0x80)
+  {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
     return 3;
   }
+  out[0] = (char)(0xF0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+/* Decode the JSON string that starts after its opening quote into 'out'
+   (strlen(p)+1 bytes always suffice). Returns the decoded length. */
+static size_t json_unescape(const char *p, char *out)
+{
+  size_t j = 0;
+  while (*p && *p != '"')
+  {
+    if (*p != '\\' || !p[1])
+    {
+      out[j++] = *p++;
+      continue;
+    }
+    char e = p[1];
+    p += 2;
+    unsigned long cp, lo;
+    switch (e)
+    {
+    case 'n':
+      out[j++] = '\n';
+      break;
+    case 'r':
+      out[j++] = '\r';
+      break;
+    case 't':
+      out[j++] = '\t';
+      break;
+    case 'b':
+      out[j++] = '\b';
+      break;
+    case 'f':
+      out[j++] = '\f';
+      break;
+    case 'u':
+      if (hex4(p, &cp) != 0)
+        break; /* malformed: drop the escape */
+      p += 4;
+      if (cp >= 0xD800 && cp < 0xDC00 && p[0] == '\\' && p[1] == 'u' && hex4(p + 2, &lo) == 0 &&
+          lo >= 0xDC00 && lo < 0xE000)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        p += 6;
+      }
+      j += put_utf8(out + j, cp);
+      break;
+    default: /* \" \\ \/ */
+      out[j++] = e;
+      break;
+    }
+  }
+  out[j] = 0;
+  return j;
+}
+
+typedef struct
+{
+  ueng_llm_piece_fn fn;
+  void *user;
+  ueng_llm_stream_stats *st;
+  double t_start;
+  struct membuf line; /* bytes of the current, incomplete line */
+  char *piece;        /* decode buffer, grown to the longest line */
+  size_t piece_cap;
+  int cancelled;
+} SseState;
+
+/* One complete line of the event stream. Only `data:` lines matter; the
+   final chunk also carries "usage" with the prompt and completion token
+   counts. */
+static int sse_line(SseState *S, char *line)
+{
+  if (strncmp(line, "data:", 5) != 0)
+    return 0;
+  const char *d = line + 5;
+  while (*d == ' ')
+    d++;
+  if (strcmp(d, "[DONE]") == 0)
+    return 0;
+  const char *u = strstr(d, "\"completion_tokens\"");
+  if (u && (u = strchr(u, ':')) != NULL)
+    S->st->tokens = atoi(u + 1);
+  u = strstr(d, "\"prompt_tokens\"");
+  if (u && (u = strchr(u, ':')) != NULL)
+    S->st->prompt_tokens = atoi(u + 1);
+  const char *c = strstr(d, "\"delta\"");
+  c = c ? strstr(c, "\"content\"") : NULL;
+  c = c ? strchr(c, ':') : NULL;
+  if (!c)
+    return 0;
+  c++;
+  while (*c == ' ')
+    c++;
+  if (*c != '"') /* null content (role-only delta) */
+    return 0;
+  size_t need = strlen(c) + 1;
+  if (need > S->piece_cap)
+  {
+    char *np = (char *)realloc(S->piece, need);
+    if (!np)
+      return -1;
+    S->piece = np;
+    S->piece_cap = need;
+  }
+  size_t n = json_unescape(c + 1, S->piece);
+  if (n == 0)
+    return 0;
+  if (S->st->pieces++ == 0)
+    S->st->ttft_ms = ueng_now_ms() - S->t_start;
+  if (S->fn(S->user, S->piece, n) != 0)
+  {
+    S->cancelled = 1;
+    return -1;
+  }
+  return 0;
+}
+
+static size_t sse_write(void *ptr, size_t sz, size_t nm, void *ud)
+{
+  SseState *S = (SseState *)ud;
+  const char *p = (const char *)ptr;
+  size_t n = sz * nm;
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (p[i] != '\n')
+    {
+      if (p[i] != '\r' && mb_write((void *)(p + i), 1, 1, &S->line) != 1)
+        return 0;
+      continue;
+    }
+    if (S->line.p)
+    {
+      int rc = sse_line(S, S->line.p);
+      S->line.n = 0;
+      S->line.p[0] = 0;
+      if (rc != 0)
+        return 0; /* aborts the transfer (CURLE_WRITE_ERROR) */
+    }
+  }
+  return n;
+}
+
+/*------------------------------ blocking prompt -----------------------------*/
 
+/* Find the reply in a Chat Completions response and decode it in place (the
+   UTF-8 form is never longer than the escaped one). Returns 0 with *text and
+   *len set, or 4/5/6 with *text pointing at an error message. */
+static int reply_text(char *json, const char **text, size_t *len)
+{
   /* very naive extraction: look for first "content":" ... " */
-  const char *p = mb.p ? strstr(mb.p, "\"content\"") : NULL;
-  if(!p){ snprintf(out, outsz, "no content in response"); free(mb.p); return 4; }
-  p = strchr(p, ':'); if(!p){ snprintf(out, outsz, "bad json"); free(mb.p); return 5; }
+  char *p = json ? strstr(json, "\"content\"") : NULL;
+  if (!p)
+  {
+    *text = "no content in response";
+    return 4;
+  }
+  p = strchr(p, ':');
+  if (!p)
+  {
+    *text = "bad json";
+    return 5;
+  }
   p++;
-  while(*p && (*p==' ')) p++;
-  if(*p!='\"'){ snprintf(out, outsz, "unexpected json"); free(mb.p); return 6; }
-  p++; /* inside string */
-  size_t j=0;
-  while(*p && j+1<outsz){
-    if(*p=='\\' && *(p+1)){ /* basic escapes */
-      char e = *(p+1);
-      if(e=='n'){ out[j++]='\n'; p+=2; continue; }
-      if(e=='r'){ out[j++]='\r'; p+=2; continue; }
-      if(e=='\"'){ out[j++]='\"'; p+=2; continue; }
-      if(e=='\\'){ out[j++]='\\'; p+=2; continue; }
-    }
-    if(*p=='\"'){ break; }
-    out[j++]=*p++;
+  while (*p == ' ')
+    p++;
+  if (*p != '"')
+  {
+    *text = "unexpected json";
+    return 6;
+  }
+  *len = json_unescape(p + 1, p);
+  *text = p;
+  return 0;
+}
+
+int ueng_llm_prompt_chat(ueng_llm_chat *ctx, const char *prompt, char *out, size_t outsz)
+{
+  if (!ctx || !prompt || !out || outsz == 0)
+    return 1;
+  out[0] = 0;
+  char *body = make_body(ctx, prompt, 0, NULL);
+  if (!body)
+  {
+    snprintf(out, outsz, "out of memory");
+    return 2;
   }
-  out[j]=0;
+  struct membuf mb = {0};
+  long code = 0;
+  CURLcode rc = post(ctx, body, 0, mb_write, &mb, &code);
+  free(body);
+
+  if (rc != CURLE_OK || code / 100 != 2)
+  {
+    snprintf(out, outsz, "HTTP %ld (curl rc=%d)", code, (int)rc);
+    free(mb.p);
+    return 3;
+  }
+
+  const char *text = NULL;
+  size_t n = 0;
+  int st = reply_text(mb.p, &text, &n);
+  if (st != 0)
+  {
+    snprintf(out, outsz, "%s", text);
+    free(mb.p);
+    return st;
+  }
+  if (n >= outsz)
+  {
+    n = outsz - 1;
+    while (n > 0 && ((unsigned char)text[n] & 0xC0) == 0x80)
+      n--;
+  }
+  memcpy(out, text, n);
+  out[n] = 0;
   free(mb.p);
   return 0;
 }
 
-void ueng_llm_close(ueng_llm_ctx *ctx){
-  if(!ctx) return;
-  free(ctx->api_key);
-  free(ctx->base_url);
-  free(ctx->model);
-  free(ctx);
+/*------------------------------ streaming (SSE) -----------------------------*/
+
+int ueng_llm_prompt_stream_chat(ueng_llm_chat *ctx, const char *prompt, ueng_llm_piece_fn fn,
+                                void *user, ueng_llm_stream_stats *stats)
+{
+  ueng_llm_stream_stats st;
+  memset(&st, 0, sizeof(st));
+  if (stats)
+    *stats = st;
+  if (!ctx || !prompt || !fn)
+    return -1;
+
+  char *body = make_body(ctx, prompt, 1, NULL);
+  if (!body)
+    return -2;
+
+  SseState S;
+  memset(&S, 0, sizeof(S));
+  S.fn = fn;
+  S.user = user;
+  S.st = &st;
+  S.t_start = ueng_now_ms();
+  long code = 0;
+  CURLcode rc = post(ctx, body, 1, sse_write, &S, &code);
+  free(body);
+  /* A stream cut without a trailing newline still ends its last event. */
+  if (rc == CURLE_OK && !S.cancelled && S.line.n > 0)
+    (void)sse_line(&S, S.line.p);
+  free(S.line.p);
+  free(S.piece);
+  st.total_ms = ueng_now_ms() - S.t_start;
+  if (stats)
+    *stats = st;
+
+  if (S.cancelled)
+    return UENG_LLM_CANCELLED;
+  if (rc != CURLE_OK || code / 100 != 2)
+  {
+    fprintf(stderr, "[%s] ERROR: HTTP %ld (curl rc=%d)\n", ctx->provider, code, (int)rc);
+    return -3;
+  }
+  return 0;
+}
+
+/*------------------------------ batch (curl_multi) --------------------------*/
+
+typedef struct
+{
+  CURL *h; /* created on first use, kept for the slot's next request */
+  struct membuf mb;
+  char *body;
+  size_t item;
+  double t0;
+  int busy;
+} Slot;
+
+static int batch_width(int max_parallel)
+{
+  if (max_parallel > 0)
+    return max_parallel;
+  const char *v = getenv("UENG_LLM_PARALLEL");
+  int w = v ? atoi(v) : 0;
+  return w > 0 ? w : 8;
+}
+
+static int batch_start(ueng_llm_chat *ctx, CURLM *m, Slot *sl, size_t i,
+                       const ueng_llm_batch_item *it)
+{
+  const char *prompt = it->prompt;
+  if (!prompt)
+    return 1;
+  if (!sl->h)
+  {
+    sl->h = new_handle(ctx);
+    if (!sl->h)
+      return 2;
+    curl_easy_setopt(sl->h, CURLOPT_HTTPHEADER, ctx->hdr);
+    curl_easy_setopt(sl->h, CURLOPT_WRITEFUNCTION, mb_write);
+    curl_easy_setopt(sl->h, CURLOPT_WRITEDATA, &sl->mb);
+    curl_easy_setopt(sl->h, CURLOPT_PRIVATE, (char *)sl);
+  }
+  free(sl->body);
+  sl->body = make_body(ctx, prompt, 0, it->sampling);
+  if (!sl->body)
+    return 2;
+  sl->mb.n = 0;
+  if (sl->mb.p)
+    sl->mb.p[0] = 0;
+  curl_easy_setopt(sl->h, CURLOPT_POSTFIELDS, sl->body);
+  sl->item = i;
+  sl->t0 = ueng_now_ms();
+  if (curl_multi_add_handle(m, sl->h) != CURLM_OK)
+    return 2;
+  sl->busy = 1;
+  return 0;
+}
+
+static void batch_finish(ueng_llm_chat *ctx, Slot *sl, CURLcode rc, ueng_llm_batch_item *it)
+{
+  it->latency_ms = ueng_now_ms() - sl->t0;
+  curl_easy_getinfo(sl->h, CURLINFO_RESPONSE_CODE, &it->http_status);
+  count_transfer(ctx, sl->h, rc);
+  if (rc != CURLE_OK || it->http_status / 100 != 2)
+  {
+    it->status = 3;
+    return;
+  }
+  const char *text = NULL;
+  size_t n = 0;
+  it->status = reply_text(sl->mb.p, &text, &n);
+  if (it->status != 0)
+    return;
+  it->text = (char *)malloc(n + 1);
+  if (!it->text)
+  {
+    it->status = 2;
+    return;
+  }
+  memcpy(it->text, text, n);
+  it->text[n] = 0;
+}
+
+int ueng_llm_prompt_batch_chat(ueng_llm_chat *ctx, ueng_llm_batch_item *items, size_t n,
+                               int max_parallel)
+{
+  if (!ctx || (!items && n))
+    return -1;
+  for (size_t i = 0; i < n; ++i)
+  {
+    items[i].text = NULL;
+    items[i].status = 0;
+    items[i].http_status = 0;
+    items[i].latency_ms = 0.0;
+  }
+  if (n == 0)
+    return 0;
+  size_t width = (size_t)batch_width(max_parallel);
+  if (width > n)
+    width = n;
+  CURLM *m = curl_multi_init();
+  Slot *slots = (Slot *)calloc(width, sizeof(Slot));
+  if (!m || !slots)
+  {
+    if (m)
+      curl_multi_cleanup(m);
+    free(slots);
+    return -1;
+  }
+
+  double t0 = ueng_trace_begin();
+  int failed = 0;
+  size_t next = 0, active = 0;
+  while (next < n || active > 0)
+  {
+    /* Keep every free slot busy while prompts are waiting. */
+    for (size_t s = 0; s < width && next < n; ++s)
+    {
+      if (slots[s].busy)
+        continue;
+      size_t i = next++;
+      int st = batch_start(ctx, m, &slots[s], i, &items[i]);
+      if (st != 0)
+      {
+        items[i].status = st;
+        failed++;
+        continue;
+      }
+      active++;
+    }
+    if (active == 0)
+      break;
+
+    int running = 0;
+    curl_multi_perform(m, &running);
+    CURLMsg *msg;
+    int left = 0;
+    int finished = 0;
+    while ((msg = curl_multi_info_read(m, &left)) != NULL)
+    {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+      char *priv = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+      Slot *sl = (Slot *)priv;
+      CURLcode rc = msg->data.result;
+      curl_multi_remove_handle(m, sl->h);
+      batch_finish(ctx, sl, rc, &items[sl->item]);
+      if (items[sl->item].status != 0)
+        failed++;
+      sl->busy = 0;
+      active--;
+      finished++;
+    }
+    if (!finished && active > 0)
+#if LIBCURL_VERSION_NUM >= 0x074200 /* 7.66 */
+      curl_multi_poll(m, NULL, 0, 1000, NULL);
+#else
+      curl_multi_wait(m, NULL, 0, 1000, NULL);
+#endif
+  }
+  ueng_trace_end_arg("llm", "chat_batch", t0, ctx->model);
+
+  for (size_t s = 0; s < width; ++s)
+  {
+    if (slots[s].h)
+      curl_easy_cleanup(slots[s].h);
+    free(slots[s].mb.p);
+    free(slots[s].body);
+  }
+  free(slots);
+  curl_multi_cleanup(m);
+  return failed;
 }
@@ -1,36 +1,53 @@
 /*-----------------------------------------------------------------------------
  * Umicom AuthorEngine AI (uaengine)
  * File: src/llm_ollama.c
- * PURPOSE: Placeholder/stub translation unit for the Ollama backend.
+ * PURPOSE: Ollama provider: settings for the Chat Completions client.
  *
- * Why this file exists:
- *   - CMakeLists.txt enumerates this source file so the build system
- *     stays stable across platforms even when a backend’s implementation
- *     is not yet wired up.
- *   - We intentionally DO NOT define ueng_llm_open/ueng_llm_prompt/
- *     ueng_llm_close here to avoid duplicate symbol collisions with the
- *     current facade (implemented in other compilation units).
- *
- * How to implement the real backend later:
- *   1) Provide provider‑specific helpers (e.g. ueng_llm_open_<suffix>,
- *      ueng_llm_prompt_<suffix>, ueng_llm_close_<suffix>).
- *   2) Have the facade dispatch to one active backend based on
- *      build flags and/or environment (UENG_LLM_PROVIDER).
- *   3) Keep all public API symbols defined in exactly one place.
- *
- * Notes for contributors:
- *   - This file compiles cleanly and is intentionally minimal.
- *   - It keeps the project linkable while we stage the full backend.
- *   - Please keep Umicom credit header and add rich comments if you expand.
+ * Ollama serves the OpenAI-style /v1/chat/completions API (with streaming),
+ * so it shares the HTTP client in llm_mistral.c; this unit only reads the
+ * Ollama settings and opens that client. llm.c calls it for
+ * UENG_LLM_PROVIDER=ollama.
+ * Environment:
+ *   UENG_OLLAMA_HOST (or OLLAMA_HOST)  base URL, default http://127.0.0.1:11434
+ *   UENG_OLLAMA_MODEL                  overrides the model passed to open
+ * No key is needed; a placeholder bearer token is sent.
+ * Built only with UAENG_ENABLE_OLLAMA (CMake option, ON by default).
  *
  * Created by: Umicom Foundation (https://umicom.foundation/)
  * Author: Sammy Hegab
  * Date: 25-09-2025
  * License: MIT
  *---------------------------------------------------------------------------*/
-#include "ueng/llm.h"
-#include <stddef.h>
+#include "ueng/llm_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-// No public API symbols defined here on purpose.
-// See notes above. Real implementation will live behind provider-specific
-// entry points to keep linkage unambiguous on all toolchains.
+ueng_llm_chat *ueng_llm_open_ollama(const char *model, int ctx_tokens, char *err, size_t errsz)
+{
+#ifdef UAENG_ENABLE_OLLAMA
+  const char *host = getenv("UENG_OLLAMA_HOST");
+  if (!host || !*host)
+    host = getenv("OLLAMA_HOST");
+  char url[512];
+  if (host && *host && !strstr(host, "://")) /* OLLAMA_HOST is often just host:port */
+  {
+    snprintf(url, sizeof(url), "http://%s", host);
+    host = url;
+  }
+  const char *ovm = getenv("UENG_OLLAMA_MODEL");
+  ueng_llm_chat_endpoint e;
+  e.provider = "ollama";
+  e.base_url = (host && *host) ? host : "http://127.0.0.1:11434";
+  e.api_key = "ollama";
+  e.model = (ovm && *ovm) ? ovm : (model && *model) ? model : "qwen2.5:3b";
+  e.seed_key = "seed";
+  return ueng_llm_open_chat(&e, ctx_tokens, err, errsz);
+#else
+  (void)model;
+  (void)ctx_tokens;
+  if (err && errsz)
+    snprintf(err, errsz, "Ollama backend not built (UAENG_ENABLE_OLLAMA=OFF)");
+  return NULL;
+#endif
+}
@@ -1,36 +1,51 @@
 /*-----------------------------------------------------------------------------
  * Umicom AuthorEngine AI (uaengine)
  * File: src/llm_openai.c
- * PURPOSE: Placeholder/stub translation unit for the OpenAI backend.
+ * PURPOSE: OpenAI provider: settings for the Chat Completions client.
  *
- * Why this file exists:
- *   - CMakeLists.txt enumerates this source file so the build system
- *     stays stable across platforms even when a backend’s implementation
- *     is not yet wired up.
- *   - We intentionally DO NOT define ueng_llm_open/ueng_llm_prompt/
- *     ueng_llm_close here to avoid duplicate symbol collisions with the
- *     current facade (implemented in other compilation units).
- *
- * How to implement the real backend later:
- *   1) Provide provider‑specific helpers (e.g. ueng_llm_open_<suffix>,
- *      ueng_llm_prompt_<suffix>, ueng_llm_close_<suffix>).
- *   2) Have the facade dispatch to one active backend based on
- *      build flags and/or environment (UENG_LLM_PROVIDER).
- *   3) Keep all public API symbols defined in exactly one place.
- *
- * Notes for contributors:
- *   - This file compiles cleanly and is intentionally minimal.
- *   - It keeps the project linkable while we stage the full backend.
- *   - Please keep Umicom credit header and add rich comments if you expand.
+ * The HTTP work (streaming, connection reuse, batches) is shared with the
+ * other hosted providers in llm_mistral.c; this unit only reads the OpenAI
+ * settings and opens that client. llm.c calls it for UENG_LLM_PROVIDER=openai.
+ * Environment:
+ *   OPENAI_API_KEY        (required)
+ *   UENG_OPENAI_BASE_URL  (optional, default https://api.openai.com; any
+ *                          OpenAI-compatible server works)
+ *   UENG_OPENAI_MODEL     (optional, overrides the model passed to open)
+ * Built only with UAENG_ENABLE_OPENAI (CMake option, ON by default).
  *
  * Created by: Umicom Foundation (https://umicom.foundation/)
  * Author: Sammy Hegab
  * Date: 25-09-2025
  * License: MIT
  *---------------------------------------------------------------------------*/
-#include "ueng/llm.h"
-#include <stddef.h>
+#include "ueng/llm_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
 
-// No public API symbols defined here on purpose.
-// See notes above. Real implementation will live behind provider-specific
-// entry points to keep linkage unambiguous on all toolchains.
+ueng_llm_chat *ueng_llm_open_openai(const char *model, int ctx_tokens, char *err, size_t errsz)
+{
+#ifdef UAENG_ENABLE_OPENAI
+  const char *key = getenv("OPENAI_API_KEY");
+  if (!key || !*key)
+  {
+    if (err && errsz)
+      snprintf(err, errsz, "OPENAI_API_KEY is not set");
+    return NULL;
+  }
+  const char *base = getenv("UENG_OPENAI_BASE_URL");
+  const char *ovm = getenv("UENG_OPENAI_MODEL");
+  ueng_llm_chat_endpoint e;
+  e.provider = "openai";
+  e.base_url = (base && *base) ? base : "https://api.openai.com";
+  e.api_key = key;
+  e.model = (ovm && *ovm) ? ovm : (model && *model) ? model : "gpt-4o-mini";
+  e.seed_key = "seed";
+  return ueng_llm_open_chat(&e, ctx_tokens, err, errsz);
+#else
+  (void)model;
+  (void)ctx_tokens;
+  if (err && errsz)
+    snprintf(err, errsz, "OpenAI backend not built (UAENG_ENABLE_OPENAI=OFF)");
+  return NULL;
+#endif
+}
@@ -32,9 +32,20 @@
      - On export failure, a short warning is printed and the first lines of pandoc_err.txt are
    echoed.
    ========================================================================================= */
+#include "ueng/bookdiff.h" /* chapter-level diff between two builds */
+#include "ueng/bookidx.h" /* binary book index (config, chapters, outline) */
 #include "ueng/common.h" /* filesystem helpers, shell exec, slugify, etc. */
+#include "ueng/dedup.h"  /* near-duplicate chapter detection */
+#include "ueng/epub.h"   /* native EPUB 3 packager */
 #include "ueng/fs.h"     /* pack_book_draft, write_site_index, theme copy */
+#include "ueng/ingest.h" /* dropzone -> workspace/chapters pipeline */
+#include "ueng/multibook.h" /* build/export/render --all */
+#include "ueng/pool.h"   /* ueng_jobs, ueng_set_jobs (-j N) */
+#include "ueng/search.h" /* site full-text search index */
 #include "ueng/serve.h"  /* tiny HTTP server entry point */
+#include "ueng/store.h"  /* content-addressed output store */
+#include "ueng/textstats.h" /* word/sentence/paragraph counts */
+#include "ueng/trace.h"     /* --trace spans */
 #include "ueng/version.h"
 
 /* If the build system ever forgets to define UENG_VERSION_STR, fall back. */
@@ -49,6 +60,8 @@ typedef struct
   char title[256];
   char author[256];
   int ingest_on_build; /* 0/1 */
+  DedupMode dedup;        /* near-duplicate chapters: off / flag / collapse */
+  double dedup_threshold; /* MinHash similarity, 0 = module default */
 } BookCfg;
 
 /* Defaults used if book.yaml is missing or a field is absent. */
@@ -58,43 +71,18 @@ static void cfg_defaults(BookCfg *c)
   strcpy(c->title, "My New Book");
   strcpy(c->author, "Anonymous");
   c->ingest_on_build = 0;
+  c->dedup = DEDUP_FLAG;
+  c->dedup_threshold = 0.0;
 }
 
 /*-------------------------- tiny YAML-ish parsing --------------------------*/
 /* We intentionally avoid a YAML library to keep the binary tiny/portable. */
 
-static void trim_eol(char *s)
-{
-  size_t n = strlen(s);
-  while (n && (s[n - 1] == '\r' || s[n - 1] == '\n'))
-    s[--n] = '\0';
-}
-
-/* Parse lines like:  key: value   → copies value into out (bounded). */
-static void parse_kv_line(const char *line, const char *key, char *out, size_t outsz)
-{
-  size_t klen = strlen(key);
-  if (strncmp(line, key, klen) == 0)
-  {
-    const char *p = line + klen;
-    while (*p == ' ' || *p == '\t')
-      p++;
-    if (*p == ':')
-      p++;
-    while (*p == ' ' || *p == '\t')
-      p++;
-    strncpy(out, p, outsz - 1);
-    out[outsz - 1] = '\0';
-  }
-}
-
 /* Parse boolean-ish: true/false/1/0/yes/no/on/off (case-insensitive). */
-static int parse_bool_line(const char *line, const char *key, int *out_bool)
+static int parse_bool_value(const char *value, int *out_bool)
 {
   char buf[64] = {0};
-  parse_kv_line(line, key, buf, sizeof(buf));
-  if (!buf[0])
-    return 0;
+  snprintf(buf, sizeof(buf), "%s", value);
   for (char *p = buf; *p; ++p)
     *p = (char)tolower((unsigned char)*p);
   if (strcmp(buf, "true") == 0 || strcmp(buf, "1") == 0 || strcmp(buf, "yes") == 0 ||
@@ -112,96 +100,60 @@ static int parse_bool_line(const char *line, const char *key, int *out_bool)
   return 0;
 }
 
-/* Read minimal config from book.yaml if present. */
-static void read_book_cfg(BookCfg *out)
+/* Apply one book.yaml "key: value" pair (keys match whole). */
+static void cfg_apply(void *ud, const char *key, const char *value)
 {
-  cfg_defaults(out);
-  FILE *f = ueng_fopen("book.yaml", "rb");
-  if (!f)
-    return; /* keep defaults */
-  char line[1024];
-  while (fgets(line, sizeof(line), f))
-  {
-    trim_eol(line);
-    parse_kv_line(line, "title", out->title, sizeof(out->title));
-    parse_kv_line(line, "author", out->author, sizeof(out->author));
-    (void)parse_bool_line(line, "ingest_on_build", &out->ingest_on_build);
-  }
-  fclose(f);
+  BookCfg *c = (BookCfg *)ud;
+  if (strcmp(key, "title") == 0)
+    snprintf(c->title, sizeof(c->title), "%s", value);
+  else if (strcmp(key, "author") == 0)
+    snprintf(c->author, sizeof(c->author), "%s", value);
+  else if (strcmp(key, "ingest_on_build") == 0)
+    (void)parse_bool_value(value, &c->ingest_on_build);
+  else if (strcmp(key, "dedup") == 0 && value[0])
+    c->dedup = dedup_mode_parse(value);
+  else if (strcmp(key, "dedup_threshold") == 0 && value[0])
+    c->dedup_threshold = atof(value);
 }
 
-/*---------------------------- light HTML export ----------------------------*/
-/* Fallback exporter used when Pandoc isn't available or fails. */
-
-static void html_escape_into(const char *in, FILE *out)
+/* Read minimal config: from the book index when it is current for book.yaml
+   (no parsing at all), otherwise straight from book.yaml. */
+static void read_book_cfg(BookCfg *out, const BookIndex *ix)
 {
-  for (const unsigned char *p = (const unsigned char *)in; *p; ++p)
+  cfg_defaults(out);
+  if (ix && bookidx_config_current(ix, "book.yaml"))
   {
-    switch (*p)
-    {
-    case '&':
-      fputs("&amp;", out);
-      break;
-    case '<':
-      fputs("&lt;", out);
-      break;
-    case '>':
-      fputs("&gt;", out);
-      break;
-    default:
-      fputc(*p, out);
-      break;
-    }
+    const char *k, *v;
+    for (size_t i = 0; bookidx_cfg_at(ix, i, &k, &v) == 0; ++i)
+      cfg_apply(out, k, v);
+    return;
   }
+  (void)bookidx_yaml_each("book.yaml", cfg_apply, out); /* missing file: keep defaults */
 }
 
-static int light_export_html(const char *title, const char *author, const char *html_dir,
-                             const char *md_path, char *out_html, size_t out_html_sz)
+/* Map workspace/.cache/book.idx, bringing it up to date first when
+   'refresh' is set (a NULL tag refreshes quietly). Returns 0 when 'ix' is
+   usable; close it either way. */
+static int open_book_index(const char *tag, int refresh, BookIndex *ix)
 {
-  if (mkpath(html_dir) != 0)
+  if (refresh && dir_exists("workspace/chapters"))
   {
-    fprintf(stderr, "[export] ERROR: cannot create %s\n", html_dir);
-    return 1;
+    BookIdxOptions bo;
+    memset(&bo, 0, sizeof(bo));
+    bo.index_path = "workspace/.cache/book.idx";
+    bo.book_yaml = "book.yaml";
+    bo.chapters_dir = "workspace/chapters";
+    BookIdxStats bs;
+    double t0 = ueng_trace_begin();
+    int urc = bookidx_update(&bo, &bs);
+    ueng_trace_end("stage", "book_index", t0);
+    if (urc != 0)
+      fprintf(stderr, "[%s] WARN: could not update the book index\n", tag ? tag : "index");
+    else if (tag)
+      printf("[%s] index: %zu chapters (%zu read, %zu unchanged), %zu headings, %.0f ms\n", tag,
+             bs.chapters, bs.scanned, bs.reused, bs.headings, bs.ms);
   }
-  char rel_css[32];
-  rel_css[0] = '\0';
-  (void)copy_theme_into_html_dir(html_dir, rel_css, sizeof(rel_css)); /* writes style.css */
-
-  snprintf(out_html, out_html_sz, "%s%cbook.html", html_dir, PATH_SEP);
-  FILE *in = ueng_fopen(md_path, "rb");
-  if (!in)
-  {
-    fprintf(stderr, "[export] ERROR: missing %s\n", md_path);
-    return 1;
-  }
-  FILE *out = ueng_fopen(out_html, "wb");
-  if (!out)
-  {
-    fclose(in);
-    fprintf(stderr, "[export] ERROR: cannot write %s\n", out_html);
-    return 1;
-  }
-
-  fputs("<!doctype html><meta charset=\"utf-8\">", out);
-  fprintf(out, "<title>%s - %s</title>", title, author);
-  fprintf(out, "<link rel=\"stylesheet\" href=\"style.css\">");
-  fputs("<body style=\"margin:2rem auto;max-width:860px;font-family:system-ui,-apple-system,Segoe "
-        "UI,Roboto,Ubuntu,Arial,sans-serif;line-height:1.6\">",
-        out);
-  fprintf(out, "<h1>%s</h1><p>Author: %s</p>", title, author);
-  fputs("<pre>", out);
-  char buf[8192];
-  size_t n;
-  while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
-  {
-    buf[n] = '\0';
-    html_escape_into(buf, out);
-  }
-  fputs("</pre></body>", out);
-  fclose(in);
-  fclose(out);
-  printf("[export] light HTML: %s\n", out_html);
-  return 0;
+  return bookidx_open("workspace/.cache/book.idx", ix);
 }
 
 /*-------------------------------- Commands ---------------------------------*/
@@ -211,10 +163,11 @@ static int cmd_init(void)
 {
   (void)write_text_file_if_absent("book.yaml", "title: My New Book\n"
                                                "author: Anonymous\n"
-                                               "ingest_on_build: false\n");
+                                               "ingest_on_build: false\n"
+                                               "dedup: flag\n");
 
   BookCfg cfg;
-  read_book_cfg(&cfg);
+  read_book_cfg(&cfg, NULL);
   char slug[256];
   slugify(cfg.title, slug, sizeof(slug));
 
@@ -226,24 +179,95 @@ static int cmd_init(void)
   return 0;
 }
 
-/* ingest: placeholder hook for OCR/cleaning/organizing into workspace. */
+/* Run near-duplicate detection over workspace/chapters and print clusters;
+   in collapse mode the names to leave out are appended to 'skip'. */
+static void scan_duplicates(const BookCfg *cfg, const char *tag, StrList *skip)
+{
+  if (cfg->dedup == DEDUP_OFF || !dir_exists("workspace/chapters"))
+    return;
+  DedupReport dr;
+  double t0 = ueng_trace_begin();
+  int drc = dedup_scan("workspace/chapters", "workspace/.cache/minhash.bin", cfg->dedup_threshold,
+                       0, &dr);
+  ueng_trace_end("stage", "dedup", t0);
+  if (drc != 0)
+  {
+    fprintf(stderr, "[%s] WARN: near-duplicate scan failed\n", tag);
+    return;
+  }
+  dedup_print(&dr, tag, cfg->dedup);
+  if (skip && cfg->dedup == DEDUP_COLLAPSE)
+    (void)dedup_dropped(&dr, skip);
+  dedup_report_free(&dr);
+}
+
+/* ingest: decode/normalize dropzone/ files into workspace/chapters (see ingest.c). */
 static int cmd_ingest(void)
 {
-  puts("[ingest] nothing to do (stub).");
-  return 0;
+  if (!dir_exists("dropzone"))
+  {
+    puts("[ingest] no dropzone/ folder - nothing to do.");
+    return 0;
+  }
+  IngestOptions io;
+  memset(&io, 0, sizeof(io));
+  io.progress = 1;
+  IngestStats is;
+  double t0 = ueng_trace_begin();
+  int rc = ingest_run(&io, &is);
+  ueng_trace_end("stage", "ingest", t0);
+  printf("[ingest] %zu found, %zu ingested, %zu unchanged, %zu duplicate, %zu failed "
+         "(%.1f MiB in, %.0f ms)\n",
+         is.found, is.ingested, is.unchanged, is.duplicate, is.failed,
+         (double)is.bytes_in / (1024.0 * 1024.0), is.ms);
+  if (is.transcoded)
+    printf("[ingest] note: %zu files were not UTF-8 and were transcoded\n", is.transcoded);
+  BookCfg cfg;
+  read_book_cfg(&cfg, NULL);
+  scan_duplicates(&cfg, "ingest", NULL);
+  if (rc != 0)
+    fprintf(stderr, "[ingest] ERROR: nothing could be ingested\n");
+  return rc;
+}
+
+/* Fold an output tree into the object store (see store.h) and report. */
+static void commit_outputs(const char *tag, const char *root)
+{
+  if (!store_enabled())
+    return;
+  StoreStats ss;
+  double t0 = ueng_trace_begin();
+  int rc = store_commit_tree(root, &ss);
+  ueng_trace_end_arg("stage", "store_commit", t0, root);
+  if (rc != 0)
+  {
+    fprintf(stderr, "[%s] WARN: could not update the output store\n", tag);
+    return;
+  }
+  printf("[%s] store: %zu files, %zu shared (%.1f MiB saved), %zu new objects, %.0f ms\n", tag,
+         ss.files, ss.linked, (double)ss.bytes_saved / (1024.0 * 1024.0), ss.new_objects, ss.ms);
+  if (ss.unlinkable)
+    printf("[%s] store: %zu files could not be linked (store on another filesystem?)\n", tag,
+           ss.unlinkable);
 }
 
 /* build: creates outputs/<slug>/<YYYY-MM-DD>/, packs draft, seeds site, HTML theme. */
 static int cmd_build(void)
 {
   BookCfg cfg;
-  read_book_cfg(&cfg);
+  BookIndex ix;
+  (void)open_book_index("build", 0, &ix);
+  read_book_cfg(&cfg, &ix);
 
   if (cfg.ingest_on_build)
   {
     puts("[build] ingest_on_build: true - running ingest...");
     (void)cmd_ingest(); /* ignore failure for now */
   }
+  /* Chapter list, outline and stats: reuse what did not change since the
+     last run, read the rest. */
+  bookidx_close(&ix);
+  (void)open_book_index("build", 1, &ix);
 
   char slug[256];
   slugify(cfg.title, slug, sizeof(slug));
@@ -254,6 +278,10 @@ static int cmd_build(void)
   char root[640];
   snprintf(root, sizeof(root), "outputs%c%s%c%s", PATH_SEP, slug, PATH_SEP, day);
   mkpath(root);
+  /* Files may be links into the object store; give them private copies
+     before anything below rewrites them. */
+  if (store_enabled())
+    (void)store_detach_tree(root);
 
   /* Common subfolders we expect to populate. */
   const char *sub[] = {"pdf", "docx", "epub", "html", "md", "cover", "video-scripts", "site", NULL};
@@ -268,11 +296,38 @@ static int cmd_build(void)
   generate_cover_svg(cfg.title, cfg.author, slug);
   generate_frontcover_md(cfg.title, cfg.author, slug);
 
+  /* Near-duplicate chapters (revisions of the same text): report them and,
+     with "dedup: collapse", build only the newest of each. */
+  StrList skip, chapters;
+  sl_init(&skip);
+  sl_init(&chapters);
+  scan_duplicates(&cfg, "build", &skip);
+  if (ix.map.data)
+    (void)bookidx_chapter_names(&ix, &chapters);
+  else
+    (void)list_md_dir("workspace/chapters", &chapters);
+  bookidx_close(&ix);
+  if (skip.count)
+  {
+    UengStrTab drop;
+    memset(&drop, 0, sizeof(drop));
+    for (size_t i = 0; i < skip.count; ++i)
+      (void)ueng_strtab_intern(&drop, skip.items[i], strlen(skip.items[i]));
+    size_t kept = 0;
+    for (size_t i = 0; i < chapters.count; ++i)
+      if (!ueng_strtab_find(&drop, chapters.items[i], strlen(chapters.items[i])))
+        chapters.items[kept++] = chapters.items[i];
+    chapters.count = kept;
+    ueng_strtab_free(&drop);
+  }
+  sl_free(&skip);
+
   /* Draft + site packing (see fs.c). */
   int has_draft = 0;
-  if (pack_book_draft(cfg.title, root, &has_draft) != 0)
+  if (pack_book_draft(cfg.title, root, &chapters, &has_draft) != 0)
   {
     fprintf(stderr, "[build] ERROR: could not pack draft\n");
+    sl_free(&chapters);
     return 1;
   }
 
@@ -283,6 +338,38 @@ static int cmd_build(void)
   rel_css_tmp[0] = '\0';
   (void)copy_theme_into_html_dir(html_dir, rel_css_tmp, sizeof(rel_css_tmp));
 
+  /* Native EPUB straight from the chapters (no pandoc needed). */
+  {
+    char epub_path[1024], css_path[768];
+    snprintf(epub_path, sizeof(epub_path), "%s%cepub%c%s.epub", root, PATH_SEP, PATH_SEP,
+             slug[0] ? slug : "book");
+    snprintf(css_path, sizeof(css_path), "%s%cstyle.css", html_dir, PATH_SEP);
+    EpubOptions eo;
+    memset(&eo, 0, sizeof(eo));
+    eo.title = cfg.title;
+    eo.author = cfg.author;
+    eo.slug = slug;
+    eo.chapters_dir = "workspace/chapters";
+    eo.cover_svg = "workspace/cover.svg";
+    eo.css_path = css_path;
+    eo.out_path = epub_path;
+    eo.chapters = &chapters;
+    EpubStats es;
+    double t0 = ueng_trace_begin();
+    int erc = epub_write_book(&eo, &es);
+    ueng_trace_end_arg("stage", "epub", t0, epub_path);
+    if (erc == 0)
+    {
+      printf("[build] epub: %s (%zu chapters, %.1f KiB, %.0f ms)\n", epub_path, es.chapters,
+             (double)es.bytes_out / 1024.0, es.ms);
+    }
+    else
+    {
+      fprintf(stderr, "[build] WARN: could not write EPUB\n");
+    }
+  }
+  sl_free(&chapters);
+
   /* Make a simple site landing page with links. */
   char stamp[64];
   time_t now = time(NULL);
@@ -290,8 +377,41 @@ static int cmd_build(void)
   strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M UTC", tm);
   char site_dir[640];
   snprintf(site_dir, sizeof(site_dir), "%s%csite", root, PATH_SEP);
-  if (write_site_index(site_dir, cfg.title, cfg.author, slug, stamp, /*has_cover=*/1, has_draft) !=
-      0)
+
+  /* Full-text search: index the draft at build time so the static site (and
+     `serve`) never has to scan the manuscript. md/book-draft.md is the copy
+     the index points at for snippets. */
+  int has_search = 0;
+  if (has_draft)
+  {
+    char md_copy[768], idx_path[768];
+    snprintf(md_copy, sizeof(md_copy), "%s%cmd%cbook-draft.md", root, PATH_SEP, PATH_SEP);
+    snprintf(idx_path, sizeof(idx_path), "%s%csearch.idx", site_dir, PATH_SEP);
+    char md_tmp[800];
+    snprintf(md_tmp, sizeof(md_tmp), "%s.tmp", md_copy);
+    if (copy_file_binary("workspace/book-draft.md", md_tmp) == 0)
+      (void)replace_file(md_tmp, md_copy); /* never truncate a copy `serve` has mapped */
+    SearchBuildStats ss;
+    double t0 = ueng_trace_begin();
+    int src = search_build_index("workspace/book-draft.md", idx_path, "../md/book-draft.md", &ss);
+    if (src == 0)
+      src = search_write_js(site_dir);
+    ueng_trace_end("stage", "search_index", t0);
+    if (src == 0)
+    {
+      has_search = 1;
+      printf("[build] search: %u terms, %u sections, %.1f KiB index, %.0f MB/s\n", ss.n_terms,
+             ss.n_docs, (double)ss.index_bytes / 1024.0,
+             ss.ms > 0 ? (double)ss.bytes_in / 1e3 / ss.ms : 0.0);
+    }
+    else
+    {
+      fprintf(stderr, "[build] WARN: could not write search index\n");
+    }
+  }
+
+  if (write_site_index(site_dir, cfg.title, cfg.author, slug, stamp, /*has_cover=*/1, has_draft,
+                       has_search) != 0)
   {
     fprintf(stderr, "[build] WARN: could not write site/index.html\n");
   }
@@ -303,11 +423,13 @@ static int cmd_build(void)
     snprintf(out_html, sizeof(out_html), "%s%cbook.html", html_dir, PATH_SEP);
     if (!file_exists(out_html) && file_exists("workspace/book-draft.md"))
     {
-      (void)light_export_html(cfg.title, cfg.author, html_dir, "workspace/book-draft.md", out_html,
-                              sizeof(out_html));
+      if (light_export_html(cfg.title, cfg.author, html_dir, "workspace/book-draft.md", out_html,
+                            sizeof(out_html)) == 0)
+        printf("[build] light HTML: %s\n", out_html);
     }
   }
 
+  commit_outputs("build", root);
   printf("[build] ok: %s\n", root);
   return 0;
 }
@@ -316,7 +438,10 @@ static int cmd_build(void)
 static int cmd_export(void)
 {
   BookCfg cfg;
-  read_book_cfg(&cfg);
+  BookIndex ix;
+  (void)open_book_index("export", 0, &ix);
+  read_book_cfg(&cfg, &ix);
+  bookidx_close(&ix);
   char slug[256];
   slugify(cfg.title, slug, sizeof(slug));
   char day[32];
@@ -330,6 +455,8 @@ static int cmd_export(void)
 
   char out_root[640];
   snprintf(out_root, sizeof(out_root), "outputs%c%s%c%s", PATH_SEP, slug, PATH_SEP, day);
+  if (store_enabled())
+    (void)store_detach_tree(out_root); /* pandoc overwrites html/ in place */
   char html_dir[640];
   snprintf(html_dir, sizeof(html_dir), "%s%chtml", out_root, PATH_SEP);
   mkpath(html_dir);
@@ -342,12 +469,7 @@ static int cmd_export(void)
   snprintf(out_html, sizeof(out_html), "%s%cbook.html", html_dir, PATH_SEP);
 
   int used_pandoc = 0;
-#ifdef _WIN32
-  const char *probe = "where pandoc >NUL 2>&1";
-#else
-  const char *probe = "command -v pandoc >/dev/null 2>&1";
-#endif
-  if (exec_cmd(probe) == 0)
+  if (tool_on_path("pandoc"))
   {
 #ifdef _WIN32
     char cmd1[2048];
@@ -383,10 +505,12 @@ static int cmd_export(void)
 
   if (!used_pandoc)
   {
-    (void)light_export_html(cfg.title, cfg.author, html_dir, "workspace/book-draft.md", out_html,
-                            sizeof(out_html));
+    if (light_export_html(cfg.title, cfg.author, html_dir, "workspace/book-draft.md", out_html,
+                          sizeof(out_html)) == 0)
+      printf("[export] light HTML: %s\n", out_html);
   }
 
+  commit_outputs("export", out_root);
   puts("[export] done");
   return 0;
 }
@@ -445,7 +569,10 @@ static int cmd_serve(int argc, char **argv)
   if (!site_root || !*site_root)
   {
     BookCfg cfg;
-    read_book_cfg(&cfg);
+    BookIndex ix;
+    (void)open_book_index("serve", 0, &ix);
+    read_book_cfg(&cfg, &ix);
+    bookidx_close(&ix);
     char slug[256];
     slugify(cfg.title, slug, sizeof(slug));
     char day[32];
@@ -467,7 +594,10 @@ static int cmd_open(void)
   if (!site_root || !*site_root)
   {
     BookCfg cfg;
-    read_book_cfg(&cfg);
+    BookIndex ix;
+    (void)open_book_index("open", 0, &ix);
+    read_book_cfg(&cfg, &ix);
+    bookidx_close(&ix);
     char slug[256];
     slugify(cfg.title, slug, sizeof(slug));
     char day[32];
@@ -496,21 +626,15 @@ static int cmd_doctor(void)
   printf("[ok] dropzone/ %s\n", dir_exists("dropzone") ? "found" : "missing");
   printf("[ok] workspace/ %s\n", dir_exists("workspace") ? "found" : "missing");
 
-#ifdef _WIN32
-  const char *probe = "where pandoc >NUL 2>&1";
-#else
-  const char *probe = "command -v pandoc >/dev/null 2>&1";
-#endif
-  int has_pandoc = (exec_cmd(probe) == 0);
+  int has_pandoc = tool_on_path("pandoc");
   puts(has_pandoc ? "[ok] pandoc found on PATH"
                   : "[info] pandoc not found (HTML export will use light fallback)");
 
 #ifdef _WIN32
   puts("[ok] Edge/Chrome present for headless PDF");
 #else
-  int has_headless = (exec_cmd("command -v google-chrome >/dev/null 2>&1") == 0) ||
-                     (exec_cmd("command -v chromium >/dev/null 2>&1") == 0) ||
-                     (exec_cmd("command -v microsoft-edge >/dev/null 2>&1") == 0);
+  int has_headless = tool_on_path("google-chrome") || tool_on_path("chromium") ||
+                     tool_on_path("microsoft-edge");
   puts(has_headless ? "[ok] Edge/Chrome present for headless PDF"
                     : "[info] No headless Chrome found (PDF via pandoc only)");
 #endif
@@ -529,6 +653,26 @@ static int cmd_doctor(void)
   return 0;
 }
 
+/* gc: prune store objects no longer referenced by any output tree. */
+static int cmd_gc(void)
+{
+  char dir[PATH_MAX];
+  store_dir(dir, sizeof(dir));
+  StoreGcStats gs;
+  if (store_gc(&gs) != 0)
+  {
+    fprintf(stderr, "[gc] ERROR: could not scan %s\n", dir);
+    return 1;
+  }
+  const double mib = 1024.0 * 1024.0;
+  printf("[gc] %s: removed %zu objects (%.1f MiB), dropped %zu stale refs\n", dir, gs.removed,
+         (double)gs.bytes_removed / mib, gs.stale_refs);
+  printf("[gc] kept %zu objects (%.1f MiB) backing %zu trees of %.1f MiB: %.1f MiB saved\n",
+         gs.objects, (double)gs.bytes / mib, gs.refs, (double)gs.bytes_referenced / mib,
+         gs.bytes_referenced > gs.bytes ? (double)(gs.bytes_referenced - gs.bytes) / mib : 0.0);
+  return 0;
+}
+
 /* Not implemented yet, but kept visible so users know it's planned. */
 static int cmd_publish(void)
 {
@@ -536,19 +680,358 @@ static int cmd_publish(void)
   return 1;
 }
 
+/* stats: editorial numbers per chapter and for the whole book, straight from
+   the book index (only chapters changed since the last run are re-read).
+   Usage: uaengine stats [--json] */
+static void json_str(const char *s)
+{
+  putchar('"');
+  for (const unsigned char *p = (const unsigned char *)s; *p; ++p)
+  {
+    if (*p == '"' || *p == '\\')
+      printf("\\%c", *p);
+    else if (*p < 0x20)
+      printf("\\u%04x", *p);
+    else
+      putchar(*p);
+  }
+  putchar('"');
+}
+
+static void fmt_reading(uint64_t words, char *out, size_t outsz)
+{
+  uint64_t min = (words + TEXTSTATS_WPM / 2) / TEXTSTATS_WPM;
+  if (min < 60)
+    snprintf(out, outsz, "%llum", (unsigned long long)min);
+  else
+    snprintf(out, outsz, "%lluh %02llum", (unsigned long long)(min / 60),
+             (unsigned long long)(min % 60));
+}
+
+static int cmd_stats(int argc, char **argv)
+{
+  int json = 0;
+  for (int i = 0; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--json") == 0)
+      json = 1;
+    else
+    {
+      fprintf(stderr, "[stats] unknown option: %s (usage: uaengine stats [--json])\n", argv[i]);
+      return 2;
+    }
+  }
+  if (!dir_exists("workspace/chapters"))
+  {
+    fprintf(stderr, "[stats] workspace/chapters not found. Run `uaengine ingest` first.\n");
+    return 1;
+  }
+  BookIndex ix;
+  if (open_book_index(NULL, 1, &ix) != 0)
+  {
+    fprintf(stderr, "[stats] ERROR: could not read the book index\n");
+    return 1;
+  }
+
+  TextStats total;
+  memset(&total, 0, sizeof(total));
+  BookIdxChapter c;
+  int namew = 7;
+  for (size_t i = 0; bookidx_chapter(&ix, i, &c) == 0; ++i)
+  {
+    int l = (int)strlen(c.name);
+    if (l > namew)
+      namew = l > 40 ? 40 : l;
+  }
+  char rt[32];
+  if (json)
+    printf("{\"words_per_minute\":%d,\"chapters\":[", TEXTSTATS_WPM);
+  else
+    printf("%-*s %9s %9s %9s %8s %9s %8s\n", namew, "Chapter", "Words", "Sentences",
+           "Paragraphs", "Headings", "KiB", "Reading");
+  for (size_t i = 0; bookidx_chapter(&ix, i, &c) == 0; ++i)
+  {
+    TextStats t;
+    memset(&t, 0, sizeof(t));
+    t.bytes = c.size;
+    t.lines = c.lines;
+    t.words = c.words;
+    t.sentences = c.sentences;
+    t.paragraphs = c.paragraphs;
+    t.headings = c.head_count;
+    t.code_lines = c.code_lines;
+    textstats_add(&total, &t);
+    if (json)
+    {
+      printf("%s{\"name\":", i ? "," : "");
+      json_str(c.name);
+      printf(",\"title\":");
+      json_str(c.title);
+      printf(",\"bytes\":%llu,\"lines\":%u,\"words\":%u,\"sentences\":%u,\"paragraphs\":%u,"
+             "\"headings\":%u,\"code_lines\":%u,\"reading_minutes\":%.1f}",
+             (unsigned long long)c.size, c.lines, c.words, c.sentences, c.paragraphs,
+             c.head_count, c.code_lines, (double)c.words / TEXTSTATS_WPM);
+      continue;
+    }
+    fmt_reading(c.words, rt, sizeof(rt));
+    printf("%-*.*s %9u %9u %9u %8u %9.1f %8s\n", namew, namew, c.name, c.words, c.sentences,
+           c.paragraphs, c.head_count, (double)c.size / 1024.0, rt);
+  }
+  size_t n = ix.n_chapters;
+  bookidx_close(&ix);
+
+  if (json)
+  {
+    printf("],\"total\":{\"chapters\":%zu,\"bytes\":%llu,\"lines\":%llu,\"words\":%llu,"
+           "\"sentences\":%llu,\"paragraphs\":%llu,\"headings\":%llu,\"code_lines\":%llu,"
+           "\"reading_minutes\":%.1f}}\n",
+           n, (unsigned long long)total.bytes, (unsigned long long)total.lines,
+           (unsigned long long)total.words, (unsigned long long)total.sentences,
+           (unsigned long long)total.paragraphs, (unsigned long long)total.headings,
+           (unsigned long long)total.code_lines, (double)total.words / TEXTSTATS_WPM);
+    return 0;
+  }
+  fmt_reading(total.words, rt, sizeof(rt));
+  char label[64];
+  snprintf(label, sizeof(label), "Total (%zu)", n);
+  printf("%-*s %9llu %9llu %9llu %8llu %9.1f %8s\n", namew, label,
+         (unsigned long long)total.words, (unsigned long long)total.sentences,
+         (unsigned long long)total.paragraphs, (unsigned long long)total.headings,
+         (double)total.bytes / 1024.0, rt);
+  if (total.sentences)
+    printf("[stats] %.1f words per sentence, %.1f sentences per paragraph; reading time at %d "
+           "words/min\n",
+           (double)total.words / (double)total.sentences,
+           total.paragraphs ? (double)total.sentences / (double)total.paragraphs : 0.0,
+           TEXTSTATS_WPM);
+  return 0;
+}
+
+/* diff: what changed in the manuscript between two dated builds.
+   Usage: uaengine diff <dayA> <dayB> [--json] [--html FILE]
+   Compares outputs/<slug>/<day>/md/book-draft.md of both days. Prints a
+   summary and writes an HTML report (default outputs/<slug>/diff-A-B.html);
+   --json prints the report as JSON on stdout instead. */
+static int cmd_diff(int argc, char **argv)
+{
+  const char *days[2] = {NULL, NULL};
+  const char *html_path = NULL;
+  int json = 0, nd = 0;
+  for (int i = 0; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--json") == 0)
+      json = 1;
+    else if (strcmp(argv[i], "--html") == 0 && i + 1 < argc)
+      html_path = argv[++i];
+    else if (argv[i][0] != '-' && nd < 2)
+      days[nd++] = argv[i];
+    else
+    {
+      nd = -1;
+      break;
+    }
+  }
+  if (nd != 2)
+  {
+    fprintf(stderr, "[diff] usage: uaengine diff <dayA> <dayB> [--json] [--html FILE]\n");
+    return 2;
+  }
+
+  BookCfg cfg;
+  BookIndex ix;
+  (void)open_book_index(NULL, 0, &ix);
+  read_book_cfg(&cfg, &ix);
+  bookidx_close(&ix);
+  char slug[256];
+  slugify(cfg.title, slug, sizeof(slug));
+
+  char draft[2][768];
+  for (int k = 0; k < 2; ++k)
+  {
+    snprintf(draft[k], sizeof(draft[k]), "outputs%c%s%c%s%cmd%cbook-draft.md", PATH_SEP, slug,
+             PATH_SEP, days[k], PATH_SEP, PATH_SEP);
+    if (!file_exists(draft[k]))
+    {
+      fprintf(stderr, "[diff] %s not found. Was `uaengine build` run on %s?\n", draft[k],
+              days[k]);
+      return 1;
+    }
+  }
+
+  BookDiff d;
+  if (bookdiff_run(draft[0], draft[1], 0, &d) != 0)
+  {
+    fprintf(stderr, "[diff] ERROR: could not compare %s and %s\n", draft[0], draft[1]);
+    return 1;
+  }
+  int rc = 0;
+  if (json)
+  {
+    rc = bookdiff_write_json(&d, days[0], days[1], stdout) == 0 ? 0 : 1;
+    bookdiff_free(&d);
+    return rc;
+  }
+
+  printf("[diff] %s -> %s: %zu changed, %zu added, %zu removed, %zu unchanged chapters "
+         "(+%zu/-%zu words, %.0f ms)\n",
+         days[0], days[1], d.changed, d.added, d.removed, d.same, d.words_ins, d.words_del,
+         d.ms);
+  for (size_t i = 0; i < d.n; ++i)
+  {
+    const BookDiffChapter *c = &d.ch[i];
+    if (c->status == BOOKDIFF_SAME)
+      continue;
+    printf("  %c %-40.40s +%zu/-%zu words\n",
+           c->status == BOOKDIFF_ADDED ? 'A' : c->status == BOOKDIFF_REMOVED ? 'D' : 'M', c->name,
+           c->words_ins, c->words_del);
+  }
+
+  char def_html[768];
+  if (!html_path)
+  {
+    snprintf(def_html, sizeof(def_html), "outputs%c%s%cdiff-%s-%s.html", PATH_SEP, slug, PATH_SEP,
+             days[0], days[1]);
+    html_path = def_html;
+  }
+  FILE *f = ueng_fopen(html_path, "wb");
+  if (!f || bookdiff_write_html(&d, cfg.title, days[0], days[1], f) != 0)
+  {
+    fprintf(stderr, "[diff] ERROR: could not write %s\n", html_path);
+    rc = 1;
+  }
+  else
+    printf("[diff] report: %s\n", html_path);
+  if (f)
+    fclose(f);
+  bookdiff_free(&d);
+  return rc;
+}
+
 /* render: convenience command that runs build → export → open. */
 static int cmd_render(void)
 {
+  double t0 = ueng_trace_begin();
   int rc = cmd_build();
+  ueng_trace_end("cmd", "build", t0);
   if (rc != 0)
     return rc;
+  t0 = ueng_trace_begin();
   rc = cmd_export();
+  ueng_trace_end("cmd", "export", t0);
   if (rc != 0)
     return rc;
+  t0 = ueng_trace_begin();
   rc = cmd_open();
+  ueng_trace_end("cmd", "open", t0);
   return rc;
 }
 
+/* --all: run build, export or render for every book.yaml under a directory.
+   Usage: uaengine <build|export|render> --all <dir> [-j N]
+   Each book runs in its own process (see multibook.h); render does build +
+   export per book and opens nothing. */
+static int by_ms_desc(const void *A, const void *B)
+{
+  const MultiBookResult *a = (const MultiBookResult *)A, *b = (const MultiBookResult *)B;
+  return (a->ms < b->ms) - (a->ms > b->ms);
+}
+
+static int cmd_all(const char *argv0, const char *cmd, int argc, char **argv)
+{
+  const char *root = NULL;
+  for (int i = 0; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--all") == 0 && i + 1 < argc && !root)
+      root = argv[++i];
+    else
+    {
+      fprintf(stderr, "[%s] usage: uaengine %s --all <dir> [-j N]\n", cmd, cmd);
+      return 2;
+    }
+  }
+  if (!root)
+  {
+    fprintf(stderr, "[%s] usage: uaengine %s --all <dir> [-j N]\n", cmd, cmd);
+    return 2;
+  }
+
+  StrList books;
+  sl_init(&books);
+  if (multibook_find(root, &books) != 0 || books.count == 0)
+  {
+    fprintf(stderr, "[%s] no book.yaml found under %s\n", cmd, root);
+    sl_free(&books);
+    return 1;
+  }
+  char exe[PATH_MAX];
+  if (multibook_self_exe(argv0, exe, sizeof(exe)) != 0)
+  {
+    fprintf(stderr, "[%s] ERROR: cannot locate the uaengine executable\n", cmd);
+    sl_free(&books);
+    return 1;
+  }
+  static const char *const build_steps[] = {"build"};
+  static const char *const export_steps[] = {"export"};
+  static const char *const render_steps[] = {"build", "export"};
+  MultiBookOptions o;
+  memset(&o, 0, sizeof(o));
+  o.exe = exe;
+  o.label = cmd;
+  o.jobs = ueng_jobs();
+  if (strcmp(cmd, "build") == 0)
+  {
+    o.steps = build_steps;
+    o.n_steps = 1;
+  }
+  else if (strcmp(cmd, "export") == 0)
+  {
+    o.steps = export_steps;
+    o.n_steps = 1;
+  }
+  else
+  {
+    o.steps = render_steps;
+    o.n_steps = 2;
+  }
+  if ((size_t)o.jobs > books.count)
+    o.jobs = (int)books.count;
+
+  MultiBookResult *res = (MultiBookResult *)calloc(books.count, sizeof(MultiBookResult));
+  if (!res)
+  {
+    sl_free(&books);
+    return 1;
+  }
+  printf("[%s] %zu books under %s, %d at a time\n", cmd, books.count, root, o.jobs);
+  double t0 = ueng_now_ms();
+  int failed = multibook_run(&o, &books, res);
+  double wall = ueng_now_ms() - t0;
+
+  /* Timing report, slowest first. */
+  double work = 0.0;
+  int namew = 4;
+  for (size_t i = 0; i < books.count; ++i)
+  {
+    work += res[i].ms;
+    int l = (int)strlen(books.items[i]);
+    if (l > namew)
+      namew = l > 48 ? 48 : l;
+  }
+  qsort(res, books.count, sizeof(MultiBookResult), by_ms_desc);
+  printf("\n%-*s %-8s %9s\n", namew, "Book", "Result", "Seconds");
+  for (size_t i = 0; i < books.count; ++i)
+    printf("%-*.*s %-8s %9.2f\n", namew, namew, res[i].dir ? res[i].dir : "?",
+           res[i].rc == 0 ? "ok" : "FAILED", res[i].ms / 1000.0);
+  printf("[%s] %zu books: %zu ok, %d failed; %.1f s wall, %.1f s of work (%.1fx)\n", cmd,
+         books.count, books.count - (size_t)(failed > 0 ? failed : 0), failed > 0 ? failed : 0,
+         wall / 1000.0, work / 1000.0, wall > 0.0 ? work / wall : 0.0);
+  if (failed > 0)
+    printf("[%s] logs: <book>%cworkspace%clogs%c%s.log\n", cmd, PATH_SEP, PATH_SEP, PATH_SEP, cmd);
+  free(res);
+  sl_free(&books);
+  return failed == 0 ? 0 : 1;
+}
+
 /*---------------------------------- main -----------------------------------*/
 /* Maps argv[1] to the command handlers above. */
 
@@ -560,13 +1043,21 @@ static void usage(void)
   puts("  init                 Initialize a new book project structure.");
   puts("  ingest               Ingest and organize content from the dropzone.");
   puts("  build                Build the book draft and prepare outputs.");
+  puts("  build --all <dir>    Build every book under <dir> in parallel (also export, render).");
   puts("  export               Export the book to HTML and PDF formats.");
   puts("  serve [opts]         Serve a site folder (defaults to today's site).");
   puts("  open                 Open the latest site (or UENG_SITE_ROOT) in browser.");
   puts("  render               Build + Export + Open (convenience).");
+  puts("  stats [--json]       Word, sentence and paragraph counts per chapter.");
+  puts("  diff <dayA> <dayB>   Chapter-level changes between two builds (--json, --html).");
   puts("  doctor               Check environment, tools, and folders.");
+  puts("  llm-bench [model]    Time the LLM backend; sweep llama.cpp threads/batch/ctx.");
+  puts("  gc                   Prune unreferenced objects from the output store.");
   puts("  publish              Publish the book to a remote server (not implemented).");
   puts("  --version            Show version information.");
+  puts("\nGlobal options:");
+  puts("  -j N, --jobs N       Threads for parallel stages (default UENG_JOBS, else CPUs).");
+  puts("  --trace FILE         Write a Chrome/Perfetto trace of the run (or UENG_TRACE).");
 }
 
 /*--------------------------------------------------------------------------
@@ -574,12 +1065,63 @@ static void usage(void)
  * PURPOSE: Add 'llm-selftest' command to exercise the embedded LLM wrapper.
  *---------------------------------------------------------------------------*/
 #include "ueng/llm.h"
+#include "ueng/llm_bench.h"
+#include "ueng/llm_cache.h"
+
+static int print_piece(void *user, const char *piece, size_t len)
+{
+  if (user) /* quiet repeats */
+    return 0;
+  fwrite(piece, 1, len, stdout);
+  fflush(stdout);
+  return 0;
+}
+
+/* llm-selftest [model] [--repeat N] [--batch N]: --repeat sends the prompt N
+   times on one context (replies after the first are not printed), which
+   shows whether an HTTP backend keeps its connection open. --batch sends N
+   copies through ueng_llm_prompt_batch (UENG_LLM_PARALLEL in flight) and
+   prints each request's latency. UENG_LLM_CACHE=<dir> puts the completion
+   cache (llm_cache.h) in front of both. */
+static int llm_selftest_batch(ueng_llm_cache *cache, ueng_llm_ctx *L, int n)
+{
+  ueng_llm_batch_item *items = (ueng_llm_batch_item *)calloc((size_t)n, sizeof(*items));
+  if (!items)
+    return 1;
+  for (int i = 0; i < n; ++i)
+    items[i].prompt = "Say hello from AuthorEngine.";
+  double t0 = ueng_now_ms();
+  int failed = ueng_llm_cache_prompt_batch(cache, L, items, (size_t)n, 0);
+  double wall = ueng_now_ms() - t0, sum = 0.0;
+  for (int i = 0; i < n; ++i)
+  {
+    sum += items[i].latency_ms;
+    fprintf(stderr, "[llm-selftest] #%d status %d (HTTP %ld) %.0f ms%s%s\n", i + 1,
+            items[i].status, items[i].http_status, items[i].latency_ms, items[i].text ? ": " : "",
+            items[i].text ? items[i].text : "");
+    free(items[i].text);
+  }
+  fprintf(stderr, "[llm-selftest] batch of %d: %d failed, %.0f ms wall, %.0f ms summed\n", n,
+          failed, wall, sum);
+  free(items);
+  return failed == 0 ? 0 : 1;
+}
 
 static int cmd_llm_selftest(int argc, char **argv)
 {
   const char *model = NULL;
-  if (argc >= 3)
-    model = argv[2];
+  int repeat = 1, batch = 0;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+      batch = atoi(argv[++i]);
+    else
+      model = argv[i];
+  }
+  if (repeat < 1)
+    repeat = 1;
   if (!model || !*model)
   {
     model = getenv("UENG_LLM_MODEL");
@@ -597,26 +1139,218 @@ static int cmd_llm_selftest(int argc, char **argv)
     fprintf(stderr, "[llm-selftest] open failed: %s\n", err[0] ? err : "(unknown)");
     return 3;
   }
-  char out[2048] = {0};
-  int rc = ueng_llm_prompt(L, "Say hello from AuthorEngine.", out, sizeof(out));
-  if (rc == 0)
+  /* Stream the reply as it is generated, then report latency. */
+  ueng_llm_cache *cache = ueng_llm_cache_open_env();
+  int rc = 0;
+  if (batch > 0)
   {
-    printf("%s\n", out);
+    rc = llm_selftest_batch(cache, L, batch);
+    repeat = 0;
   }
-  else
+  for (int r = 0; r < repeat && rc == 0; ++r)
   {
-    fprintf(stderr, "[llm-selftest] prompt failed (rc=%d)\n", rc);
+    ueng_llm_stream_stats st;
+    rc = ueng_llm_cache_prompt_stream(cache, L, "Say hello from AuthorEngine.", print_piece,
+                                      r ? L : NULL, &st);
+    if (rc == 0)
+    {
+      if (r == 0)
+        printf("\n");
+      fprintf(stderr,
+              "[llm-selftest] first token %.0f ms, %d pieces (%d tokens) in %.0f ms\n",
+              st.ttft_ms, st.pieces, st.tokens, st.total_ms);
+      if (st.prefill_ms > 0)
+        fprintf(stderr,
+                "[llm-selftest] prefill %d tokens (%d reused) in %.0f ms (%.0f tokens/s)\n",
+                st.prompt_tokens, st.cached_tokens, st.prefill_ms,
+                (st.prompt_tokens - st.cached_tokens) * 1000.0 / st.prefill_ms);
+      if (st.draft_tokens > 0)
+        fprintf(stderr, "[llm-selftest] draft: %d of %d guessed tokens accepted (%.0f%%)\n",
+                st.draft_accepted, st.draft_tokens, 100.0 * st.draft_accepted / st.draft_tokens);
+    }
+    else
+    {
+      fprintf(stderr, "[llm-selftest] prompt failed (rc=%d)\n", rc);
+    }
+  }
+  ueng_llm_conn_stats cs;
+  if (ueng_llm_get_conn_stats(L, &cs) == 0)
+    fprintf(stderr,
+            "[llm-selftest] %ld requests, %ld connections opened (%.0f ms), %ld reused\n",
+            cs.requests, cs.connects, cs.connect_ms, cs.reused);
+  if (cache)
+  {
+    ueng_llm_cache_stats ks;
+    ueng_llm_cache_get_stats(cache, &ks);
+    fprintf(stderr,
+            "[llm-selftest] cache: %llu hits, %llu misses, %llu coalesced, %llu entries "
+            "(%llu bytes)\n",
+            (unsigned long long)ks.hits, (unsigned long long)ks.misses,
+            (unsigned long long)ks.coalesced, (unsigned long long)ks.entries,
+            (unsigned long long)ks.log_bytes);
+    ueng_llm_cache_close(cache);
   }
   ueng_llm_close(L);
   return rc;
 }
+
+/* llm-bench [model] [--threads 4,8] [--batch 128,512] [--ctx 2048,4096]
+   [--prompt-words N] [--gen-tokens N] [--runs N] [--requests N] [--parallel N]
+   [--json] [--write-config [FILE]]: see llm_bench.h. FILE defaults to
+   config/ueng.yaml. */
+static int cmd_llm_bench(int argc, char **argv)
+{
+  LlmBenchOptions o;
+  memset(&o, 0, sizeof(o));
+  for (int i = 2; i < argc; ++i)
+  {
+    const char *a = argv[i];
+    int *list = NULL, *count = NULL;
+    if (strcmp(a, "--threads") == 0)
+      list = o.threads, count = &o.n_threads;
+    else if (strcmp(a, "--batch") == 0)
+      list = o.batch, count = &o.n_batch;
+    else if (strcmp(a, "--ctx") == 0)
+      list = o.ctx, count = &o.n_ctx;
+    if (list)
+    {
+      if (i + 1 >= argc || (*count = llm_bench_parse_list(argv[++i], list)) < 0)
+      {
+        fprintf(stderr, "[llm-bench] ERROR: %s needs a list like 1,2,4 (at most %d values)\n", a,
+                LLM_BENCH_MAX_SWEEP);
+        return 2;
+      }
+    }
+    else if (strcmp(a, "--prompt-words") == 0 && i + 1 < argc)
+      o.prompt_words = atoi(argv[++i]);
+    else if (strcmp(a, "--gen-tokens") == 0 && i + 1 < argc)
+      o.gen_tokens = atoi(argv[++i]);
+    else if (strcmp(a, "--runs") == 0 && i + 1 < argc)
+      o.runs = atoi(argv[++i]);
+    else if (strcmp(a, "--requests") == 0 && i + 1 < argc)
+      o.requests = atoi(argv[++i]);
+    else if (strcmp(a, "--parallel") == 0 && i + 1 < argc)
+      o.parallel = atoi(argv[++i]);
+    else if (strcmp(a, "--json") == 0)
+      o.json = 1;
+    else if (strcmp(a, "--write-config") == 0)
+      o.write_config = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "config/ueng.yaml";
+    else if (a[0] == '-')
+    {
+      fprintf(stderr, "[llm-bench] unknown option: %s\n", a);
+      return 2;
+    }
+    else
+      o.model = a;
+  }
+  if (!o.model || !*o.model)
+    o.model = getenv("UENG_LLM_MODEL");
+  if (!o.model || !*o.model)
+  {
+    fprintf(stderr, "[llm-bench] ERROR: no model path given and UENG_LLM_MODEL not set.\n");
+    return 2;
+  }
+  return llm_bench_run(&o);
+}
+/* Global options (anywhere after the program name), removed from argv so
+   commands never see them:
+     -j N / -jN / --jobs N   thread count of every parallel stage (ueng_set_jobs)
+     --trace FILE            record spans to FILE (see trace.h)
+   Returns -1 on a missing or bad value. */
+static int take_global_options(int *argc, char **argv, const char **trace_path)
+{
+  int out = 1;
+  for (int i = 1; i < *argc; ++i)
+  {
+    const char *a = argv[i], *val = NULL;
+    if (strcmp(a, "--trace") == 0)
+    {
+      if (i + 1 >= *argc)
+        return -1;
+      *trace_path = argv[++i];
+      continue;
+    }
+    if (strncmp(a, "--trace=", 8) == 0)
+    {
+      *trace_path = a + 8;
+      continue;
+    }
+    if (strcmp(a, "-j") == 0 || strcmp(a, "--jobs") == 0)
+    {
+      if (i + 1 >= *argc)
+        return -1;
+      val = argv[++i];
+    }
+    else if (strncmp(a, "-j", 2) == 0 && a[2] >= '0' && a[2] <= '9')
+      val = a + 2;
+    else if (strncmp(a, "--jobs=", 7) == 0)
+      val = a + 7;
+    if (!val)
+    {
+      argv[out++] = argv[i];
+      continue;
+    }
+    char *end = NULL;
+    long n = strtol(val, &end, 10);
+    if (end == val || *end || n < 1 || n > 1024)
+      return -1;
+    ueng_set_jobs((int)n);
+  }
+  argv[out] = NULL;
+  *argc = out;
+  return 0;
+}
+
+/* UENG_ALLOC_STATS=1: print allocation counters when the command ends. */
+static void dump_alloc_stats(void) { ueng_alloc_stats_dump(stderr); }
+
+static int run_command(int argc, char **argv);
+
 int main(int argc, char **argv)
 {
+  const char *trace_path = getenv("UENG_TRACE");
+  if (take_global_options(&argc, argv, &trace_path) != 0)
+  {
+    fprintf(stderr, "[uaengine] ERROR: -j needs a thread count between 1 and 1024, "
+                    "--trace a file name\n");
+    return 2;
+  }
   if (argc < 2)
   {
     usage();
     return 0;
   }
+  const char *alloc_stats = getenv("UENG_ALLOC_STATS");
+  if (alloc_stats && *alloc_stats && strcmp(alloc_stats, "0") != 0)
+  {
+    ueng_alloc_stats_enable();
+    atexit(dump_alloc_stats);
+  }
+  if (trace_path && *trace_path && ueng_trace_start(trace_path) != 0)
+    fprintf(stderr, "[trace] WARN: cannot write %s; tracing is off\n", trace_path);
+
+  double t0 = ueng_trace_begin();
+  int rc = run_command(argc, argv);
+  if (ueng_trace_on())
+  {
+    char line[1024];
+    size_t used = 0;
+    line[0] = '\0';
+    for (int i = 1; i < argc && used + 2 < sizeof(line); ++i)
+    {
+      int n = snprintf(line + used, sizeof(line) - used, i > 1 ? " %s" : "%s", argv[i]);
+      if (n < 0)
+        break;
+      used += (size_t)n;
+    }
+    ueng_trace_end_arg("cmd", "command", t0, line);
+  }
+  return rc;
+}
+
+/* Maps argv[1] to a handler; returns the exit code. */
+static int run_command(int argc, char **argv)
+{
   if (strcmp(argv[1], "--version") == 0)
   {
     puts(UENG_VERSION_STR);
@@ -640,6 +1374,8 @@ int main(int argc, char **argv)
   const char *cmd = argv[1];
   if (strcmp(cmd, "llm-selftest") == 0)
     return cmd_llm_selftest(argc, argv);
+  if (strcmp(cmd, "llm-bench") == 0)
+    return cmd_llm_bench(argc, argv);
   if (strcmp(cmd, "help") == 0)
   {
     usage();
@@ -655,10 +1391,14 @@ int main(int argc, char **argv)
   }
   else if (strcmp(cmd, "build") == 0)
   {
+    if (argc > 2)
+      return cmd_all(argv[0], cmd, argc - 2, argv + 2);
     return cmd_build();
   }
   else if (strcmp(cmd, "export") == 0)
   {
+    if (argc > 2)
+      return cmd_all(argv[0], cmd, argc - 2, argv + 2);
     return cmd_export();
   }
   else if (strcmp(cmd, "serve") == 0)
@@ -671,12 +1411,26 @@ int main(int argc, char **argv)
   }
   else if (strcmp(cmd, "render") == 0)
   {
+    if (argc > 2)
+      return cmd_all(argv[0], cmd, argc - 2, argv + 2);
     return cmd_render();
   }
+  else if (strcmp(cmd, "stats") == 0)
+  {
+    return cmd_stats(argc - 2, argv + 2);
+  }
+  else if (strcmp(cmd, "diff") == 0)
+  {
+    return cmd_diff(argc - 2, argv + 2);
+  }
   else if (strcmp(cmd, "doctor") == 0)
   {
     return cmd_doctor();
   }
+  else if (strcmp(cmd, "gc") == 0)
+  {
+    return cmd_gc();
+  }
   else if (strcmp(cmd, "publish") == 0)
   {
     return cmd_publish();
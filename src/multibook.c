@@ -0,0 +1,348 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/multibook.c
+ * Purpose: Run one command over every book under a directory (--all)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "ueng/multibook.h"
+#include "ueng/trace.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h> /* _NSGetExecutablePath */
+#endif
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------ discovery -----------------------------------*/
+
+static int skip_dir(const char *name)
+{
+  return name[0] == '.' || strcmp(name, "outputs") == 0 || strcmp(name, "workspace") == 0 ||
+         strcmp(name, "node_modules") == 0;
+}
+
+static void find_books(const char *dir, StrList *out, int depth)
+{
+  char yaml[PATH_MAX];
+  snprintf(yaml, sizeof(yaml), "%s%cbook.yaml", dir, PATH_SEP);
+  if (file_exists(yaml))
+  {
+    sl_push(out, dir); /* books do not nest */
+    return;
+  }
+  if (depth > 16)
+    return;
+#ifdef _WIN32
+  char pattern[PATH_MAX];
+  snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+  WIN32_FIND_DATAA f;
+  HANDLE h = FindFirstFileA(pattern, &f);
+  if (h == INVALID_HANDLE_VALUE)
+    return;
+  do
+  {
+    if (!(f.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+        (f.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) || skip_dir(f.cFileName))
+      continue;
+    char sub[PATH_MAX];
+    snprintf(sub, sizeof(sub), "%s\\%s", dir, f.cFileName);
+    find_books(sub, out, depth + 1);
+  } while (FindNextFileA(h, &f));
+  FindClose(h);
+#else
+  DIR *d = opendir(dir);
+  if (!d)
+    return;
+  struct dirent *e;
+  while ((e = readdir(d)))
+  {
+    if (skip_dir(e->d_name))
+      continue;
+    char sub[PATH_MAX];
+    snprintf(sub, sizeof(sub), "%s/%s", dir, e->d_name);
+    struct stat st;
+    if (lstat(sub, &st) == 0 && S_ISDIR(st.st_mode))
+      find_books(sub, out, depth + 1);
+  }
+  closedir(d);
+#endif
+}
+
+int multibook_find(const char *root, StrList *out)
+{
+  if (!root || !out || !dir_exists(root))
+    return -1;
+  size_t first = out->count;
+  char base[PATH_MAX];
+  snprintf(base, sizeof(base), "%s", root);
+  size_t n = strlen(base);
+  while (n > 1 && (base[n - 1] == '/' || base[n - 1] == PATH_SEP))
+    base[--n] = '\0';
+  find_books(base, out, 0);
+  if (out->count > first)
+    qsort(out->items + first, out->count - first, sizeof(char *), qsort_nat_ci_cmp);
+  return 0;
+}
+
+int multibook_self_exe(const char *argv0, char *out, size_t outsz)
+{
+  if (!out || outsz == 0)
+    return -1;
+#ifdef _WIN32
+  DWORD n = GetModuleFileNameA(NULL, out, (DWORD)outsz);
+  if (n > 0 && n < outsz)
+    return 0;
+#elif defined(__APPLE__)
+  uint32_t sz = (uint32_t)outsz;
+  if (_NSGetExecutablePath(out, &sz) == 0)
+    return 0;
+#else
+  ssize_t n = readlink("/proc/self/exe", out, outsz - 1);
+  if (n > 0)
+  {
+    out[n] = '\0';
+    return 0;
+  }
+#endif
+  if (!argv0 || !*argv0)
+    return -1;
+  /* A bare name was found on PATH and will be again; a path is made absolute
+     because the children start in the book directories. */
+  if ((strchr(argv0, '/') || strchr(argv0, PATH_SEP)) && path_abs(argv0, out, outsz) == 0)
+    return 0;
+  snprintf(out, outsz, "%s", argv0);
+  return 0;
+}
+
+/*------------------------------ processes -----------------------------------*/
+
+/* Start 'exe step' in 'dir' with stdout/stderr appended to 'log' and wait. */
+static int spawn_wait(const char *exe, const char *step, const char *dir, const char *log)
+{
+#ifdef _WIN32
+  SECURITY_ATTRIBUTES sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.nLength = sizeof(sa);
+  sa.bInheritHandle = TRUE;
+  HANDLE lh = CreateFileA(log, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa,
+                          OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (lh == INVALID_HANDLE_VALUE)
+    return -1;
+  STARTUPINFOA si;
+  PROCESS_INFORMATION pi;
+  ZeroMemory(&si, sizeof(si));
+  si.cb = sizeof(si);
+  si.dwFlags = STARTF_USESTDHANDLES;
+  si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+  si.hStdOutput = lh;
+  si.hStdError = lh;
+  ZeroMemory(&pi, sizeof(pi));
+  char cmd[2 * PATH_MAX];
+  snprintf(cmd, sizeof(cmd), "\"%s\" %s", exe, step);
+  BOOL ok = CreateProcessA(NULL, cmd, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, dir, &si, &pi);
+  CloseHandle(lh);
+  if (!ok)
+    return -1;
+  WaitForSingleObject(pi.hProcess, INFINITE);
+  DWORD code = 0;
+  GetExitCodeProcess(pi.hProcess, &code);
+  CloseHandle(pi.hThread);
+  CloseHandle(pi.hProcess);
+  return (int)code;
+#else
+  int fd = open(log, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    return -1;
+  fflush(NULL); /* do not duplicate buffered parent output in the child */
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  if (pid == 0)
+  {
+    /* Only async-signal-safe calls between fork and exec. */
+    int nul = open("/dev/null", O_RDONLY);
+    if (nul >= 0)
+      dup2(nul, 0);
+    dup2(fd, 1);
+    dup2(fd, 2);
+    if (chdir(dir) != 0)
+      _exit(126);
+    char *const argv[] = {(char *)exe, (char *)step, NULL};
+    execvp(exe, argv);
+    _exit(127);
+  }
+  close(fd);
+  int st = 0;
+  while (waitpid(pid, &st, 0) < 0)
+  {
+    if (errno != EINTR)
+      return -1;
+  }
+  return WIFEXITED(st) ? WEXITSTATUS(st) : -1;
+#endif
+}
+
+/*------------------------------ run -----------------------------------------*/
+
+typedef struct
+{
+  const MultiBookOptions *o;
+  const StrList *books;
+  MultiBookResult *res;
+  size_t *order; /* schedule: longest previous run first */
+  double *prev;
+  ueng_mutex_t mu;
+  size_t done;
+} RunCtx;
+
+static void ms_path(const char *dir, const char *label, char *out, size_t outsz)
+{
+  snprintf(out, outsz, "%s%cworkspace%clogs%c%s.ms", dir, PATH_SEP, PATH_SEP, PATH_SEP, label);
+}
+
+static void book_worker(void *ud, size_t k)
+{
+  RunCtx *c = (RunCtx *)ud;
+  size_t i = c->order[k];
+  MultiBookResult *r = &c->res[i];
+  const char *dir = c->books->items[i];
+  r->dir = dir;
+  r->rc = -1;
+  snprintf(r->log, sizeof(r->log), "%s%cworkspace%clogs%c%s.log", dir, PATH_SEP, PATH_SEP,
+           PATH_SEP, c->o->label);
+  double t0 = ueng_now_ms();
+  if (mkpath_parent(r->log) == 0 && write_text_file(r->log, "") == 0)
+  {
+    for (size_t s = 0; s < c->o->n_steps; ++s)
+    {
+      r->rc = spawn_wait(c->o->exe, c->o->steps[s], dir, r->log);
+      if (r->rc != 0)
+        break;
+    }
+  }
+  r->ms = ueng_now_ms() - t0;
+  ueng_trace_end_arg("book", c->o->label, t0, dir);
+  if (r->rc == 0)
+  {
+    char mp[PATH_MAX], buf[32];
+    ms_path(dir, c->o->label, mp, sizeof(mp));
+    snprintf(buf, sizeof(buf), "%.0f\n", r->ms);
+    (void)write_text_file(mp, buf);
+  }
+
+  ueng_mutex_lock(&c->mu);
+  size_t done = ++c->done;
+  if (!c->o->quiet)
+  {
+    if (r->rc == 0)
+      printf("[%s] (%zu/%zu) %s: ok, %.1f s\n", c->o->label, done, c->books->count, dir,
+             r->ms / 1000.0);
+    else
+      printf("[%s] (%zu/%zu) %s: FAILED (rc=%d), see %s\n", c->o->label, done, c->books->count,
+             dir, r->rc, r->log);
+    fflush(stdout);
+  }
+  ueng_mutex_unlock(&c->mu);
+}
+
+static RunCtx *g_sort_ctx; /* qsort has no user pointer */
+
+static int by_prev_desc(const void *A, const void *B)
+{
+  size_t a = *(const size_t *)A, b = *(const size_t *)B;
+  double pa = g_sort_ctx->prev[a], pb = g_sort_ctx->prev[b];
+  if (pa != pb)
+    return pa < pb ? 1 : -1;
+  return (a > b) - (a < b);
+}
+
+static void set_env(const char *name, const char *value)
+{
+#ifdef _WIN32
+  _putenv_s(name, value);
+#else
+  setenv(name, value, 1);
+#endif
+}
+
+int multibook_run(const MultiBookOptions *o, const StrList *books, MultiBookResult *res)
+{
+  if (!o || !o->exe || !o->label || !o->steps || o->n_steps == 0 || !books || !res)
+    return -1;
+  size_t n = books->count;
+  if (n == 0)
+    return 0;
+  memset(res, 0, n * sizeof(*res));
+
+  /* Probe once here; every child inherits the answer. */
+  set_env("UENG_HAVE_PANDOC", tool_on_path("pandoc") ? "1" : "0");
+  /* A traced run traces each book too, into its own log folder (the path is
+     relative to the book directory the child starts in). */
+  if (ueng_trace_on())
+  {
+    char tp[128];
+    snprintf(tp, sizeof(tp), "workspace%clogs%c%s.trace.json", PATH_SEP, PATH_SEP, o->label);
+    set_env("UENG_TRACE", tp);
+  }
+
+  RunCtx c;
+  memset(&c, 0, sizeof(c));
+  c.o = o;
+  c.books = books;
+  c.res = res;
+  c.order = (size_t *)malloc(n * sizeof(size_t));
+  c.prev = (double *)malloc(n * sizeof(double));
+  if (!c.order || !c.prev)
+  {
+    free(c.order);
+    free(c.prev);
+    return -1;
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    char mp[PATH_MAX];
+    ms_path(books->items[i], o->label, mp, sizeof(mp));
+    char *txt = read_file_alloc(mp, NULL);
+    c.prev[i] = txt ? atof(txt) : 1e18; /* never run: unknown, start early */
+    free(txt);
+    c.order[i] = i;
+  }
+  g_sort_ctx = &c;
+  qsort(c.order, n, sizeof(size_t), by_prev_desc);
+  g_sort_ctx = NULL;
+
+  ueng_mutex_init(&c.mu);
+  ueng_parallel_for(n, o->jobs, book_worker, &c);
+  ueng_mutex_destroy(&c.mu);
+  free(c.order);
+  free(c.prev);
+
+  int failed = 0;
+  for (size_t i = 0; i < n; ++i)
+    failed += res[i].rc != 0;
+  return failed;
+}
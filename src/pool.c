@@ -0,0 +1,493 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/pool.c
+ * Purpose: Work-stealing task pool shared by every parallel stage
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "ueng/pool.h"
+#include "ueng/common.h"
+#include "ueng/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------ atomics -------------------------------------*/
+/* The few atomic operations the deque needs. GCC/Clang builtins use the
+   orderings from the paper; MSVC gets full barriers (interlocked ops), which
+   are stronger and still correct. */
+typedef long long i64;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define UENG_TLS __declspec(thread)
+static i64 ld64(volatile i64 *p) { return InterlockedCompareExchange64(p, 0, 0); }
+static void st64(volatile i64 *p, i64 v) { InterlockedExchange64(p, v); }
+static int cas64(volatile i64 *p, i64 expect, i64 want)
+{
+  return InterlockedCompareExchange64(p, want, expect) == expect;
+}
+static void *ldp(void *volatile *p) { return InterlockedCompareExchangePointer(p, NULL, NULL); }
+static void stp(void *volatile *p, void *v) { InterlockedExchangePointer(p, v); }
+static long ldl(volatile long *p) { return InterlockedCompareExchange(p, 0, 0); }
+static long addl(volatile long *p, long d) { return InterlockedExchangeAdd(p, d) + d; }
+static void fence_sc(void) { MemoryBarrier(); }
+static void fence_rel(void) { MemoryBarrier(); }
+#else
+#define UENG_TLS _Thread_local
+static i64 ld64(volatile i64 *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void st64(volatile i64 *p, i64 v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static int cas64(volatile i64 *p, i64 expect, i64 want)
+{
+  return __atomic_compare_exchange_n(p, &expect, want, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+static void *ldp(void *volatile *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void stp(void *volatile *p, void *v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static long ldl(volatile long *p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static long addl(volatile long *p, long d) { return __atomic_add_fetch(p, d, __ATOMIC_SEQ_CST); }
+static void fence_sc(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static void fence_rel(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+#endif
+
+/*------------------------------ tasks and deques ----------------------------*/
+
+typedef struct
+{
+  void (*fn)(void *arg);
+  void *arg;
+  UengTaskGroup *g;
+} Task;
+
+typedef struct DqArray
+{
+  i64 size; /* power of two */
+  struct DqArray *retired; /* older, smaller arrays a thief may still read */
+  void *volatile slot[];
+} DqArray;
+
+/* Chase-Lev deque: the owner pushes and takes at 'bottom', thieves steal at
+   'top'. Padded so two workers' deques never share a cache line. */
+typedef struct
+{
+  volatile i64 top;
+  char pad0[64 - sizeof(i64)];
+  volatile i64 bottom;
+  void *volatile arr; /* DqArray */
+  char pad1[64 - sizeof(i64) - sizeof(void *)];
+} Deque;
+
+static DqArray *dq_array(i64 size)
+{
+  DqArray *a = (DqArray *)calloc(1, sizeof(DqArray) + (size_t)size * sizeof(void *));
+  if (a)
+    a->size = size;
+  return a;
+}
+
+static int dq_init(Deque *q)
+{
+  memset(q, 0, sizeof(*q));
+  q->arr = dq_array(64);
+  return q->arr ? 0 : -1;
+}
+
+static void dq_free(Deque *q)
+{
+  DqArray *a = (DqArray *)q->arr;
+  while (a)
+  {
+    DqArray *r = a->retired;
+    free(a);
+    a = r;
+  }
+  q->arr = NULL;
+}
+
+/* Owner only. Returns -1 when the deque is full and cannot grow. */
+static int dq_push(Deque *q, Task *t)
+{
+  i64 b = ld64(&q->bottom), top = ld64(&q->top);
+  DqArray *a = (DqArray *)q->arr;
+  if (b - top > a->size - 1)
+  {
+    DqArray *na = dq_array(a->size * 2);
+    if (!na)
+      return -1;
+    for (i64 i = top; i < b; ++i)
+      na->slot[i & (na->size - 1)] = ldp(&a->slot[i & (a->size - 1)]);
+    na->retired = a; /* freed with the pool: a thief may be reading it */
+    stp(&q->arr, na);
+    a = na;
+  }
+  stp(&a->slot[b & (a->size - 1)], t);
+  fence_rel();
+  st64(&q->bottom, b + 1);
+  return 0;
+}
+
+/* Owner only: newest task first (keeps the owner's working set warm). */
+static Task *dq_take(Deque *q)
+{
+  i64 b = ld64(&q->bottom) - 1;
+  DqArray *a = (DqArray *)q->arr;
+  st64(&q->bottom, b);
+  fence_sc();
+  i64 t = ld64(&q->top);
+  Task *x = NULL;
+  if (t <= b)
+  {
+    x = (Task *)ldp(&a->slot[b & (a->size - 1)]);
+    if (t == b)
+    {
+      if (!cas64(&q->top, t, t + 1))
+        x = NULL; /* a thief got the last one */
+      st64(&q->bottom, b + 1);
+    }
+  }
+  else
+    st64(&q->bottom, b + 1);
+  return x;
+}
+
+/* Any thread: oldest task first. *lost is set when a race was lost (retry). */
+static Task *dq_steal(Deque *q, int *lost)
+{
+  i64 t = ld64(&q->top);
+  fence_sc();
+  i64 b = ld64(&q->bottom);
+  if (t >= b)
+    return NULL;
+  DqArray *a = (DqArray *)ldp(&q->arr);
+  Task *x = (Task *)ldp(&a->slot[t & (a->size - 1)]);
+  if (!cas64(&q->top, t, t + 1))
+  {
+    *lost = 1;
+    return NULL;
+  }
+  return x;
+}
+
+/*------------------------------ pool ----------------------------------------*/
+
+typedef struct
+{
+  Deque dq;
+  UengPool *pool;
+  ueng_thread_t th;
+  int id;
+  int started;
+} Worker;
+
+struct UengPool
+{
+  int n;
+  Worker *w;
+  ueng_mutex_t mu; /* sleeping and the injection queue */
+  ueng_cond_t cv;
+  Task **inj; /* FIFO ring for tasks spawned outside the workers */
+  size_t inj_head, inj_count, inj_cap;
+  volatile long inj_n;    /* inj_count, readable without the lock */
+  volatile long queued;   /* tasks sitting in any queue */
+  volatile long sleepers; /* threads blocked on cv */
+  volatile long stop;
+};
+
+static UENG_TLS Worker *tl_worker;
+
+static Task *inj_pop(UengPool *p)
+{
+  Task *t = NULL;
+  if (ldl(&p->inj_n) == 0)
+    return NULL;
+  ueng_mutex_lock(&p->mu);
+  if (p->inj_count)
+  {
+    t = p->inj[p->inj_head];
+    p->inj_head = (p->inj_head + 1) % p->inj_cap;
+    p->inj_count--;
+    addl(&p->inj_n, -1);
+  }
+  ueng_mutex_unlock(&p->mu);
+  return t;
+}
+
+static int inj_push(UengPool *p, Task *t)
+{
+  ueng_mutex_lock(&p->mu);
+  if (p->inj_count == p->inj_cap)
+  {
+    size_t nc = p->inj_cap ? p->inj_cap * 2 : 64;
+    Task **ni = (Task **)malloc(nc * sizeof(Task *));
+    if (!ni)
+    {
+      ueng_mutex_unlock(&p->mu);
+      return -1;
+    }
+    for (size_t i = 0; i < p->inj_count; ++i)
+      ni[i] = p->inj[(p->inj_head + i) % p->inj_cap];
+    free(p->inj);
+    p->inj = ni;
+    p->inj_head = 0;
+    p->inj_cap = nc;
+  }
+  p->inj[(p->inj_head + p->inj_count) % p->inj_cap] = t;
+  p->inj_count++;
+  addl(&p->inj_n, 1);
+  ueng_mutex_unlock(&p->mu);
+  return 0;
+}
+
+static void wake(UengPool *p)
+{
+  if (ldl(&p->sleepers) > 0)
+  {
+    ueng_mutex_lock(&p->mu);
+    ueng_cond_broadcast(&p->cv);
+    ueng_mutex_unlock(&p->mu);
+  }
+}
+
+/* Own deque, then the injection queue, then the other workers' deques. */
+static Task *find_task(UengPool *p, Worker *self)
+{
+  if (ldl(&p->queued) == 0)
+    return NULL;
+  Task *t = self ? dq_take(&self->dq) : NULL;
+  if (!t)
+    t = inj_pop(p);
+  for (int round = 0; !t && round < 2; ++round)
+  {
+    int lost = 0;
+    int start = self ? self->id + 1 : 0;
+    for (int k = 0; k < p->n && !t; ++k)
+    {
+      Worker *v = &p->w[(start + k) % p->n];
+      if (v != self)
+        t = dq_steal(&v->dq, &lost);
+    }
+    if (!lost)
+      break;
+  }
+  if (t)
+    addl(&p->queued, -1);
+  return t;
+}
+
+static void run_task(UengPool *p, Task *t)
+{
+  UengTaskGroup *g = t->g;
+  if (!ldl(&g->cancelled))
+    t->fn(t->arg);
+  free(t);
+  if (addl(&g->pending, -1) == 0)
+    wake(p); /* a waiter may be asleep */
+}
+
+static void worker_main(void *arg)
+{
+  Worker *w = (Worker *)arg;
+  UengPool *p = w->pool;
+  tl_worker = w;
+  if (ueng_trace_on())
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "pool worker %d", (int)(w - p->w) + 1);
+    ueng_trace_thread_name(name);
+  }
+  for (;;)
+  {
+    Task *t = find_task(p, w);
+    if (t)
+    {
+      run_task(p, t);
+      continue;
+    }
+    ueng_mutex_lock(&p->mu);
+    addl(&p->sleepers, 1);
+    while (!ldl(&p->stop) && ldl(&p->queued) == 0)
+      ueng_cond_wait(&p->cv, &p->mu);
+    addl(&p->sleepers, -1);
+    int done = ldl(&p->stop) && ldl(&p->queued) == 0;
+    ueng_mutex_unlock(&p->mu);
+    if (done)
+      break;
+  }
+  tl_worker = NULL;
+}
+
+UengPool *ueng_pool_create(int workers)
+{
+  if (workers < 0)
+    workers = 0;
+  UengPool *p = (UengPool *)calloc(1, sizeof(UengPool));
+  if (!p)
+    return NULL;
+  p->w = workers ? (Worker *)calloc((size_t)workers, sizeof(Worker)) : NULL;
+  if (workers && !p->w)
+  {
+    free(p);
+    return NULL;
+  }
+  ueng_mutex_init(&p->mu);
+  ueng_cond_init(&p->cv);
+  /* Every deque exists before any thread starts, so thieves can scan all
+     p->n of them; a worker whose thread fails to start just stays empty. */
+  for (int i = 0; i < workers; ++i)
+  {
+    if (dq_init(&p->w[i].dq) != 0)
+      break;
+    p->w[i].pool = p;
+    p->w[i].id = i;
+    p->n++;
+  }
+  for (int i = 0; i < p->n; ++i)
+    p->w[i].started = ueng_thread_start(&p->w[i].th, worker_main, &p->w[i]) == 0;
+  return p;
+}
+
+void ueng_pool_destroy(UengPool *p)
+{
+  if (!p)
+    return;
+  ueng_mutex_lock(&p->mu);
+  addl(&p->stop, 1);
+  ueng_cond_broadcast(&p->cv);
+  ueng_mutex_unlock(&p->mu);
+  for (int i = 0; i < p->n; ++i)
+    if (p->w[i].started)
+      ueng_thread_join(p->w[i].th);
+  for (Task *t; (t = find_task(p, NULL)) != NULL;)
+    run_task(p, t); /* spawned by nobody who waited; still honoured */
+  for (int i = 0; i < p->n; ++i)
+    dq_free(&p->w[i].dq);
+  ueng_cond_destroy(&p->cv);
+  ueng_mutex_destroy(&p->mu);
+  free(p->inj);
+  free(p->w);
+  free(p);
+}
+
+int ueng_pool_workers(const UengPool *p) { return p ? p->n : 0; }
+
+/*------------------------------ groups --------------------------------------*/
+
+void ueng_group_init(UengTaskGroup *g, UengPool *p)
+{
+  g->pool = p;
+  g->pending = 0;
+  g->cancelled = 0;
+}
+
+int ueng_group_spawn(UengTaskGroup *g, void (*fn)(void *arg), void *arg)
+{
+  UengPool *p = g->pool;
+  Task *t = p ? (Task *)malloc(sizeof(Task)) : NULL;
+  if (!t)
+  {
+    if (!ldl(&g->cancelled))
+      fn(arg);
+    return -1;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  t->g = g;
+  addl(&g->pending, 1);
+  Worker *w = tl_worker;
+  int rc = (w && w->pool == p) ? dq_push(&w->dq, t) : inj_push(p, t);
+  if (rc != 0)
+  {
+    addl(&g->pending, -1);
+    free(t);
+    if (!ldl(&g->cancelled))
+      fn(arg);
+    return -1;
+  }
+  addl(&p->queued, 1);
+  wake(p);
+  return 0;
+}
+
+void ueng_group_wait(UengTaskGroup *g)
+{
+  UengPool *p = g->pool;
+  if (!p)
+    return;
+  Worker *self = tl_worker && tl_worker->pool == p ? tl_worker : NULL;
+  while (ldl(&g->pending) > 0)
+  {
+    Task *t = find_task(p, self);
+    if (t)
+    {
+      run_task(p, t);
+      continue;
+    }
+    ueng_mutex_lock(&p->mu);
+    addl(&p->sleepers, 1);
+    while (ldl(&g->pending) > 0 && ldl(&p->queued) == 0)
+      ueng_cond_wait(&p->cv, &p->mu);
+    addl(&p->sleepers, -1);
+    ueng_mutex_unlock(&p->mu);
+  }
+}
+
+void ueng_group_cancel(UengTaskGroup *g) { addl(&g->cancelled, 1); }
+
+int ueng_group_cancelled(const UengTaskGroup *g)
+{
+  return ldl((volatile long *)&g->cancelled) != 0;
+}
+
+/*------------------------------ global pool ---------------------------------*/
+
+static int g_jobs;
+static UengPool *g_pool;
+
+int ueng_jobs(void)
+{
+  if (g_jobs > 0)
+    return g_jobs;
+  const char *e = getenv("UENG_JOBS");
+  int n = e ? atoi(e) : 0;
+  return n > 0 ? n : ueng_cpu_count();
+}
+
+void ueng_set_jobs(int jobs) { g_jobs = jobs > 0 ? jobs : 0; }
+
+static void global_pool_exit(void)
+{
+  ueng_pool_destroy(g_pool);
+  g_pool = NULL;
+}
+
+static void global_pool_init(void)
+{
+  g_pool = ueng_pool_create(ueng_jobs() - 1); /* the waiting thread is the last one */
+  if (g_pool)
+    atexit(global_pool_exit);
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK global_pool_once(PINIT_ONCE once, PVOID param, PVOID *ctx)
+{
+  (void)once;
+  (void)param;
+  (void)ctx;
+  global_pool_init();
+  return TRUE;
+}
+#endif
+
+UengPool *ueng_pool_global(void)
+{
+#ifdef _WIN32
+  static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+  InitOnceExecuteOnce(&once, global_pool_once, NULL, NULL);
+#else
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, global_pool_init);
+#endif
+  return g_pool;
+}
@@ -0,0 +1,1533 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/search.c
+ * Purpose: Build-time full-text search index for the generated site
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *
+ * Notes for contributors:
+ * - Single pass over the mmap'd draft. The per-token path only touches the
+ *   hash slot and a 16-byte Term; each section's distinct (term, tf) pairs
+ *   are appended to one flat hit list when the section ends. Postings are
+ *   encoded from that list at the end (size pass, then fill pass), so no
+ *   per-term buffers are grown while scanning.
+ * - Anchors follow pandoc's auto_identifiers rules so links land on the
+ *   headings of html/book.html when pandoc produced it.
+ *---------------------------------------------------------------------------*/
+#include "ueng/search.h"
+#include "ueng/common.h"
+#include "ueng/hash.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------ byte buffers --------------------------------*/
+
+typedef struct
+{
+  unsigned char *p;
+  size_t n, cap;
+  int oom;
+} Buf;
+
+static int buf_reserve(Buf *b, size_t extra)
+{
+  if (b->n + extra <= b->cap)
+    return 0;
+  size_t nc = b->cap ? b->cap * 2 : 256;
+  while (nc < b->n + extra)
+    nc *= 2;
+  unsigned char *np = (unsigned char *)realloc(b->p, nc);
+  if (!np)
+  {
+    b->oom = 1;
+    return -1;
+  }
+  b->p = np;
+  b->cap = nc;
+  return 0;
+}
+
+static void buf_put(Buf *b, const void *p, size_t n)
+{
+  if (buf_reserve(b, n) != 0)
+    return;
+  memcpy(b->p + b->n, p, n);
+  b->n += n;
+}
+
+static size_t varint_len(uint32_t v)
+{
+  size_t n = 1;
+  while (v >= 0x80)
+  {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+static unsigned char *put_varint(unsigned char *p, uint32_t v)
+{
+  while (v >= 0x80)
+  {
+    *p++ = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (unsigned char)v;
+  return p;
+}
+
+static void buf_varint(Buf *b, uint32_t v)
+{
+  if (buf_reserve(b, 5) != 0)
+    return;
+  b->n = (size_t)(put_varint(b->p + b->n, v) - b->p);
+}
+
+static void buf_u32(Buf *b, uint32_t v)
+{
+  unsigned char t[4] = {(unsigned char)(v & 0xFF), (unsigned char)((v >> 8) & 0xFF),
+                        (unsigned char)((v >> 16) & 0xFF), (unsigned char)(v >> 24)};
+  buf_put(b, t, 4);
+}
+
+/* Append a NUL-terminated string to the pool and return its offset. */
+static uint32_t pool_add(Buf *pool, const char *s, size_t n)
+{
+  uint32_t off = (uint32_t)pool->n;
+  buf_put(pool, s, n);
+  buf_put(pool, "", 1);
+  return off;
+}
+
+/*------------------------------ term table ----------------------------------*/
+
+#define NO_DOC 0xFFFFFFFFu
+
+/* Kept to 16 bytes: this is touched for every token. */
+typedef struct
+{
+  uint32_t str_off; /* into the term arena */
+  uint32_t len;
+  uint32_t last_doc, tf; /* tf within last_doc */
+} Term;
+
+typedef struct
+{
+  Term *terms;
+  size_t count, cap;
+  uint64_t *slots; /* (hash >> 32) << 32 | (term index + 1); 0 = empty */
+  size_t nslots;
+  Buf arena;
+} TermTable;
+
+static int tt_grow_slots(TermTable *t)
+{
+  size_t ns = t->nslots ? t->nslots * 2 : 1u << 14;
+  uint64_t *sl = (uint64_t *)calloc(ns, sizeof(uint64_t));
+  if (!sl)
+    return -1;
+  for (size_t i = 0; i < t->count; ++i)
+  {
+    uint64_t h = ueng_hash64(t->arena.p + t->terms[i].str_off, t->terms[i].len, 0);
+    size_t j = (size_t)h & (ns - 1);
+    while (sl[j])
+      j = (j + 1) & (ns - 1);
+    sl[j] = (h & 0xFFFFFFFF00000000ull) | (uint64_t)(i + 1);
+  }
+  free(t->slots);
+  t->slots = sl;
+  t->nslots = ns;
+  return 0;
+}
+
+/* Find or insert a term whose hash is 'h'; returns its index or -1 on
+   allocation failure. */
+static long tt_get(TermTable *t, const unsigned char *s, size_t n, uint64_t h)
+{
+  if ((t->count + 1) * 2 > t->nslots && tt_grow_slots(t) != 0)
+    return -1;
+  uint64_t tag = h & 0xFFFFFFFF00000000ull;
+  size_t j = (size_t)h & (t->nslots - 1);
+  while (t->slots[j])
+  {
+    uint64_t v = t->slots[j];
+    if ((v & 0xFFFFFFFF00000000ull) == tag)
+    {
+      size_t i = (size_t)(v & 0xFFFFFFFFu) - 1;
+      const Term *e = &t->terms[i];
+      if (e->len == n && memcmp(t->arena.p + e->str_off, s, n) == 0)
+        return (long)i;
+    }
+    j = (j + 1) & (t->nslots - 1);
+  }
+  if (t->count == t->cap)
+  {
+    size_t nc = t->cap ? t->cap * 2 : 4096;
+    Term *nt = (Term *)realloc(t->terms, nc * sizeof(Term));
+    if (!nt)
+      return -1;
+    t->terms = nt;
+    t->cap = nc;
+  }
+  Term *e = &t->terms[t->count];
+  e->str_off = (uint32_t)t->arena.n;
+  e->len = (uint32_t)n;
+  e->last_doc = NO_DOC;
+  e->tf = 0;
+  buf_put(&t->arena, s, n);
+  if (t->arena.oom)
+    return -1;
+  t->slots[j] = tag | (uint64_t)(t->count + 1);
+  return (long)t->count++;
+}
+
+static void tt_free(TermTable *t)
+{
+  free(t->terms);
+  free(t->slots);
+  free(t->arena.p);
+  memset(t, 0, sizeof(*t));
+}
+
+/*------------------------------ anchors -------------------------------------*/
+
+/* pandoc auto_identifiers: keep alphanumerics, '_', '-', '.'; spaces become
+   '-'; lower-case; drop everything before the first letter; "section" if
+   nothing is left. Non-ASCII bytes are kept (pandoc keeps Unicode letters). */
+static void heading_anchor(const char *s, size_t n, char *out, size_t outsz)
+{
+  size_t j = 0;
+  int seen_letter = 0;
+  for (size_t i = 0; i < n && j + 1 < outsz; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    int letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+    if (!seen_letter && !letter)
+      continue;
+    seen_letter = 1;
+    if (c >= 'A' && c <= 'Z')
+      out[j++] = (char)(c - 'A' + 'a');
+    else if (c == 0xC3 && i + 1 < n && j + 2 < outsz)
+    {
+      /* Latin-1 capitals (U+00C0..U+00DE minus U+00D7) lower-case like pandoc. */
+      unsigned char d = (unsigned char)s[++i];
+      out[j++] = (char)c;
+      out[j++] = (char)((d >= 0x80 && d <= 0x9E && d != 0x97) ? d + 0x20 : d);
+    }
+    else if (letter || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.')
+      out[j++] = (char)c;
+    else if (c == ' ' || c == '\t')
+      out[j++] = '-';
+  }
+  out[j] = '\0';
+  if (!j)
+    snprintf(out, outsz, "section");
+}
+
+/* Pandoc de-duplicates ids as foo, foo-1, foo-2, ... */
+typedef struct
+{
+  uint64_t *keys;
+  uint32_t *counts;
+  size_t n, cap;
+} AnchorSet;
+
+static uint32_t anchor_seen(AnchorSet *a, const char *s)
+{
+  if ((a->n + 1) * 2 > a->cap)
+  {
+    size_t nc = a->cap ? a->cap * 2 : 1024;
+    uint64_t *nk = (uint64_t *)calloc(nc, sizeof(uint64_t));
+    uint32_t *ncnt = (uint32_t *)calloc(nc, sizeof(uint32_t));
+    if (!nk || !ncnt)
+    {
+      free(nk);
+      free(ncnt);
+      return 0;
+    }
+    for (size_t i = 0; i < a->cap; ++i)
+      if (a->keys[i])
+      {
+        size_t j = (size_t)a->keys[i] & (nc - 1);
+        while (nk[j])
+          j = (j + 1) & (nc - 1);
+        nk[j] = a->keys[i];
+        ncnt[j] = a->counts[i];
+      }
+    free(a->keys);
+    free(a->counts);
+    a->keys = nk;
+    a->counts = ncnt;
+    a->cap = nc;
+  }
+  uint64_t k = ueng_hash64(s, strlen(s), 1) | 1; /* 0 marks an empty slot */
+  size_t j = (size_t)k & (a->cap - 1);
+  while (a->keys[j] && a->keys[j] != k)
+    j = (j + 1) & (a->cap - 1);
+  if (!a->keys[j])
+  {
+    a->keys[j] = k;
+    a->n++;
+  }
+  return a->counts[j]++;
+}
+
+/*------------------------------ builder -------------------------------------*/
+
+/* 0 = separator, else the byte as indexed (ASCII lower-cased). Shared by the
+   builder and the query path so both split text identically. */
+static void token_classes(unsigned char cls[256])
+{
+  for (int c = 0; c < 256; ++c)
+  {
+    cls[c] = 0;
+    if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c >= 0x80)
+      cls[c] = (unsigned char)c;
+    else if (c >= 'A' && c <= 'Z')
+      cls[c] = (unsigned char)(c - 'A' + 'a');
+  }
+}
+
+/* Decode the UTF-8 sequence at p; 0 when it is malformed or cut off. */
+static uint32_t utf8_decode(const unsigned char *p, const unsigned char *e, size_t *len)
+{
+  unsigned char c = *p;
+  size_t k = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC2 ? 1 : 0;
+  if (!k || c >= 0xF5 || (size_t)(e - p) <= k)
+    return 0;
+  uint32_t cp = c & (0x3F >> k);
+  for (size_t j = 1; j <= k; ++j)
+  {
+    if ((p[j] & 0xC0) != 0x80)
+      return 0;
+    cp = (cp << 6) | (p[j] & 0x3F);
+  }
+  *len = k + 1;
+  return cp;
+}
+
+/* Non-ASCII spaces and punctuation that must split words like their ASCII
+   cousins do: NBSP, Latin-1 punctuation (guillemets, inverted marks,
+   section/pilcrow, middle dot), the General Punctuation block (typographic
+   spaces, dashes, curly quotes, ellipsis, ...), ideographic space and
+   punctuation, and the BOM. */
+static int uni_separator(uint32_t cp)
+{
+  switch (cp)
+  {
+  case 0x00A0: case 0x00A1: case 0x00A7: case 0x00AB: case 0x00B6: case 0x00B7:
+  case 0x00BB: case 0x00BF: case 0xFEFF:
+    return 1;
+  default:
+    return (cp >= 0x2000 && cp <= 0x206F) || (cp >= 0x3000 && cp <= 0x3003);
+  }
+}
+
+/* Bytes of the separator at p, or 0 when p starts (or continues) a token.
+   Every tokenizer goes through this, so the builder, the query and the
+   snippet search split text identically. */
+static size_t sep_len(const unsigned char *cls, const unsigned char *p, const unsigned char *e)
+{
+  if (*p < 0x80)
+    return cls[*p] ? 0 : 1;
+  size_t len = 0;
+  uint32_t cp = (*p & 0xC0) == 0x80 ? 0 : utf8_decode(p, e, &len);
+  return cp && uni_separator(cp) ? len : 0;
+}
+
+/* Tokens are looked up in batches: hashing a whole batch first lets the
+   slot loads be prefetched instead of stalling once per token. */
+#define TOK_BATCH 64
+
+typedef struct
+{
+  unsigned char bytes[TOK_BATCH * SEARCH_TERM_MAX];
+  uint32_t off[TOK_BATCH], len[TOK_BATCH];
+  uint64_t h[TOK_BATCH];
+  size_t n, used;
+} TokBatch;
+
+typedef struct
+{
+  TermTable tt;
+  Buf docs;    /* SearchIdxDoc records, serialized at the end */
+  Buf pool;    /* string pool */
+  Buf chaps;   /* u32 string offsets, one per chapter */
+  Buf doc_terms; /* native u32 term ids first seen in the current section */
+  Buf hits;      /* native u32 (term, tf) pairs, grouped by section */
+  Buf hit_end;   /* native u32 end of each section's pairs in 'hits' */
+  SearchIdxDoc cur;
+  uint32_t n_docs, n_chapters;
+  int have_doc;
+  AnchorSet anchors;
+  unsigned char cls[256]; /* 0 = separator, else lower-cased byte */
+  TokBatch batch;
+} Builder;
+
+static void add_token(Builder *b, const unsigned char *s, size_t n, uint64_t h)
+{
+  long id = tt_get(&b->tt, s, n, h);
+  if (id < 0)
+    return;
+  Term *e = &b->tt.terms[id];
+  b->cur.n_tokens++;
+  if (e->last_doc == b->n_docs)
+  {
+    e->tf++;
+    return;
+  }
+  e->last_doc = b->n_docs;
+  e->tf = 1;
+  uint32_t id32 = (uint32_t)id;
+  buf_put(&b->doc_terms, &id32, sizeof(id32));
+}
+
+static void batch_flush(Builder *b, TokBatch *q)
+{
+  size_t mask = b->tt.nslots ? b->tt.nslots - 1 : 0;
+  for (size_t i = 0; i < q->n; ++i)
+  {
+    q->h[i] = ueng_hash64(q->bytes + q->off[i], q->len[i], 0);
+#if defined(__GNUC__) || defined(__clang__)
+    if (b->tt.slots)
+      __builtin_prefetch(&b->tt.slots[q->h[i] & mask]);
+#endif
+  }
+#if defined(__GNUC__) || defined(__clang__)
+  /* Second stage: the home slots are (mostly) cached now; prefetch the term
+     and its bytes so the compare in tt_get does not stall either. */
+  for (size_t i = 0; b->tt.slots && i < q->n; ++i)
+  {
+    uint64_t v = b->tt.slots[q->h[i] & mask];
+    if (v)
+    {
+      const Term *e = &b->tt.terms[(v & 0xFFFFFFFFu) - 1];
+      __builtin_prefetch(e);
+      __builtin_prefetch(b->tt.arena.p + e->str_off);
+    }
+  }
+#endif
+  for (size_t i = 0; i < q->n; ++i)
+    add_token(b, q->bytes + q->off[i], q->len[i], q->h[i]);
+  q->n = 0;
+  q->used = 0;
+}
+
+static void tokenize(Builder *b, const unsigned char *p, size_t n)
+{
+  TokBatch *q = &b->batch;
+  size_t tl = 0;
+  for (size_t i = 0; i <= n; ++i)
+  {
+    size_t sep = i < n ? sep_len(b->cls, p + i, p + n) : 1;
+    unsigned char c = sep ? 0 : b->cls[p[i]];
+    if (c)
+    {
+      if (tl < SEARCH_TERM_MAX)
+        q->bytes[q->used + tl] = c;
+      tl++;
+      continue;
+    }
+    if (tl >= SEARCH_TERM_MIN && tl <= SEARCH_TERM_MAX)
+    {
+      q->off[q->n] = (uint32_t)q->used;
+      q->len[q->n] = (uint32_t)tl;
+      q->used += tl;
+      if (++q->n == TOK_BATCH)
+        batch_flush(b, q);
+    }
+    tl = 0;
+    i += sep > 1 ? sep - 1 : 0;
+  }
+  batch_flush(b, q);
+}
+
+static void end_doc(Builder *b, uint32_t end_off)
+{
+  if (!b->have_doc)
+    return;
+  b->cur.src_len = end_off - b->cur.src_off;
+  buf_u32(&b->docs, b->cur.src_off);
+  buf_u32(&b->docs, b->cur.src_len);
+  buf_u32(&b->docs, b->cur.n_tokens);
+  buf_u32(&b->docs, b->cur.chapter);
+  buf_u32(&b->docs, b->cur.anchor_str);
+  buf_u32(&b->docs, b->cur.title_str);
+  const uint32_t *ids = (const uint32_t *)b->doc_terms.p;
+  size_t nids = b->doc_terms.n / sizeof(uint32_t);
+  if (buf_reserve(&b->hits, nids * 2 * sizeof(uint32_t)) == 0)
+  {
+    uint32_t *out = (uint32_t *)(b->hits.p + b->hits.n);
+    for (size_t i = 0; i < nids; ++i)
+    {
+      out[2 * i] = ids[i];
+      out[2 * i + 1] = b->tt.terms[ids[i]].tf;
+    }
+    b->hits.n += nids * 2 * sizeof(uint32_t);
+  }
+  b->doc_terms.n = 0;
+  uint32_t he = (uint32_t)(b->hits.n / (2 * sizeof(uint32_t)));
+  buf_put(&b->hit_end, &he, sizeof(he));
+  b->n_docs++;
+  b->have_doc = 0;
+}
+
+/* Start a new section. An empty previous section (e.g. a chapter marker
+   directly followed by its heading) is replaced instead of kept. */
+static void begin_doc(Builder *b, uint32_t off, const char *title, size_t tn, const char *anchor)
+{
+  if (b->have_doc && b->cur.n_tokens > 0)
+    end_doc(b, off);
+  b->cur.src_off = b->have_doc ? b->cur.src_off : off;
+  b->cur.n_tokens = 0;
+  b->cur.chapter = b->n_chapters ? b->n_chapters - 1 : 0;
+  b->cur.title_str = pool_add(&b->pool, title, tn);
+  b->cur.anchor_str = pool_add(&b->pool, anchor, strlen(anchor));
+  b->have_doc = 1;
+}
+
+/* qsort has no context pointer in C17, so the comparator reads the table being
+   sorted from these file statics (the build runs on one thread). */
+typedef struct
+{
+  uint32_t df, len; /* postings count and encoded bytes */
+  uint32_t cur;     /* write cursor into the postings section */
+} TermPost;
+
+static const unsigned char *sort_arena;
+static const Term *sort_terms;
+
+static int term_cmp(const void *a, const void *b)
+{
+  const Term *x = &sort_terms[*(const uint32_t *)a];
+  const Term *y = &sort_terms[*(const uint32_t *)b];
+  uint32_t n = x->len < y->len ? x->len : y->len;
+  int c = memcmp(sort_arena + x->str_off, sort_arena + y->str_off, n);
+  if (c)
+    return c;
+  return (x->len > y->len) - (x->len < y->len);
+}
+
+/* "<!-- name -->" lines are the chapter markers written by concat_md_dir. */
+static int chapter_marker(const unsigned char *p, size_t n, size_t *name_off, size_t *name_len)
+{
+  if (n < 9 || memcmp(p, "<!-- ", 5) != 0 || memcmp(p + n - 4, " -->", 4) != 0)
+    return 0;
+  *name_off = 5;
+  *name_len = n - 9;
+  return 1;
+}
+
+int search_build_index(const char *draft_path, const char *index_path, const char *source_rel,
+                       SearchBuildStats *st)
+{
+  double t0 = ueng_now_ms();
+  if (st)
+    memset(st, 0, sizeof(*st));
+  UengMap m;
+  if (ueng_map_file(draft_path, &m) != 0)
+    return -1;
+  if (m.len > 0xFFFFFFFFu)
+  {
+    ueng_unmap_file(&m);
+    return -1;
+  }
+
+  Builder *b = (Builder *)calloc(1, sizeof(Builder));
+  if (!b)
+  {
+    ueng_unmap_file(&m);
+    return -1;
+  }
+  token_classes(b->cls);
+  (void)pool_add(&b->pool, "", 0); /* offset 0 = empty string */
+
+  const unsigned char *p = m.data, *end = m.data + m.len;
+  int in_code = 0;
+  while (p < end)
+  {
+    const unsigned char *eol = (const unsigned char *)memchr(p, '\n', (size_t)(end - p));
+    if (!eol)
+      eol = end;
+    size_t ll = (size_t)(eol - p);
+    if (ll && p[ll - 1] == '\r')
+      ll--;
+    uint32_t off = (uint32_t)(p - m.data);
+    size_t no, nl;
+
+    if (ll >= 3 && memcmp(p, "```", 3) == 0)
+      in_code = !in_code;
+    else if (!in_code && chapter_marker(p, ll, &no, &nl))
+    {
+      uint32_t s = pool_add(&b->pool, (const char *)p + no, nl);
+      buf_u32(&b->chaps, s);
+      b->n_chapters++;
+      char title[256];
+      size_t tn = nl < sizeof(title) - 1 ? nl : sizeof(title) - 1;
+      memcpy(title, p + no, tn);
+      if (tn > 3 && memcmp(title + tn - 3, ".md", 3) == 0)
+        tn -= 3;
+      begin_doc(b, off, title, tn, "");
+    }
+    else if (!in_code && ll > 1 && p[0] == '#')
+    {
+      size_t h = 0;
+      while (h < ll && p[h] == '#')
+        h++;
+      if (h <= 6 && h < ll && p[h] == ' ')
+      {
+        const char *t = (const char *)p + h + 1;
+        size_t tn = ll - h - 1;
+        char anchor[256], uniq[272];
+        heading_anchor(t, tn, anchor, sizeof(anchor));
+        uint32_t dup = anchor_seen(&b->anchors, anchor);
+        if (dup)
+          snprintf(uniq, sizeof(uniq), "%s-%u", anchor, dup);
+        else
+          snprintf(uniq, sizeof(uniq), "%s", anchor);
+        begin_doc(b, off, t, tn, uniq);
+      }
+      else if (!b->have_doc)
+        begin_doc(b, off, "", 0, "");
+      tokenize(b, p, ll);
+    }
+    else
+    {
+      if (!b->have_doc)
+        begin_doc(b, off, "", 0, "");
+      tokenize(b, p, ll);
+    }
+    p = (eol < end) ? eol + 1 : end;
+  }
+  end_doc(b, (uint32_t)m.len);
+  uint64_t bytes_in = m.len;
+  ueng_unmap_file(&m);
+
+  /* Order terms bytewise for front coding, then encode postings from the hit
+     list: pass 1 sizes each term's list, pass 2 fills it in place. */
+  TermTable *tt = &b->tt;
+  size_t nt = tt->count ? tt->count : 1;
+  uint32_t *order = (uint32_t *)malloc(nt * sizeof(uint32_t));
+  TermPost *tp = (TermPost *)calloc(nt, sizeof(TermPost));
+  int rc = (order && tp && !b->hits.oom && !b->hit_end.oom && !b->doc_terms.oom) ? 0 : -1;
+  const uint32_t *hits = (const uint32_t *)b->hits.p;
+  const uint32_t *hit_end = (const uint32_t *)b->hit_end.p;
+  Buf posts = {0};
+  for (int pass = 0; rc == 0 && pass < 2; ++pass)
+  {
+    for (size_t i = 0; i < tt->count; ++i)
+      tt->terms[i].last_doc = NO_DOC;
+    size_t h = 0;
+    for (uint32_t d = 0; d < b->n_docs; ++d)
+    {
+      for (; h < hit_end[d]; ++h)
+      {
+        uint32_t t = hits[2 * h], tf = hits[2 * h + 1];
+        Term *e = &tt->terms[t];
+        uint32_t delta = e->last_doc == NO_DOC ? d : d - e->last_doc;
+        e->last_doc = d;
+        if (pass == 0)
+        {
+          tp[t].df++;
+          tp[t].len += (uint32_t)(varint_len(delta) + varint_len(tf));
+        }
+        else
+        {
+          unsigned char *w = put_varint(posts.p + tp[t].cur, delta);
+          w = put_varint(w, tf);
+          tp[t].cur = (uint32_t)(w - posts.p);
+        }
+      }
+    }
+    if (pass == 0)
+    {
+      for (size_t i = 0; i < tt->count; ++i)
+        order[i] = (uint32_t)i;
+      sort_arena = tt->arena.p;
+      sort_terms = tt->terms;
+      qsort(order, tt->count, sizeof(uint32_t), term_cmp);
+      uint64_t total = 0;
+      for (size_t k = 0; k < tt->count; ++k)
+      {
+        tp[order[k]].cur = (uint32_t)total;
+        total += tp[order[k]].len;
+      }
+      if (total > 0xFFFFFFFFu || buf_reserve(&posts, (size_t)total + 1) != 0)
+        rc = -1;
+      else
+        posts.n = (size_t)total;
+    }
+  }
+
+  Buf terms = {0}, blocks = {0};
+  uint32_t n_blocks = 0;
+  const unsigned char *prev = NULL;
+  uint32_t prev_len = 0;
+  for (size_t k = 0; rc == 0 && k < tt->count; ++k)
+  {
+    Term *e = &tt->terms[order[k]];
+    const TermPost *q = &tp[order[k]];
+    const unsigned char *s = tt->arena.p + e->str_off;
+    if (k % SEARCH_IDX_BLOCK == 0)
+    {
+      buf_u32(&blocks, (uint32_t)terms.n);
+      buf_u32(&blocks, q->cur - q->len); /* start of this term's postings */
+      n_blocks++;
+      buf_varint(&terms, e->len);
+      buf_put(&terms, s, e->len);
+    }
+    else
+    {
+      uint32_t shared = 0;
+      while (shared < prev_len && shared < e->len && prev[shared] == s[shared])
+        shared++;
+      buf_varint(&terms, shared);
+      buf_varint(&terms, e->len - shared);
+      buf_put(&terms, s + shared, e->len - shared);
+    }
+    buf_varint(&terms, q->df);
+    buf_varint(&terms, q->len);
+    prev = s;
+    prev_len = e->len;
+  }
+
+  /* Lay out sections and write the file. */
+  if (!source_rel)
+    source_rel = "";
+  uint32_t src_str = pool_add(&b->pool, source_rel, strlen(source_rel));
+  uint64_t docs_off = 64;
+  uint64_t chapters_off = docs_off + b->docs.n;
+  uint64_t blocks_off = chapters_off + b->chaps.n;
+  uint64_t strings_off = blocks_off + blocks.n;
+  uint64_t terms_off = strings_off + b->pool.n;
+  uint64_t post_off = terms_off + terms.n;
+  uint64_t file_len = post_off + posts.n;
+  if (terms.oom || posts.oom || blocks.oom || b->docs.oom || b->pool.oom || b->chaps.oom ||
+      tt->arena.oom || file_len > 0xFFFFFFFFu)
+    rc = -1;
+
+  if (rc == 0)
+  {
+    Buf hdr = {0};
+    buf_put(&hdr, SEARCH_IDX_MAGIC, 8);
+    buf_u32(&hdr, SEARCH_IDX_VERSION);
+    buf_u32(&hdr, b->n_docs);
+    buf_u32(&hdr, (uint32_t)tt->count);
+    buf_u32(&hdr, b->n_chapters);
+    buf_u32(&hdr, n_blocks);
+    buf_u32(&hdr, (uint32_t)docs_off);
+    buf_u32(&hdr, (uint32_t)chapters_off);
+    buf_u32(&hdr, (uint32_t)blocks_off);
+    buf_u32(&hdr, (uint32_t)strings_off);
+    buf_u32(&hdr, (uint32_t)terms_off);
+    buf_u32(&hdr, (uint32_t)post_off);
+    buf_u32(&hdr, src_str);
+    buf_u32(&hdr, (uint32_t)file_len);
+    buf_u32(&hdr, 0);
+    /* Write beside the target and rename over it: `serve` may have the old
+       index mapped, and truncating a mapped file would fault its readers. */
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", index_path);
+    FILE *f = (hdr.oom || mkpath_parent(index_path) != 0) ? NULL : ueng_fopen(tmp, "wb");
+    if (!f)
+      rc = -1;
+    else
+    {
+      const Buf *parts[] = {&hdr, &b->docs, &b->chaps, &blocks, &b->pool, &terms, &posts};
+      for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i)
+        if (parts[i]->n && fwrite(parts[i]->p, 1, parts[i]->n, f) != parts[i]->n)
+          rc = -1;
+      if (fclose(f) != 0)
+        rc = -1;
+      if (rc == 0 && replace_file(tmp, index_path) != 0)
+        rc = -1;
+      if (rc != 0)
+        remove(tmp);
+    }
+    free(hdr.p);
+  }
+
+  if (st && rc == 0)
+  {
+    st->bytes_in = bytes_in;
+    st->n_docs = b->n_docs;
+    st->n_terms = (uint32_t)tt->count;
+    st->n_chapters = b->n_chapters;
+    st->index_bytes = file_len;
+    st->ms = ueng_now_ms() - t0;
+  }
+  free(order);
+  free(tp);
+  free(terms.p);
+  free(posts.p);
+  free(blocks.p);
+  free(b->docs.p);
+  free(b->pool.p);
+  free(b->chaps.p);
+  free(b->doc_terms.p);
+  free(b->hits.p);
+  free(b->hit_end.p);
+  free(b->anchors.keys);
+  free(b->anchors.counts);
+  tt_free(tt);
+  free(b);
+  return rc;
+}
+
+/*------------------------------ reader --------------------------------------*/
+
+struct SearchIndex
+{
+  UengMap idx, src;
+  SearchIdxHeader h;
+  double avg_len;
+  unsigned char cls[256];
+};
+
+static uint32_t rd32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Bounded varint read; returns NULL on a truncated/overlong value. */
+static const unsigned char *get_varint(const unsigned char *p, const unsigned char *end,
+                                       uint32_t *v)
+{
+  uint32_t x = 0;
+  for (int shift = 0; shift < 35 && p < end; shift += 7)
+  {
+    unsigned char c = *p++;
+    x |= (uint32_t)(c & 0x7F) << shift;
+    if (!(c & 0x80))
+    {
+      *v = x;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+static const char *ix_str(const SearchIndex *ix, uint32_t off)
+{
+  uint32_t n = ix->h.terms_off - ix->h.strings_off;
+  return off < n ? (const char *)ix->idx.data + ix->h.strings_off + off : "";
+}
+
+SearchIndex *search_open(const char *index_path)
+{
+  SearchIndex *ix = (SearchIndex *)calloc(1, sizeof(*ix));
+  if (!ix)
+    return NULL;
+  if (ueng_map_file(index_path, &ix->idx) != 0 || ix->idx.len < 64 ||
+      memcmp(ix->idx.data, SEARCH_IDX_MAGIC, 8) != 0)
+  {
+    search_close(ix);
+    return NULL;
+  }
+  const unsigned char *d = ix->idx.data;
+  SearchIdxHeader *h = &ix->h;
+  memcpy(h->magic, d, 8);
+  uint32_t *f[] = {&h->version,      &h->n_docs,     &h->n_terms,    &h->n_chapters,
+                   &h->n_blocks,     &h->docs_off,   &h->chapters_off, &h->blocks_off,
+                   &h->strings_off,  &h->terms_off,  &h->post_off,   &h->source_str,
+                   &h->file_len,     &h->reserved};
+  for (size_t i = 0; i < sizeof(f) / sizeof(f[0]); ++i)
+    *f[i] = rd32(d + 8 + 4 * i);
+  /* Sections must be in order and match their declared sizes. */
+  if (h->version != SEARCH_IDX_VERSION || h->file_len != ix->idx.len || h->docs_off != 64 ||
+      h->chapters_off != h->docs_off + (uint64_t)h->n_docs * 24 ||
+      h->blocks_off != h->chapters_off + (uint64_t)h->n_chapters * 4 ||
+      h->strings_off != h->blocks_off + (uint64_t)h->n_blocks * 8 ||
+      h->terms_off < h->strings_off || h->post_off < h->terms_off || h->file_len < h->post_off ||
+      h->n_blocks != (h->n_terms + SEARCH_IDX_BLOCK - 1) / SEARCH_IDX_BLOCK)
+  {
+    search_close(ix);
+    return NULL;
+  }
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < h->n_docs; ++i)
+    total += rd32(d + h->docs_off + (size_t)i * 24 + 8);
+  ix->avg_len = h->n_docs && total ? (double)total / h->n_docs : 1.0;
+  token_classes(ix->cls);
+
+  /* The draft is optional: without it results just have no snippet. */
+  const char *rel = ix_str(ix, h->source_str);
+  if (*rel)
+  {
+    char dir[PATH_MAX], src[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", index_path);
+    char *slash = strrchr(dir, '/');
+#ifdef _WIN32
+    char *bslash = strrchr(dir, '\\');
+    if (!slash || (bslash && bslash > slash))
+      slash = bslash;
+#endif
+    if (slash)
+      slash[1] = '\0';
+    else
+      dir[0] = '\0';
+    snprintf(src, sizeof(src), "%s%s", dir, rel);
+    if (ueng_map_file(src, &ix->src) != 0)
+      memset(&ix->src, 0, sizeof(ix->src));
+  }
+  return ix;
+}
+
+void search_close(SearchIndex *ix)
+{
+  if (!ix)
+    return;
+  ueng_unmap_file(&ix->idx);
+  ueng_unmap_file(&ix->src);
+  free(ix);
+}
+
+typedef struct
+{
+  uint32_t df, post_off, post_len;
+} TermRef;
+
+/* Compare the first term of block 'b' with 'key'. */
+static int block_cmp(const SearchIndex *ix, uint32_t b, const unsigned char *key, size_t kn)
+{
+  const unsigned char *end = ix->idx.data + ix->h.post_off;
+  const unsigned char *p = ix->idx.data + ix->h.terms_off + rd32(ix->idx.data + ix->h.blocks_off + (size_t)b * 8);
+  uint32_t n;
+  if (p >= end || !(p = get_varint(p, end, &n)) || n > (uint32_t)(end - p))
+    return 1;
+  size_t m = n < kn ? n : kn;
+  int c = memcmp(p, key, m);
+  return c ? c : (n > kn) - (n < kn);
+}
+
+static int term_lookup(const SearchIndex *ix, const unsigned char *key, size_t kn, TermRef *out)
+{
+  const unsigned char *base = ix->idx.data;
+  uint32_t lo = 0, hi = ix->h.n_blocks, blk = UINT32_MAX;
+  while (lo < hi) /* last block whose first term <= key */
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (block_cmp(ix, mid, key, kn) <= 0)
+    {
+      blk = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid;
+  }
+  if (blk == UINT32_MAX)
+    return -1;
+  const unsigned char *end = base + ix->h.post_off;
+  const unsigned char *p = base + ix->h.terms_off + rd32(base + ix->h.blocks_off + (size_t)blk * 8);
+  uint64_t post = rd32(base + ix->h.blocks_off + (size_t)blk * 8 + 4);
+  unsigned char cur[SEARCH_TERM_MAX];
+  uint32_t cur_len = 0;
+  for (uint32_t k = 0; k < SEARCH_IDX_BLOCK && (uint64_t)blk * SEARCH_IDX_BLOCK + k < ix->h.n_terms;
+       ++k)
+  {
+    uint32_t shared = 0, sl, df, plen;
+    if (k && !(p = get_varint(p, end, &shared)))
+      return -1;
+    if (!(p = get_varint(p, end, &sl)) || shared > cur_len || shared + sl > SEARCH_TERM_MAX ||
+        sl > (uint32_t)(end - p))
+      return -1;
+    memcpy(cur + shared, p, sl);
+    p += sl;
+    cur_len = shared + sl;
+    if (!(p = get_varint(p, end, &df)) || !(p = get_varint(p, end, &plen)))
+      return -1;
+    size_t m = cur_len < kn ? cur_len : kn;
+    int c = memcmp(cur, key, m);
+    if (!c)
+      c = (cur_len > kn) - (cur_len < kn);
+    if (c == 0)
+    {
+      if (post + plen > ix->h.file_len - ix->h.post_off)
+        return -1;
+      out->df = df;
+      out->post_off = (uint32_t)post;
+      out->post_len = plen;
+      return 0;
+    }
+    if (c > 0)
+      return -1;
+    post += plen;
+  }
+  return -1;
+}
+
+typedef struct
+{
+  uint32_t *doc, *tf;
+  uint32_t n, df;
+  double idf;
+} PostList;
+
+static int decode_postings(const SearchIndex *ix, const TermRef *t, PostList *pl)
+{
+  pl->doc = (uint32_t *)malloc((t->df ? t->df : 1) * sizeof(uint32_t));
+  pl->tf = (uint32_t *)malloc((t->df ? t->df : 1) * sizeof(uint32_t));
+  if (!pl->doc || !pl->tf)
+    return -1;
+  const unsigned char *p = ix->idx.data + ix->h.post_off + t->post_off, *end = p + t->post_len;
+  uint32_t doc = 0;
+  pl->n = 0;
+  while (p < end && pl->n < t->df)
+  {
+    uint32_t delta, tf;
+    if (!(p = get_varint(p, end, &delta)) || !(p = get_varint(p, end, &tf)))
+      return -1;
+    doc = pl->n ? doc + delta : delta;
+    if (doc >= ix->h.n_docs)
+      return -1;
+    pl->doc[pl->n] = doc;
+    pl->tf[pl->n++] = tf;
+  }
+  pl->df = pl->n;
+  double N = ix->h.n_docs, df = pl->n;
+  pl->idf = log(1.0 + (N - df + 0.5) / (df + 0.5));
+  return 0;
+}
+
+/* First index i >= from with a[i] >= key: exponential probe, then binary
+   search inside the bracket. Cheap when the short list skips far ahead. */
+static uint32_t gallop(const uint32_t *a, uint32_t n, uint32_t from, uint32_t key)
+{
+  uint32_t step = 1, lo = from, hi = from;
+  while (hi < n && a[hi] < key)
+  {
+    lo = hi + 1;
+    hi = (n - hi > step) ? hi + step : n;
+    step *= 2;
+  }
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+typedef struct
+{
+  uint32_t doc;
+  double score;
+} Hit;
+
+static int hit_cmp(const void *a, const void *b)
+{
+  const Hit *x = (const Hit *)a, *y = (const Hit *)b;
+  if (x->score != y->score)
+    return x->score < y->score ? 1 : -1;
+  return (x->doc > y->doc) - (x->doc < y->doc);
+}
+
+static int postlist_cmp(const void *a, const void *b)
+{
+  const PostList *x = (const PostList *)a, *y = (const PostList *)b;
+  return (x->n > y->n) - (x->n < y->n);
+}
+
+static void json_str(Buf *o, const char *s, size_t n)
+{
+  buf_put(o, "\"", 1);
+  for (size_t i = 0; i < n; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\')
+    {
+      buf_put(o, "\\", 1);
+      buf_put(o, &s[i], 1);
+    }
+    else if (c < 0x20)
+    {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      buf_put(o, esc, 6);
+    }
+    else if (c < 0x80)
+      buf_put(o, &s[i], 1);
+    else
+    {
+      /* Pass through well-formed UTF-8 only so the JSON stays valid. */
+      size_t k = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC2 ? 1 : 0;
+      size_t j = 1;
+      while (j <= k && i + j < n && ((unsigned char)s[i + j] & 0xC0) == 0x80)
+        j++;
+      if (k && j == k + 1 && c < 0xF5)
+      {
+        buf_put(o, &s[i], j);
+        i += k;
+      }
+      else
+        buf_put(o, "\xEF\xBF\xBD", 3); /* U+FFFD */
+    }
+  }
+  buf_put(o, "\"", 1);
+}
+
+/* Start of the line after the one at p (or e). */
+static const unsigned char *next_line(const unsigned char *p, const unsigned char *e)
+{
+  const unsigned char *nl = (const unsigned char *)memchr(p, '\n', (size_t)(e - p));
+  return nl ? nl + 1 : e;
+}
+
+static int is_marker_line(const unsigned char *p, const unsigned char *e)
+{
+  while (p < e && (*p == ' ' || *p == '\t'))
+    p++;
+  return e - p >= 4 && memcmp(p, "<!--", 4) == 0;
+}
+
+static int is_word_byte(unsigned char c)
+{
+  return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c >= 0x80;
+}
+
+/* Append the prose of line [p, e) to 'o': heading '#'s, blockquote and
+   list markers and emphasis marks ('*', '`', '_' at a word edge) dropped,
+   whitespace folded. '*hit_at' is set when 'hit' is copied. */
+static void clean_line(const unsigned char *p, const unsigned char *e, const unsigned char *hit,
+                       Buf *o, size_t *hit_at)
+{
+  while (p < e && (*p == ' ' || *p == '\t'))
+    p++;
+  while (p < e && *p == '#')
+    p++;
+  for (;;)
+  {
+    while (p < e && (*p == ' ' || *p == '\t'))
+      p++;
+    const unsigned char *m = p;
+    while (m < e && m - p < 9 && *m >= '0' && *m <= '9')
+      m++;
+    if (m > p && m < e && (*m == '.' || *m == ')'))
+      m++;
+    else if (m == p && p < e && (*p == '>' || *p == '-' || *p == '*' || *p == '+'))
+      m++;
+    else
+      break;
+    if (m < e && *m != ' ' && *m != '\t')
+      break;
+    p = m;
+  }
+  int space = o->n > 0;
+  for (; p < e; ++p)
+  {
+    unsigned char c = *p;
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+      space = o->n > 0;
+      continue;
+    }
+    if (c == '*' || c == '`' ||
+        (c == '_' && (p == e - 1 || !is_word_byte(p[1]) || !is_word_byte(p[-1]))))
+      continue;
+    if (space)
+      buf_put(o, " ", 1);
+    space = 0;
+    if (p == hit)
+      *hit_at = o->n;
+    buf_put(o, p, 1);
+  }
+}
+
+/* About 200 bytes of the section's prose centred on the first query-term
+   hit: packer markers and the section's own heading (reported as the
+   title) are skipped, Markdown syntax is stripped. */
+static void snippet(const SearchIndex *ix, uint32_t doc, const unsigned char (*terms)[SEARCH_TERM_MAX],
+                    const size_t *tlen, size_t nt, Buf *o)
+{
+  const unsigned char *rec = ix->idx.data + ix->h.docs_off + (size_t)doc * 24;
+  uint64_t off = rd32(rec), len = rd32(rec + 4);
+  if (!ix->src.data || off + len > ix->src.len)
+  {
+    buf_put(o, "\"\"", 2);
+    return;
+  }
+  const unsigned char *s = ix->src.data + off, *e = s + len;
+  while (s < e && (is_marker_line(s, e) || *s == '\n'))
+    s = next_line(s, e);
+  if (s < e && *s == '#')
+    s = next_line(s, e);
+
+  const unsigned char *hit = NULL;
+  for (const unsigned char *p = s; p < e && !hit;)
+  {
+    for (size_t k; p < e && (k = sep_len(ix->cls, p, e)) != 0;)
+      p += k;
+    const unsigned char *t = p;
+    while (p < e && !sep_len(ix->cls, p, e))
+      p++;
+    size_t n = (size_t)(p - t);
+    for (size_t k = 0; k < nt && !hit; ++k)
+    {
+      if (n != tlen[k])
+        continue;
+      size_t j = 0;
+      while (j < n && ix->cls[t[j]] == terms[k][j])
+        j++;
+      if (j == n)
+        hit = t;
+    }
+  }
+  if (!hit)
+    hit = s;
+
+  /* Clean the lines around the hit, then cut the window from that. */
+  const unsigned char *a = hit - s > 400 ? hit - 400 : s;
+  while (a > s && a[-1] != '\n' && hit - a < 800)
+    a--;
+  const unsigned char *b = e - hit > 600 ? hit + 600 : e;
+  Buf c = {0};
+  size_t hit_at = 0;
+  for (const unsigned char *l = a; l < b;)
+  {
+    const unsigned char *le = next_line(l, b);
+    if (!is_marker_line(l, le))
+      clean_line(l, le, hit, &c, &hit_at);
+    l = le;
+  }
+  if (c.oom)
+  {
+    free(c.p);
+    buf_put(o, "\"\"", 2);
+    return;
+  }
+  size_t from = hit_at > 80 ? hit_at - 80 : 0, to = c.n - from > 200 ? from + 200 : c.n;
+  if (to - from < 200)
+    from = to > 200 ? to - 200 : 0;
+  while (from > 0 && from < to && (c.p[from] & 0xC0) == 0x80)
+    from++;
+  while (to < c.n && to > from && (c.p[to] & 0xC0) == 0x80)
+    to--;
+  /* Start on a word when the cut is close to one. */
+  for (size_t k = from; from > 0 && k < from + 16 && k < hit_at; ++k)
+    if (c.p[k] == ' ')
+    {
+      from = k + 1;
+      break;
+    }
+  char tmp[256];
+  size_t n = 0;
+  if (from > 0 || a > s)
+    n += (size_t)snprintf(tmp, sizeof(tmp), "...");
+  memcpy(tmp + n, c.p + from, to - from);
+  n += to - from;
+  if (to < c.n || b < e)
+  {
+    memcpy(tmp + n, "...", 3);
+    n += 3;
+  }
+  free(c.p);
+  json_str(o, tmp, n);
+}
+
+int search_query_json(const SearchIndex *ix, const char *query, size_t limit, char **out,
+                      size_t *out_len)
+{
+  if (!ix || !query || !out)
+    return -1;
+  double t0 = ueng_now_ms();
+  *out = NULL;
+
+  /* Tokenize the query exactly like the builder; repeated terms count once. */
+  unsigned char terms[16][SEARCH_TERM_MAX];
+  size_t tlen[16], nt = 0;
+  const unsigned char *q = (const unsigned char *)query, *qe = q + strlen(query);
+  for (size_t i = 0; q[i] && nt < 16;)
+  {
+    for (size_t k; q[i] && (k = sep_len(ix->cls, q + i, qe)) != 0;)
+      i += k;
+    size_t n = 0, start = i;
+    while (q[i] && !sep_len(ix->cls, q + i, qe))
+      i++, n++;
+    if (n < SEARCH_TERM_MIN || n > SEARCH_TERM_MAX)
+      continue;
+    for (size_t j = 0; j < n; ++j)
+      terms[nt][j] = ix->cls[q[start + j]];
+    int dup = 0;
+    for (size_t k = 0; k < nt && !dup; ++k)
+      dup = tlen[k] == n && memcmp(terms[k], terms[nt], n) == 0;
+    if (!dup)
+      tlen[nt++] = n;
+  }
+
+  PostList lists[16];
+  memset(lists, 0, sizeof(lists));
+  Hit *hits = NULL;
+  size_t nhits = 0;
+  int rc = 0, missing = nt == 0;
+  for (size_t k = 0; k < nt && !missing && rc == 0; ++k)
+  {
+    TermRef r;
+    if (term_lookup(ix, terms[k], tlen[k], &r) != 0)
+      missing = 1; /* AND semantics: one unknown term means no results */
+    else if (decode_postings(ix, &r, &lists[k]) != 0)
+      rc = -1;
+  }
+
+  if (rc == 0 && !missing)
+  {
+    /* Drive the intersection from the rarest term and gallop through the rest. */
+    qsort(lists, nt, sizeof(PostList), postlist_cmp);
+    hits = (Hit *)malloc((lists[0].n ? lists[0].n : 1) * sizeof(Hit));
+    uint32_t pos[16] = {0};
+    if (!hits)
+      rc = -1;
+    for (uint32_t i = 0; rc == 0 && i < lists[0].n; ++i)
+    {
+      uint32_t d = lists[0].doc[i];
+      double len = rd32(ix->idx.data + ix->h.docs_off + (size_t)d * 24 + 8);
+      double norm = 1.2 * (0.25 + 0.75 * len / ix->avg_len), score = 0;
+      size_t k;
+      for (k = 0; k < nt; ++k)
+      {
+        uint32_t j = k ? gallop(lists[k].doc, lists[k].n, pos[k], d) : i;
+        pos[k] = j;
+        if (j >= lists[k].n || lists[k].doc[j] != d)
+          break;
+        double tf = lists[k].tf[j];
+        score += lists[k].idf * tf * 2.2 / (tf + norm); /* BM25, k1 = 1.2, b = 0.75 */
+      }
+      if (k == nt)
+      {
+        hits[nhits].doc = d;
+        hits[nhits++].score = score;
+      }
+    }
+    if (rc == 0)
+      qsort(hits, nhits, sizeof(Hit), hit_cmp);
+  }
+
+  Buf o = {0};
+  if (rc == 0)
+  {
+    char num[64];
+    buf_put(&o, "{\"query\":", 9);
+    json_str(&o, query, strlen(query));
+    snprintf(num, sizeof(num), ",\"total\":%zu,\"results\":[", nhits);
+    buf_put(&o, num, strlen(num));
+    for (size_t i = 0; i < nhits && i < limit; ++i)
+    {
+      const unsigned char *rec = ix->idx.data + ix->h.docs_off + (size_t)hits[i].doc * 24;
+      uint32_t ch = rd32(rec + 12);
+      const char *chap = ch < ix->h.n_chapters
+                             ? ix_str(ix, rd32(ix->idx.data + ix->h.chapters_off + (size_t)ch * 4))
+                             : "";
+      const char *anchor = ix_str(ix, rd32(rec + 16)), *title = ix_str(ix, rd32(rec + 20));
+      buf_put(&o, i ? ",{\"title\":" : "{\"title\":", i ? 10 : 9);
+      json_str(&o, title, strlen(title));
+      buf_put(&o, ",\"anchor\":", 10);
+      json_str(&o, anchor, strlen(anchor));
+      buf_put(&o, ",\"chapter\":", 11);
+      json_str(&o, chap, strlen(chap));
+      snprintf(num, sizeof(num), ",\"score\":%.4f,\"snippet\":", hits[i].score);
+      buf_put(&o, num, strlen(num));
+      snippet(ix, hits[i].doc, (const unsigned char(*)[SEARCH_TERM_MAX])terms, tlen, nt, &o);
+      buf_put(&o, "}", 1);
+    }
+    snprintf(num, sizeof(num), "],\"ms\":%.3f}\n", ueng_now_ms() - t0);
+    buf_put(&o, num, strlen(num) + 1);
+    if (o.oom)
+      rc = -1;
+  }
+
+  for (size_t k = 0; k < 16; ++k)
+  {
+    free(lists[k].doc);
+    free(lists[k].tf);
+  }
+  free(hits);
+  if (rc != 0)
+  {
+    free(o.p);
+    return -1;
+  }
+  *out = (char *)o.p;
+  if (out_len)
+    *out_len = o.n - 1; /* NUL written above, not part of the body */
+  return 0;
+}
+
+/*------------------------------ browser shim --------------------------------*/
+/* Plain ES5 so it runs everywhere the light site does; no build step. */
+static const char *SEARCH_JS =
+    "/* uaengine search shim: queries search.idx (format: include/ueng/search.h). */\n"
+    "(function () {\n"
+    "  'use strict';\n"
+    "  var BLOCK = 16, idx = null, loading = null;\n"
+    "  function u32(dv, o) { return dv.getUint32(o, true); }\n"
+    "  function varint(u8, st) {\n"
+    "    var v = 0, m = 1, b;\n"
+    "    do { b = u8[st.p++]; v += (b & 0x7f) * m; m *= 128; } while (b & 0x80);\n"
+    "    return v;\n"
+    "  }\n"
+    "  function cmp(a, b) {\n"
+    "    var n = Math.min(a.length, b.length);\n"
+    "    for (var i = 0; i < n; i++) if (a[i] !== b[i]) return a[i] - b[i];\n"
+    "    return a.length - b.length;\n"
+    "  }\n"
+    "  function str(o) {\n"
+    "    var u8 = idx.u8, s = idx.strings + o, e = s;\n"
+    "    while (u8[e]) e++;\n"
+    "    return new TextDecoder('utf-8').decode(u8.subarray(s, e));\n"
+    "  }\n"
+    "  function parse(buf) {\n"
+    "    var dv = new DataView(buf), u8 = new Uint8Array(buf);\n"
+    "    if (String.fromCharCode.apply(null, u8.subarray(0, 8)) !== 'UENGSIX1') throw new "
+    "Error('bad index');\n"
+    "    var h = { dv: dv, u8: u8, nDocs: u32(dv, 12), nTerms: u32(dv, 16), nBlocks: u32(dv, 24),\n"
+    "      docs: u32(dv, 28), chapters: u32(dv, 32), blocks: u32(dv, 36), strings: u32(dv, 40),\n"
+    "      terms: u32(dv, 44), post: u32(dv, 48), avgLen: 1 };\n"
+    "    var total = 0;\n"
+    "    for (var d = 0; d < h.nDocs; d++) total += u32(dv, h.docs + d * 24 + 8);\n"
+    "    h.avgLen = h.nDocs ? Math.max(1, total / h.nDocs) : 1;\n"
+    "    return h;\n"
+    "  }\n"
+    "  function firstTerm(b) {\n"
+    "    var st = { p: idx.terms + u32(idx.dv, idx.blocks + b * 8) };\n"
+    "    var n = varint(idx.u8, st);\n"
+    "    return idx.u8.subarray(st.p, st.p + n);\n"
+    "  }\n"
+    "  function lookup(t) {\n"
+    "    var lo = 0, hi = idx.nBlocks - 1, b = -1;\n"
+    "    while (lo <= hi) {\n"
+    "      var mid = (lo + hi) >> 1;\n"
+    "      if (cmp(firstTerm(mid), t) <= 0) { b = mid; lo = mid + 1; } else hi = mid - 1;\n"
+    "    }\n"
+    "    if (b < 0) return null;\n"
+    "    var st = { p: idx.terms + u32(idx.dv, idx.blocks + b * 8) };\n"
+    "    var post = idx.post + u32(idx.dv, idx.blocks + b * 8 + 4), prev = null;\n"
+    "    for (var k = 0; k < BLOCK && b * BLOCK + k < idx.nTerms; k++) {\n"
+    "      var cur;\n"
+    "      if (k === 0) { var n = varint(idx.u8, st); cur = idx.u8.slice(st.p, st.p + n); st.p += n; }\n"
+    "      else {\n"
+    "        var sh = varint(idx.u8, st), sl = varint(idx.u8, st);\n"
+    "        cur = new Uint8Array(sh + sl);\n"
+    "        cur.set(prev.subarray(0, sh)); cur.set(idx.u8.subarray(st.p, st.p + sl), sh); st.p += sl;\n"
+    "      }\n"
+    "      var df = varint(idx.u8, st), plen = varint(idx.u8, st), c = cmp(cur, t);\n"
+    "      if (c === 0) return { df: df, off: post, len: plen };\n"
+    "      if (c > 0) return null;\n"
+    "      post += plen; prev = cur;\n"
+    "    }\n"
+    "    return null;\n"
+    "  }\n"
+    "  function postings(e) {\n"
+    "    var st = { p: e.off }, end = e.off + e.len, doc = 0, first = true, m = {};\n"
+    "    while (st.p < end) {\n"
+    "      var d = varint(idx.u8, st); doc = first ? d : doc + d; first = false;\n"
+    "      m[doc] = varint(idx.u8, st);\n"
+    "    }\n"
+    "    return m;\n"
+    "  }\n"
+    "  function sep(c) {\n"
+    "    if (c < 128) return !((c >= 48 && c <= 57) || (c >= 97 && c <= 122));\n"
+    "    return c === 0xA0 || c === 0xA1 || c === 0xA7 || c === 0xAB || c === 0xB6 || c === 0xB7 ||\n"
+    "      c === 0xBB || c === 0xBF || c === 0xFEFF || (c >= 0x2000 && c <= 0x206F) ||\n"
+    "      (c >= 0x3000 && c <= 0x3003);\n"
+    "  }\n"
+    "  function tokens(q) {\n"
+    "    var enc = new TextEncoder(), cs = Array.from(q + ' '), out = [], cur = [];\n"
+    "    for (var i = 0; i < cs.length; i++) {\n"
+    "      var c = cs[i].codePointAt(0);\n"
+    "      if (c >= 65 && c <= 90) c += 32;\n"
+    "      if (!sep(c)) { cur.push.apply(cur, enc.encode(String.fromCodePoint(c))); continue; }\n"
+    "      if (cur.length >= 2 && cur.length <= 48) out.push(new Uint8Array(cur));\n"
+    "      cur = [];\n"
+    "    }\n"
+    "    return out;\n"
+    "  }\n"
+    "  function search(q) {\n"
+    "    var ts = tokens(q), lists = [];\n"
+    "    for (var i = 0; i < ts.length; i++) {\n"
+    "      var e = lookup(ts[i]);\n"
+    "      if (!e) return [];\n"
+    "      lists.push({ df: e.df, m: postings(e) });\n"
+    "    }\n"
+    "    if (!lists.length) return [];\n"
+    "    lists.sort(function (a, b) { return a.df - b.df; });\n"
+    "    var hits = [];\n"
+    "    for (var d in lists[0].m) {\n"
+    "      var score = 0, len = u32(idx.dv, idx.docs + d * 24 + 8), ok = true;\n"
+    "      for (var j = 0; j < lists.length && ok; j++) {\n"
+    "        var tf = lists[j].m[d];\n"
+    "        if (tf === undefined) { ok = false; break; }\n"
+    "        var idf = Math.log(1 + (idx.nDocs - lists[j].df + 0.5) / (lists[j].df + 0.5));\n"
+    "        score += idf * tf * 2.2 / (tf + 1.2 * (0.25 + 0.75 * len / idx.avgLen));\n"
+    "      }\n"
+    "      if (ok) hits.push({ doc: +d, score: score });\n"
+    "    }\n"
+    "    hits.sort(function (a, b) { return b.score - a.score; });\n"
+    "    return hits.slice(0, 20);\n"
+    "  }\n"
+    "  function show(q, rows, out) {\n"
+    "    var html = '';\n"
+    "    for (var i = 0; i < rows.length; i++) {\n"
+    "      var a = document.createElement('a'), s = document.createElement('small');\n"
+    "      a.href = '../html/book.html' + (rows[i].anchor ? '#' + "
+    "encodeURIComponent(rows[i].anchor) : '');\n"
+    "      a.textContent = rows[i].title || '(untitled)';\n"
+    "      s.textContent = rows[i].snippet || '';\n"
+    "      html += '<li>' + a.outerHTML + (rows[i].snippet ? '<br>' + s.outerHTML : '') + "
+    "'</li>';\n"
+    "    }\n"
+    "    out.innerHTML = q && !rows.length ? '<li>No matches.</li>' : html;\n"
+    "  }\n"
+    "  function local(q, out) {\n"
+    "    if (!loading) loading = fetch('search.idx').then(function (r) { return r.arrayBuffer(); "
+    "})\n"
+    "      .then(function (b) { idx = parse(b); return idx; });\n"
+    "    loading.then(function () {\n"
+    "      var hits = search(q), rows = [];\n"
+    "      for (var i = 0; i < hits.length; i++) {\n"
+    "        var r = idx.docs + hits[i].doc * 24;\n"
+    "        rows.push({ anchor: str(u32(idx.dv, r + 16)), title: str(u32(idx.dv, r + 20)) });\n"
+    "      }\n"
+    "      show(q, rows, out);\n"
+    "    }, function () {\n"
+    "      out.innerHTML = '<li>Search index unavailable (serve the site over HTTP).</li>';\n"
+    "    });\n"
+    "  }\n"
+    "  /* Under `uaengine serve` ask the server (no index download, with snippets);\n"
+    "     on plain static hosting fall back to querying search.idx here. */\n"
+    "  var remote = true;\n"
+    "  function run(q, out) {\n"
+    "    if (!remote) return local(q, out);\n"
+    "    fetch('__search?n=20&q=' + encodeURIComponent(q)).then(function (r) {\n"
+    "      if (!r.ok) throw new Error(r.status);\n"
+    "      return r.json();\n"
+    "    }).then(function (j) { show(q, j.results, out); }, function () {\n"
+    "      remote = false;\n"
+    "      local(q, out);\n"
+    "    });\n"
+    "  }\n"
+    "  document.addEventListener('DOMContentLoaded', function () {\n"
+    "    var input = document.getElementById('uae-search-q');\n"
+    "    var out = document.getElementById('uae-results');\n"
+    "    if (!input || !out) return;\n"
+    "    var timer = null;\n"
+    "    input.addEventListener('input', function () {\n"
+    "      clearTimeout(timer);\n"
+    "      timer = setTimeout(function () { run(input.value, out); }, 120);\n"
+    "    });\n"
+    "  });\n"
+    "})();\n";
+
+int search_write_js(const char *site_dir)
+{
+  char p[PATH_MAX];
+  snprintf(p, sizeof(p), "%s%csearch.js", site_dir, PATH_SEP);
+  return write_text_file(p, SEARCH_JS);
+}
@@ -12,14 +12,20 @@
  * - It's only used for local preview of the generated site folder.
  * - We keep it cross‑platform using WinSock on Windows and BSD sockets elsewhere.
  * - Newcomer tip: read handle_client() to see the end-to-end flow of one request.
+ * - /__search?q= is answered from <root>/search.idx (written by `build`). The
+ *   index is mmap'd once and re-opened when the file changes on disk.
  *---------------------------------------------------------------------------*/
 #include "ueng/serve.h"
 #include "ueng/common.h"
+#include "ueng/search.h"
+#include "ueng/trace.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -158,6 +164,37 @@ static void http_send_200_head(ueng_socket_t cs, const char *mime, size_t len)
 #endif
 }
 
+/* Send an in-memory 200 response (used for generated JSON). */
+static void http_send_body(ueng_socket_t cs, const char *mime, const char *body, size_t len,
+                           int head_only)
+{
+  char hdr[512];
+  int n = snprintf(hdr, sizeof(hdr),
+                   "HTTP/1.1 200 OK\r\n"
+                   "Content-Type: %s\r\n"
+                   "Content-Length: %zu\r\n"
+                   "Cache-Control: no-store\r\n"
+                   "Connection: close\r\n\r\n",
+                   mime, len);
+#ifdef _WIN32
+  send(cs, hdr, n, 0);
+#else
+  send(cs, hdr, (size_t)n, 0);
+#endif
+  while (!head_only && len > 0)
+  {
+#ifdef _WIN32
+    int sent = send(cs, body, (int)len, 0);
+#else
+    ssize_t sent = send(cs, body, len, 0);
+#endif
+    if (sent <= 0)
+      break;
+    body += sent;
+    len -= (size_t)sent;
+  }
+}
+
 /* Stream a file to the client; head_only skips the body for HEAD requests. */
 static int send_file(ueng_socket_t cs, const char *fs_path, const char *mime, int head_only)
 {
@@ -196,10 +233,129 @@ static int send_file(ueng_socket_t cs, const char *fs_path, const char *mime, in
   return 0;
 }
 
+/* ------------------------------ search API --------------------------------- */
+
+/* Decode %XX and '+' in a query-string value. */
+static void url_decode(const char *in, size_t n, char *out, size_t outsz)
+{
+  size_t j = 0;
+  for (size_t i = 0; i < n && j + 1 < outsz; ++i)
+  {
+    char c = in[i];
+    if (c == '+')
+      c = ' ';
+    else if (c == '%' && i + 2 < n && isxdigit((unsigned char)in[i + 1]) &&
+             isxdigit((unsigned char)in[i + 2]))
+    {
+      char hex[3] = {in[i + 1], in[i + 2], 0};
+      c = (char)strtol(hex, NULL, 16);
+      i += 2;
+    }
+    out[j++] = c;
+  }
+  out[j] = '\0';
+}
+
+/* Find 'key' in a raw query string and decode its value into out. */
+static int query_param(const char *qs, const char *key, char *out, size_t outsz)
+{
+  size_t kl = strlen(key);
+  while (qs && *qs)
+  {
+    const char *amp = strchr(qs, '&');
+    size_t len = amp ? (size_t)(amp - qs) : strlen(qs);
+    if (len > kl && strncmp(qs, key, kl) == 0 && qs[kl] == '=')
+    {
+      url_decode(qs + kl + 1, len - kl - 1, out, outsz);
+      return 1;
+    }
+    qs = amp ? amp + 1 : NULL;
+  }
+  return 0;
+}
+
+/* The open index plus the stat fields used to notice a rebuild. */
+static SearchIndex *g_search;
+static long long g_search_mtime = -1, g_search_size = -1;
+
+static SearchIndex *search_index_for(const char *root)
+{
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s%csearch.idx", root, PATH_SEP);
+  struct stat st;
+  if (stat(path, &st) != 0)
+  {
+    search_close(g_search);
+    g_search = NULL;
+    g_search_mtime = g_search_size = -1;
+    return NULL;
+  }
+  if (!g_search || (long long)st.st_mtime != g_search_mtime ||
+      (long long)st.st_size != g_search_size)
+  {
+    /* `build` replaces the file by rename, so the old mapping stays valid
+       until we drop it here. */
+    search_close(g_search);
+    g_search = search_open(path);
+    g_search_mtime = (long long)st.st_mtime;
+    g_search_size = (long long)st.st_size;
+  }
+  return g_search;
+}
+
+static void handle_search(ueng_socket_t cs, const char *root, const char *qs, int head_only)
+{
+  SearchIndex *ix = search_index_for(root);
+  if (!ix)
+  {
+    http_send_simple(cs, "404 Not Found", "404 Not Found (no search.idx; run `uaengine build`)\n");
+    return;
+  }
+  char q[1024] = {0}, lim[16] = {0};
+  (void)query_param(qs, "q", q, sizeof(q));
+  size_t limit = 10;
+  if (query_param(qs, "n", lim, sizeof(lim)))
+  {
+    long v = strtol(lim, NULL, 10);
+    limit = v < 1 ? 1 : v > 100 ? 100 : (size_t)v;
+  }
+  char *json = NULL;
+  size_t len = 0;
+  if (search_query_json(ix, q, limit, &json, &len) != 0)
+  {
+    http_send_simple(cs, "500 Internal Server Error", "500 Internal Server Error\n");
+    return;
+  }
+  http_send_body(cs, "application/json; charset=utf-8", json, len, head_only);
+  free(json);
+}
+
 /* -------------------------------- core ------------------------------------- */
 
 /* Handle a single HTTP/1.1 GET/HEAD request from socket cs. */
-static void handle_client(ueng_socket_t cs, const char *root)
+int serve_parse_request(const char *req, ServeRequest *r)
+{
+  memset(r, 0, sizeof(*r));
+  /* Minimal parse: METHOD PATH HTTP/x.y  (we ignore headers for now) */
+  if (sscanf(req, "%7s %2047s %15s", r->method, r->path, r->version) != 3)
+    return 1;
+  /* Split off the query string; static files ignore it. */
+  char *qs = strchr(r->path, '?');
+  if (qs)
+  {
+    *qs++ = '\0';
+    r->query = qs;
+  }
+  /* Allow only GET and HEAD for this tiny static server */
+  if (strcmp(r->method, "HEAD") == 0)
+    r->head_only = 1;
+  else if (strcmp(r->method, "GET") != 0)
+    return 2;
+  return 0;
+}
+
+/* 'what' receives "METHOD /path" for the trace (empty when unparsable). */
+static void handle_client(ueng_socket_t cs, const char *root, char *what, size_t whatsz)
 {
   char req[4096];
 #ifdef _WIN32
@@ -214,30 +370,27 @@ static void handle_client(ueng_socket_t cs, const char *root)
   }
   req[rn] = '\0';
 
-  /* Minimal parse: METHOD PATH HTTP/x.y  (we ignore headers for now) */
-  char method[8] = {0};
-  char path[2048] = {0};
-  char httpver[16] = {0};
-  if (sscanf(req, "%7s %2047s %15s", method, path, httpver) != 3)
+  ServeRequest r;
+  int prc = serve_parse_request(req, &r);
+  if (prc == 1)
   {
     http_send_simple(cs, "400 Bad Request", "400 Bad Request\n");
     closesock(cs);
     return;
   }
-
-  /* Allow only GET and HEAD for this tiny static server */
-  int head_only = 0;
-  if (strcmp(method, "GET") == 0)
-  {
-    head_only = 0;
-  }
-  else if (strcmp(method, "HEAD") == 0)
+  snprintf(what, whatsz, "%s %s", r.method, r.path);
+  if (prc == 2)
   {
-    head_only = 1;
+    http_send_simple(cs, "405 Method Not Allowed", "405 Method Not Allowed\n");
+    closesock(cs);
+    return;
   }
-  else
+  const char *path = r.path, *qs = r.query;
+  int head_only = r.head_only;
+
+  if (strcmp(path, "/__search") == 0)
   {
-    http_send_simple(cs, "405 Method Not Allowed", "405 Method Not Allowed\n");
+    handle_search(cs, root, qs, head_only);
     closesock(cs);
     return;
   }
@@ -390,7 +543,11 @@ int serve_run(const char *root, const char *host, int port)
       /* Transient accept error; keep serving. */
       continue;
     }
-    handle_client(cs, root);
+    double t0 = ueng_trace_begin();
+    char what[2064] = "";
+    handle_client(cs, root, what, sizeof(what));
+    ueng_trace_end_arg("serve", "request", t0, what);
+    ueng_trace_flush(); /* Ctrl+C ends the process; keep the file current */
   }
 
   /* Unreachable in normal flow */
@@ -0,0 +1,563 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/store.c
+ * Purpose: Content-addressed object store that deduplicates output trees
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *
+ * Notes for contributors:
+ * - Linking order is reflink (Linux FICLONE, macOS clonefile) then hardlink.
+ *   A reflink is a private copy-on-write file, so it never needs detaching;
+ *   a hardlink is the object itself, which is why objects are read-only and
+ *   build/export call store_detach_tree() before writing into a tree.
+ * - New objects appear via a temp name + rename, so concurrent builds
+ *   sharing one store only ever see complete objects.
+ * - A ref manifest ("<sha256> <size> <relpath>" per line, sorted by path)
+ *   also lets a re-commit skip hashing files still linked to their object.
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "ueng/store.h"
+#include "ueng/common.h"
+#include "ueng/hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h> /* FICLONE */
+#include <sys/ioctl.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+#endif
+
+/*------------------------------- locations ----------------------------------*/
+
+int store_enabled(void)
+{
+  const char *e = getenv("UENG_STORE");
+  return !(e && strcmp(e, "0") == 0);
+}
+
+void store_dir(char *out, size_t outsz)
+{
+  const char *e = getenv("UENG_CACHE_DIR");
+  if (e && *e)
+    snprintf(out, outsz, "%s", e);
+  else
+    snprintf(out, outsz, "outputs%c.store", PATH_SEP);
+}
+
+static void object_path(const char *store, const char *hex, char *out, size_t outsz)
+{
+  snprintf(out, outsz, "%s%cobjects%c%.2s%c%s", store, PATH_SEP, PATH_SEP, hex, PATH_SEP, hex + 2);
+}
+
+static unsigned long pid_now(void)
+{
+#ifdef _WIN32
+  return (unsigned long)GetCurrentProcessId();
+#else
+  return (unsigned long)getpid();
+#endif
+}
+
+/*------------------------------- file system --------------------------------*/
+
+typedef struct
+{
+  uint64_t dev, ino, size, nlink;
+  int readonly;
+} FileId;
+
+static int file_id(const char *path, FileId *id)
+{
+  memset(id, 0, sizeof(*id));
+#ifdef _WIN32
+  HANDLE h = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (h == INVALID_HANDLE_VALUE)
+    return -1;
+  BY_HANDLE_FILE_INFORMATION fi;
+  BOOL ok = GetFileInformationByHandle(h, &fi);
+  CloseHandle(h);
+  if (!ok)
+    return -1;
+  id->dev = fi.dwVolumeSerialNumber;
+  id->ino = ((uint64_t)fi.nFileIndexHigh << 32) | fi.nFileIndexLow;
+  id->size = ((uint64_t)fi.nFileSizeHigh << 32) | fi.nFileSizeLow;
+  id->nlink = fi.nNumberOfLinks;
+  id->readonly = (fi.dwFileAttributes & FILE_ATTRIBUTE_READONLY) != 0;
+#else
+  struct stat st;
+  if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode))
+    return -1;
+  id->dev = (uint64_t)st.st_dev;
+  id->ino = (uint64_t)st.st_ino;
+  id->size = (uint64_t)st.st_size;
+  id->nlink = (uint64_t)st.st_nlink;
+  id->readonly = (st.st_mode & S_IWUSR) == 0;
+#endif
+  return 0;
+}
+
+static int same_file(const FileId *a, const FileId *b)
+{
+  return a->dev == b->dev && a->ino == b->ino;
+}
+
+static int hash_file(const char *path, char hex[65])
+{
+  FILE *f = ueng_fopen(path, "rb");
+  if (!f)
+    return -1;
+  UengSha256 c;
+  ueng_sha256_init(&c);
+  unsigned char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    ueng_sha256_update(&c, buf, n);
+  int rc = ferror(f) ? -1 : 0;
+  fclose(f);
+  unsigned char d[32];
+  ueng_sha256_final(&c, d);
+  for (int i = 0; i < 32; ++i)
+    snprintf(hex + 2 * i, 3, "%02x", d[i]);
+  return rc;
+}
+
+/* Copy-on-write clone of src at dst (dst must not exist). */
+static int clone_file(const char *src, const char *dst)
+{
+#if defined(__linux__) && defined(FICLONE)
+  int in = open(src, O_RDONLY);
+  if (in < 0)
+    return -1;
+  int out = open(dst, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (out < 0)
+  {
+    close(in);
+    return -1;
+  }
+  int rc = ioctl(out, FICLONE, in) == 0 ? 0 : -1;
+  close(in);
+  close(out);
+  if (rc != 0)
+    unlink(dst);
+  return rc;
+#elif defined(__APPLE__)
+  return clonefile(src, dst, 0) == 0 ? 0 : -1;
+#else
+  (void)src;
+  (void)dst;
+  return -1;
+#endif
+}
+
+static int hard_link(const char *src, const char *dst)
+{
+#ifdef _WIN32
+  return CreateHardLinkA(dst, src, NULL) ? 0 : -1;
+#else
+  return link(src, dst) == 0 ? 0 : -1;
+#endif
+}
+
+/* Objects are read-only so a stray in-place write fails instead of changing
+   every tree that links them. Not on Windows: there the attribute would also
+   block the rename-over that detaching relies on. */
+static void make_readonly(const char *p)
+{
+#ifdef _WIN32
+  (void)p;
+#else
+  (void)chmod(p, 0444);
+#endif
+}
+
+static void make_writable(const char *p)
+{
+#ifdef _WIN32
+  DWORD a = GetFileAttributesA(p);
+  if (a != INVALID_FILE_ATTRIBUTES && (a & FILE_ATTRIBUTE_READONLY))
+    SetFileAttributesA(p, a & ~FILE_ATTRIBUTE_READONLY);
+#else
+  (void)chmod(p, 0644);
+#endif
+}
+
+/* Point 'path' at object 'obj' (reflink, else hardlink). 0 on success. */
+static int link_from_object(const char *obj, const char *path)
+{
+  char tmp[PATH_MAX + 32];
+  snprintf(tmp, sizeof(tmp), "%s.store-%lu", path, pid_now());
+  remove(tmp);
+  int cloned = clone_file(obj, tmp) == 0;
+  if (!cloned && hard_link(obj, tmp) != 0)
+    return -1;
+  if (cloned)
+    make_writable(tmp); /* a clone is a private file: keep the usual mode */
+  if (replace_file(tmp, path) != 0)
+  {
+    remove(tmp);
+    return -1;
+  }
+  return 0;
+}
+
+/*------------------------------- detach -------------------------------------*/
+
+int store_detach_tree(const char *root)
+{
+  if (!root || !dir_exists(root))
+    return 0;
+  StrList files;
+  sl_init(&files);
+  list_tree_files(root, &files);
+  int rc = 0;
+  for (size_t i = 0; i < files.count; ++i)
+  {
+    char p[PATH_MAX], tmp[PATH_MAX + 32];
+    if (snprintf(p, sizeof(p), "%s%c%s", root, PATH_SEP, files.items[i]) >= (int)sizeof(p))
+    {
+      rc = -1; /* too long to open: it stays linked */
+      continue;
+    }
+    FileId id;
+    if (file_id(p, &id) != 0)
+      continue;
+    if (id.nlink > 1)
+    {
+      snprintf(tmp, sizeof(tmp), "%s.store-%lu", p, pid_now());
+      if (copy_file_binary(p, tmp) != 0)
+      {
+        remove(tmp);
+        rc = -1;
+        continue;
+      }
+      make_writable(tmp);
+      if (replace_file(tmp, p) != 0)
+      {
+        remove(tmp);
+        rc = -1;
+      }
+    }
+    else if (id.readonly)
+    {
+      make_writable(p); /* last link to a collected object */
+    }
+  }
+  sl_free(&files);
+  return rc;
+}
+
+/*------------------------------- commit -------------------------------------*/
+
+static int strp_cmp(const void *a, const void *b)
+{
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Parsed previous manifest line: "<hex> <size> <relpath>". */
+typedef struct
+{
+  const char *hex, *rel;
+} RefLine;
+
+static size_t parse_ref(char *text, RefLine **out, char **root_line)
+{
+  size_t n = 0, cap = 0;
+  RefLine *v = NULL;
+  *root_line = NULL;
+  for (char *line = text; line && *line;)
+  {
+    char *nl = strchr(line, '\n');
+    if (nl)
+      *nl = '\0';
+    if (strncmp(line, "root ", 5) == 0)
+      *root_line = line + 5;
+    else
+    {
+      char *sp1 = strchr(line, ' ');
+      char *sp2 = sp1 ? strchr(sp1 + 1, ' ') : NULL;
+      if (sp1 && sp2 && sp1 - line == 64)
+      {
+        if (n == cap)
+        {
+          size_t nc = cap ? cap * 2 : 64;
+          RefLine *nv = (RefLine *)realloc(v, nc * sizeof(*nv));
+          if (!nv)
+            break;
+          v = nv;
+          cap = nc;
+        }
+        *sp1 = '\0';
+        v[n].hex = line;
+        v[n].rel = sp2 + 1;
+        n++;
+      }
+    }
+    line = nl ? nl + 1 : NULL;
+  }
+  *out = v;
+  return n;
+}
+
+static void ref_path(const char *store, const char *abs_root, char *out, size_t outsz)
+{
+  unsigned long long id = (unsigned long long)ueng_hash64(abs_root, strlen(abs_root), 0);
+  snprintf(out, outsz, "%s%crefs%c%016llx.ref", store, PATH_SEP, PATH_SEP, id);
+}
+
+int store_commit_tree(const char *root, StoreStats *st)
+{
+  double t0 = ueng_now_ms();
+  StoreStats local;
+  if (!st)
+    st = &local;
+  memset(st, 0, sizeof(*st));
+  if (!root || !dir_exists(root))
+    return -1;
+
+  /* Suffixes appended to 'store' are bounded: refs/<16 hex>.ref, the
+     objects/ fan-out and .<pid>.tmp. */
+  char store[PATH_MAX], sub[PATH_MAX + 16], abs_root[PATH_MAX];
+  char ref[PATH_MAX + 32], ref_tmp[PATH_MAX + 64];
+  store_dir(store, sizeof(store));
+  snprintf(sub, sizeof(sub), "%s%cobjects", store, PATH_SEP);
+  if (mkpath(sub) != 0)
+    return -1;
+  snprintf(sub, sizeof(sub), "%s%crefs", store, PATH_SEP);
+  if (mkpath(sub) != 0 || path_abs(root, abs_root, sizeof(abs_root)) != 0)
+    return -1;
+  ref_path(store, abs_root, ref, sizeof(ref));
+  snprintf(ref_tmp, sizeof(ref_tmp), "%s.%lu.tmp", ref, pid_now());
+
+  /* The previous manifest lets unchanged, still-linked files skip hashing. */
+  size_t old_len = 0;
+  char *old_text = read_file_alloc(ref, &old_len), *old_root = NULL;
+  RefLine *old = NULL;
+  size_t n_old = old_text ? parse_ref(old_text, &old, &old_root) : 0;
+
+  StrList files;
+  sl_init(&files);
+  list_tree_files(root, &files);
+  qsort(files.items, files.count, sizeof(char *), strp_cmp);
+
+  FILE *rf = ueng_fopen(ref_tmp, "wb");
+  if (!rf)
+  {
+    sl_free(&files);
+    free(old);
+    free(old_text);
+    return -1;
+  }
+  fprintf(rf, "root %s\n", abs_root);
+
+  size_t k = 0; /* merge cursor into 'old' (both sorted by path) */
+  for (size_t i = 0; i < files.count; ++i)
+  {
+    const char *rel = files.items[i];
+    char p[PATH_MAX], obj[PATH_MAX + 80], hex[65];
+    FileId fid, oid;
+    if (snprintf(p, sizeof(p), "%s%c%s", root, PATH_SEP, rel) >= (int)sizeof(p) ||
+        file_id(p, &fid) != 0)
+      continue;
+
+    while (k < n_old && strcmp(old[k].rel, rel) < 0)
+      k++;
+    int known = 0;
+    if (k < n_old && strcmp(old[k].rel, rel) == 0)
+    {
+      object_path(store, old[k].hex, obj, sizeof(obj));
+      if (file_id(obj, &oid) == 0 && same_file(&fid, &oid))
+      {
+        memcpy(hex, old[k].hex, 65);
+        known = 1;
+      }
+    }
+    if (!known)
+    {
+      if (hash_file(p, hex) != 0)
+        continue;
+      object_path(store, hex, obj, sizeof(obj));
+    }
+    st->files++;
+    st->bytes += fid.size;
+
+    if (!known)
+    {
+      if (file_id(obj, &oid) == 0)
+      {
+        if (!same_file(&fid, &oid))
+        {
+          if (link_from_object(obj, p) == 0)
+          {
+            st->linked++;
+            st->bytes_saved += fid.size;
+          }
+          else
+            st->unlinkable++;
+        }
+      }
+      else
+      {
+        /* New content: the object is a clone or hardlink of this file, or a
+           copy that the file is then linked back to. */
+        char tmp[PATH_MAX + 112];
+        snprintf(tmp, sizeof(tmp), "%s.%lu.tmp", obj, pid_now());
+        (void)mkpath_parent(obj);
+        remove(tmp);
+        int made = clone_file(p, tmp) == 0 || hard_link(p, tmp) == 0;
+        int copied = !made && copy_file_binary(p, tmp) == 0;
+        if (made || copied)
+        {
+          make_readonly(tmp);
+          if (replace_file(tmp, obj) == 0)
+          {
+            st->new_objects++;
+            if (copied && link_from_object(obj, p) != 0)
+              st->unlinkable++;
+          }
+          else
+            remove(tmp);
+        }
+      }
+    }
+    fprintf(rf, "%s %llu ", hex, (unsigned long long)fid.size);
+    for (const char *c = rel; *c; ++c)
+      fputc(*c == '\\' ? '/' : *c, rf);
+    fputc('\n', rf);
+  }
+
+  int rc = ferror(rf) ? -1 : 0;
+  if (fclose(rf) != 0)
+    rc = -1;
+  if (rc == 0 && replace_file(ref_tmp, ref) != 0)
+    rc = -1;
+  if (rc != 0)
+    remove(ref_tmp);
+  sl_free(&files);
+  free(old);
+  free(old_text);
+  st->ms = ueng_now_ms() - t0;
+  return rc;
+}
+
+/*------------------------------- gc -----------------------------------------*/
+
+static int hexp_cmp(const void *key, const void *item)
+{
+  return strcmp((const char *)key, *(const char *const *)item);
+}
+
+int store_gc(StoreGcStats *st)
+{
+  StoreGcStats local;
+  if (!st)
+    st = &local;
+  memset(st, 0, sizeof(*st));
+  char store[PATH_MAX], refs_dir[PATH_MAX + 16], objs_dir[PATH_MAX + 16];
+  store_dir(store, sizeof(store));
+  snprintf(refs_dir, sizeof(refs_dir), "%s%crefs", store, PATH_SEP);
+  snprintf(objs_dir, sizeof(objs_dir), "%s%cobjects", store, PATH_SEP);
+  if (!dir_exists(objs_dir))
+    return 0;
+
+  /* Mark: every object named by a ref whose tree still exists. */
+  StrList refs, live;
+  sl_init(&refs);
+  sl_init(&live);
+  list_tree_files(refs_dir, &refs);
+  for (size_t i = 0; i < refs.count; ++i)
+  {
+    size_t nlen = strlen(refs.items[i]);
+    if (nlen < 4 || strcmp(refs.items[i] + nlen - 4, ".ref") != 0)
+      continue;
+    char p[PATH_MAX + 16];
+    if (snprintf(p, sizeof(p), "%s%c%s", refs_dir, PATH_SEP, refs.items[i]) >= (int)sizeof(p))
+      continue;
+    size_t len = 0;
+    char *text = read_file_alloc(p, &len), *root = NULL;
+    if (!text)
+      continue;
+    RefLine *lines = NULL;
+    size_t n = parse_ref(text, &lines, &root);
+    if (!root || !dir_exists(root))
+    {
+      remove(p);
+      st->stale_refs++;
+    }
+    else
+    {
+      st->refs++;
+      for (size_t j = 0; j < n; ++j)
+      {
+        sl_push(&live, lines[j].hex);
+        st->bytes_referenced += strtoull(lines[j].hex + 65, NULL, 10);
+      }
+    }
+    free(lines);
+    free(text);
+  }
+  qsort(live.items, live.count, sizeof(char *), strp_cmp);
+
+  /* Sweep: objects/ab/cdef... -> "abcdef..."; temp files are left alone. */
+  StrList objs;
+  sl_init(&objs);
+  list_tree_files(objs_dir, &objs);
+  for (size_t i = 0; i < objs.count; ++i)
+  {
+    const char *rel = objs.items[i];
+    if (strlen(rel) != 65 || strchr(rel, '.'))
+      continue;
+    char hex[65], p[PATH_MAX + 96];
+    memcpy(hex, rel, 2);
+    memcpy(hex + 2, rel + 3, 62);
+    hex[64] = '\0';
+    snprintf(p, sizeof(p), "%s%c%s", objs_dir, PATH_SEP, rel);
+    FileId id;
+    if (file_id(p, &id) != 0)
+      continue;
+    if (live.count && bsearch(hex, live.items, live.count, sizeof(char *), hexp_cmp))
+    {
+      st->objects++;
+      st->bytes += id.size;
+    }
+    else if (remove(p) == 0)
+    {
+      st->removed++;
+      st->bytes_removed += id.size;
+    }
+  }
+  /* Drop emptied fan-out directories (rmdir fails harmlessly otherwise). */
+  for (int b = 0; b < 256; ++b)
+  {
+    char d[PATH_MAX + 32];
+    snprintf(d, sizeof(d), "%s%c%02x", objs_dir, PATH_SEP, b);
+#ifdef _WIN32
+    RemoveDirectoryA(d);
+#else
+    rmdir(d);
+#endif
+  }
+  sl_free(&objs);
+  sl_free(&live);
+  sl_free(&refs);
+  return 0;
+}
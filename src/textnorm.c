@@ -0,0 +1,631 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/textnorm.c
+ * Purpose: UTF-8 validation and text normalization for manuscript sources
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "ueng/textnorm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TN_X86_GNU 1
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TN_X86_MSVC 1
+#include <emmintrin.h>
+#include <intrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TN_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*------------------------------ ASCII fast path -----------------------------*/
+/* Each variant copies the leading run of "plain" bytes (0x01..0x7F except
+   CR) from src to dst and returns its length. Whole blocks are stored before
+   they are checked, so dst must have 32 bytes of slack past the run; callers
+   only use these while at least 32 input bytes remain and size dst with
+   textnorm_bound(). */
+
+static inline int plain(unsigned char b) { return b != 0 && b < 0x80 && b != '\r'; }
+
+static size_t ascii_tail(unsigned char *dst, const unsigned char *src, size_t i, size_t n)
+{
+  while (i < n && plain(src[i]))
+  {
+    dst[i] = src[i];
+    i++;
+  }
+  return i;
+}
+
+static unsigned ctz32(unsigned m)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long r;
+  _BitScanForward(&r, m);
+  return (unsigned)r;
+#else
+  return (unsigned)__builtin_ctz(m);
+#endif
+}
+
+#if defined(TN_X86_GNU) || defined(TN_X86_MSVC)
+#ifdef TN_X86_GNU
+__attribute__((target("sse2")))
+#endif
+static size_t ascii_copy_sse2(unsigned char *dst, const unsigned char *src, size_t n)
+{
+  const __m128i cr = _mm_set1_epi8('\r'), zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+    unsigned m = (unsigned)_mm_movemask_epi8(
+        _mm_or_si128(v, _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, zero))));
+    if (m)
+      return i + ctz32(m);
+  }
+  return ascii_tail(dst, src, i, n);
+}
+#endif
+
+#ifdef TN_X86_GNU
+__attribute__((target("avx2"))) static size_t ascii_copy_avx2(unsigned char *dst,
+                                                               const unsigned char *src, size_t n)
+{
+  const __m256i cr = _mm256_set1_epi8('\r'), zero = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), v);
+    unsigned m = (unsigned)_mm256_movemask_epi8(
+        _mm256_or_si256(v, _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, zero))));
+    if (m)
+      return i + ctz32(m);
+  }
+  return ascii_copy_sse2(dst + i, src + i, n - i) + i;
+}
+#endif
+
+#ifdef TN_X86_GNU
+/* Whole-block UTF-8 validation (the "lookup" algorithm of Keiser & Lemire,
+   "Validating UTF-8 In Less Than One Instruction Per Byte", 2021): three
+   nibble table lookups classify every (byte, previous byte) pair, and a
+   second check demands continuation bytes 2 and 3 after 3/4-byte leads.
+   Copies whole valid blocks without CR/NUL and returns the length copied,
+   backed up to the start of any sequence still open at the stop point. */
+static const unsigned char UTF8_T1[32] = {2,   2,   2,   2,   2,  2, 2,  2,  128, 128, 128,
+                                          128, 33,  1,   21,  73, 2, 2,  2,  2,   2,   2,
+                                          2,   2,   128, 128, 128, 128, 33, 1, 21, 73};
+static const unsigned char UTF8_T2[32] = {231, 163, 131, 131, 139, 203, 203, 203, 203, 203, 203,
+                                          203, 203, 219, 203, 203, 231, 163, 131, 131, 139, 203,
+                                          203, 203, 203, 203, 203, 203, 203, 219, 203, 203};
+static const unsigned char UTF8_T3[32] = {1,   1,   1, 1, 1, 1, 1, 1, 230, 174, 186,
+                                          186, 1,   1, 1, 1, 1, 1, 1, 1,   1,   1,
+                                          1,   1,   230, 174, 186, 186, 1, 1, 1, 1};
+
+__attribute__((target("avx2"))) static size_t utf8_copy_avx2(unsigned char *dst,
+                                                              const unsigned char *src, size_t n)
+{
+  const __m256i t1 = _mm256_loadu_si256((const __m256i *)UTF8_T1);
+  const __m256i t2 = _mm256_loadu_si256((const __m256i *)UTF8_T2);
+  const __m256i t3 = _mm256_loadu_si256((const __m256i *)UTF8_T3);
+  const __m256i nib = _mm256_set1_epi8(0x0F), cr = _mm256_set1_epi8('\r');
+  const __m256i zero = _mm256_setzero_si256(), hibit = _mm256_set1_epi8((char)0x80);
+  const __m256i third = _mm256_set1_epi8((char)(0xE0 - 0x80));
+  const __m256i fourth = _mm256_set1_epi8((char)(0xF0 - 0x80));
+  __m256i prev = zero;
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m256i in = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i ctl = _mm256_or_si256(_mm256_cmpeq_epi8(in, cr), _mm256_cmpeq_epi8(in, zero));
+    __m256i carry = _mm256_permute2x128_si256(prev, in, 0x21);
+    __m256i p1 = _mm256_alignr_epi8(in, carry, 15);
+    __m256i p2 = _mm256_alignr_epi8(in, carry, 14);
+    __m256i p3 = _mm256_alignr_epi8(in, carry, 13);
+    __m256i sc = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(t1, _mm256_and_si256(_mm256_srli_epi16(p1, 4), nib)),
+            _mm256_shuffle_epi8(t2, _mm256_and_si256(p1, nib))),
+        _mm256_shuffle_epi8(t3, _mm256_and_si256(_mm256_srli_epi16(in, 4), nib)));
+    __m256i must23 =
+        _mm256_or_si256(_mm256_subs_epu8(p2, third), _mm256_subs_epu8(p3, fourth));
+    __m256i err = _mm256_xor_si256(_mm256_and_si256(must23, hibit), sc);
+    err = _mm256_or_si256(err, ctl);
+    if (!_mm256_testz_si256(err, err))
+      break;
+    _mm256_storeu_si256((__m256i *)(dst + i), in);
+    prev = in;
+  }
+  if (i >= 1 && src[i - 1] >= 0xC0)
+    return i - 1;
+  if (i >= 2 && src[i - 2] >= 0xE0)
+    return i - 2;
+  if (i >= 3 && src[i - 3] >= 0xF0)
+    return i - 3;
+  return i;
+}
+#endif
+
+#ifdef TN_NEON
+static size_t ascii_copy_neon(unsigned char *dst, const unsigned char *src, size_t n)
+{
+  const uint8x16_t cr = vdupq_n_u8('\r'), zero = vdupq_n_u8(0), hi = vdupq_n_u8(0x80);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    uint8x16_t v = vld1q_u8(src + i);
+    vst1q_u8(dst + i, v);
+    uint8x16_t bad = vorrq_u8(vcgeq_u8(v, hi), vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, zero)));
+    if (vmaxvq_u8(bad))
+      return ascii_tail(dst, src, i, n);
+  }
+  return ascii_tail(dst, src, i, n);
+}
+#endif
+
+/* Portable fallback: 8 bytes per step with the classic "has zero byte" trick. */
+static size_t ascii_copy_swar(unsigned char *dst, const unsigned char *src, size_t n)
+{
+  const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    uint64_t x, c;
+    memcpy(&x, src + i, 8);
+    memcpy(dst + i, &x, 8);
+    c = x ^ (ones * '\r');
+    if ((x & highs) | ((x - ones) & ~x & highs) | ((c - ones) & ~c & highs))
+      return ascii_tail(dst, src, i, n);
+  }
+  return ascii_tail(dst, src, i, n);
+}
+
+typedef size_t (*AsciiCopyFn)(unsigned char *, const unsigned char *, size_t);
+
+static AsciiCopyFn pick_ascii_copy(void)
+{
+#if defined(TN_X86_GNU)
+  if (__builtin_cpu_supports("avx2"))
+    return ascii_copy_avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return ascii_copy_sse2;
+  return ascii_copy_swar;
+#elif defined(TN_X86_MSVC)
+  return ascii_copy_sse2;
+#elif defined(TN_NEON)
+  return ascii_copy_neon;
+#else
+  return ascii_copy_swar;
+#endif
+}
+
+/*------------------------------ code points ---------------------------------*/
+
+/* Windows-1252 0x80..0x9F; 0xA0..0xFF equal their Latin-1 code points.
+   The five undefined slots become U+FFFD. */
+static const uint16_t CP1252_C1[32] = {
+    0x20AC, 0xFFFD, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160,
+    0x2039, 0x0152, 0xFFFD, 0x017D, 0xFFFD, 0xFFFD, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022,
+    0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0xFFFD, 0x017E, 0x0178};
+
+static size_t put_utf8(unsigned char *o, uint32_t cp)
+{
+  if (cp < 0x80)
+  {
+    o[0] = (unsigned char)cp;
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    o[0] = (unsigned char)(0xC0 | (cp >> 6));
+    o[1] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    o[0] = (unsigned char)(0xE0 | (cp >> 12));
+    o[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    o[2] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  o[0] = (unsigned char)(0xF0 | (cp >> 18));
+  o[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+  o[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+  o[3] = (unsigned char)(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+/* Length of the well-formed UTF-8 sequence at p (Unicode 15, table 3-7):
+   >0 = valid, 0 = valid so far but cut off at 'avail', -1 = invalid. */
+static inline int utf8_seq(const unsigned char *p, size_t avail)
+{
+  unsigned char b = p[0];
+  int len;
+  unsigned char lo = 0x80, hi = 0xBF; /* range of the second byte */
+  if (b >= 0xC2 && b <= 0xDF)
+    len = 2;
+  else if (b >= 0xE0 && b <= 0xEF)
+  {
+    len = 3;
+    if (b == 0xE0)
+      lo = 0xA0;
+    else if (b == 0xED)
+      hi = 0x9F;
+  }
+  else if (b >= 0xF0 && b <= 0xF4)
+  {
+    len = 4;
+    if (b == 0xF0)
+      lo = 0x90;
+    else if (b == 0xF4)
+      hi = 0x8F;
+  }
+  else
+    return -1;
+  for (int k = 1; k < len; ++k)
+  {
+    if ((size_t)k >= avail)
+      return 0;
+    unsigned char c = p[k];
+    if (k == 1 ? (c < lo || c > hi) : (c < 0x80 || c > 0xBF))
+      return -1;
+  }
+  return len;
+}
+
+/* Emit one decoded code point with line-ending and NUL handling. */
+static size_t emit_cp(TextNorm *tn, uint32_t cp, unsigned char *o)
+{
+  if (tn->cr)
+  {
+    tn->cr = 0;
+    if (cp == '\n')
+      return 0;
+  }
+  if (cp == '\r')
+  {
+    tn->cr = 1;
+    tn->st.line_endings++;
+    o[0] = '\n';
+    return 1;
+  }
+  if (cp == 0)
+  {
+    tn->st.replaced++;
+    return 0;
+  }
+  return put_utf8(o, cp);
+}
+
+/*------------------------------ decoders ------------------------------------*/
+
+static size_t core_utf8(TextNorm *tn, const unsigned char *p, size_t n, int final,
+                        unsigned char *o, size_t *consumed)
+{
+  AsciiCopyFn copy = pick_ascii_copy();
+#ifdef TN_X86_GNU
+  int simd_utf8 = __builtin_cpu_supports("avx2");
+#endif
+  size_t i = 0, w = 0;
+  while (i < n)
+  {
+    if (tn->cr)
+    {
+      tn->cr = 0;
+      if (p[i] == '\n')
+      {
+        i++;
+        continue;
+      }
+    }
+    unsigned char b = p[i];
+    if (plain(b))
+    {
+      size_t run = (n - i >= 32) ? copy(o + w, p + i, n - i) : ascii_tail(o + w, p + i, 0, n - i);
+      i += run;
+      w += run;
+      continue;
+    }
+    if (b == '\r')
+    {
+      o[w++] = '\n';
+      tn->cr = 1;
+      tn->st.line_endings++;
+      i++;
+      continue;
+    }
+    if (b == 0)
+    {
+      tn->st.replaced++;
+      i++;
+      continue;
+    }
+#ifdef TN_X86_GNU
+    if (simd_utf8 && n - i >= 64)
+    {
+      size_t run = utf8_copy_avx2(o + w, p + i, n - i);
+      i += run;
+      w += run;
+      if (run)
+        continue;
+    }
+#endif
+    /* Stay in this loop while the text is non-ASCII (Cyrillic, CJK, ...). */
+    int len;
+    while ((len = utf8_seq(p + i, n - i)) > 0)
+    {
+      o[w] = p[i];
+      o[w + 1] = p[i + 1];
+      if (len > 2)
+        o[w + 2] = p[i + 2];
+      if (len > 3)
+        o[w + 3] = p[i + 3];
+      w += (size_t)len;
+      i += (size_t)len;
+      if (i >= n || p[i] < 0x80)
+        break;
+    }
+    if (len > 0)
+      continue;
+    if (len == 0 && !final)
+      break; /* keep the partial sequence for the next chunk */
+    b = p[i];
+    uint32_t cp = b < 0xA0 ? CP1252_C1[b - 0x80] : b;
+    w += put_utf8(o + w, cp);
+    tn->st.transcoded++;
+    i++;
+  }
+  *consumed = i;
+  return w;
+}
+
+static size_t core_utf16(TextNorm *tn, const unsigned char *p, size_t n, int final,
+                         unsigned char *o, size_t *consumed)
+{
+  int be = tn->st.encoding == TEXTNORM_UTF16BE;
+  size_t i = 0, w = 0;
+  while (i + 2 <= n)
+  {
+    uint32_t u = be ? ((uint32_t)p[i] << 8 | p[i + 1]) : ((uint32_t)p[i + 1] << 8 | p[i]);
+    size_t used = 2;
+    if (u >= 0xD800 && u <= 0xDBFF)
+    {
+      if (i + 4 > n && !final)
+        break;
+      uint32_t u2 = 0;
+      if (i + 4 <= n)
+        u2 = be ? ((uint32_t)p[i + 2] << 8 | p[i + 3]) : ((uint32_t)p[i + 3] << 8 | p[i + 2]);
+      if (u2 >= 0xDC00 && u2 <= 0xDFFF)
+      {
+        u = 0x10000 + ((u - 0xD800) << 10) + (u2 - 0xDC00);
+        used = 4;
+      }
+      else
+      {
+        u = 0xFFFD;
+        tn->st.replaced++;
+      }
+    }
+    else if (u >= 0xDC00 && u <= 0xDFFF)
+    {
+      u = 0xFFFD;
+      tn->st.replaced++;
+    }
+    w += emit_cp(tn, u, o + w);
+    i += used;
+  }
+  if (final && i < n) /* odd trailing byte */
+  {
+    tn->st.replaced++;
+    i = n;
+  }
+  *consumed = i;
+  return w;
+}
+
+static size_t core(TextNorm *tn, const unsigned char *p, size_t n, int final, unsigned char *o,
+                   size_t *consumed)
+{
+  if (tn->st.encoding == TEXTNORM_UTF8)
+    return core_utf8(tn, p, n, final, o, consumed);
+  return core_utf16(tn, p, n, final, o, consumed);
+}
+
+/* Pick the encoding from a BOM, or sniff BOM-less UTF-16 from NUL bytes
+   (ASCII text in UTF-16LE has a zero in every odd byte). 'base' is the
+   stream offset of s[0]. Returns the BOM length. */
+static size_t detect(TextNorm *tn, const unsigned char *head, size_t nh, const unsigned char *s,
+                     size_t n, size_t base)
+{
+  if (nh >= 3 && head[0] == 0xEF && head[1] == 0xBB && head[2] == 0xBF)
+  {
+    tn->st.had_bom = 1;
+    return 3;
+  }
+  if (nh >= 2 && head[0] == 0xFF && head[1] == 0xFE)
+  {
+    tn->st.encoding = TEXTNORM_UTF16LE;
+    tn->st.had_bom = 1;
+    return 2;
+  }
+  if (nh >= 2 && head[0] == 0xFE && head[1] == 0xFF)
+  {
+    tn->st.encoding = TEXTNORM_UTF16BE;
+    tn->st.had_bom = 1;
+    return 2;
+  }
+  size_t sample = n < 512 ? n : 512;
+  size_t z_even = 0, z_odd = 0;
+  for (size_t k = 0; k < sample; ++k)
+    if (s[k] == 0)
+    {
+      if ((base + k) & 1)
+        z_odd++;
+      else
+        z_even++;
+    }
+  size_t pairs = sample / 2;
+  if (pairs >= 8)
+  {
+    if (z_odd * 5 >= pairs * 2 && z_even * 20 <= z_odd)
+      tn->st.encoding = TEXTNORM_UTF16LE;
+    else if (z_even * 5 >= pairs * 2 && z_odd * 20 <= z_even)
+      tn->st.encoding = TEXTNORM_UTF16BE;
+  }
+  return 0;
+}
+
+/*------------------------------ public API ----------------------------------*/
+
+void textnorm_init(TextNorm *tn) { memset(tn, 0, sizeof(*tn)); }
+
+size_t textnorm_bound(size_t n) { return 3 * n + 48; }
+
+size_t textnorm_step(TextNorm *tn, const void *inv, size_t n, int final, char *outv)
+{
+  const unsigned char *in = (const unsigned char *)inv;
+  unsigned char *out = (unsigned char *)outv;
+  size_t w = 0, used = 0;
+  tn->st.bytes_in += n;
+
+  if (!tn->started)
+  {
+    if (tn->ncarry + n < 4 && !final)
+    {
+      memcpy(tn->carry + tn->ncarry, in, n);
+      tn->ncarry += n;
+      return 0;
+    }
+    unsigned char head[4];
+    size_t nh = 0;
+    for (size_t k = 0; k < tn->ncarry && nh < 4; ++k)
+      head[nh++] = tn->carry[k];
+    for (size_t k = 0; k < n && nh < 4; ++k)
+      head[nh++] = in[k];
+    size_t bom = detect(tn, head, nh, in, n, tn->ncarry);
+    tn->started = 1;
+    size_t from_carry = bom < tn->ncarry ? bom : tn->ncarry;
+    memmove(tn->carry, tn->carry + from_carry, tn->ncarry - from_carry);
+    tn->ncarry -= from_carry;
+    in += bom - from_carry;
+    n -= bom - from_carry;
+  }
+
+  /* Finish a sequence left over from the previous chunk. */
+  if (tn->ncarry)
+  {
+    unsigned char tmp[16];
+    size_t old = tn->ncarry, take = n < 8 ? n : 8;
+    memcpy(tmp, tn->carry, old);
+    memcpy(tmp + old, in, take);
+    w += core(tn, tmp, old + take, final && take == n, out, &used);
+    if (used < old)
+    {
+      tn->ncarry = old + take - used;
+      memmove(tn->carry, tmp + used, tn->ncarry);
+      tn->st.bytes_out += w;
+      return w;
+    }
+    in += used - old;
+    n -= used - old;
+    tn->ncarry = 0;
+  }
+
+  w += core(tn, in, n, final, out + w, &used);
+  tn->ncarry = n - used; /* at most 3 bytes: an incomplete sequence */
+  memcpy(tn->carry, in + used, tn->ncarry);
+  tn->st.bytes_out += w;
+  return w;
+}
+
+int textnorm_buffer(const void *in, size_t n, char **out, size_t *out_len, TextNormStats *st)
+{
+  if (!out)
+    return -1;
+  *out = NULL;
+  if (out_len)
+    *out_len = 0;
+  const size_t chunk = 256 * 1024;
+  size_t cap = n + 64, w = 0;
+  char *buf = (char *)malloc(cap);
+  if (!buf)
+    return -1;
+  TextNorm tn;
+  textnorm_init(&tn);
+  const unsigned char *p = (const unsigned char *)in;
+  size_t off = 0;
+  do
+  {
+    size_t take = n - off < chunk ? n - off : chunk;
+    int final = off + take == n;
+    size_t need = w + textnorm_bound(take) + 1;
+    if (need > cap)
+    {
+      size_t ncap = cap * 2 > need ? cap * 2 : need;
+      char *nb = (char *)realloc(buf, ncap);
+      if (!nb)
+      {
+        free(buf);
+        return -1;
+      }
+      buf = nb;
+      cap = ncap;
+    }
+    w += textnorm_step(&tn, p + off, take, final, buf + w);
+    off += take;
+  } while (off < n);
+  buf[w] = '\0';
+  *out = buf;
+  if (out_len)
+    *out_len = w;
+  if (st)
+    *st = tn.st;
+  return 0;
+}
+
+int textnorm_copy_stream(FILE *in, FILE *out, TextNormStats *st)
+{
+  const size_t chunk = 64 * 1024;
+  unsigned char *ibuf = (unsigned char *)malloc(chunk);
+  char *obuf = (char *)malloc(textnorm_bound(chunk));
+  if (!ibuf || !obuf)
+  {
+    free(ibuf);
+    free(obuf);
+    return -1;
+  }
+  TextNorm tn;
+  textnorm_init(&tn);
+  int rc = 0;
+  for (;;)
+  {
+    size_t got = fread(ibuf, 1, chunk, in);
+    int final = got < chunk && (feof(in) || ferror(in));
+    size_t w = textnorm_step(&tn, ibuf, got, final, obuf);
+    if (w && fwrite(obuf, 1, w, out) != w)
+    {
+      rc = -1;
+      break;
+    }
+    if (final)
+    {
+      if (ferror(in))
+        rc = -1;
+      break;
+    }
+  }
+  free(ibuf);
+  free(obuf);
+  if (st)
+    *st = tn.st;
+  return rc;
+}
@@ -0,0 +1,402 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/textstats.c
+ * Purpose: Single-pass manuscript statistics (words, sentences, structure)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#include "ueng/textstats.h"
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TS_X86_GNU 1
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TS_X86_MSVC 1
+#include <emmintrin.h>
+#include <intrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TS_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*------------------------------ bit helpers ---------------------------------*/
+
+static inline unsigned popcount64(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+  return (unsigned)__popcnt64(x);
+#elif defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  return (unsigned)((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+static inline unsigned ctz64(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+  unsigned long i;
+  _BitScanForward64(&i, x);
+  return (unsigned)i;
+#elif defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_ctzll(x);
+#else
+  unsigned n = 0;
+  while (!(x & 1))
+  {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/* Bits [a, b) set; 0 <= a <= b <= 64. */
+static inline uint64_t bit_range(unsigned a, unsigned b)
+{
+  uint64_t hi = b >= 64 ? ~0ull : (1ull << b) - 1;
+  uint64_t lo = a >= 64 ? ~0ull : (1ull << a) - 1;
+  return hi & ~lo;
+}
+
+/*------------------------------ classification ------------------------------*/
+/* One bit per byte of a 64-byte block. */
+
+typedef struct
+{
+  uint64_t ws, nl, term, digit, close;
+} Masks;
+
+static inline int is_ws(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+static inline int is_close(unsigned char c)
+{
+  return c == '"' || c == '\'' || c == ')' || c == '*' || c == '_';
+}
+
+static void classify_scalar(const unsigned char *p, Masks *m)
+{
+  memset(m, 0, sizeof(*m));
+  for (unsigned i = 0; i < 64; ++i)
+  {
+    unsigned char c = p[i];
+    uint64_t b = 1ull << i;
+    m->ws |= is_ws(c) ? b : 0;
+    m->nl |= c == '\n' ? b : 0;
+    m->term |= (c == '.' || c == '!' || c == '?') ? b : 0;
+    m->digit |= (c >= '0' && c <= '9') ? b : 0;
+    m->close |= is_close(c) ? b : 0;
+  }
+}
+
+#if defined(TS_X86_GNU) || defined(TS_X86_MSVC)
+#ifdef TS_X86_GNU
+__attribute__((target("sse2")))
+#endif
+static void classify_sse2(const unsigned char *p, Masks *m)
+{
+  memset(m, 0, sizeof(*m));
+  for (unsigned i = 0; i < 64; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+#define EQ(c) _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+    /* Signed compares are fine: every range tested is below 0x80. */
+    __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+    __m128i dig = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i term = _mm_or_si128(EQ('.'), _mm_or_si128(EQ('!'), EQ('?')));
+    __m128i close = _mm_or_si128(_mm_or_si128(EQ('"'), EQ('\'')),
+                                 _mm_or_si128(EQ(')'), _mm_or_si128(EQ('*'), EQ('_'))));
+    m->ws |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(ctl, EQ(' '))) << i;
+    m->nl |= (uint64_t)(unsigned)_mm_movemask_epi8(EQ('\n')) << i;
+    m->term |= (uint64_t)(unsigned)_mm_movemask_epi8(term) << i;
+    m->digit |= (uint64_t)(unsigned)_mm_movemask_epi8(dig) << i;
+    m->close |= (uint64_t)(unsigned)_mm_movemask_epi8(close) << i;
+#undef EQ
+  }
+}
+#endif
+
+#ifdef TS_X86_GNU
+__attribute__((target("avx2"))) static void classify_avx2(const unsigned char *p, Masks *m)
+{
+  memset(m, 0, sizeof(*m));
+  for (unsigned i = 0; i < 64; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+#define EQ(c) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+    __m256i ctl = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                   _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+    __m256i dig = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                   _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i term = _mm256_or_si256(EQ('.'), _mm256_or_si256(EQ('!'), EQ('?')));
+    __m256i close = _mm256_or_si256(_mm256_or_si256(EQ('"'), EQ('\'')),
+                                    _mm256_or_si256(EQ(')'), _mm256_or_si256(EQ('*'), EQ('_'))));
+    m->ws |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(ctl, EQ(' '))) << i;
+    m->nl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(EQ('\n')) << i;
+    m->term |= (uint64_t)(uint32_t)_mm256_movemask_epi8(term) << i;
+    m->digit |= (uint64_t)(uint32_t)_mm256_movemask_epi8(dig) << i;
+    m->close |= (uint64_t)(uint32_t)_mm256_movemask_epi8(close) << i;
+#undef EQ
+  }
+}
+#endif
+
+#ifdef TS_NEON
+static inline uint64_t neon_mask16(uint8x16_t v)
+{
+  static const uint8_t w[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t t = vandq_u8(v, vld1q_u8(w));
+  return (uint64_t)vaddv_u8(vget_low_u8(t)) | ((uint64_t)vaddv_u8(vget_high_u8(t)) << 8);
+}
+
+static void classify_neon(const unsigned char *p, Masks *m)
+{
+  memset(m, 0, sizeof(*m));
+  for (unsigned i = 0; i < 64; i += 16)
+  {
+    uint8x16_t v = vld1q_u8(p + i);
+#define EQ(c) vceqq_u8(v, vdupq_n_u8(c))
+    uint8x16_t ctl = vandq_u8(vcgeq_u8(v, vdupq_n_u8('\t')), vcleq_u8(v, vdupq_n_u8('\r')));
+    uint8x16_t dig = vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9')));
+    uint8x16_t term = vorrq_u8(EQ('.'), vorrq_u8(EQ('!'), EQ('?')));
+    uint8x16_t close =
+        vorrq_u8(vorrq_u8(EQ('"'), EQ('\'')), vorrq_u8(EQ(')'), vorrq_u8(EQ('*'), EQ('_'))));
+    m->ws |= neon_mask16(vorrq_u8(ctl, EQ(' '))) << i;
+    m->nl |= neon_mask16(EQ('\n')) << i;
+    m->term |= neon_mask16(term) << i;
+    m->digit |= neon_mask16(dig) << i;
+    m->close |= neon_mask16(close) << i;
+#undef EQ
+  }
+}
+#endif
+
+typedef void (*ClassifyFn)(const unsigned char *, Masks *);
+
+static ClassifyFn pick_classify(void)
+{
+#if defined(TS_X86_GNU)
+  if (__builtin_cpu_supports("avx2"))
+    return classify_avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return classify_sse2;
+  return classify_scalar;
+#elif defined(TS_X86_MSVC)
+  return classify_sse2;
+#elif defined(TS_NEON)
+  return classify_neon;
+#else
+  return classify_scalar;
+#endif
+}
+
+/*------------------------------ line structure ------------------------------*/
+
+typedef struct
+{
+  const char *s;
+  size_t n;
+  TextStats *st;
+  TextStatsHeadingFn on_heading;
+  void *ud;
+  char fence;     /* '`' or '~' while inside a fenced code block */
+  int in_para;    /* the previous line continued a paragraph */
+  uint64_t marks; /* Markdown markers the word popcount took for words */
+} Lines;
+
+static inline int is_blank(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+/* Length of a block marker at p ("> ", "- ", "* ", "+ ", "12. ", "3) "),
+   or 0. Each is one whitespace-delimited run, i.e. one counted word. */
+static size_t block_marker(const char *p, const char *end)
+{
+  if (p < end && (*p == '>' || *p == '-' || *p == '*' || *p == '+'))
+    return (p + 1 == end || is_blank(p[1])) ? 1 : 0;
+  size_t d = 0;
+  while (p + d < end && d < 9 && p[d] >= '0' && p[d] <= '9')
+    d++;
+  if (d == 0 || p + d == end || (p[d] != '.' && p[d] != ')'))
+    return 0;
+  return (p + d + 1 == end || is_blank(p[d + 1])) ? d + 1 : 0;
+}
+
+/* Classify the line starting at 'pos'; returns 1 when it is code. */
+static int line_start(Lines *L, size_t pos)
+{
+  const char *s = L->s, *end = s + L->n;
+  const char *p = s + pos;
+  unsigned ind = 0;
+  while (p < end && *p == ' ' && ind < 4)
+  {
+    p++;
+    ind++;
+  }
+  if (ind < 4 && end - p >= 3 && (*p == '`' || *p == '~') && p[1] == *p && p[2] == *p)
+  {
+    if (!L->fence)
+      L->fence = *p;
+    else if (L->fence == *p)
+      L->fence = 0;
+    L->st->code_lines++;
+    L->in_para = 0;
+    return 1;
+  }
+  if (L->fence)
+  {
+    L->st->code_lines++;
+    return 1;
+  }
+  const char *q = p;
+  while (q < end && (*q == ' ' || *q == '\t'))
+    q++;
+  if (q == end || *q == '\n')
+  {
+    L->in_para = 0; /* blank */
+    return 0;
+  }
+  if (ind < 4 && *p == '#')
+  {
+    int level = 0;
+    while (p + level < end && p[level] == '#')
+      level++;
+    if (level <= 6 && (p + level == end || p[level] == ' ' || p[level] == '\t' || p[level] == '\n'))
+    {
+      const char *a = p + level;
+      const char *b = memchr(a, '\n', (size_t)(end - a));
+      if (!b)
+        b = end;
+      while (a < b && (*a == ' ' || *a == '\t'))
+        a++;
+      while (b > a && (b[-1] == ' ' || b[-1] == '\t'))
+        b--;
+      /* Optional closing sequence: "## Title ##". */
+      const char *c = b;
+      while (c > a && c[-1] == '#')
+        c--;
+      L->marks++; /* the opening '#'s */
+      if (c < b && (c == a || c[-1] == ' ' || c[-1] == '\t'))
+      {
+        L->marks++; /* the closing ones */
+        b = c;
+        while (b > a && (b[-1] == ' ' || b[-1] == '\t'))
+          b--;
+      }
+      L->st->headings++;
+      L->in_para = 0;
+      if (L->on_heading)
+        L->on_heading(L->ud, pos, level, a, (size_t)(b - a));
+      return 0;
+    }
+  }
+  /* Blockquote and list markers, possibly nested ("> - item"). */
+  for (size_t k; (k = block_marker(q, end)) != 0;)
+  {
+    L->marks++;
+    q += k;
+    while (q < end && (*q == ' ' || *q == '\t'))
+      q++;
+  }
+  if (!L->in_para)
+  {
+    L->st->paragraphs++;
+    L->in_para = 1;
+  }
+  return 0;
+}
+
+/*------------------------------ driver --------------------------------------*/
+
+void textstats_scan(const char *s, size_t n, TextStats *st, TextStatsHeadingFn on_heading,
+                    void *ud)
+{
+  if (!st)
+    return;
+  memset(st, 0, sizeof(*st));
+  st->bytes = n;
+  if (!s || !n)
+    return;
+  ClassifyFn classify = pick_classify();
+  Lines L = {s, n, st, on_heading, ud, 0, 0, 0};
+
+  uint64_t prev_nl = 1; /* a line starts at offset 0 */
+  uint64_t prev_ns = 0, prev_term = 0, prev_after = 0, prev_digit = 0;
+  int code = 0; /* the current line is code */
+  unsigned char tail[64];
+  for (size_t base = 0; base < n; base += 64)
+  {
+    size_t avail = n - base;
+    const unsigned char *p = (const unsigned char *)s + base;
+    if (avail < 64)
+    {
+      /* Pad with spaces: they start no word and end a pending sentence. */
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, p, avail);
+      p = tail;
+    }
+    Masks m;
+    classify(p, &m);
+    uint64_t valid = avail < 64 ? bit_range(0, (unsigned)avail) : ~0ull;
+
+    /* Line starts: the byte after each newline. Segments between them
+       inherit the code/prose state of their line. */
+    uint64_t starts = ((m.nl << 1) | prev_nl) & valid;
+    uint64_t code_mask = 0;
+    unsigned from = 0;
+    while (starts)
+    {
+      unsigned k = ctz64(starts);
+      starts &= starts - 1;
+      if (code)
+        code_mask |= bit_range(from, k);
+      code = line_start(&L, base + k);
+      from = k;
+    }
+    if (code)
+      code_mask |= bit_range(from, 64);
+
+    uint64_t ns = ~m.ws & valid;
+    st->words += popcount64(ns & ~((ns << 1) | prev_ns) & ~code_mask);
+
+    uint64_t term = m.term & ~((m.digit << 1) | prev_digit);
+    uint64_t after = (term << 1) | prev_term;             /* right after . ! ? */
+    uint64_t closed = m.close & after;                    /* one closing mark */
+    uint64_t after2 = after | (closed << 1) | prev_after; /* ... or after that */
+    st->sentences += popcount64(m.ws & after2 & ~code_mask);
+
+    st->lines += popcount64(m.nl & valid);
+    prev_nl = m.nl >> 63;
+    prev_ns = ns >> 63;
+    prev_term = term >> 63;
+    prev_after = closed >> 63;
+    prev_digit = m.digit >> 63;
+  }
+  if (n % 64 == 0 && !code)
+  {
+    /* No padding block followed: a sentence may end exactly at the end. */
+    st->sentences += (prev_term | prev_after) != 0;
+  }
+  if (s[n - 1] != '\n')
+    st->lines++;
+  st->words -= L.marks; /* every marker started one of the counted runs */
+}
+
+void textstats_add(TextStats *a, const TextStats *b)
+{
+  if (!a || !b)
+    return;
+  a->bytes += b->bytes;
+  a->lines += b->lines;
+  a->words += b->words;
+  a->sentences += b->sentences;
+  a->paragraphs += b->paragraphs;
+  a->headings += b->headings;
+  a->code_lines += b->code_lines;
+}
@@ -0,0 +1,254 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/trace.c
+ * Purpose: Timed spans written as a Chrome trace-event file (--trace)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "ueng/trace.h"
+#include "ueng/common.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h> /* getpid */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define UENG_TLS __declspec(thread)
+#else
+#define UENG_TLS _Thread_local
+#endif
+
+#define TRACE_MAX_EVENTS ((size_t)1 << 20) /* per thread; later spans are counted, not kept */
+
+typedef struct
+{
+  const char *cat, *name, *arg; /* arg lives in the buffer's arena */
+  double t0, dur;               /* ms, ueng_now_ms clock */
+} TraceEvent;
+
+typedef struct TraceBuf
+{
+  TraceEvent *ev;
+  size_t n, cap, dropped;
+  UengArena mem;
+  int tid;
+  int named; /* thread_name record already written */
+  char name[48];
+  struct TraceBuf *next;
+} TraceBuf;
+
+static int g_on;
+static FILE *g_out;
+static double g_base; /* ts 0 in the file */
+static long g_pid;
+static int g_first = 1; /* no event written yet (separator) */
+static ueng_mutex_t g_mu; /* buffer list and file */
+static TraceBuf *g_bufs;
+static int g_next_tid = 1;
+static UENG_TLS TraceBuf *tl_buf;
+
+static TraceBuf *my_buf(void)
+{
+  TraceBuf *b = tl_buf;
+  if (b)
+    return b;
+  b = (TraceBuf *)calloc(1, sizeof(*b));
+  if (!b)
+    return NULL;
+  ueng_mutex_lock(&g_mu);
+  b->tid = g_next_tid++;
+  if (b->tid == 1)
+    snprintf(b->name, sizeof(b->name), "main");
+  else
+    snprintf(b->name, sizeof(b->name), "thread %d", b->tid);
+  b->next = g_bufs;
+  g_bufs = b;
+  ueng_mutex_unlock(&g_mu);
+  tl_buf = b;
+  return b;
+}
+
+/*------------------------------ writing -------------------------------------*/
+
+static void put_json_str(FILE *f, const char *s)
+{
+  fputc('"', f);
+  for (const unsigned char *p = (const unsigned char *)s; *p; ++p)
+  {
+    if (*p == '"' || *p == '\\')
+      fprintf(f, "\\%c", *p);
+    else if (*p < 0x20)
+      fprintf(f, "\\u%04x", *p);
+    else
+      fputc(*p, f);
+  }
+  fputc('"', f);
+}
+
+static void sep(void)
+{
+  fputs(g_first ? "\n" : ",\n", g_out);
+  g_first = 0;
+}
+
+/* Caller holds g_mu. */
+static void write_buf(TraceBuf *b)
+{
+  if (!b->named)
+  {
+    sep();
+    fprintf(g_out,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%d,\"args\":{\"name\":",
+            g_pid, b->tid);
+    put_json_str(g_out, b->name);
+    fputs("}}", g_out);
+    b->named = 1;
+  }
+  for (size_t i = 0; i < b->n; ++i)
+  {
+    const TraceEvent *e = &b->ev[i];
+    sep();
+    fputs("{\"name\":", g_out);
+    put_json_str(g_out, e->name);
+    fputs(",\"cat\":", g_out);
+    put_json_str(g_out, e->cat);
+    fprintf(g_out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%d",
+            (e->t0 - g_base) * 1000.0, e->dur * 1000.0, g_pid, b->tid);
+    if (e->arg)
+    {
+      fputs(",\"args\":{\"detail\":", g_out);
+      put_json_str(g_out, e->arg);
+      fputc('}', g_out);
+    }
+    fputc('}', g_out);
+  }
+  b->n = 0;
+  ueng_arena_free(&b->mem);
+}
+
+/* atexit: every other thread is idle or gone by now. */
+static void trace_finish(void)
+{
+  if (!g_on)
+    return;
+  ueng_mutex_lock(&g_mu);
+  size_t dropped = 0;
+  for (TraceBuf *b = g_bufs; b; b = b->next)
+  {
+    write_buf(b);
+    dropped += b->dropped;
+  }
+  fputs("\n]\n", g_out);
+  fclose(g_out);
+  g_out = NULL;
+  g_on = 0;
+  ueng_mutex_unlock(&g_mu);
+  if (dropped)
+    fprintf(stderr, "[trace] WARN: %zu spans dropped (buffer full)\n", dropped);
+}
+
+/*------------------------------ API -----------------------------------------*/
+
+int ueng_trace_start(const char *path)
+{
+  if (g_on || !path || !*path)
+    return -1;
+  if (mkpath_parent(path) != 0)
+    return -1;
+  g_out = ueng_fopen(path, "wb");
+  if (!g_out)
+    return -1;
+  ueng_mutex_init(&g_mu);
+#ifdef _WIN32
+  g_pid = (long)GetCurrentProcessId();
+#else
+  g_pid = (long)getpid();
+#endif
+  g_base = ueng_now_ms();
+  fputc('[', g_out);
+  sep();
+  fprintf(g_out,
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"args\":{\"name\":\"uaengine\"}}",
+          g_pid);
+  g_on = 1;
+  atexit(trace_finish);
+  (void)my_buf(); /* the starting thread is "main" */
+  return 0;
+}
+
+int ueng_trace_on(void) { return g_on; }
+
+double ueng_trace_begin(void) { return g_on ? ueng_now_ms() : 0.0; }
+
+void ueng_trace_end_arg(const char *cat, const char *name, double t0, const char *detail)
+{
+  if (!g_on || t0 == 0.0)
+    return;
+  double t1 = ueng_now_ms();
+  TraceBuf *b = my_buf();
+  if (!b)
+    return;
+  if (b->n == b->cap)
+  {
+    size_t cap = b->cap ? b->cap * 2 : 256;
+    TraceEvent *ev = cap <= TRACE_MAX_EVENTS
+                         ? (TraceEvent *)realloc(b->ev, cap * sizeof(TraceEvent))
+                         : NULL;
+    if (!ev)
+    {
+      b->dropped++;
+      return;
+    }
+    b->ev = ev;
+    b->cap = cap;
+  }
+  TraceEvent *e = &b->ev[b->n++];
+  e->cat = cat ? cat : "";
+  e->name = name ? name : "";
+  e->arg = detail ? ueng_arena_strdup(&b->mem, detail) : NULL;
+  e->t0 = t0;
+  e->dur = t1 - t0;
+}
+
+void ueng_trace_end(const char *cat, const char *name, double t0)
+{
+  ueng_trace_end_arg(cat, name, t0, NULL);
+}
+
+void ueng_trace_thread_name(const char *name)
+{
+  if (!g_on || !name)
+    return;
+  TraceBuf *b = my_buf();
+  if (b && !b->named)
+    snprintf(b->name, sizeof(b->name), "%s", name);
+}
+
+void ueng_trace_flush(void)
+{
+  if (!g_on || !tl_buf)
+    return;
+  ueng_mutex_lock(&g_mu);
+  if (g_out)
+  {
+    write_buf(tl_buf);
+    fflush(g_out);
+  }
+  ueng_mutex_unlock(&g_mu);
+}
+
+/*------------------------------ End of file --------------------------------*/
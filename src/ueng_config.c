@@ -13,13 +13,15 @@
  * - We intentionally parse a *flat* subset of YAML: "key: value" pairs only.
  * - Comments start with '#' and are ignored (tolerated anywhere on a line).
  * - Unknown keys are ignored on purpose to allow forward evolution.
- * - This module is *loosely coupled*: it does not include other project
- *   headers and can be compiled as-is in any C17 toolchain.
+ * - This module is *loosely coupled*: apart from common.h (PATH_MAX and
+ *   replace_file, for rewriting the file in place) it does not include
+ *   other project headers.
  * - To keep the rest of the code unchanged, we also provide a helper
  *   to export a few environment variables that existing code already
  *   reads (UENG_LLM_PROVIDER, UENG_LLM_MODEL, etc.).
  *---------------------------------------------------------------------------*/
 #include "ueng/config.h"
+#include "ueng/common.h" /* PATH_MAX, replace_file */
 
 #include <stdio.h>  /* FILE, fopen, fgets */
 #include <stdlib.h> /* getenv, strtol */
@@ -98,6 +100,23 @@ static void set_env_if(const char *name, const char *value, int overwrite)
 #endif
 }
 
+/* positive_int: tuning knobs; anything unparsable or <= 0 means "default" (0). */
+static int positive_int(const char *s)
+{
+  long v = strtol(s, NULL, 10);
+  return (v > 0 && v <= 1 << 20) ? (int)v : 0;
+}
+
+/* set_env_int_if: set_env_if for the integer knobs; 0 (default) is not exported. */
+static void set_env_int_if(const char *name, int value, int overwrite)
+{
+  if (value <= 0)
+    return;
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", value);
+  set_env_if(name, buf, overwrite);
+}
+
 /*------------------------------ API impl ------------------------------------*/
 
 void ueng_config_defaults(UengConfig *c)
@@ -119,6 +138,7 @@ void ueng_config_defaults(UengConfig *c)
   c->openai_base_url[0] = '\0';
   c->ollama_host[0] = '\0'; /* default Ollama host can be inferred by the backend if empty */
   c->llama_model_path[0] = '\0';
+  c->llama_draft_model_path[0] = '\0';
 }
 
 static void apply_kv(UengConfig *c, const char *key, const char *value)
@@ -151,6 +171,38 @@ static void apply_kv(UengConfig *c, const char *key, const char *value)
   {
     copy_str(c->llama_model_path, sizeof(c->llama_model_path), value);
   }
+  else if (strcmp(key, "llama.draft_model_path") == 0)
+  {
+    copy_str(c->llama_draft_model_path, sizeof(c->llama_draft_model_path), value);
+  }
+  else if (strcmp(key, "llama.draft_max") == 0)
+  {
+    c->llama_draft_max = positive_int(value);
+  }
+  else if (strcmp(key, "llama.max_tokens") == 0)
+  {
+    c->llama_max_tokens = positive_int(value);
+  }
+  else if (strcmp(key, "llama.n_batch") == 0)
+  {
+    c->llama_n_batch = positive_int(value);
+  }
+  else if (strcmp(key, "llama.n_ubatch") == 0)
+  {
+    c->llama_n_ubatch = positive_int(value);
+  }
+  else if (strcmp(key, "llama.n_threads") == 0)
+  {
+    c->llama_n_threads = positive_int(value);
+  }
+  else if (strcmp(key, "llama.session_dir") == 0)
+  {
+    copy_str(c->llama_session_dir, sizeof(c->llama_session_dir), value);
+  }
+  else if (strcmp(key, "llama.session_max_mb") == 0)
+  {
+    c->llama_session_max_mb = positive_int(value);
+  }
   else if (strcmp(key, "serve.host") == 0)
   {
     copy_str(c->serve_host, sizeof(c->serve_host), value);
@@ -225,6 +277,22 @@ void ueng_config_apply_env(UengConfig *c)
     copy_str(c->ollama_host, sizeof(c->ollama_host), s);
   if ((s = getenv("UENG_LLAMA_MODEL_PATH")) && *s)
     copy_str(c->llama_model_path, sizeof(c->llama_model_path), s);
+  if ((s = getenv("UENG_LLAMA_DRAFT_MODEL_PATH")) && *s)
+    copy_str(c->llama_draft_model_path, sizeof(c->llama_draft_model_path), s);
+  if ((s = getenv("UENG_LLAMA_DRAFT_MAX")) && *s)
+    c->llama_draft_max = positive_int(s);
+  if ((s = getenv("UENG_LLAMA_MAX_TOKENS")) && *s)
+    c->llama_max_tokens = positive_int(s);
+  if ((s = getenv("UENG_LLAMA_N_BATCH")) && *s)
+    c->llama_n_batch = positive_int(s);
+  if ((s = getenv("UENG_LLAMA_N_UBATCH")) && *s)
+    c->llama_n_ubatch = positive_int(s);
+  if ((s = getenv("UENG_LLAMA_N_THREADS")) && *s)
+    c->llama_n_threads = positive_int(s);
+  if ((s = getenv("UENG_LLAMA_SESSION_DIR")) && *s)
+    copy_str(c->llama_session_dir, sizeof(c->llama_session_dir), s);
+  if ((s = getenv("UENG_LLAMA_SESSION_MAX_MB")) && *s)
+    c->llama_session_max_mb = positive_int(s);
 
   if ((s = getenv("UENG_SERVE_HOST")) && *s)
     copy_str(c->serve_host, sizeof(c->serve_host), s);
@@ -250,6 +318,14 @@ void ueng_config_export_env(const UengConfig *c, int overwrite)
   set_env_if("UENG_OPENAI_BASE_URL", c->openai_base_url, overwrite);
   set_env_if("UENG_OLLAMA_HOST", c->ollama_host, overwrite);
   set_env_if("UENG_LLAMA_MODEL_PATH", c->llama_model_path, overwrite);
+  set_env_if("UENG_LLAMA_DRAFT_MODEL_PATH", c->llama_draft_model_path, overwrite);
+  set_env_int_if("UENG_LLAMA_DRAFT_MAX", c->llama_draft_max, overwrite);
+  set_env_int_if("UENG_LLAMA_MAX_TOKENS", c->llama_max_tokens, overwrite);
+  set_env_int_if("UENG_LLAMA_N_BATCH", c->llama_n_batch, overwrite);
+  set_env_int_if("UENG_LLAMA_N_UBATCH", c->llama_n_ubatch, overwrite);
+  set_env_int_if("UENG_LLAMA_N_THREADS", c->llama_n_threads, overwrite);
+  set_env_if("UENG_LLAMA_SESSION_DIR", c->llama_session_dir, overwrite);
+  set_env_int_if("UENG_LLAMA_SESSION_MAX_MB", c->llama_session_max_mb, overwrite);
   /* We intentionally do not export OPENAI_API_KEY automatically for security;
    * users should set it explicitly via an environment variable or secrets store. */
   char portbuf[16];
@@ -260,6 +336,105 @@ void ueng_config_export_env(const UengConfig *c, int overwrite)
   set_env_if("UENG_SITE_ROOT", c->site_root, overwrite);
 }
 
+/* line_key_is: does 'line' set 'key' ("key:" after optional indentation)? */
+static int line_key_is(const char *line, const char *key)
+{
+  while (*line == ' ' || *line == '\t')
+    line++;
+  size_t k = strlen(key);
+  if (strncmp(line, key, k) != 0)
+    return 0;
+  line += k;
+  while (*line == ' ' || *line == '\t')
+    line++;
+  return *line == ':';
+}
+
+/* put_line: 'line' with its value replaced by 'value', written to 'f'. */
+static void put_line(FILE *f, const char *line, const char *value)
+{
+  const char *colon = strchr(line, ':');
+  const char *v = colon + 1;
+  while (*v == ' ' || *v == '\t')
+    v++;
+  const char *hash = strchr(v, '#');
+  fwrite(line, 1, (size_t)(v - line), f);
+  fputs(value, f);
+  if (hash)
+  {
+    /* keep the comment where it was when the new value leaves room */
+    int pad = (int)(hash - v) - (int)strlen(value);
+    fprintf(f, "%*s%s", pad > 1 ? pad : 1, "", hash);
+    if (!strchr(hash, '\n'))
+      fputc('\n', f);
+  }
+  else
+  {
+    fputc('\n', f);
+  }
+}
+
+int ueng_config_update_file(const char *path, const char *const *keys, const char *const *values,
+                            size_t n)
+{
+  if (!path || !*path || (n && (!keys || !values)))
+    return 1;
+  char tmp[PATH_MAX + 8];
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    return 2;
+  FILE *in = fopen(path, "r"); /* absent: start an empty file */
+  FILE *out = fopen(tmp, "w");
+  if (!out)
+  {
+    if (in)
+      fclose(in);
+    return 2;
+  }
+  unsigned char done[64] = {0};
+  if (n > sizeof(done))
+    n = sizeof(done);
+  char line[1024];
+  int bol = 1; /* at the start of a line (long lines arrive in pieces) */
+  while (in && fgets(line, sizeof(line), in))
+  {
+    int whole = bol;
+    bol = strchr(line, '\n') != NULL;
+    whole = whole && (bol || feof(in));
+    size_t k = n;
+    if (whole)
+      for (k = 0; k < n && !line_key_is(line, keys[k]); ++k)
+        ;
+    if (k < n)
+    {
+      put_line(out, line, values[k]);
+      done[k] = 1;
+      bol = 1;
+    }
+    else
+    {
+      fputs(line, out);
+    }
+  }
+  if (!bol)
+    fputc('\n', out);
+  for (size_t k = 0; k < n; ++k)
+    if (!done[k])
+      fprintf(out, "%s: %s\n", keys[k], values[k]);
+  if (in)
+    fclose(in);
+  if (fclose(out) != 0)
+  {
+    remove(tmp);
+    return 3;
+  }
+  if (replace_file(tmp, path) != 0)
+  {
+    remove(tmp);
+    return 3;
+  }
+  return 0;
+}
+
 int ueng_config_init_from(const char *file_or_null, UengConfig *out)
 {
   if (!out)
@@ -0,0 +1,361 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: src/zip.c
+ * Purpose: Minimal streaming ZIP writer (stored + deflate entries)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *
+ * Notes for contributors:
+ * - Format reference: PKWARE APPNOTE.TXT, sections 4.3.7 (local header),
+ *   4.3.12 (central directory) and 4.3.16 (end of central directory).
+ * - Sizes and CRCs are known before a member is written (blobs are finished
+ *   in memory), so we never need data descriptors (general purpose bit 3).
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "ueng/zip.h"
+#include "ueng/common.h"
+#include "ueng/hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef UENG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/*------------------------------- blob helpers -------------------------------*/
+
+static int blob_reserve(UengZipBlob *b, size_t extra)
+{
+  if (b->len + extra <= b->cap)
+    return 0;
+  size_t nc = b->cap ? b->cap * 2 : 16 * 1024;
+  while (nc < b->len + extra)
+    nc *= 2;
+  unsigned char *np = (unsigned char *)realloc(b->data, nc);
+  if (!np)
+    return -1;
+  b->data = np;
+  b->cap = nc;
+  return 0;
+}
+
+int zip_blob_begin(UengZipBlob *b, int method)
+{
+  if (!b)
+    return -1;
+  memset(b, 0, sizeof(*b));
+  b->method = UENG_ZIP_STORED;
+#ifdef UENG_HAVE_ZLIB
+  if (method == UENG_ZIP_DEFLATE)
+  {
+    z_stream *zs = (z_stream *)calloc(1, sizeof(*zs));
+    if (!zs)
+      return -1;
+    /* Negative window bits = raw deflate (no zlib header), as ZIP expects. */
+    if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      free(zs);
+      return -1;
+    }
+    b->z = zs;
+    b->method = UENG_ZIP_DEFLATE;
+  }
+#else
+  (void)method;
+#endif
+  return 0;
+}
+
+#ifdef UENG_HAVE_ZLIB
+/* Run deflate over 'len' input bytes (flush = Z_NO_FLUSH or Z_FINISH). */
+static int blob_deflate(UengZipBlob *b, const void *data, size_t len, int flush)
+{
+  z_stream *zs = (z_stream *)b->z;
+  zs->next_in = (Bytef *)data;
+  zs->avail_in = (uInt)len;
+  for (;;)
+  {
+    if (blob_reserve(b, 16 * 1024) != 0)
+      return -1;
+    zs->next_out = b->data + b->len;
+    zs->avail_out = (uInt)(b->cap - b->len);
+    int rc = deflate(zs, flush);
+    b->len = b->cap - zs->avail_out;
+    if (rc == Z_STREAM_END)
+      return 0;
+    if (rc != Z_OK && rc != Z_BUF_ERROR)
+      return -1;
+    if (flush == Z_NO_FLUSH && zs->avail_in == 0)
+      return 0;
+  }
+}
+#endif
+
+int zip_blob_write(UengZipBlob *b, const void *data, size_t len)
+{
+  if (!b || (!data && len))
+    return -1;
+  if (len == 0)
+    return 0;
+  b->crc = ueng_crc32(b->crc, data, len);
+  b->raw_size += len;
+#ifdef UENG_HAVE_ZLIB
+  if (b->z)
+  {
+    /* Feed in slices that fit zlib's 32-bit avail_in. */
+    const unsigned char *p = (const unsigned char *)data;
+    while (len)
+    {
+      size_t n = len > (1u << 30) ? (1u << 30) : len;
+      if (blob_deflate(b, p, n, Z_NO_FLUSH) != 0)
+        return -1;
+      p += n;
+      len -= n;
+    }
+    return 0;
+  }
+#endif
+  if (blob_reserve(b, len) != 0)
+    return -1;
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  return 0;
+}
+
+int zip_blob_end(UengZipBlob *b)
+{
+  if (!b)
+    return -1;
+#ifdef UENG_HAVE_ZLIB
+  if (b->z)
+  {
+    int rc = blob_deflate(b, NULL, 0, Z_FINISH);
+    deflateEnd((z_stream *)b->z);
+    free(b->z);
+    b->z = NULL;
+    return rc;
+  }
+#endif
+  return 0;
+}
+
+void zip_blob_free(UengZipBlob *b)
+{
+  if (!b)
+    return;
+#ifdef UENG_HAVE_ZLIB
+  if (b->z)
+  {
+    deflateEnd((z_stream *)b->z);
+    free(b->z);
+  }
+#endif
+  free(b->data);
+  memset(b, 0, sizeof(*b));
+}
+
+/*------------------------------- archive writer -----------------------------*/
+
+typedef struct
+{
+  char *name;
+  uint32_t crc, csize, usize, offset;
+  uint16_t method;
+} ZipCdEntry;
+
+struct UengZip
+{
+  FILE *f;
+  uint64_t offset;
+  ZipCdEntry *ents;
+  size_t count, cap;
+  uint16_t dos_time, dos_date;
+  int failed;
+};
+
+static void put16(unsigned char *p, uint16_t v)
+{
+  p[0] = (unsigned char)(v & 0xFF);
+  p[1] = (unsigned char)(v >> 8);
+}
+static void put32(unsigned char *p, uint32_t v)
+{
+  p[0] = (unsigned char)(v & 0xFF);
+  p[1] = (unsigned char)((v >> 8) & 0xFF);
+  p[2] = (unsigned char)((v >> 16) & 0xFF);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+static int zwrite(UengZip *z, const void *p, size_t n)
+{
+  if (z->failed)
+    return -1;
+  if (n && fwrite(p, 1, n, z->f) != n)
+  {
+    z->failed = 1;
+    return -1;
+  }
+  z->offset += n;
+  return 0;
+}
+
+UengZip *zip_create(const char *path)
+{
+  if (!path || mkpath_parent(path) != 0)
+    return NULL;
+  UengZip *z = (UengZip *)calloc(1, sizeof(*z));
+  if (!z)
+    return NULL;
+  z->f = ueng_fopen(path, "wb");
+  if (!z->f)
+  {
+    free(z);
+    return NULL;
+  }
+  /* One timestamp for every member keeps archives reproducible within a run. */
+  time_t now = time(NULL);
+  struct tm lt;
+#ifdef _WIN32
+  localtime_s(&lt, &now);
+#else
+  localtime_r(&now, &lt);
+#endif
+  z->dos_time = (uint16_t)((lt.tm_hour << 11) | (lt.tm_min << 5) | (lt.tm_sec / 2));
+  z->dos_date = (uint16_t)(((lt.tm_year - 80) << 9) | ((lt.tm_mon + 1) << 5) | lt.tm_mday);
+  return z;
+}
+
+static int zip_add_raw(UengZip *z, const char *name, const unsigned char *data, size_t len,
+                       uint64_t raw_size, uint32_t crc, int method)
+{
+  if (!z || !name || z->failed)
+    return -1;
+  size_t nlen = strlen(name);
+  if (nlen > 0xFFFF || z->count >= 0xFFFF || z->offset + 30 + nlen + len > 0xFFFFFFFFull ||
+      raw_size > 0xFFFFFFFFull)
+  {
+    fprintf(stderr, "[zip] ERROR: %s exceeds ZIP (non-Zip64) limits\n", name);
+    z->failed = 1;
+    return -1;
+  }
+  if (z->count == z->cap)
+  {
+    size_t nc = z->cap ? z->cap * 2 : 64;
+    ZipCdEntry *ne = (ZipCdEntry *)realloc(z->ents, nc * sizeof(*ne));
+    if (!ne)
+      return -1;
+    z->ents = ne;
+    z->cap = nc;
+  }
+  ZipCdEntry *e = &z->ents[z->count];
+  e->name = (char *)malloc(nlen + 1);
+  if (!e->name)
+    return -1;
+  memcpy(e->name, name, nlen + 1);
+  e->crc = crc;
+  e->csize = (uint32_t)len;
+  e->usize = (uint32_t)raw_size;
+  e->offset = (uint32_t)z->offset;
+  e->method = (uint16_t)method;
+  z->count++;
+
+  unsigned char h[30];
+  put32(h + 0, 0x04034b50u);
+  put16(h + 4, 20); /* version needed: 2.0 (deflate) */
+  put16(h + 6, 0);  /* flags */
+  put16(h + 8, e->method);
+  put16(h + 10, z->dos_time);
+  put16(h + 12, z->dos_date);
+  put32(h + 14, e->crc);
+  put32(h + 18, e->csize);
+  put32(h + 22, e->usize);
+  put16(h + 26, (uint16_t)nlen);
+  put16(h + 28, 0); /* no extra field (EPUB requires this for 'mimetype') */
+  if (zwrite(z, h, sizeof(h)) != 0 || zwrite(z, name, nlen) != 0 || zwrite(z, data, len) != 0)
+    return -1;
+  return 0;
+}
+
+int zip_add_blob(UengZip *z, const char *name, const UengZipBlob *b)
+{
+  if (!b || b->z)
+    return -1; /* blob must be finished with zip_blob_end() */
+  return zip_add_raw(z, name, b->data, b->len, b->raw_size, b->crc, b->method);
+}
+
+int zip_add_bytes(UengZip *z, const char *name, const void *data, size_t len, int method)
+{
+  UengZipBlob b;
+  if (zip_blob_begin(&b, method) != 0)
+    return -1;
+  int rc = zip_blob_write(&b, data, len);
+  if (rc == 0)
+    rc = zip_blob_end(&b);
+  if (rc == 0)
+    rc = zip_add_blob(z, name, &b);
+  zip_blob_free(&b);
+  return rc;
+}
+
+int zip_close(UengZip *z)
+{
+  if (!z)
+    return -1;
+  int rc = z->failed ? -1 : 0;
+  uint64_t cd_start = z->offset;
+  for (size_t i = 0; i < z->count && rc == 0; ++i)
+  {
+    const ZipCdEntry *e = &z->ents[i];
+    size_t nlen = strlen(e->name);
+    unsigned char h[46];
+    put32(h + 0, 0x02014b50u);
+    put16(h + 4, 20); /* version made by */
+    put16(h + 6, 20); /* version needed */
+    put16(h + 8, 0);
+    put16(h + 10, e->method);
+    put16(h + 12, z->dos_time);
+    put16(h + 14, z->dos_date);
+    put32(h + 16, e->crc);
+    put32(h + 20, e->csize);
+    put32(h + 24, e->usize);
+    put16(h + 28, (uint16_t)nlen);
+    put16(h + 30, 0); /* extra */
+    put16(h + 32, 0); /* comment */
+    put16(h + 34, 0); /* disk */
+    put16(h + 36, 0); /* internal attrs */
+    put32(h + 38, 0); /* external attrs */
+    put32(h + 42, e->offset);
+    if (zwrite(z, h, sizeof(h)) != 0 || zwrite(z, e->name, nlen) != 0)
+      rc = -1;
+  }
+  if (rc == 0)
+  {
+    unsigned char eocd[22];
+    put32(eocd + 0, 0x06054b50u);
+    put16(eocd + 4, 0);
+    put16(eocd + 6, 0);
+    put16(eocd + 8, (uint16_t)z->count);
+    put16(eocd + 10, (uint16_t)z->count);
+    put32(eocd + 12, (uint32_t)(z->offset - cd_start));
+    put32(eocd + 16, (uint32_t)cd_start);
+    put16(eocd + 20, 0);
+    if (zwrite(z, eocd, sizeof(eocd)) != 0)
+      rc = -1;
+  }
+  if (fclose(z->f) != 0)
+    rc = -1;
+  for (size_t i = 0; i < z->count; ++i)
+    free(z->ents[i].name);
+  free(z->ents);
+  free(z);
+  return rc;
+}
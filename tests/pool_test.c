@@ -0,0 +1,303 @@
+/*-----------------------------------------------------------------------------
+ * Umicom AuthorEngine AI (uaengine)
+ * File: tests/pool_test.c
+ * Purpose: pool_test - checks of the work-stealing task pool (src/pool.c)
+ *
+ * Created by: Umicom Foundation (https://umicom.foundation/)
+ * Author: Sammy Hegab + contributors
+ * License: MIT
+ *---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------
+ * Module notes:
+ *   - Registered with ctest (`ctest -R pool`). Each check prints one line;
+ *     any failure makes the exit status 1.
+ *   - Covers spawn/wait (with and without workers), nested groups waiting
+ *     inside tasks, stealing when every task sits in one worker's deque,
+ *     cancellation, and pool shutdown with tasks nobody waited for.
+ *   - The stealing check cannot hang: the task that owns the deque waits
+ *     with a deadline and fails instead.
+ *---------------------------------------------------------------------------*/
+#ifndef _WIN32
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+#include "ueng/common.h"
+#include "ueng/pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STEAL_DEADLINE_MS 10000.0
+
+static int g_failed;
+
+static void check(int ok, const char *what)
+{
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  if (!ok)
+    g_failed = 1;
+}
+
+/* A counter tasks bump under a lock; waiters can sleep on it. */
+typedef struct
+{
+  ueng_mutex_t mu;
+  ueng_cond_t cv;
+  long n;
+} Counter;
+
+static void counter_init(Counter *c)
+{
+  ueng_mutex_init(&c->mu);
+  ueng_cond_init(&c->cv);
+  c->n = 0;
+}
+
+static void counter_free(Counter *c)
+{
+  ueng_cond_destroy(&c->cv);
+  ueng_mutex_destroy(&c->mu);
+}
+
+static void counter_add(Counter *c)
+{
+  ueng_mutex_lock(&c->mu);
+  c->n++;
+  ueng_cond_broadcast(&c->cv);
+  ueng_mutex_unlock(&c->mu);
+}
+
+static long counter_get(Counter *c)
+{
+  ueng_mutex_lock(&c->mu);
+  long n = c->n;
+  ueng_mutex_unlock(&c->mu);
+  return n;
+}
+
+/*------------------------------ spawn / wait --------------------------------*/
+
+typedef struct
+{
+  long *out;
+  long i;
+} Square;
+
+static void square_task(void *arg)
+{
+  Square *s = (Square *)arg;
+  s->out[s->i] = s->i * s->i;
+}
+
+static void test_spawn_wait(int workers)
+{
+  enum
+  {
+    N = 10000
+  };
+  UengPool *p = ueng_pool_create(workers);
+  long *out = (long *)calloc(N, sizeof(long));
+  Square *args = (Square *)calloc(N, sizeof(Square));
+  int ok = p && out && args;
+  if (ok)
+  {
+    UengTaskGroup g;
+    ueng_group_init(&g, p);
+    for (long i = 0; i < N; ++i)
+    {
+      args[i].out = out;
+      args[i].i = i;
+      ueng_group_spawn(&g, square_task, &args[i]);
+    }
+    ueng_group_wait(&g);
+    for (long i = 0; i < N && ok; ++i)
+      ok = out[i] == i * i;
+    ok = ok && g.pending == 0;
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "spawn/wait: %d tasks, %d workers", N, workers);
+  check(ok, what);
+  free(args);
+  free(out);
+  ueng_pool_destroy(p);
+}
+
+/*------------------------------ nested spawn --------------------------------*/
+
+typedef struct
+{
+  UengPool *pool;
+  Counter *leaves;
+  int depth;
+} Node;
+
+/* Each node spawns two children into its own group and waits for them from
+   inside the task, so every level blocks a thread that must keep working. */
+static void node_task(void *arg)
+{
+  Node *n = (Node *)arg;
+  if (n->depth == 0)
+  {
+    counter_add(n->leaves);
+    return;
+  }
+  Node kids[2];
+  UengTaskGroup g;
+  ueng_group_init(&g, n->pool);
+  for (int k = 0; k < 2; ++k)
+  {
+    kids[k] = *n;
+    kids[k].depth = n->depth - 1;
+    ueng_group_spawn(&g, node_task, &kids[k]);
+  }
+  ueng_group_wait(&g);
+}
+
+static void test_nested(int workers)
+{
+  enum
+  {
+    DEPTH = 12
+  };
+  UengPool *p = ueng_pool_create(workers);
+  Counter leaves;
+  counter_init(&leaves);
+  if (p)
+  {
+    Node root = {p, &leaves, DEPTH};
+    UengTaskGroup g;
+    ueng_group_init(&g, p);
+    ueng_group_spawn(&g, node_task, &root);
+    ueng_group_wait(&g);
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "nested spawn: depth %d, %d workers", DEPTH, workers);
+  check(p && counter_get(&leaves) == 1L << DEPTH, what);
+  counter_free(&leaves);
+  ueng_pool_destroy(p);
+}
+
+/*------------------------------ stealing under skew -------------------------*/
+
+typedef struct
+{
+  UengPool *pool;
+  Counter *done;
+  int n;
+  int stolen;        /* out: all n finished while the owner ran none of them */
+  Counter *finished; /* bumped when skew_task returns */
+} Skew;
+
+static void leaf_task(void *arg) { counter_add((Counter *)arg); }
+
+/* Runs on a worker: every leaf lands in this worker's own deque, and the
+   owner does not run them, so only thieves can finish them. */
+static void skew_task(void *arg)
+{
+  Skew *s = (Skew *)arg;
+  UengTaskGroup g;
+  ueng_group_init(&g, s->pool);
+  for (int i = 0; i < s->n; ++i)
+    ueng_group_spawn(&g, leaf_task, s->done);
+  double t0 = ueng_now_ms();
+  Counter *c = s->done;
+  ueng_mutex_lock(&c->mu);
+  while (c->n < s->n && ueng_now_ms() - t0 < STEAL_DEADLINE_MS)
+    ueng_cond_timedwait(&c->cv, &c->mu, 50.0);
+  s->stolen = c->n == s->n;
+  ueng_mutex_unlock(&c->mu);
+  ueng_group_wait(&g); /* on failure, finish them here */
+  counter_add(s->finished);
+}
+
+static void test_steal(int workers)
+{
+  UengPool *p = ueng_pool_create(workers);
+  Counter done, finished;
+  counter_init(&done);
+  counter_init(&finished);
+  Skew s = {p, &done, 256, 0, &finished};
+  if (p)
+  {
+    /* Sleep rather than ueng_group_wait, which would run skew_task on this
+       thread: it has to start on a worker for its spawns to go to a deque. */
+    UengTaskGroup g;
+    ueng_group_init(&g, p);
+    ueng_group_spawn(&g, skew_task, &s);
+    ueng_mutex_lock(&finished.mu);
+    while (finished.n == 0)
+      ueng_cond_wait(&finished.cv, &finished.mu);
+    ueng_mutex_unlock(&finished.mu);
+    ueng_group_wait(&g);
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "stealing under skew: %d tasks, %d workers", s.n, workers);
+  check(p && s.stolen && counter_get(&done) == s.n, what);
+  counter_free(&finished);
+  counter_free(&done);
+  ueng_pool_destroy(p);
+}
+
+/*------------------------------ cancel --------------------------------------*/
+
+static void test_cancel(void)
+{
+  /* No workers: nothing runs until the wait, so the cancel is deterministic. */
+  UengPool *p = ueng_pool_create(0);
+  Counter ran;
+  counter_init(&ran);
+  UengTaskGroup g;
+  ueng_group_init(&g, p);
+  for (int i = 0; i < 100; ++i)
+    ueng_group_spawn(&g, leaf_task, &ran);
+  ueng_group_cancel(&g);
+  ueng_group_wait(&g);
+  check(p && ueng_group_cancelled(&g) && g.pending == 0 && counter_get(&ran) == 0,
+        "cancel: queued tasks are dropped");
+  counter_free(&ran);
+  ueng_pool_destroy(p);
+}
+
+/*------------------------------ shutdown ------------------------------------*/
+
+static void test_shutdown(int workers)
+{
+  enum
+  {
+    N = 1000,
+    ROUNDS = 50
+  };
+  int ok = 1;
+  for (int r = 0; r < ROUNDS && ok; ++r)
+  {
+    UengPool *p = ueng_pool_create(workers);
+    Counter ran;
+    counter_init(&ran);
+    UengTaskGroup g;
+    ueng_group_init(&g, p);
+    /* Half the rounds queue work nobody waits for: destroy must run it. */
+    int n = (r & 1) ? N : 0;
+    for (int i = 0; i < n; ++i)
+      ueng_group_spawn(&g, leaf_task, &ran);
+    ueng_pool_destroy(p);
+    ok = p && counter_get(&ran) == n && g.pending == 0;
+    counter_free(&ran);
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "shutdown: %d create/destroy rounds, %d workers", ROUNDS, workers);
+  check(ok, what);
+}
+
+int main(void)
+{
+  test_spawn_wait(0);
+  test_spawn_wait(4);
+  test_nested(0);
+  test_nested(3);
+  test_steal(3);
+  test_cancel();
+  test_shutdown(0);
+  test_shutdown(4);
+  return g_failed;
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# Umicom AuthorEngine AI (uaengine)
+# File: tests/smoke/mock_llm_server.py
+# Purpose: Local stand-in for the Chat Completions API (no key, no network)
+#
+# Created by: Umicom Foundation (https://umicom.foundation/)
+# Author: Sammy Hegab + contributors
+# License: MIT
+# -----------------------------------------------------------------------------
+# Answers POST /v1/chat/completions with a fixed reply, as one JSON body or as
+# server-sent events when the request asks for "stream": true. HTTP/1.1
+# keep-alive is on, and every new TCP connection is logged, so connection
+# reuse can be checked from the client's counters and from this log:
+#
+#   python3 tests/smoke/mock_llm_server.py 8089 &
+#   export MISTRAL_API_KEY=test UENG_MISTRAL_BASE_URL=http://127.0.0.1:8089
+#   UENG_LLM_PROVIDER=mistral ./build/uaengine llm-selftest mock --repeat 20
+#
+# Optional second argument: delay in ms before each reply (latency tests).
+# -----------------------------------------------------------------------------
+import http.server
+import json
+import socketserver
+import sys
+import time
+
+REPLY = ["Hello", " from", " the", " mock", " server", "."]
+DELAY = 0.0
+CONNECTIONS = 0
+REQUESTS = 0
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        global CONNECTIONS
+        super().setup()
+        CONNECTIONS += 1
+        sys.stderr.write("[mock] connection %d from %s:%d\n" % ((CONNECTIONS,) + self.client_address))
+
+    def do_POST(self):
+        global REQUESTS
+        n = int(self.headers.get("Content-Length", "0"))
+        try:
+            req = json.loads(self.rfile.read(n) or b"{}")
+        except ValueError:
+            self.send_error(400)
+            return
+        if self.path != "/v1/chat/completions" or not self.headers.get("Authorization"):
+            self.send_error(404 if self.headers.get("Authorization") else 401)
+            return
+        REQUESTS += 1
+        if DELAY:
+            time.sleep(DELAY)
+        model = req.get("model", "mock")
+        usage = {"prompt_tokens": 8, "completion_tokens": len(REPLY), "total_tokens": 8 + len(REPLY)}
+        if req.get("stream"):
+            self.send_response(200)
+            self.send_header("Content-Type", "text/event-stream")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            events = [{"model": model, "choices": [{"index": 0, "delta": {"role": "assistant"}}]}]
+            events += [{"model": model, "choices": [{"index": 0, "delta": {"content": p}}]} for p in REPLY]
+            events.append({"model": model, "choices": [], "usage": usage})
+            for ev in events:
+                self._chunk(("data: %s\n\n" % json.dumps(ev)).encode())
+            self._chunk(b"data: [DONE]\n\n")
+            self._chunk(b"")
+            return
+        body = json.dumps({
+            "model": model,
+            "choices": [{"index": 0, "message": {"role": "assistant", "content": "".join(REPLY)},
+                         "finish_reason": "stop"}],
+            "usage": usage,
+        }).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def _chunk(self, data):
+        self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+        self.wfile.flush()
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+if __name__ == "__main__":
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8089
+    DELAY = (float(sys.argv[2]) / 1000.0) if len(sys.argv) > 2 else 0.0
+    sys.stderr.write("[mock] listening on http://127.0.0.1:%d\n" % port)
+    try:
+        Server(("127.0.0.1", port), Handler).serve_forever()
+    except KeyboardInterrupt:
+        sys.stderr.write("[mock] %d requests on %d connections\n" % (REQUESTS, CONNECTIONS))